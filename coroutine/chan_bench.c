@@ -0,0 +1,299 @@
+// Messages per second through channels (sync.h) between the coroutines of
+// one schedule.
+//
+//   pingpong: two coroutines bounce a message --messages times over two
+//             channels of capacity 1. "polling" is the same over two
+//             global slots that the receiver polls with coroutine_yield.
+//   pipeline: a producer sends --messages messages through --stages
+//             coroutines, each receiving from one channel of capacity
+//             --cap and sending to the next, to a consumer.
+//   mutex:    --lockers coroutines take a mutex --messages times in all,
+//             yielding while they hold it, so that every unlock hands the
+//             mutex over to a waiter.
+// A wait group tells when the coroutines of a run are done. Each channel
+// run is made with plain channels ("mpmc") and with CO_CHAN_SPSC, and the
+// pipeline also with unbounded channels.
+//
+// Usage: chan_bench [--messages=N] [--stages=N] [--cap=N] [--lockers=N]
+//                   [--private_stacks]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sync.h"
+
+static long FLAGS_messages = 2000000;
+static int FLAGS_stages = 4;
+static int FLAGS_cap = 64;
+static int FLAGS_lockers = 16;
+static int FLAGS_private_stacks = 0;
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static struct schedule *S;
+static struct co_waitgroup wg;
+static struct co_chan **chans;  // chans[i] feeds stage i
+static struct co_mutex mutex;
+static long counter;
+static double finished;
+
+static void spawn(coroutine_func func, void *ud) {
+  int mode =
+      FLAGS_private_stacks ? COROUTINE_STACK_PRIVATE : COROUTINE_STACK_SHARED;
+  int id = coroutine_new_mode(S, func, ud, mode);
+  if (id < 0) {
+    fprintf(stderr, "cannot create coroutine\n");
+    exit(1);
+  }
+  coroutine_wake(S, id);
+}
+
+static void done(void) { co_waitgroup_done(&wg); }
+
+static void waiter(struct schedule *S, void *ud) {
+  (void)S;
+  (void)ud;
+  co_waitgroup_wait(&wg);
+  finished = now_seconds();
+}
+
+// Run the coroutines spawned by start, n of them, and return the seconds
+// it took them to finish.
+static double run(void (*start)(void), int n) {
+  S = coroutine_open();
+  co_waitgroup_init(&wg, S);
+  co_waitgroup_add(&wg, n);
+  spawn(waiter, NULL);
+  start();
+  double begin = now_seconds();
+  while (coroutine_run_ready(S) > 0) {
+  }
+  if (S->nco != 0) {
+    fprintf(stderr, "%d coroutines stuck\n", S->nco);
+    exit(1);
+  }
+  coroutine_close(S);
+  return finished - begin;
+}
+
+static int chan_cap;
+static int chan_flags;
+
+static void open_chans(int n) {
+  chans = malloc(sizeof(struct co_chan *) * n);
+  int i;
+  for (i = 0; i < n; i++) {
+    chans[i] = co_chan_new(S, sizeof(long), chan_cap, chan_flags);
+  }
+}
+
+static void close_chans(int n) {
+  int i;
+  for (i = 0; i < n; i++) {
+    co_chan_delete(chans[i]);
+  }
+  free(chans);
+}
+
+static void ping(struct schedule *S, void *ud) {
+  (void)S;
+  (void)ud;
+  long i, v;
+  for (i = 0; i < FLAGS_messages / 2; i++) {
+    co_chan_send(chans[0], &i);
+    co_chan_recv(chans[1], &v);
+  }
+  done();
+}
+
+static void pong(struct schedule *S, void *ud) {
+  (void)S;
+  (void)ud;
+  long v;
+  while (co_chan_recv(chans[0], &v)) {
+    co_chan_send(chans[1], &v);
+    if (v == FLAGS_messages / 2 - 1) {
+      break;
+    }
+  }
+  done();
+}
+
+static void start_pingpong(void) {
+  open_chans(2);
+  spawn(ping, NULL);
+  spawn(pong, NULL);
+}
+
+// Globals polled with coroutine_yield: what there was before channels.
+static volatile long slots[2];
+static volatile int full[2];
+
+static void poll_ping(struct schedule *S, void *ud) {
+  (void)ud;
+  long i;
+  for (i = 0; i < FLAGS_messages / 2; i++) {
+    slots[0] = i;
+    full[0] = 1;
+    while (!full[1]) coroutine_yield(S);
+    full[1] = 0;
+  }
+  done();
+}
+
+static void poll_pong(struct schedule *S, void *ud) {
+  (void)ud;
+  long i;
+  for (i = 0; i < FLAGS_messages / 2; i++) {
+    while (!full[0]) coroutine_yield(S);
+    full[0] = 0;
+    slots[1] = slots[0];
+    full[1] = 1;
+  }
+  done();
+}
+
+static void start_polling(void) {
+  spawn(poll_ping, NULL);
+  spawn(poll_pong, NULL);
+}
+
+static void producer(struct schedule *S, void *ud) {
+  (void)S;
+  (void)ud;
+  long i;
+  for (i = 0; i < FLAGS_messages; i++) {
+    co_chan_send(chans[0], &i);
+  }
+  co_chan_close(chans[0]);
+  done();
+}
+
+static void stage(struct schedule *S, void *ud) {
+  (void)S;
+  long k = (long)(intptr_t)ud;
+  long v;
+  while (co_chan_recv(chans[k], &v)) {
+    co_chan_send(chans[k + 1], &v);
+  }
+  co_chan_close(chans[k + 1]);
+  done();
+}
+
+static void consumer(struct schedule *S, void *ud) {
+  (void)S;
+  (void)ud;
+  long v, expect = 0;
+  while (co_chan_recv(chans[FLAGS_stages], &v)) {
+    if (v != expect++) {
+      fprintf(stderr, "pipeline: got %ld, want %ld\n", v, expect - 1);
+      exit(1);
+    }
+  }
+  done();
+}
+
+static void start_pipeline(void) {
+  open_chans(FLAGS_stages + 1);
+  spawn(producer, NULL);
+  int i;
+  for (i = 0; i < FLAGS_stages; i++) {
+    spawn(stage, (void *)(intptr_t)i);
+  }
+  spawn(consumer, NULL);
+}
+
+static void locker(struct schedule *S, void *ud) {
+  (void)ud;
+  long i;
+  for (i = 0; i < FLAGS_messages / FLAGS_lockers; i++) {
+    co_mutex_lock(&mutex);
+    long v = counter;
+    coroutine_yield(S);
+    counter = v + 1;
+    co_mutex_unlock(&mutex);
+  }
+  done();
+}
+
+static void start_mutex(void) {
+  co_mutex_init(&mutex, S);
+  counter = 0;
+  int i;
+  for (i = 0; i < FLAGS_lockers; i++) {
+    spawn(locker, NULL);
+  }
+}
+
+static void report(const char *bench, const char *impl, long messages,
+                   double secs) {
+  printf("%s\t%s\t%ld\t%.0f\t%.1f\n", bench, impl, messages, messages / secs,
+         secs * 1e9 / messages);
+}
+
+static void bench_pingpong(const char *impl, int flags) {
+  chan_cap = 1;
+  chan_flags = flags;
+  double secs = run(start_pingpong, 2);
+  close_chans(2);
+  report("pingpong", impl, FLAGS_messages, secs);
+}
+
+static void bench_pipeline(const char *impl, int cap, int flags) {
+  chan_cap = cap;
+  chan_flags = flags;
+  double secs = run(start_pipeline, FLAGS_stages + 2);
+  close_chans(FLAGS_stages + 1);
+  report("pipeline", impl, FLAGS_messages, secs);
+}
+
+int main(int argc, char **argv) {
+  int i;
+  for (i = 1; i < argc; i++) {
+    unsigned long long n;
+    char junk;
+    if (sscanf(argv[i], "--messages=%llu%c", &n, &junk) == 1) {
+      FLAGS_messages = (long)n;
+    } else if (sscanf(argv[i], "--stages=%llu%c", &n, &junk) == 1) {
+      FLAGS_stages = (int)n;
+    } else if (sscanf(argv[i], "--cap=%llu%c", &n, &junk) == 1) {
+      FLAGS_cap = (int)n;
+    } else if (sscanf(argv[i], "--lockers=%llu%c", &n, &junk) == 1) {
+      FLAGS_lockers = (int)n;
+    } else if (strcmp(argv[i], "--private_stacks") == 0) {
+      FLAGS_private_stacks = 1;
+    } else {
+      fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+  if (FLAGS_messages < 2 || FLAGS_stages <= 0 || FLAGS_cap <= 0 ||
+      FLAGS_lockers <= 0) {
+    fprintf(stderr, "need --messages >= 2 and the other flags > 0\n");
+    return 1;
+  }
+
+  printf("bench\timpl\tmessages\tmessages_per_sec\tns_per_message\n");
+  bench_pingpong("mpmc", 0);
+  bench_pingpong("spsc", CO_CHAN_SPSC);
+  double secs = run(start_polling, 2);
+  report("pingpong", "polling", FLAGS_messages, secs);
+
+  bench_pipeline("mpmc", FLAGS_cap, 0);
+  bench_pipeline("spsc", FLAGS_cap, CO_CHAN_SPSC);
+  bench_pipeline("unbounded", CO_CHAN_UNBOUNDED, 0);
+
+  secs = run(start_mutex, FLAGS_lockers);
+  long locks = FLAGS_messages / FLAGS_lockers * FLAGS_lockers;
+  if (counter != locks) {
+    fprintf(stderr, "mutex: counter %ld, want %ld\n", counter, locks);
+    return 1;
+  }
+  report("mutex", "handoff", locks, secs);
+  return 0;
+}
@@ -0,0 +1,65 @@
+#include "co_task.h"
+
+namespace co {
+
+namespace {
+
+constexpr std::size_t kFrameClasses = kFrameMaxCached / kFrameGranularity;
+
+struct free_frame {
+  free_frame* next;
+};
+
+// Freed frames of this thread, by size class.
+struct frame_cache {
+  free_frame* free[kFrameClasses] = {};
+  std::size_t nfree[kFrameClasses] = {};
+
+  ~frame_cache() {
+    for (std::size_t c = 0; c < kFrameClasses; c++) {
+      while (free[c] != nullptr) {
+        free_frame* f = free[c];
+        free[c] = f->next;
+        ::operator delete(f);
+      }
+    }
+  }
+};
+
+thread_local frame_cache cache;
+
+}  // namespace
+
+void* frame_alloc(std::size_t size) {
+  std::size_t units = (size + kFrameGranularity - 1) / kFrameGranularity;
+  if (units == 0 || units > kFrameClasses) {
+    return ::operator new(size);
+  }
+  std::size_t c = units - 1;
+  if (cache.free[c] != nullptr) {
+    free_frame* f = cache.free[c];
+    cache.free[c] = f->next;
+    cache.nfree[c]--;
+    return f;
+  }
+  return ::operator new(units * kFrameGranularity);
+}
+
+void frame_free(void* p, std::size_t size) {
+  std::size_t units = (size + kFrameGranularity - 1) / kFrameGranularity;
+  if (units == 0 || units > kFrameClasses) {
+    ::operator delete(p);
+    return;
+  }
+  std::size_t c = units - 1;
+  if (cache.nfree[c] == kFrameMaxFree) {
+    ::operator delete(p);
+    return;
+  }
+  free_frame* f = static_cast<free_frame*>(p);
+  f->next = cache.free[c];
+  cache.free[c] = f;
+  cache.nfree[c]++;
+}
+
+}  // namespace co
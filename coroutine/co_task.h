@@ -0,0 +1,480 @@
+#pragma once
+
+// Stackless C++20 coroutines on top of the schedule of coroutine.h.
+//
+// A co::task<T> is a coroutine frame on the heap, a few hundred bytes at
+// most, where a stackful coroutine needs a stack (or a saved copy of one).
+// Tasks are lazy: a task starts when it is co_awaited, handed to
+// co::spawn, or awaited from a stackful coroutine with co::await.
+// Awaiting a task transfers control to it directly (symmetric transfer),
+// and its completion transfers back to the awaiter, without going through
+// the scheduler and without growing the stack. Frames come from a
+// per-thread cache of recycled frames (co::frame_alloc).
+//
+// Tasks run on the schedule's run queue: a task that suspends on the
+// schedule (co::yield, co::sleep) is resumed by coroutine_run_ready, or by
+// reactor_run, in turn with the stackful coroutines and on the thread
+// stack. The two kinds await each other:
+//   - a task awaits a stackful coroutine with co_await co::stackful(S, f):
+//     f runs on a new stackful coroutine, free to block on anything, and
+//     the task resumes with its result once f returns;
+//   - a stackful coroutine awaits a task with co::await(S, task): the
+//     task starts right away on the current stack, and the coroutine
+//     parks until it completes.
+//
+// co::generator<T> is a synchronous, lazily evaluated sequence, produced
+// with co_yield and consumed with a range-for loop.
+//
+// Destroy a task only when it is not suspended on the schedule, i.e.
+// before it starts or once it has completed.
+//
+// Symmetric transfer only keeps the stack flat if the compiler turns the
+// transfer into a tail call. Clang always does; GCC only with
+// -foptimize-sibling-calls (on from -O2), so code with long chains of
+// tasks that complete at once must be built with it.
+
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "coroutine.h"
+
+namespace co {
+
+// Coroutine frames are allocated in multiples of kFrameGranularity bytes.
+// Freed frames up to kFrameMaxCached bytes are kept for reuse by the same
+// thread, at most kFrameMaxFree of each size.
+constexpr std::size_t kFrameGranularity = 64;
+constexpr std::size_t kFrameMaxCached = 4096;
+constexpr std::size_t kFrameMaxFree = 1024;
+
+void* frame_alloc(std::size_t size);
+void frame_free(void* p, std::size_t size);
+
+template <typename T = void>
+class task;
+
+template <typename T>
+T await(struct schedule* S, task<T> t);
+inline void spawn(struct schedule* S, task<void> t);
+
+namespace detail {
+
+// Resumes the coroutine at "address", from the run queue.
+inline void resume_posted(void* address) {
+  std::coroutine_handle<>::from_address(address).resume();
+}
+
+// Out of memory for the run queue, h could never be resumed, and whoever
+// awaits it would wait forever.
+inline void post(struct schedule* S, std::coroutine_handle<> h) noexcept {
+  if (coroutine_post(S, resume_posted, h.address()) != 0) {
+    std::terminate();
+  }
+}
+
+// Coroutine frames of the promise types deriving from this come from
+// frame_alloc.
+struct frame_allocated {
+  static void* operator new(std::size_t size) { return frame_alloc(size); }
+  static void operator delete(void* p, std::size_t size) {
+    frame_free(p, size);
+  }
+};
+
+class promise_base : public frame_allocated {
+ public:
+  struct final_awaiter {
+    bool await_ready() noexcept { return false; }
+
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<Promise> h) noexcept {
+      promise_base& p = h.promise();
+      p.done_ = true;
+      if (p.continuation_) {
+        return p.continuation_;
+      }
+      if (p.waiter_ >= 0 && coroutine_running(p.waiter_S_) != p.waiter_) {
+        coroutine_wake(p.waiter_S_, p.waiter_);
+      }
+      if (p.detached_) {
+        if (p.exception_) {
+          std::terminate();  // nobody left to rethrow it to
+        }
+        h.destroy();
+      }
+      return std::noop_coroutine();
+    }
+
+    void await_resume() noexcept {}
+  };
+
+  std::suspend_always initial_suspend() noexcept { return {}; }
+  final_awaiter final_suspend() noexcept { return {}; }
+  void unhandled_exception() noexcept {
+    exception_ = std::current_exception();
+  }
+
+ protected:
+  void rethrow_if_failed() {
+    if (exception_) {
+      std::rethrow_exception(exception_);
+    }
+  }
+
+ private:
+  template <typename T>
+  friend class co::task;
+  template <typename T>
+  friend T co::await(struct schedule* S, task<T> t);
+  friend void co::spawn(struct schedule* S, task<void> t);
+
+  // Resumed once the task completes: an awaiting task, or else a parked
+  // stackful coroutine.
+  std::coroutine_handle<> continuation_;
+  struct schedule* waiter_S_ = nullptr;
+  int waiter_ = -1;
+  bool done_ = false;
+  bool detached_ = false;  // destroys itself when done
+  std::exception_ptr exception_;
+};
+
+template <typename T>
+class task_promise : public promise_base {
+ public:
+  task<T> get_return_object() noexcept;
+
+  template <typename U>
+  void return_value(U&& value) {
+    value_.emplace(std::forward<U>(value));
+  }
+
+  T result() {
+    rethrow_if_failed();
+    return std::move(*value_);
+  }
+
+ private:
+  std::optional<T> value_;
+};
+
+template <>
+class task_promise<void> : public promise_base {
+ public:
+  task<void> get_return_object() noexcept;
+  void return_void() noexcept {}
+  void result() { rethrow_if_failed(); }
+};
+
+}  // namespace detail
+
+template <typename T>
+class [[nodiscard]] task {
+ public:
+  using promise_type = detail::task_promise<T>;
+  using handle_type = std::coroutine_handle<promise_type>;
+
+  task() = default;
+  explicit task(handle_type h) noexcept : h_(h) {}
+  task(task&& other) noexcept : h_(std::exchange(other.h_, nullptr)) {}
+  task& operator=(task&& other) noexcept {
+    if (this != &other) {
+      if (h_) {
+        h_.destroy();
+      }
+      h_ = std::exchange(other.h_, nullptr);
+    }
+    return *this;
+  }
+  task(const task&) = delete;
+  task& operator=(const task&) = delete;
+  ~task() {
+    if (h_) {
+      h_.destroy();
+    }
+  }
+
+  bool done() const { return h_ && h_.done(); }
+
+  // Start the task, or let it finish, and resume the awaiting coroutine
+  // with its result.
+  auto operator co_await() noexcept {
+    struct awaiter {
+      handle_type h;
+      bool await_ready() noexcept { return h.done(); }
+      std::coroutine_handle<> await_suspend(
+          std::coroutine_handle<> awaiting) noexcept {
+        h.promise().continuation_ = awaiting;
+        return h;
+      }
+      T await_resume() { return h.promise().result(); }
+    };
+    assert(h_);
+    return awaiter{h_};
+  }
+
+ private:
+  friend T await<T>(struct schedule* S, task<T> t);
+  friend void spawn(struct schedule* S, task<void> t);
+
+  handle_type h_;
+};
+
+namespace detail {
+
+template <typename T>
+task<T> task_promise<T>::get_return_object() noexcept {
+  return task<T>(std::coroutine_handle<task_promise>::from_promise(*this));
+}
+
+inline task<void> task_promise<void>::get_return_object() noexcept {
+  return task<void>(std::coroutine_handle<task_promise>::from_promise(*this));
+}
+
+}  // namespace detail
+
+// Run t from the current stackful coroutine of S, and return its result.
+// The coroutine parks while t is suspended.
+template <typename T>
+T await(struct schedule* S, task<T> t) {
+  assert(coroutine_running(S) >= 0);
+  auto& p = t.h_.promise();
+  p.waiter_S_ = S;
+  p.waiter_ = coroutine_running(S);
+  t.h_.resume();
+  while (!p.done_) {
+    coroutine_park(S);
+  }
+  return p.result();
+}
+
+// Run t on S, from the run queue. It is destroyed once it completes.
+inline void spawn(struct schedule* S, task<void> t) {
+  auto h = std::exchange(t.h_, nullptr);
+  h.promise().detached_ = true;
+  detail::post(S, h);
+}
+
+// co_await co::yield(S): let the other coroutines of S run first.
+inline auto yield(struct schedule* S) noexcept {
+  struct awaiter {
+    struct schedule* S;
+    bool await_ready() noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) noexcept {
+      detail::post(S, h);
+    }
+    void await_resume() noexcept {}
+  };
+  return awaiter{S};
+}
+
+// co_await co::sleep(S, ms): resume after ms milliseconds, from the timer
+// wheel of S.
+class sleep_awaiter {
+ public:
+  sleep_awaiter(struct schedule* S, int ms) : S_(S), ms_(ms) {
+    timer_init(&timer_, expired);
+  }
+  sleep_awaiter(const sleep_awaiter&) = delete;
+  sleep_awaiter& operator=(const sleep_awaiter&) = delete;
+  ~sleep_awaiter() { timer_cancel(&S_->timers, &timer_); }
+
+  bool await_ready() noexcept { return ms_ <= 0; }
+  void await_suspend(std::coroutine_handle<> h) noexcept {
+    h_ = h;
+    coroutine_add_timer(S_, &timer_, ms_);
+  }
+  void await_resume() noexcept {}
+
+ private:
+  static void expired(struct timer* t) {
+    // timer_ is the first member of a standard-layout class.
+    auto* self = reinterpret_cast<sleep_awaiter*>(t);
+    detail::post(self->S_, self->h_);
+  }
+
+  struct timer timer_;
+  struct schedule* S_;
+  int ms_;
+  std::coroutine_handle<> h_;
+};
+
+static_assert(std::is_standard_layout_v<sleep_awaiter>);
+
+inline sleep_awaiter sleep(struct schedule* S, int ms) { return {S, ms}; }
+
+// co_await co::stackful(S, f): call f() on a new stackful coroutine of S
+// and resume with what it returns (or throws).
+template <typename F>
+class stackful_awaiter {
+ public:
+  using result_type = std::invoke_result_t<F&>;
+
+  stackful_awaiter(struct schedule* S, F f) : S_(S), f_(std::move(f)) {}
+  stackful_awaiter(const stackful_awaiter&) = delete;
+  stackful_awaiter& operator=(const stackful_awaiter&) = delete;
+
+  bool await_ready() noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> h) {
+    h_ = h;
+    if (coroutine_spawn(S_, run, this) < 0) {
+      throw std::bad_alloc();
+    }
+  }
+  result_type await_resume() {
+    if (exception_) {
+      std::rethrow_exception(exception_);
+    }
+    if constexpr (!std::is_void_v<result_type>) {
+      return std::move(*result_);
+    }
+  }
+
+ private:
+  using stored_type =
+      std::conditional_t<std::is_void_v<result_type>, bool,
+                         std::optional<result_type>>;
+
+  // Runs on the stackful coroutine. The awaiter itself lives in the
+  // frame of the suspended task, not on a stack.
+  static void run(struct schedule* S, void* ud) {
+    auto* self = static_cast<stackful_awaiter*>(ud);
+    try {
+      if constexpr (std::is_void_v<result_type>) {
+        std::invoke(self->f_);
+      } else {
+        self->result_.emplace(std::invoke(self->f_));
+      }
+    } catch (...) {
+      self->exception_ = std::current_exception();
+    }
+    detail::post(S, self->h_);
+  }
+
+  struct schedule* S_;
+  F f_;
+  std::coroutine_handle<> h_;
+  stored_type result_{};
+  std::exception_ptr exception_;
+};
+
+template <typename F>
+stackful_awaiter<std::decay_t<F>> stackful(struct schedule* S, F&& f) {
+  return {S, std::forward<F>(f)};
+}
+
+template <typename T>
+class [[nodiscard]] generator {
+ public:
+  using value_type = std::remove_cvref_t<T>;
+  using reference = std::conditional_t<std::is_reference_v<T>, T, T&>;
+
+  class promise_type : public detail::frame_allocated {
+   public:
+    generator get_return_object() noexcept {
+      return generator(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    // The yielded object outlives the suspension: only its address is
+    // kept.
+    std::suspend_always yield_value(
+        std::remove_reference_t<reference>& value) noexcept {
+      value_ = std::addressof(value);
+      return {};
+    }
+    std::suspend_always yield_value(
+        std::remove_reference_t<reference>&& value) noexcept {
+      value_ = std::addressof(value);
+      return {};
+    }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept {
+      exception_ = std::current_exception();
+    }
+    void rethrow_if_failed() {
+      if (exception_) {
+        std::rethrow_exception(exception_);
+      }
+    }
+    // A generator is driven by its consumer, not the schedule.
+    template <typename U>
+    std::suspend_never await_transform(U&&) = delete;
+
+   private:
+    friend class generator;
+    std::remove_reference_t<reference>* value_ = nullptr;
+    std::exception_ptr exception_;
+  };
+
+  using handle_type = std::coroutine_handle<promise_type>;
+
+  class iterator {
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = generator::value_type;
+
+    iterator() = default;
+    explicit iterator(handle_type h) : h_(h) {}
+
+    reference operator*() const {
+      return static_cast<reference>(*h_.promise().value_);
+    }
+    iterator& operator++() {
+      h_.resume();
+      h_.promise().rethrow_if_failed();
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+    friend bool operator==(const iterator& it, std::default_sentinel_t) {
+      return it.h_.done();
+    }
+
+   private:
+    handle_type h_;
+  };
+
+  explicit generator(handle_type h) noexcept : h_(h) {}
+  generator(generator&& other) noexcept
+      : h_(std::exchange(other.h_, nullptr)) {}
+  generator& operator=(generator&& other) noexcept {
+    if (this != &other) {
+      if (h_) {
+        h_.destroy();
+      }
+      h_ = std::exchange(other.h_, nullptr);
+    }
+    return *this;
+  }
+  generator(const generator&) = delete;
+  generator& operator=(const generator&) = delete;
+  ~generator() {
+    if (h_) {
+      h_.destroy();
+    }
+  }
+
+  // Runs the generator up to its first co_yield.
+  iterator begin() {
+    iterator it(h_);
+    ++it;
+    return it;
+  }
+  std::default_sentinel_t end() const noexcept { return {}; }
+
+ private:
+  handle_type h_;
+};
+
+}  // namespace co
@@ -0,0 +1,374 @@
+// Tests of co_task.h: tasks awaiting tasks, detached tasks destroying
+// their own frames, exceptions crossing every kind of await, the handoff
+// between tasks and stackful coroutines around co::yield and co::sleep, a
+// long chain of tasks that complete at once (which only keeps the stack
+// flat with symmetric transfer as tail calls), generators, and the frame
+// cache. The stackful cases run with shared and with private stacks.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "co_task.h"
+#include "coroutine.h"
+
+#define CHECK(cond)                                                  \
+  do {                                                               \
+    if (!(cond)) {                                                   \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+              #cond);                                                \
+      exit(1);                                                       \
+    }                                                                \
+  } while (0)
+
+static struct schedule* S;
+static int stack_mode;
+static std::string log_buf;  // events, in the order they happened
+
+// Counts the frames alive: a task takes one by value, so it lives as long
+// as the frame does.
+static int live_frames;
+
+struct FrameGuard {
+  FrameGuard() { live_frames++; }
+  FrameGuard(const FrameGuard&) { live_frames++; }
+  ~FrameGuard() { live_frames--; }
+};
+
+static double now_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+static void begin() {
+  S = coroutine_open();
+  CHECK(S != nullptr);
+  log_buf.clear();
+  live_frames = 0;
+}
+
+// Drive the run queue and the timers until nothing is left to run.
+static void finish() {
+  for (;;) {
+    coroutine_run_ready(S);
+    coroutine_run_timers(S);
+    if (S->nrunq > 0) continue;
+    int ms = coroutine_next_timer(S);
+    if (ms < 0) break;
+    struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+    nanosleep(&ts, nullptr);
+  }
+  CHECK(S->nco == 0);
+  CHECK(S->timers.count == 0);
+  CHECK(live_frames == 0);
+  coroutine_close(S);
+}
+
+static void spawn_stackful(coroutine_func func, void* ud) {
+  int id = coroutine_new_mode(S, func, ud, stack_mode);
+  CHECK(id >= 0);
+  coroutine_wake(S, id);
+}
+
+// --- Detached tasks destroy their frames in final_suspend, whether they
+// complete at once or after suspending on the schedule; a task that is
+// awaited is destroyed by its owner instead.
+
+static co::task<int> value(FrameGuard, int v) { co_return v; }
+
+static co::task<void> detached_at_once(FrameGuard g) {
+  int v = co_await value(g, 1);
+  log_buf += "a" + std::to_string(v);
+}
+
+static co::task<void> detached_suspending(FrameGuard g) {
+  co_await co::yield(S);
+  log_buf += "y";
+  co_await co::sleep(S, 2);
+  int v = co_await value(g, 2);
+  log_buf += "s" + std::to_string(v);
+}
+
+static void test_detached() {
+  begin();
+  co::spawn(S, detached_at_once(FrameGuard()));
+  co::spawn(S, detached_suspending(FrameGuard()));
+  // Both frames are queued to start, none has run yet.
+  CHECK(live_frames == 2);
+  CHECK(log_buf.empty());
+  coroutine_run_ready(S);
+  CHECK(log_buf == "a1");
+  CHECK(live_frames == 1);
+  finish();
+  CHECK(log_buf == "a1ys2");
+
+  // Never started: its owner destroys it.
+  begin();
+  {
+    co::task<int> t = value(FrameGuard(), 3);
+    CHECK(live_frames == 1);
+    CHECK(!t.done());
+  }
+  CHECK(live_frames == 0);
+  finish();
+}
+
+// --- Exceptions reach whoever awaits: a task, through await_resume; a
+// stackful coroutine, through co::await; and a task awaiting a stackful
+// coroutine, through the stackful_awaiter.
+
+static co::task<int> thrower(FrameGuard, const char* what) {
+  co_await co::yield(S);
+  throw std::runtime_error(what);
+}
+
+static co::task<void> catcher(FrameGuard g) {
+  try {
+    co_await thrower(g, "task");
+    CHECK(false);
+  } catch (const std::runtime_error& e) {
+    log_buf += std::string(e.what()) + ",";
+  }
+  try {
+    co_await co::stackful(S, [] {
+      coroutine_yield(S);
+      throw std::runtime_error("stackful");
+    });
+    CHECK(false);
+  } catch (const std::runtime_error& e) {
+    log_buf += std::string(e.what()) + ",";
+  }
+  // And a value comes back the same way.
+  int v = co_await co::stackful(S, [] { return 42; });
+  log_buf += std::to_string(v) + ",";
+}
+
+static void stackful_catcher(struct schedule*, void*) {
+  try {
+    co::await(S, thrower(FrameGuard(), "await"));
+    CHECK(false);
+  } catch (const std::runtime_error& e) {
+    log_buf += std::string(e.what()) + ",";
+  }
+}
+
+static void test_exceptions() {
+  begin();
+  co::spawn(S, catcher(FrameGuard()));
+  finish();
+  CHECK(log_buf == "task,stackful,42,");
+
+  begin();
+  spawn_stackful(stackful_catcher, nullptr);
+  finish();
+  CHECK(log_buf == "await,");
+}
+
+// --- A stackful coroutine awaits a task that suspends on the schedule,
+// which awaits a stackful coroutine that blocks, which awaits a task in
+// turn. Each side resumes the other once it completes.
+
+static co::task<int> inner_task(FrameGuard) {
+  log_buf += "[t";
+  co_await co::yield(S);
+  co_await co::sleep(S, 3);
+  log_buf += "t]";
+  co_return 7;
+}
+
+static co::task<int> middle_task(FrameGuard g) {
+  log_buf += "[m";
+  co_await co::sleep(S, 1);
+  // A named lambda: GCC 12 mixes up the copies of the captures of one
+  // that is a temporary of the co_await expression.
+  auto f = [g] {
+    log_buf += "[s";
+    co_sleep(S, 2);
+    coroutine_yield(S);
+    int w = co::await(S, inner_task(g));
+    log_buf += "s]";
+    return w * 10;
+  };
+  int v = co_await co::stackful(S, f);
+  co_await co::yield(S);
+  log_buf += "m]";
+  co_return v + 1;
+}
+
+static int handoff_result;
+
+static void outer_stackful(struct schedule*, void*) {
+  double start = now_ms();
+  handoff_result = co::await(S, middle_task(FrameGuard()));
+  // The sleeps of both kinds were waited for.
+  CHECK(now_ms() - start >= 6);
+}
+
+// Runs alongside, to check that the schedule keeps going meanwhile.
+static void ticker(struct schedule*, void*) {
+  for (int i = 0; i < 5; i++) {
+    co_sleep(S, 1);
+  }
+  log_buf += ".";
+}
+
+static void test_handoff() {
+  begin();
+  handoff_result = 0;
+  spawn_stackful(outer_stackful, nullptr);
+  spawn_stackful(ticker, nullptr);
+  finish();
+  CHECK(handoff_result == 71);
+  // The ticker's mark falls anywhere, the rest is in nesting order.
+  std::string nested;
+  for (char c : log_buf) {
+    if (c != '.') nested += c;
+  }
+  CHECK(nested == "[m[s[tt]s]m]");
+  CHECK(log_buf.size() == nested.size() + 1);
+}
+
+// --- A chain of tasks that each await the next and complete at once.
+// Without tail calls every transfer would take a native frame, and the
+// chain would overflow any stack, a coroutine's first.
+
+enum { kChain = 1000000 };
+
+static co::task<long> chain(int n) {
+  if (n == 0) {
+    co_return 0;
+  }
+  long rest = co_await chain(n - 1);
+  co_return rest + n;
+}
+
+static co::task<void> chain_root(FrameGuard) {
+  long sum = co_await chain(kChain);
+  CHECK(sum == static_cast<long>(kChain) * (kChain + 1) / 2);
+  log_buf += "c";
+}
+
+static void chain_stackful(struct schedule*, void*) {
+  long sum = co::await(S, chain(kChain));
+  CHECK(sum == static_cast<long>(kChain) * (kChain + 1) / 2);
+  log_buf += "C";
+}
+
+static void test_sync_chain() {
+  begin();
+  co::spawn(S, chain_root(FrameGuard()));
+  spawn_stackful(chain_stackful, nullptr);
+  finish();
+  CHECK(log_buf == "cC");
+}
+
+// --- Generators are lazy, stop where the producer returns, and rethrow
+// what it throws to the consumer.
+
+static int produced;
+
+static co::generator<int> squares(int n) {
+  for (int i = 0; i < n; i++) {
+    produced++;
+    co_yield i * i;
+  }
+}
+
+static co::generator<const std::string&> words(bool fail) {
+  std::string w = "one";
+  co_yield w;
+  co_yield std::string("two");
+  if (fail) {
+    throw std::runtime_error("generator");
+  }
+}
+
+static void test_generator() {
+  produced = 0;
+  co::generator<int> g = squares(5);
+  CHECK(produced == 0);
+  std::vector<int> got;
+  for (int v : g) {
+    got.push_back(v);
+    CHECK(produced == static_cast<int>(got.size()));
+  }
+  CHECK((got == std::vector<int>{0, 1, 4, 9, 16}));
+
+  // Abandoned half way: destroying it ends the producer.
+  produced = 0;
+  {
+    co::generator<int> partial = squares(1000);
+    auto it = partial.begin();
+    ++it;
+    CHECK(*it == 1 && produced == 2);
+  }
+
+  std::string joined;
+  for (const std::string& w : words(false)) {
+    joined += w + " ";
+  }
+  CHECK(joined == "one two ");
+  joined.clear();
+  try {
+    for (const std::string& w : words(true)) {
+      joined += w + " ";
+    }
+    CHECK(false);
+  } catch (const std::runtime_error& e) {
+    CHECK(std::strcmp(e.what(), "generator") == 0);
+  }
+  CHECK(joined == "one two ");
+}
+
+// --- The frame cache hands freed frames back by size class, up to
+// kFrameMaxFree of them, and leaves large frames to operator new.
+
+static void test_frame_alloc() {
+  void* a = co::frame_alloc(100);
+  co::frame_free(a, 100);
+  // Same class of kFrameGranularity bytes: the same frame.
+  void* b = co::frame_alloc(128);
+  CHECK(b == a);
+  void* c = co::frame_alloc(129);
+  CHECK(c != b);
+  co::frame_free(b, 128);
+  co::frame_free(c, 129);
+
+  std::vector<void*> frames;
+  for (std::size_t i = 0; i < co::kFrameMaxFree + 10; i++) {
+    frames.push_back(co::frame_alloc(200));
+    memset(frames.back(), 0xab, 200);
+  }
+  for (void* f : frames) {
+    co::frame_free(f, 200);
+  }
+  // Only kFrameMaxFree were kept, and come back last freed first.
+  for (std::size_t i = 0; i < co::kFrameMaxFree; i++) {
+    void* f = co::frame_alloc(200);
+    CHECK(f == frames[co::kFrameMaxFree - 1 - i]);
+    frames[co::kFrameMaxFree - 1 - i] = nullptr;
+  }
+
+  void* big = co::frame_alloc(co::kFrameMaxCached + 1);
+  memset(big, 0xcd, co::kFrameMaxCached + 1);
+  co::frame_free(big, co::kFrameMaxCached + 1);
+}
+
+int main() {
+  test_generator();
+  test_frame_alloc();
+  int modes[] = {COROUTINE_STACK_SHARED, COROUTINE_STACK_PRIVATE};
+  for (int mode : modes) {
+    stack_mode = mode;
+    test_detached();
+    test_exceptions();
+    test_handoff();
+    test_sync_chain();
+  }
+  printf("ok\n");
+  return 0;
+}
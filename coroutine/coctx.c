@@ -0,0 +1,101 @@
+#include "coctx.h"
+
+#include <stdint.h>
+
+#ifdef COCTX_ASM
+
+// coctx_swap(from, to): rdi = from, rsi = to, and coctx::sp is at offset 0
+// of both. The frame left on a suspended stack, from its saved sp up:
+//   mxcsr (4 bytes), x87 control word (2 bytes), padding (2 bytes),
+//   r15, r14, r13, r12, rbx, rbp, return address.
+// coctx_entry is where a fresh context "returns" to: coctx_make leaves fn
+// in r13 and arg in r12.
+__asm__(
+    ".text\n"
+    ".globl coctx_swap\n"
+    ".type coctx_swap, @function\n"
+    "coctx_swap:\n"
+    "  pushq %rbp\n"
+    "  pushq %rbx\n"
+    "  pushq %r12\n"
+    "  pushq %r13\n"
+    "  pushq %r14\n"
+    "  pushq %r15\n"
+    "  subq $8, %rsp\n"
+    "  stmxcsr (%rsp)\n"
+    "  fnstcw 4(%rsp)\n"
+    "  movq %rsp, (%rdi)\n"
+    "  movq (%rsi), %rsp\n"
+    "  ldmxcsr (%rsp)\n"
+    "  fldcw 4(%rsp)\n"
+    "  addq $8, %rsp\n"
+    "  popq %r15\n"
+    "  popq %r14\n"
+    "  popq %r13\n"
+    "  popq %r12\n"
+    "  popq %rbx\n"
+    "  popq %rbp\n"
+    "  ret\n"
+    ".size coctx_swap, .-coctx_swap\n"
+    "\n"
+    ".type coctx_entry, @function\n"
+    "coctx_entry:\n"
+    "  movq %r12, %rdi\n"
+    "  callq *%r13\n"
+    "  ud2\n"
+    ".size coctx_entry, .-coctx_entry\n");
+
+void coctx_entry(void);
+
+void coctx_make(struct coctx *ctx, char *stack, size_t size,
+                void (*fn)(void *), void *arg) {
+  // coctx_entry starts with a 16-byte aligned rsp, as the ABI requires
+  // before its call to fn.
+  uintptr_t top = ((uintptr_t)stack + size) & ~(uintptr_t)15;
+  uint64_t *frame = (uint64_t *)top - 8;
+  frame[0] = 0x1F80 | ((uint64_t)0x037F << 32);  // default mxcsr, x87 cw
+  frame[1] = 0;                                  // r15
+  frame[2] = 0;                                  // r14
+  frame[3] = (uint64_t)(uintptr_t)fn;            // r13
+  frame[4] = (uint64_t)(uintptr_t)arg;           // r12
+  frame[5] = 0;                                  // rbx
+  frame[6] = 0;                                  // rbp
+  frame[7] = (uint64_t)(uintptr_t)coctx_entry;   // return address
+  ctx->sp = (char *)frame;
+}
+
+#else
+
+static void _trampoline(uint32_t low32, uint32_t high32) {
+  uintptr_t ptr = (uintptr_t)low32 | ((uintptr_t)high32 << 32);
+  struct coctx *ctx = (struct coctx *)ptr;
+  ctx->fn(ctx->arg);
+}
+
+void coctx_make(struct coctx *ctx, char *stack, size_t size,
+                void (*fn)(void *), void *arg) {
+  getcontext(&ctx->uc);
+  ctx->uc.uc_stack.ss_sp = stack;
+  ctx->uc.uc_stack.ss_size = size;
+  ctx->uc.uc_link = NULL;
+  ctx->fn = fn;
+  ctx->arg = arg;
+  ctx->sp = stack + size;
+  uintptr_t ptr = (uintptr_t)ctx;
+  makecontext(&ctx->uc, (void (*)(void))_trampoline, 2, (uint32_t)ptr,
+              (uint32_t)(ptr >> 32));
+}
+
+// An address below the frame of the caller, and so below everything that
+// caller needs on its stack. swapcontext keeps the registers in the
+// ucontext_t, not on the stack.
+__attribute__((noinline)) static char *_stack_mark(void) {
+  return __builtin_frame_address(0);
+}
+
+void coctx_swap(struct coctx *from, struct coctx *to) {
+  from->sp = _stack_mark();
+  swapcontext(&from->uc, &to->uc);
+}
+
+#endif
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stddef.h>
+
+// Machine context of a coroutine, and the switch between two of them.
+//
+// On x86-64 a switch is a few instructions of assembly: the callee-saved
+// registers (and the x87/SSE control words) are pushed on the current
+// stack, the stack pointer is swapped, and they are popped from the other
+// one. Everything else is caller-saved and already spilled by the compiler
+// around the call. glibc's swapcontext, by contrast, saves the whole
+// register file and makes an rt_sigprocmask syscall to save the signal
+// mask on every switch.
+//
+// Elsewhere, or with COROUTINE_USE_UCONTEXT defined, the ucontext
+// functions are used instead.
+#if defined(__x86_64__) && !defined(COROUTINE_USE_UCONTEXT)
+#define COCTX_ASM 1
+#define COCTX_IMPL "asm"
+#else
+#include <ucontext.h>
+#define COCTX_IMPL "ucontext"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct coctx {
+  // Stack pointer at the last switch away from this context: everything
+  // the context needs on its stack lies at or above it.
+  char *sp;
+#ifndef COCTX_ASM
+  ucontext_t uc;
+  void (*fn)(void *);
+  void *arg;
+#endif
+};
+
+/**
+ * @brief prepare ctx to run fn(arg) on [stack, stack + size) when it is
+ * switched to. fn must not return; it ends by switching away for good.
+ */
+void coctx_make(struct coctx *ctx, char *stack, size_t size,
+                void (*fn)(void *), void *arg);
+
+/**
+ * @brief save the current context into from and continue in to
+ */
+void coctx_swap(struct coctx *from, struct coctx *to);
+
+#ifdef __cplusplus
+}
+#endif
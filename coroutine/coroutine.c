@@ -13,33 +13,76 @@
 #include <assert.h>
 #include <stdint.h>
 #include <sys/types.h>
-#include <ucontext.h>
+#include <time.h>
+
+#define NS_PER_MS 1000000
+
+static uint64_t _now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void _timer_expired(struct timer *t);
+static int _runq_reserve(struct schedule *S, int cap);
 
 // coroutine_open: 创建一个协程。
 /**
  * @brief 创建一个协程调度器, 默认协程数16
  *
- * @return struct schedule*
+ * @return struct schedule*, or NULL if out of memory
  */
 struct schedule *coroutine_open(void) {
   struct schedule *S = malloc(sizeof(*S));
+  if (S == NULL) {
+    return NULL;
+  }
+  S->shared_stack.base = NULL;
+  S->shared_stack.size = 0;
   S->nco = 0;                  // 初始化时，协程数量为0
   S->running = -1;             // 初始化时，没有协程在运行
   S->cap = DEFAULT_COROUTINE;  // 初始化时，协程调度器的容量为默认值
-  S->co =
-      malloc(sizeof(struct coroutine) * S->cap);  // 分配内存空间，用于存储协程
-  memset(S->co, 0, sizeof(struct coroutine) * S->cap);
+  S->co = calloc(S->cap, sizeof(struct coroutine *));
+  // Free ids are popped from the end: lowest first.
+  S->free_ids = malloc(sizeof(int) * S->cap);
+  // Room for every id, see _runq_reserve.
+  S->runq_cap = S->cap;
+  S->runq = malloc(sizeof(struct runq_entry) * S->runq_cap);
+  if (S->co == NULL || S->free_ids == NULL || S->runq == NULL) {
+    free(S->runq);
+    free(S->free_ids);
+    free(S->co);
+    free(S);
+    return NULL;
+  }
+  S->nfree_ids = S->cap;
+  int i;
+  for (i = 0; i < S->cap; i++) {
+    S->free_ids[i] = S->cap - 1 - i;
+  }
+  S->slabs = NULL;
+  S->free_co = NULL;
+  stack_pool_init(&S->stacks, PRIVATE_STACK_SIZE, STACK_POOL_MAX_FREE);
+  S->retired.base = NULL;
+  S->retired.size = 0;
+  S->runq_head = 0;
+  S->nrunq = 0;
+  S->nposted = 0;
+  timer_wheel_init(&S->timers, _now_ns() / NS_PER_MS);
   return S;
 }
 
 /**
  * @brief delete coroutine
  *
+ * @param [in] S scheduler, which takes back the object and a private stack
  * @param [in] co coroutine
  */
-void _delete_co(struct coroutine *co) {
+void _delete_co(struct schedule *S, struct coroutine *co) {
+  stack_pool_put(&S->stacks, &co->private_stack);
   free(co->stack);
-  free(co);
+  co->next_free = S->free_co;
+  S->free_co = co;
 }
 
 /**
@@ -52,9 +95,18 @@ void coroutine_close(struct schedule *S) {
   for (i = 0; i < S->cap; i++) {
     struct coroutine *co = S->co[i];
     if (co) {
-      _delete_co(co);
+      _delete_co(S, co);
     }
   }
+  while (S->slabs != NULL) {
+    struct co_slab *slab = S->slabs;
+    S->slabs = slab->next;
+    free(slab);
+  }
+  stack_pool_destroy(&S->stacks);
+  co_stack_unmap(&S->shared_stack);
+  free(S->runq);
+  free(S->free_ids);
   free(S->co);
   S->co = NULL;
   free(S);
@@ -66,10 +118,24 @@ void coroutine_close(struct schedule *S) {
  * @param [in] S
  * @param [in] func
  * @param [in] ud
- * @return struct coroutine*
+ * @return struct coroutine*, or NULL if out of memory
  */
 struct coroutine *_co_new(struct schedule *S, coroutine_func func, void *ud) {
-  struct coroutine *co = malloc(sizeof(*co));
+  if (S->free_co == NULL) {
+    struct co_slab *slab = malloc(sizeof(*slab));
+    if (slab == NULL) {
+      return NULL;
+    }
+    slab->next = S->slabs;
+    S->slabs = slab;
+    int i;
+    for (i = COROUTINE_SLAB_SIZE - 1; i >= 0; i--) {
+      slab->co[i].next_free = S->free_co;
+      S->free_co = &slab->co[i];
+    }
+  }
+  struct coroutine *co = S->free_co;
+  S->free_co = co->next_free;
   co->func = func;
   co->ud = ud;
   co->sch = S;
@@ -77,6 +143,19 @@ struct coroutine *_co_new(struct schedule *S, coroutine_func func, void *ud) {
   co->size = 0;
   co->status = COROUTINE_READY;
   co->stack = NULL;
+  co->stack_mode = COROUTINE_STACK_SHARED;
+  co->private_stack.base = NULL;
+  co->private_stack.size = 0;
+  co->queued = 0;
+  co->parked = 0;
+  co->window_max = 0;
+  co->saves = 0;
+  co->id = -1;
+  timer_init(&co->timer, _timer_expired);
+  co->timed_out = 0;
+  co->waitq = NULL;
+  co->wait_next = NULL;
+  co->next_free = NULL;
   return co;
 }
 
@@ -89,44 +168,128 @@ struct coroutine *_co_new(struct schedule *S, coroutine_func func, void *ud) {
  * @return int
  */
 int coroutine_new(struct schedule *S, coroutine_func func, void *ud) {
+  return coroutine_new_mode(S, func, ud, COROUTINE_STACK_SHARED);
+}
+
+/**
+ * @brief double the capacity of S, adding the new ids to the free list
+ *
+ * @return int 0, or -1 if out of memory
+ */
+static int _grow(struct schedule *S) {
+  int cap = S->cap * 2;
+  struct coroutine **co = realloc(S->co, sizeof(struct coroutine *) * cap);
+  if (co == NULL) {
+    return -1;
+  }
+  S->co = co;
+  memset(S->co + S->cap, 0, sizeof(struct coroutine *) * S->cap);
+  int *free_ids = realloc(S->free_ids, sizeof(int) * cap);
+  if (free_ids == NULL) {
+    return -1;
+  }
+  S->free_ids = free_ids;
+  if (_runq_reserve(S, cap + S->nposted) != 0) {
+    return -1;
+  }
+  int i;
+  for (i = cap - 1; i >= S->cap; i--) {
+    S->free_ids[S->nfree_ids++] = i;
+  }
+  S->cap = cap;
+  return 0;
+}
+
+/**
+ * @brief create a new coroutine in schedule S with the given stack mode
+ *
+ * @param [in] S scheduler
+ * @param [in] func corotine function
+ * @param [in] ud user define parameter
+ * @param [in] stack_mode COROUTINE_STACK_SHARED or COROUTINE_STACK_PRIVATE
+ * @return int id, or -1 if out of memory or no stack could be mapped
+ */
+int coroutine_new_mode(struct schedule *S, coroutine_func func, void *ud,
+                       int stack_mode) {
+  if (stack_mode == COROUTINE_STACK_SHARED && S->shared_stack.base == NULL &&
+      co_stack_map(&S->shared_stack, STACK_SIZE) != 0) {
+    return -1;
+  }
+  if (S->nfree_ids == 0 && _grow(S) != 0) {
+    return -1;
+  }
   struct coroutine *co = _co_new(S, func, ud);
-  if (S->nco >= S->cap) {
-    // if the coroutine num in S is larger than the capacity of S, then we need
-    // to expand the cap. .
-    int id = S->cap;
-    S->co = realloc(S->co, S->cap * 2 * sizeof(struct coroutine *));
-    memset(S->co + S->cap, 0, sizeof(struct coroutine *) * S->cap);
-    S->cap *= 2;
-    S->co[S->cap] = co;
-    S->nco = S->nco + 1;
-    return id;
-  } else {
-    // if the coroutine num in S is less than the capacity of S, then we can
-    // directly use the next available slot.
-    int i = 0;
-    for (int i = 0; i < S->cap; i++) {
-      int id = (i + S->nco) % S->cap;
-      if (S->co[id] == NULL) {
-        S->co[id] = co;
-        S->nco = S->nco + 1;
-        return id;
-      }
-    }
+  if (co == NULL) {
+    return -1;
+  }
+  co->stack_mode = stack_mode;
+  if (stack_mode == COROUTINE_STACK_PRIVATE &&
+      stack_pool_get(&S->stacks, &co->private_stack) != 0) {
+    _delete_co(S, co);
+    return -1;
   }
-  assert(0);
-  return -1;
+  int id = S->free_ids[--S->nfree_ids];
+  co->id = id;
+  S->co[id] = co;
+  S->nco = S->nco + 1;
+  return id;
 }
 
-static void mainfunc(uint32_t low32, uint32_t high32) {
-  uintptr_t ptr = (uintptr_t)low32 | ((uintptr_t)high32 << 32);
-  struct schedule *S = (struct schedule *)ptr;
+static void mainfunc(void *ud) {
+  struct schedule *S = ud;
   int id = S->running;
   struct coroutine *co = S->co[id];
   co->func(S, co->ud);
-  _delete_co(co);
+  S->retired = co->private_stack;
+  co->private_stack.base = NULL;
+  _delete_co(S, co);
   S->co[id] = NULL;
+  S->free_ids[S->nfree_ids++] = id;
   S->nco = S->nco - 1;
   S->running = -1;
+  struct coctx dead;
+  coctx_swap(&dead, &S->main);
+}
+
+/**
+ * @brief save the live part of a suspended coroutine's shared stack
+ *
+ * @param [in] C coroutine
+ * @param [in] top top of the shared stack
+ */
+static void _save_stack(struct coroutine *C, char *top) {
+  char *sp = C->ctx.sp;
+  ptrdiff_t size = top - sp;
+  assert(size <= STACK_SIZE);
+  if (size > C->window_max) {
+    C->window_max = size;
+  }
+  if (C->cap < size) {
+    free(C->stack);
+    C->cap = size;
+    C->stack = malloc(C->cap);
+    // The coroutine already switched out, and the next one to run on the
+    // shared stack overwrites its frames: there is nobody to report to,
+    // and nothing left to resume it with.
+    if (C->stack == NULL) {
+      abort();
+    }
+  } else if (++C->saves == SAVED_STACK_SHRINK_PERIOD) {
+    // window_max >= size: the buffer still fits this save, and keeps
+    // being used if a smaller one cannot be had.
+    if (C->cap > SAVED_STACK_SHRINK_MIN && C->cap > 2 * C->window_max) {
+      char *stack = malloc(C->window_max);
+      if (stack != NULL) {
+        free(C->stack);
+        C->cap = C->window_max;
+        C->stack = stack;
+      }
+    }
+    C->saves = 0;
+    C->window_max = 0;
+  }
+  C->size = size;
+  memcpy(C->stack, sp, C->size);
 }
 
 /**
@@ -141,26 +304,34 @@ void coroutine_resume(struct schedule *S, int id) {
   struct coroutine *co = S->co[id];
   if (co == NULL) return;
   if (co->status == COROUTINE_READY) {
-    // get current context, and save it into co->ctx。
-    getcontext(&co->ctx);
-    co->ctx.uc_stack.ss_sp = S->stack;
-    co->ctx.uc_stack.ss_size = STACK_SIZE;
-    co->ctx.uc_link = &S->main;
+    // prepare co->ctx to start mainfunc on the coroutine's stack.
+    if (co->stack_mode == COROUTINE_STACK_PRIVATE) {
+      coctx_make(&co->ctx, co->private_stack.base, co->private_stack.size,
+                 mainfunc, S);
+    } else {
+      coctx_make(&co->ctx, S->shared_stack.base, STACK_SIZE, mainfunc, S);
+    }
     S->running = id;
     co->status = COROUTINE_RUNNING;
-    uintptr_t ptr = (uintptr_t)S;
-    makecontext(&co->ctx, (void (*)(void))mainfunc, 2, (uint32_t)ptr,
-                (uint32_t)(ptr >> 32));
-    swapcontext(&S->main, &co->ctx);
+    coctx_swap(&S->main, &co->ctx);
   } else if (co->status == COROUTINE_SUSPEND) {
-    memcpy(S->stack + STACK_SIZE - co->size, co->stack, co->size);
+    if (co->stack_mode == COROUTINE_STACK_SHARED) {
+      memcpy(S->shared_stack.base + STACK_SIZE - co->size, co->stack,
+             co->size);
+    }
     S->running = id;
     co->status = COROUTINE_RUNNING;
-    swapcontext(&S->main, &co->ctx);
+    coctx_swap(&S->main, &co->ctx);
   } else {
     assert(0);
   }
-  return;
+  // The coroutine yielded or finished. If it yielded, its frames on the
+  // shared stack are saved now, from the exact stack pointer it left.
+  stack_pool_put(&S->stacks, &S->retired);
+  co = S->co[id];
+  if (co != NULL && co->stack_mode == COROUTINE_STACK_SHARED) {
+    _save_stack(co, S->shared_stack.base + STACK_SIZE);
+  }
 }
 
 /**
@@ -180,25 +351,6 @@ int coroutine_status(struct schedule *S, int id) {
 
 int coroutine_running(struct schedule *S) { return S->running; }
 
-/**
- * @brief save current coroutine stack
- *
- * @param [in] C coroutine
- * @param [in] top current stack top
- */
-static void _save_stack(struct coroutine *C, char *top) {
-  char dummy = 0;
-  assert(top - &dummy <= STACK_SIZE);
-  if (C->cap < top - &dummy) {
-    free(C->stack);
-    C->cap = top - &dummy;
-    C->stack = malloc(C->cap);
-  } else {
-    C->size = top - &dummy;
-    memcpy(C->stack, &dummy, C->size);
-  }
-}
-
 /**
  * @brief yield current coroutine
  *
@@ -208,9 +360,236 @@ void coroutine_yield(struct schedule *S) {
   int id = S->running;
   assert(id >= 0);
   struct coroutine *C = S->co[id];
-  assert((char *)&C > S->stack);
-  _save_stack(C, S->stack + STACK_SIZE);
+  assert(C->stack_mode != COROUTINE_STACK_SHARED ||
+         (char *)&C > S->shared_stack.base);
   C->status = COROUTINE_SUSPEND;
   S->running = -1;
-  swapcontext(&C->ctx, &S->main);
-}
\ No newline at end of file
+  coctx_swap(&C->ctx, &S->main);
+}
+
+/**
+ * @brief grow the run queue to hold at least cap entries
+ *
+ * The queue always has room for an entry per coroutine id, besides the
+ * callbacks queued: a coroutine is queued at most once, so coroutine_wake
+ * never needs to allocate, and only coroutine_post and _grow can fail.
+ *
+ * @return int 0, or -1 if out of memory
+ */
+static int _runq_reserve(struct schedule *S, int cap) {
+  if (cap <= S->runq_cap) {
+    return 0;
+  }
+  if (cap < S->runq_cap * 2) {
+    cap = S->runq_cap * 2;
+  }
+  struct runq_entry *runq = malloc(sizeof(struct runq_entry) * cap);
+  if (runq == NULL) {
+    return -1;
+  }
+  int i;
+  for (i = 0; i < S->nrunq; i++) {
+    runq[i] = S->runq[(S->runq_head + i) % S->runq_cap];
+  }
+  free(S->runq);
+  S->runq = runq;
+  S->runq_cap = cap;
+  S->runq_head = 0;
+  return 0;
+}
+
+static void _runq_push(struct schedule *S, int id, void (*fn)(void *),
+                       void *arg) {
+  assert(S->nrunq < S->runq_cap);
+  struct runq_entry *e = &S->runq[(S->runq_head + S->nrunq) % S->runq_cap];
+  e->id = id;
+  e->fn = fn;
+  e->arg = arg;
+  S->nrunq++;
+}
+
+static struct runq_entry _runq_pop(struct schedule *S) {
+  struct runq_entry e = S->runq[S->runq_head];
+  S->runq_head = (S->runq_head + 1) % S->runq_cap;
+  S->nrunq--;
+  if (e.id < 0) {
+    S->nposted--;
+  }
+  return e;
+}
+
+/**
+ * @brief queue coroutine id to be resumed by coroutine_run_ready
+ *
+ * @param [in] S
+ * @param [in] id
+ */
+void coroutine_wake(struct schedule *S, int id) {
+  assert(id >= 0 && id < S->cap);
+  struct coroutine *co = S->co[id];
+  if (co == NULL || co->queued) return;
+  co->queued = 1;
+  _runq_push(S, id, NULL, NULL);
+}
+
+/**
+ * @brief queue fn(arg) to be called by coroutine_run_ready
+ *
+ * @param [in] S
+ * @param [in] fn
+ * @param [in] arg
+ * @return int 0, or -1 if out of memory
+ */
+int coroutine_post(struct schedule *S, void (*fn)(void *), void *arg) {
+  if (_runq_reserve(S, S->cap + S->nposted + 1) != 0) {
+    return -1;
+  }
+  S->nposted++;
+  _runq_push(S, -1, fn, arg);
+  return 0;
+}
+
+/**
+ * @brief suspend the current coroutine until coroutine_wake
+ *
+ * @param [in] S
+ */
+void coroutine_park(struct schedule *S) {
+  assert(S->running >= 0);
+  S->co[S->running]->parked = 1;
+  coroutine_yield(S);
+}
+
+/**
+ * @brief resume the coroutines in the run queue, and call the callbacks
+ *
+ * @param [in] S
+ * @return int number of coroutines resumed and callbacks called
+ */
+int coroutine_run_ready(struct schedule *S) {
+  int n = S->nrunq;
+  int ran = 0;
+  int i;
+  for (i = 0; i < n; i++) {
+    struct runq_entry e = _runq_pop(S);
+    if (e.id < 0) {
+      e.fn(e.arg);
+      ran++;
+      continue;
+    }
+    int id = e.id;
+    struct coroutine *co = S->co[id];
+    // The slot may have been emptied, or even reused, by a coroutine that
+    // finished after being resumed by hand.
+    if (co == NULL || !co->queued) continue;
+    co->queued = 0;
+    co->parked = 0;
+    coroutine_resume(S, id);
+    ran++;
+    co = S->co[id];
+    if (co != NULL && !co->parked) {
+      coroutine_wake(S, id);  // it yielded
+    }
+  }
+  return ran;
+}
+
+/**
+ * @brief create a coroutine and queue it to run
+ *
+ * @return int id, or -1
+ */
+int coroutine_spawn(struct schedule *S, coroutine_func func, void *ud) {
+  int id = coroutine_new(S, func, ud);
+  if (id >= 0) {
+    coroutine_wake(S, id);
+  }
+  return id;
+}
+
+/**
+ * @brief arm t to fire once timeout_ms have passed
+ *
+ * @param [in] S
+ * @param [in] t a timer that is not pending
+ * @param [in] timeout_ms
+ */
+void coroutine_add_timer(struct schedule *S, struct timer *t, int timeout_ms) {
+  // Round the deadline up to a tick, so that the timer never fires early.
+  uint64_t deadline = _now_ns() + (uint64_t)timeout_ms * NS_PER_MS;
+  timer_add(&S->timers, t, (deadline + NS_PER_MS - 1) / NS_PER_MS);
+}
+
+static void _timer_expired(struct timer *t) {
+  struct coroutine *co =
+      (struct coroutine *)((char *)t - offsetof(struct coroutine, timer));
+  co->timed_out = 1;
+  coroutine_wake(co->sch, co->id);
+}
+
+/**
+ * @brief park the current coroutine until coroutine_wake or a timeout
+ *
+ * @param [in] S
+ * @param [in] timeout_ms no timeout if < 0
+ * @return int 0 if woken, -1 if the timeout expired first
+ */
+int coroutine_park_timeout(struct schedule *S, int timeout_ms) {
+  assert(S->running >= 0);
+  struct coroutine *C = S->co[S->running];
+  C->timed_out = 0;
+  if (timeout_ms >= 0) {
+    coroutine_add_timer(S, &C->timer, timeout_ms);
+  }
+  coroutine_park(S);
+  timer_cancel(&S->timers, &C->timer);
+  return C->timed_out ? -1 : 0;
+}
+
+/**
+ * @brief suspend the current coroutine for ms milliseconds
+ *
+ * @param [in] S
+ * @param [in] ms
+ */
+void co_sleep(struct schedule *S, int ms) {
+  uint64_t deadline = _now_ns() + (uint64_t)(ms > 0 ? ms : 0) * NS_PER_MS;
+  // Wakeups that are not the timer's send it back to sleep.
+  for (;;) {
+    uint64_t now = _now_ns();
+    if (now >= deadline) {
+      break;
+    }
+    coroutine_park_timeout(S, (int)((deadline - now + NS_PER_MS - 1) /
+                                    NS_PER_MS));
+  }
+}
+
+/**
+ * @brief wake the coroutines whose timeout expired, all in one batch
+ *
+ * @param [in] S
+ * @return int number of coroutines woken
+ */
+int coroutine_run_timers(struct schedule *S) {
+  return timer_wheel_advance(&S->timers, _now_ns() / NS_PER_MS);
+}
+
+/**
+ * @brief time until the next timeout may expire, for a poll timeout
+ *
+ * @param [in] S
+ * @return int milliseconds, 0 if a timeout already expired, -1 if none
+ */
+int coroutine_next_timer(struct schedule *S) {
+  uint64_t next = timer_wheel_next(&S->timers);
+  if (next == UINT64_MAX) {
+    return -1;
+  }
+  uint64_t now = _now_ns();
+  if (next * NS_PER_MS <= now) {
+    return 0;
+  }
+  uint64_t ms = (next * NS_PER_MS - now + NS_PER_MS - 1) / NS_PER_MS;
+  return ms > INT32_MAX ? INT32_MAX : (int)ms;
+}
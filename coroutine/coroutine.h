@@ -13,13 +13,31 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ucontext.h>
 
+#include "coctx.h"
 #include "coroutine.h"
+#include "stack.h"
+#include "timer_wheel.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 struct schedule;
 
 #define STACK_SIZE 1024 * 1024
+// Usable bytes of a private stack, and how many freed ones are kept.
+#define PRIVATE_STACK_SIZE (256 * 1024)
+#define STACK_POOL_MAX_FREE 64
+// Coroutine objects are allocated this many at a time.
+#define COROUTINE_SLAB_SIZE 256
+// A saved shared stack is shrunk to the largest size saved over the last
+// SAVED_STACK_SHRINK_PERIOD yields if it is more than twice as large as
+// that, and larger than SAVED_STACK_SHRINK_MIN bytes. A coroutine that
+// went deep once does not keep its high-water buffer for the rest of its
+// life, while one that goes deep regularly does not reallocate every time.
+#define SAVED_STACK_SHRINK_PERIOD 16
+#define SAVED_STACK_SHRINK_MIN 512
 typedef void (*coroutine_func)(struct schedule *, void *ud);
 #define DEFAULT_COROUTINE 16
 #define COROUTINE_DEAD 0
@@ -27,35 +45,147 @@ typedef void (*coroutine_func)(struct schedule *, void *ud);
 #define COROUTINE_RUNNING 2
 #define COROUTINE_SUSPEND 3
 
+// Where a coroutine's stack lives while it is suspended.
+// COROUTINE_STACK_SHARED: every coroutine runs on schedule::shared_stack,
+// and a yield copies the live part of the stack out (resume copies it
+// back). Memory per coroutine is what its stack actually uses, but each
+// switch costs a memcpy of that size.
+// COROUTINE_STACK_PRIVATE: the coroutine runs on an mmap'd stack of its
+// own with a guard page below it, taken from schedule::stacks. Nothing is
+// copied on a switch, at the price of PRIVATE_STACK_SIZE of address space
+// (pages are committed as they are touched) per coroutine.
+#define COROUTINE_STACK_SHARED 0
+#define COROUTINE_STACK_PRIVATE 1
+
 // 先声明协程类型
 struct coroutine;
+struct co_slab;
+struct co_waitq;
+
+// Run queue entry: a coroutine to resume, or a callback if id is -1.
+struct runq_entry {
+  int id;
+  void (*fn)(void *);
+  void *arg;
+};
 
 struct schedule {
-  char stack[STACK_SIZE];
-  ucontext_t main;
+  struct co_stack shared_stack;  // STACK_SIZE bytes, mapped on first use
+  struct coctx main;
   int nco;
   int cap;
   int running;
   struct coroutine **co;
+  // Unused ids below cap, popped by coroutine_new; a stack of cap entries.
+  int *free_ids;
+  int nfree_ids;
+  // Coroutine objects: every slab ever allocated, and the unused objects.
+  struct co_slab *slabs;
+  struct coroutine *free_co;
+  struct stack_pool stacks;  // private stacks
+  // Private stack of the coroutine that just finished: it is still running
+  // on it, so the stack is released once back in coroutine_resume.
+  struct co_stack retired;
+  // Run queue, a ring of runq_cap entries: room for cap coroutines and
+  // the nposted callbacks queued.
+  struct runq_entry *runq;
+  int runq_cap;
+  int runq_head;
+  int nrunq;
+  int nposted;
+  // Timers of the coroutines, in ticks of 1ms of CLOCK_MONOTONIC.
+  struct timer_wheel timers;
 };
 
 // coroutine: 协程。对于协程需要什么？
 struct coroutine {
   coroutine_func func;   // 协程函数
   void *ud;              // 协程函数参数
-  ucontext_t ctx;        // 协程上下文
+  struct coctx ctx;      // 协程上下文
   struct schedule *sch;  // 协程所属的调度器
   ptrdiff_t cap;         // 协程栈容量
   ptrdiff_t size;        // 协程栈大小
   int status;            // 协程状态
   char *stack;           // 协程栈
+  int stack_mode;        // COROUTINE_STACK_SHARED or _PRIVATE
+  struct co_stack private_stack;  // for COROUTINE_STACK_PRIVATE
+  int queued;            // in schedule::runq
+  int parked;            // called coroutine_park, not woken yet
+  int id;
+  // Timeout of coroutine_park_timeout. It lives here, not on the stack of
+  // the coroutine, which is copied out while it is parked on the shared
+  // stack.
+  struct timer timer;
+  int timed_out;
+  // Wait queue (sync.h) the coroutine is parked in, and the next one in it.
+  struct co_waitq *waitq;
+  struct coroutine *wait_next;
+  // Shrink policy of the saved stack, see SAVED_STACK_SHRINK_PERIOD.
+  ptrdiff_t window_max;
+  int saves;
+  struct coroutine *next_free;  // in schedule::free_co while unused
 };
 
+struct co_slab {
+  struct co_slab *next;
+  struct coroutine co[COROUTINE_SLAB_SIZE];
+};
+
+// Returns NULL if out of memory.
 struct schedule *coroutine_open(void);
 void coroutine_close(struct schedule *);
 
 int coroutine_new(struct schedule *, coroutine_func, void *ud);
+// Like coroutine_new, with the stack mode of the new coroutine. Returns -1
+// if a private stack cannot be mapped.
+int coroutine_new_mode(struct schedule *, coroutine_func, void *ud,
+                       int stack_mode);
 void coroutine_resume(struct schedule *, int id);
 int coroutine_status(struct schedule *, int id);
 int coroutine_running(struct schedule *);
 void coroutine_yield(struct schedule *);
+
+// Run queue. coroutine_wake queues a coroutine, and coroutine_run_ready
+// resumes the queued ones in FIFO order. A coroutine resumed from the
+// queue that calls coroutine_yield goes to the back of the queue; one that
+// calls coroutine_park stays off it until the next coroutine_wake. Waking
+// a coroutine that is not parked is harmless: it just runs once more, so
+// a parked coroutine must recheck what it waits for. Event loops such as
+// the reactor (reactor.h) are built on these.
+void coroutine_wake(struct schedule *, int id);
+void coroutine_park(struct schedule *);
+// Resume every coroutine (and call every callback, see coroutine_post)
+// queued at the time of the call, once. Returns how many ran.
+int coroutine_run_ready(struct schedule *);
+// coroutine_new followed by coroutine_wake.
+int coroutine_spawn(struct schedule *, coroutine_func, void *ud);
+// Queue fn(arg) to be called by coroutine_run_ready, in turn with the
+// coroutines woken, outside of any coroutine. Stackless coroutines
+// (co_task.h) are resumed this way. Returns -1 if out of memory; waking a
+// coroutine, on the other hand, never fails.
+int coroutine_post(struct schedule *, void (*fn)(void *), void *arg);
+
+// Timers. A coroutine parked with a timeout is woken by
+// coroutine_run_timers once the timeout expires, at a 1ms resolution and
+// never early. Whoever drives the run queue must also call
+// coroutine_run_timers, and may sleep for coroutine_next_timer ms when the
+// queue is empty; reactor_run does both.
+//
+// Park the running coroutine until coroutine_wake, or until timeout_ms
+// have passed if timeout_ms >= 0. Returns 0 if woken, -1 on timeout.
+int coroutine_park_timeout(struct schedule *, int timeout_ms);
+// Suspend the running coroutine for ms milliseconds.
+void co_sleep(struct schedule *, int ms);
+// Fire the timers that expired, which wakes the coroutines whose timeout
+// did. Returns how many fired.
+int coroutine_run_timers(struct schedule *);
+// Arm a timer of one's own to fire, on S's wheel, once timeout_ms have
+// passed. Cancel it with timer_cancel(&S->timers, t).
+void coroutine_add_timer(struct schedule *, struct timer *t, int timeout_ms);
+// Milliseconds until a timeout may expire: 0 if one already did, -1 if no
+// coroutine has one pending.
+int coroutine_next_timer(struct schedule *);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,229 @@
+// Loopback echo server on one thread with the epoll reactor.
+//
+// The server thread runs one coroutine per connection: co_read what the
+// client sent, co_write it back. A second thread runs --conns client
+// coroutines on a reactor of its own; each connects and, for --seconds,
+// sends --msg_size bytes, waits for the whole echo and records the round
+// trip. Reported: requests per second over all connections, and the
+// latency percentiles of a round trip.
+//
+// Usage: echo_bench [--conns=N] [--msg_size=N] [--seconds=N]
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "reactor.h"
+
+static int FLAGS_conns = 64;
+static int FLAGS_msg_size = 64;
+static int FLAGS_seconds = 5;
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void check(int ok, const char *what) {
+  if (!ok) {
+    perror(what);
+    exit(1);
+  }
+}
+
+struct server {
+  struct reactor *R;
+  int listen_fd;
+  int stop_fd;  // eventfd: readable once the clients are done
+};
+
+static struct server server;
+
+static void connection(struct schedule *S, void *ud) {
+  (void)S;
+  int fd = (int)(intptr_t)ud;
+  char buf[4096];
+  for (;;) {
+    ssize_t n = co_read(server.R, fd, buf, sizeof(buf), -1);
+    if (n <= 0 || co_write(server.R, fd, buf, n, -1) != n) {
+      break;
+    }
+  }
+  co_close(server.R, fd);
+}
+
+static void acceptor(struct schedule *S, void *ud) {
+  (void)ud;
+  for (;;) {
+    int fd = co_accept(server.R, server.listen_fd, NULL, NULL, -1);
+    if (fd < 0) {
+      break;  // the listening socket was closed by stopper
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    coroutine_spawn(S, connection, (void *)(intptr_t)fd);
+  }
+}
+
+static void stopper(struct schedule *S, void *ud) {
+  (void)S;
+  (void)ud;
+  uint64_t v;
+  co_read(server.R, server.stop_fd, &v, sizeof(v), -1);
+  co_close(server.R, server.listen_fd);
+  co_close(server.R, server.stop_fd);
+}
+
+static void *server_main(void *arg) {
+  (void)arg;
+  struct schedule *S = coroutine_open();
+  server.R = reactor_open(S);
+  coroutine_spawn(S, acceptor, NULL);
+  coroutine_spawn(S, stopper, NULL);
+  reactor_run(server.R);
+  reactor_close(server.R);
+  coroutine_close(S);
+  return NULL;
+}
+
+struct client {
+  struct reactor *R;
+  struct sockaddr_in addr;
+  double deadline;
+  double *micros;  // latency of every round trip
+  long n;
+  long cap;
+};
+
+static void client(struct schedule *S, void *ud) {
+  (void)S;
+  struct client *c = ud;
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  check(fd >= 0, "socket");
+  check(co_connect(c->R, fd, (struct sockaddr *)&c->addr, sizeof(c->addr),
+                   -1) == 0,
+        "co_connect");
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  char *msg = malloc(FLAGS_msg_size);
+  char *reply = malloc(FLAGS_msg_size);
+  memset(msg, 'x', FLAGS_msg_size);
+  double now = now_seconds();
+  while (now < c->deadline) {
+    check(co_write(c->R, fd, msg, FLAGS_msg_size, -1) == FLAGS_msg_size,
+          "co_write");
+    int got = 0;
+    while (got < FLAGS_msg_size) {
+      ssize_t n = co_read(c->R, fd, reply + got, FLAGS_msg_size - got, -1);
+      check(n > 0, "co_read");
+      got += n;
+    }
+    double after = now_seconds();
+    if (c->n == c->cap) {
+      c->cap = c->cap ? c->cap * 2 : 1024;
+      c->micros = realloc(c->micros, sizeof(double) * c->cap);
+    }
+    c->micros[c->n++] = (after - now) * 1e6;
+    now = after;
+  }
+  free(reply);
+  free(msg);
+  co_close(c->R, fd);
+}
+
+static int compare_double(const void *a, const void *b) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, long n, double p) {
+  if (n == 0) return 0;
+  long i = (long)(p * n);
+  return sorted[i < n ? i : n - 1];
+}
+
+int main(int argc, char **argv) {
+  int i;
+  for (i = 1; i < argc; i++) {
+    unsigned long long n;
+    char junk;
+    if (sscanf(argv[i], "--conns=%llu%c", &n, &junk) == 1) {
+      FLAGS_conns = (int)n;
+    } else if (sscanf(argv[i], "--msg_size=%llu%c", &n, &junk) == 1) {
+      FLAGS_msg_size = (int)n;
+    } else if (sscanf(argv[i], "--seconds=%llu%c", &n, &junk) == 1) {
+      FLAGS_seconds = (int)n;
+    } else {
+      fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+  if (FLAGS_conns <= 0 || FLAGS_msg_size <= 0) {
+    fprintf(stderr, "need --conns > 0 and --msg_size > 0\n");
+    return 1;
+  }
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  server.listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  check(server.listen_fd >= 0, "socket");
+  check(bind(server.listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0,
+        "bind");
+  check(listen(server.listen_fd, 1024) == 0, "listen");
+  socklen_t len = sizeof(addr);
+  getsockname(server.listen_fd, (struct sockaddr *)&addr, &len);
+  server.stop_fd = eventfd(0, EFD_CLOEXEC);
+  check(server.stop_fd >= 0, "eventfd");
+
+  pthread_t server_thread;
+  pthread_create(&server_thread, NULL, server_main, NULL);
+
+  struct schedule *S = coroutine_open();
+  struct reactor *R = reactor_open(S);
+  struct client *clients = calloc(FLAGS_conns, sizeof(struct client));
+  double start = now_seconds();
+  for (i = 0; i < FLAGS_conns; i++) {
+    clients[i].R = R;
+    clients[i].addr = addr;
+    clients[i].deadline = start + FLAGS_seconds;
+    coroutine_spawn(S, client, &clients[i]);
+  }
+  reactor_run(R);
+  double secs = now_seconds() - start;
+  uint64_t one = 1;
+  check(write(server.stop_fd, &one, sizeof(one)) == sizeof(one), "write");
+  pthread_join(server_thread, NULL);
+
+  long total = 0;
+  for (i = 0; i < FLAGS_conns; i++) {
+    total += clients[i].n;
+  }
+  double *micros = malloc(sizeof(double) * (total ? total : 1));
+  long k = 0;
+  for (i = 0; i < FLAGS_conns; i++) {
+    memcpy(micros + k, clients[i].micros, sizeof(double) * clients[i].n);
+    k += clients[i].n;
+    free(clients[i].micros);
+  }
+  qsort(micros, total, sizeof(double), compare_double);
+  printf("conns\tmsg_size\trequests_per_sec\tp50_us\tp99_us\tp999_us\n");
+  printf("%d\t%d\t%.0f\t%.1f\t%.1f\t%.1f\n", FLAGS_conns, FLAGS_msg_size,
+         total / secs, percentile(micros, total, 0.5),
+         percentile(micros, total, 0.99), percentile(micros, total, 0.999));
+  free(micros);
+  free(clients);
+  reactor_close(R);
+  coroutine_close(S);
+  return 0;
+}
@@ -0,0 +1,142 @@
+// Throughput of the M:N scheduler on a fan-out/fan-in workload, from 1 to
+// --max_threads worker threads.
+//
+// The main thread spawns --roots root coroutines into the scheduler. Each
+// root spawns --fanout children and then yields until all of them are
+// done; each child spins for --work iterations of an LCG and yields
+// --yields times along the way. Children are spawned into the root's
+// worker deque and the other workers steal them, so the run measures
+// spawning, stealing and switching together.
+//
+// The result is the number of children completed per second, and the
+// speedup over one thread.
+//
+// Coroutines run on their worker's shared stack unless --private_stacks=1:
+// with the defaults up to --roots * --fanout coroutines are alive at once,
+// and at two mappings per private stack that runs into vm.max_map_count.
+//
+// Usage: fanout_bench [--roots=N] [--fanout=N] [--work=N] [--yields=N]
+//                     [--max_threads=N] [--private_stacks=0|1]
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mschedule.h"
+
+static int FLAGS_roots = 64;
+static int FLAGS_fanout = 1024;
+static int FLAGS_work = 2000;
+static int FLAGS_yields = 2;
+static int FLAGS_max_threads = 0;  // 0: number of online CPUs
+static int FLAGS_private_stacks = 0;
+
+struct root {
+  struct mschedule *M;
+  atomic_int pending;
+  atomic_ulong sum;
+};
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void child(struct schedule *S, void *ud) {
+  struct root *r = ud;
+  unsigned long x = (unsigned long)(uintptr_t)&x;
+  int step = FLAGS_work / (FLAGS_yields + 1);
+  int i;
+  for (i = 0; i < FLAGS_work; i++) {
+    x = x * 6364136223846793005ul + 1442695040888963407ul;
+    if (step > 0 && i % step == step - 1 && i + 1 < FLAGS_work) {
+      coroutine_yield(S);
+    }
+  }
+  atomic_fetch_add_explicit(&r->sum, x & 1, memory_order_relaxed);
+  atomic_fetch_sub_explicit(&r->pending, 1, memory_order_release);
+}
+
+static void root(struct schedule *S, void *ud) {
+  struct root *r = ud;
+  int i;
+  for (i = 0; i < FLAGS_fanout; i++) {
+    if (mschedule_spawn(r->M, child, r) != 0) {
+      fprintf(stderr, "mschedule_spawn failed\n");
+      exit(1);
+    }
+  }
+  while (atomic_load_explicit(&r->pending, memory_order_acquire) > 0) {
+    coroutine_yield(S);
+  }
+}
+
+static double bench(int nthreads) {
+  struct mschedule *M =
+      mschedule_open(nthreads, FLAGS_private_stacks ? COROUTINE_STACK_PRIVATE
+                                                    : COROUTINE_STACK_SHARED);
+  struct root *roots = malloc(sizeof(struct root) * FLAGS_roots);
+  int i;
+  for (i = 0; i < FLAGS_roots; i++) {
+    roots[i].M = M;
+    atomic_init(&roots[i].pending, FLAGS_fanout);
+    atomic_init(&roots[i].sum, 0);
+  }
+  double start = now_seconds();
+  for (i = 0; i < FLAGS_roots; i++) {
+    mschedule_spawn(M, root, &roots[i]);
+  }
+  mschedule_wait(M);
+  double secs = now_seconds() - start;
+  mschedule_close(M);
+  free(roots);
+  return (double)FLAGS_roots * FLAGS_fanout / secs;
+}
+
+int main(int argc, char **argv) {
+  int i;
+  for (i = 1; i < argc; i++) {
+    unsigned long long n;
+    char junk;
+    if (sscanf(argv[i], "--roots=%llu%c", &n, &junk) == 1) {
+      FLAGS_roots = (int)n;
+    } else if (sscanf(argv[i], "--fanout=%llu%c", &n, &junk) == 1) {
+      FLAGS_fanout = (int)n;
+    } else if (sscanf(argv[i], "--work=%llu%c", &n, &junk) == 1) {
+      FLAGS_work = (int)n;
+    } else if (sscanf(argv[i], "--yields=%llu%c", &n, &junk) == 1) {
+      FLAGS_yields = (int)n;
+    } else if (sscanf(argv[i], "--max_threads=%llu%c", &n, &junk) == 1) {
+      FLAGS_max_threads = (int)n;
+    } else if (sscanf(argv[i], "--private_stacks=%llu%c", &n, &junk) == 1) {
+      FLAGS_private_stacks = (int)n;
+    } else {
+      fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+  if (FLAGS_max_threads == 0) {
+    FLAGS_max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  if (FLAGS_roots <= 0 || FLAGS_fanout <= 0 || FLAGS_max_threads <= 0) {
+    fprintf(stderr, "need --roots, --fanout and --max_threads > 0\n");
+    return 1;
+  }
+
+  printf("threads\ttasks_per_sec\tspeedup\n");
+  double base = 0;
+  int t;
+  for (t = 1; t <= FLAGS_max_threads; t = (t * 2 > FLAGS_max_threads &&
+                                           t < FLAGS_max_threads)
+                                              ? FLAGS_max_threads
+                                              : t * 2) {
+    double rate = bench(t);
+    if (t == 1) {
+      base = rate;
+    }
+    printf("%d\t%.0f\t%.2f\n", t, rate, rate / base);
+  }
+  return 0;
+}
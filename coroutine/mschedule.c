@@ -0,0 +1,308 @@
+#include "mschedule.h"
+
+#include <stdlib.h>
+
+// The worker running on this thread, if any.
+static __thread struct mworker *current_worker;
+
+// Returns -1 if the queue is full and could not grow.
+static int _ready_push(struct mworker *W, int id) {
+  if (W->nready == W->ready_cap) {
+    int cap = W->ready_cap * 2;
+    int *ready = malloc(sizeof(int) * cap);
+    if (ready == NULL) {
+      return -1;
+    }
+    int i;
+    for (i = 0; i < W->nready; i++) {
+      ready[i] = W->ready[(W->ready_head + i) % W->ready_cap];
+    }
+    free(W->ready);
+    W->ready = ready;
+    W->ready_cap = cap;
+    W->ready_head = 0;
+  }
+  W->ready[(W->ready_head + W->nready) % W->ready_cap] = id;
+  W->nready++;
+  return 0;
+}
+
+static int _ready_pop(struct mworker *W) {
+  int id = W->ready[W->ready_head];
+  W->ready_head = (W->ready_head + 1) % W->ready_cap;
+  W->nready--;
+  return id;
+}
+
+static struct mtask *_inject_pop(struct mschedule *M) {
+  if (atomic_load_explicit(&M->ninject, memory_order_relaxed) == 0) {
+    return NULL;
+  }
+  pthread_mutex_lock(&M->mu);
+  struct mtask *task = M->inject_head;
+  if (task != NULL) {
+    M->inject_head = task->next;
+    if (M->inject_head == NULL) {
+      M->inject_tail = NULL;
+    }
+    atomic_fetch_sub_explicit(&M->ninject, 1, memory_order_relaxed);
+  }
+  pthread_mutex_unlock(&M->mu);
+  return task;
+}
+
+static struct mtask *_steal(struct mworker *W) {
+  struct mschedule *M = W->M;
+  int n = M->nworkers;
+  if (n == 1) {
+    return NULL;
+  }
+  W->rng = W->rng * 1103515245 + 12345;
+  int start = (W->rng >> 16) % n;
+  int i;
+  for (i = 0; i < n; i++) {
+    struct mworker *victim = &M->workers[(start + i) % n];
+    if (victim == W) {
+      continue;
+    }
+    struct mtask *task = ws_deque_steal(&victim->tasks);
+    if (task != NULL) {
+      return task;
+    }
+  }
+  return NULL;
+}
+
+static struct mtask *_find_task(struct mworker *W) {
+  struct mtask *task = ws_deque_take(&W->tasks);
+  if (task == NULL) {
+    task = _inject_pop(W->M);
+  }
+  if (task == NULL) {
+    task = _steal(W);
+  }
+  return task;
+}
+
+static int _has_work(struct mschedule *M) {
+  if (atomic_load(&M->ninject) > 0) {
+    return 1;
+  }
+  int i;
+  for (i = 0; i < M->nworkers; i++) {
+    if (ws_deque_size(&M->workers[i].tasks) > 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void _wake_one(struct mschedule *M) {
+  // Pairs with the increment of idle in _park: either the spawner sees
+  // the idle worker, or the worker sees the new task before it sleeps.
+  atomic_thread_fence(memory_order_seq_cst);
+  if (atomic_load_explicit(&M->idle, memory_order_relaxed) > 0) {
+    pthread_mutex_lock(&M->mu);
+    pthread_cond_signal(&M->work_cv);
+    pthread_mutex_unlock(&M->mu);
+  }
+}
+
+static void _park(struct mschedule *M) {
+  pthread_mutex_lock(&M->mu);
+  atomic_fetch_add(&M->idle, 1);
+  atomic_thread_fence(memory_order_seq_cst);
+  if (!atomic_load(&M->stop) && !_has_work(M)) {
+    pthread_cond_wait(&M->work_cv, &M->mu);
+  }
+  atomic_fetch_sub(&M->idle, 1);
+  pthread_mutex_unlock(&M->mu);
+}
+
+// Resume coroutine "id" of W until it yields or finishes.
+static void _run(struct mworker *W, int id) {
+  coroutine_resume(W->S, id);
+  if (coroutine_status(W->S, id) != COROUTINE_DEAD) {
+    // As in _start: a coroutine that cannot be queued would never run
+    // again and leave mschedule_wait hanging.
+    if (_ready_push(W, id) != 0) {
+      abort();
+    }
+  } else if (atomic_fetch_sub(&W->M->live, 1) == 1) {
+    pthread_mutex_lock(&W->M->mu);
+    pthread_cond_broadcast(&W->M->done_cv);
+    pthread_mutex_unlock(&W->M->mu);
+  }
+}
+
+static void _start(struct mworker *W, struct mtask *task) {
+  int id = coroutine_new_mode(W->S, task->func, task->ud, W->M->stack_mode);
+  free(task);
+  // Out of memory for a private stack: there is no caller left to report
+  // to, and dropping the task would leave mschedule_wait hanging.
+  if (id < 0) {
+    abort();
+  }
+  _run(W, id);
+}
+
+static void *_worker_main(void *arg) {
+  struct mworker *W = arg;
+  struct mschedule *M = W->M;
+  current_worker = W;
+  while (!atomic_load_explicit(&M->stop, memory_order_relaxed)) {
+    struct mtask *task = _find_task(W);
+    if (task != NULL) {
+      _start(W, task);
+    }
+    if (W->nready > 0) {
+      _run(W, _ready_pop(W));
+    } else if (task == NULL) {
+      _park(M);
+    }
+  }
+  current_worker = NULL;
+  return NULL;
+}
+
+// Free what mschedule_open set up for every worker. The workers were
+// calloc'ed, so those it did not get to are all NULL.
+static void _free_workers(struct mschedule *M) {
+  int i;
+  for (i = 0; i < M->nworkers; i++) {
+    struct mworker *W = &M->workers[i];
+    struct mtask *task;
+    if (atomic_load_explicit(&W->tasks.ring, memory_order_relaxed) != NULL) {
+      while ((task = ws_deque_take(&W->tasks)) != NULL) {
+        free(task);
+      }
+    }
+    ws_deque_destroy(&W->tasks);
+    if (W->S != NULL) {
+      coroutine_close(W->S);
+    }
+    free(W->ready);
+  }
+  while (M->inject_head != NULL) {
+    struct mtask *task = M->inject_head;
+    M->inject_head = task->next;
+    free(task);
+  }
+  pthread_cond_destroy(&M->done_cv);
+  pthread_cond_destroy(&M->work_cv);
+  pthread_mutex_destroy(&M->mu);
+  free(M->workers);
+  free(M);
+}
+
+// Stop and join the first n worker threads.
+static void _stop_workers(struct mschedule *M, int n) {
+  pthread_mutex_lock(&M->mu);
+  atomic_store(&M->stop, 1);
+  pthread_cond_broadcast(&M->work_cv);
+  pthread_mutex_unlock(&M->mu);
+  int i;
+  for (i = 0; i < n; i++) {
+    pthread_join(M->workers[i].thread, NULL);
+  }
+}
+
+struct mschedule *mschedule_open(int nthreads, int stack_mode) {
+  if (nthreads < 1) {
+    return NULL;
+  }
+  struct mschedule *M = malloc(sizeof(*M));
+  if (M == NULL) {
+    return NULL;
+  }
+  M->workers = calloc(nthreads, sizeof(struct mworker));
+  if (M->workers == NULL) {
+    free(M);
+    return NULL;
+  }
+  M->nworkers = nthreads;
+  M->stack_mode = stack_mode;
+  atomic_init(&M->live, 0);
+  atomic_init(&M->idle, 0);
+  atomic_init(&M->stop, 0);
+  atomic_init(&M->ninject, 0);
+  pthread_mutex_init(&M->mu, NULL);
+  pthread_cond_init(&M->work_cv, NULL);
+  pthread_cond_init(&M->done_cv, NULL);
+  M->inject_head = NULL;
+  M->inject_tail = NULL;
+
+  int i;
+  for (i = 0; i < nthreads; i++) {
+    struct mworker *W = &M->workers[i];
+    W->M = M;
+    W->index = i;
+    W->S = coroutine_open();
+    W->ready_cap = 64;
+    W->ready = malloc(sizeof(int) * W->ready_cap);
+    W->ready_head = 0;
+    W->nready = 0;
+    W->rng = 0x9e3779b9u * (i + 1);
+    if (ws_deque_init(&W->tasks, 256) != 0 || W->S == NULL ||
+        W->ready == NULL) {
+      _free_workers(M);
+      return NULL;
+    }
+  }
+  // Start the threads once every worker is set up: they steal from each
+  // other right away.
+  for (i = 0; i < nthreads; i++) {
+    if (pthread_create(&M->workers[i].thread, NULL, _worker_main,
+                       &M->workers[i]) != 0) {
+      _stop_workers(M, i);
+      _free_workers(M);
+      return NULL;
+    }
+  }
+  return M;
+}
+
+void mschedule_close(struct mschedule *M) {
+  _stop_workers(M, M->nworkers);
+  _free_workers(M);
+}
+
+int mschedule_spawn(struct mschedule *M, coroutine_func func, void *ud) {
+  struct mtask *task = malloc(sizeof(*task));
+  if (task == NULL) {
+    return -1;
+  }
+  task->func = func;
+  task->ud = ud;
+  task->next = NULL;
+  atomic_fetch_add(&M->live, 1);
+
+  struct mworker *W = current_worker;
+  if (W != NULL && W->M == M) {
+    if (ws_deque_push(&W->tasks, task) != 0) {
+      atomic_fetch_sub(&M->live, 1);
+      free(task);
+      return -1;
+    }
+  } else {
+    pthread_mutex_lock(&M->mu);
+    if (M->inject_tail != NULL) {
+      M->inject_tail->next = task;
+    } else {
+      M->inject_head = task;
+    }
+    M->inject_tail = task;
+    atomic_fetch_add(&M->ninject, 1);
+    pthread_mutex_unlock(&M->mu);
+  }
+  _wake_one(M);
+  return 0;
+}
+
+void mschedule_wait(struct mschedule *M) {
+  pthread_mutex_lock(&M->mu);
+  while (atomic_load(&M->live) > 0) {
+    pthread_cond_wait(&M->done_cv, &M->mu);
+  }
+  pthread_mutex_unlock(&M->mu);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "coroutine.h"
+#include "ws_deque.h"
+
+struct mschedule;
+
+// A task spawned but not started yet.
+struct mtask {
+  coroutine_func func;
+  void *ud;
+  struct mtask *next;  // in mschedule::inject
+};
+
+// One worker thread. It owns a plain single-threaded schedule, so the
+// coroutines it runs see the usual coroutine_func(S, ud) signature and
+// can coroutine_yield(S) as on any schedule.
+struct mworker {
+  struct mschedule *M;
+  int index;
+  pthread_t thread;
+  struct schedule *S;
+  struct ws_deque tasks;  // spawned by this worker, stealable
+  // Coroutines of S that yielded and are ready to run again, in FIFO
+  // order. A coroutine stays on the worker that started it.
+  int *ready;
+  int ready_cap;
+  int ready_head;
+  int nready;
+  unsigned rng;  // picks the first victim to steal from
+};
+
+/**
+ * @brief M:N scheduler: coroutines spread over a fixed set of threads.
+ *
+ * Each worker takes work, in this order, from its own deque of spawned
+ * tasks (newest first, as they are most likely to be cache-warm), from
+ * the injection queue that threads outside the scheduler spawn into, and
+ * finally by stealing the oldest task of another worker. Between two new
+ * tasks it also resumes one of its ready coroutines, so a coroutine that
+ * yields waiting for the tasks it spawned does not starve them.
+ *
+ * Only tasks that have not started are stolen. A started coroutine keeps
+ * pointers into its own stack, and into its worker's schedule, so it
+ * stays on the worker that started it.
+ *
+ * A worker with nothing to do sleeps until a spawn wakes it up.
+ */
+struct mschedule {
+  int nworkers;
+  int stack_mode;  // of every coroutine
+  struct mworker *workers;
+
+  atomic_long live;  // spawned and not finished yet
+  atomic_int idle;   // workers sleeping on work_cv
+  atomic_int stop;
+  atomic_long ninject;
+
+  pthread_mutex_t mu;
+  pthread_cond_t work_cv;  // signalled on spawn when a worker is idle
+  pthread_cond_t done_cv;  // signalled when live drops to zero
+  // Guarded by mu.
+  struct mtask *inject_head;
+  struct mtask *inject_tail;
+};
+
+/**
+ * @brief start nthreads workers
+ *
+ * @param [in] nthreads number of worker threads
+ * @param [in] stack_mode COROUTINE_STACK_SHARED or _PRIVATE
+ * @return struct mschedule*, or NULL on failure
+ */
+struct mschedule *mschedule_open(int nthreads, int stack_mode);
+
+/**
+ * @brief stop the workers and free the scheduler. Coroutines that did not
+ * finish are dropped.
+ */
+void mschedule_close(struct mschedule *M);
+
+/**
+ * @brief run func(S, ud) as a coroutine on one of the workers. May be
+ * called from any thread, including from a coroutine of M.
+ *
+ * @return 0 on success, -1 on allocation failure
+ */
+int mschedule_spawn(struct mschedule *M, coroutine_func func, void *ud);
+
+/**
+ * @brief block the calling thread until every spawned coroutine finished.
+ * Must not be called from a coroutine of M.
+ */
+void mschedule_wait(struct mschedule *M);
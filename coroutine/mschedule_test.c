@@ -0,0 +1,103 @@
+// Fan-out test of the M:N scheduler: a root coroutine spawns children from
+// inside the scheduler, every child spawns grandchildren and yields along
+// the way, and mschedule_wait must return only once every one of them has
+// run to completion. Runs with shared and private stacks and 1 to 4
+// worker threads.
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mschedule.h"
+
+#define CHECK(cond)                                                  \
+  do {                                                               \
+    if (!(cond)) {                                                   \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+              #cond);                                                \
+      exit(1);                                                       \
+    }                                                                \
+  } while (0)
+
+enum { kRoots = 4, kChildren = 64, kGrandchildren = 8, kYields = 3 };
+
+// Lives on the heap: a coroutine on a shared stack must not point into
+// another coroutine's stack.
+struct fanout {
+  struct mschedule *M;
+  atomic_int started;
+  atomic_int finished;
+};
+
+static void grandchild(struct schedule *S, void *ud) {
+  struct fanout *f = ud;
+  atomic_fetch_add(&f->started, 1);
+  coroutine_yield(S);
+  atomic_fetch_add(&f->finished, 1);
+}
+
+static void child(struct schedule *S, void *ud) {
+  struct fanout *f = ud;
+  atomic_fetch_add(&f->started, 1);
+  int i;
+  for (i = 0; i < kGrandchildren; i++) {
+    CHECK(mschedule_spawn(f->M, grandchild, f) == 0);
+    if (i % (kGrandchildren / kYields) == 0) {
+      coroutine_yield(S);
+    }
+  }
+  atomic_fetch_add(&f->finished, 1);
+}
+
+static void root(struct schedule *S, void *ud) {
+  struct fanout *f = ud;
+  atomic_fetch_add(&f->started, 1);
+  int i;
+  for (i = 0; i < kChildren; i++) {
+    CHECK(mschedule_spawn(f->M, child, f) == 0);
+  }
+  coroutine_yield(S);
+  atomic_fetch_add(&f->finished, 1);
+}
+
+static void run(int nthreads, int stack_mode) {
+  struct fanout *f = malloc(sizeof(*f));
+  CHECK(f != NULL);
+  f->M = mschedule_open(nthreads, stack_mode);
+  CHECK(f->M != NULL);
+  atomic_init(&f->started, 0);
+  atomic_init(&f->finished, 0);
+
+  const int total = kRoots * (1 + kChildren * (1 + kGrandchildren));
+  int round;
+  for (round = 1; round <= 3; round++) {
+    int i;
+    for (i = 0; i < kRoots; i++) {
+      CHECK(mschedule_spawn(f->M, root, f) == 0);
+    }
+    mschedule_wait(f->M);
+    if (atomic_load(&f->finished) != round * total ||
+        atomic_load(&f->started) != round * total) {
+      fprintf(stderr,
+              "%d threads, %s stacks, round %d: %d started, %d finished, "
+              "want %d\n",
+              nthreads, stack_mode == COROUTINE_STACK_SHARED ? "shared"
+                                                             : "private",
+              round, atomic_load(&f->started), atomic_load(&f->finished),
+              round * total);
+      exit(1);
+    }
+  }
+  mschedule_close(f->M);
+  free(f);
+}
+
+int main() {
+  CHECK(mschedule_open(0, COROUTINE_STACK_SHARED) == NULL);
+  int nthreads;
+  for (nthreads = 1; nthreads <= 4; nthreads++) {
+    run(nthreads, COROUTINE_STACK_SHARED);
+    run(nthreads, COROUTINE_STACK_PRIVATE);
+  }
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,289 @@
+#define _GNU_SOURCE
+
+#include "reactor.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
+
+#define REACTOR_MAX_EVENTS 256
+#define NS_PER_MS 1000000
+#define NO_DEADLINE UINT64_MAX
+
+static uint64_t _now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t _deadline(int timeout_ms) {
+  if (timeout_ms < 0) {
+    return NO_DEADLINE;
+  }
+  return _now_ns() + (uint64_t)timeout_ms * NS_PER_MS;
+}
+
+struct reactor *reactor_open(struct schedule *S) {
+  int epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (epfd < 0) {
+    return NULL;
+  }
+  struct reactor *R = malloc(sizeof(*R));
+  if (R == NULL) {
+    close(epfd);
+    return NULL;
+  }
+  R->S = S;
+  R->epfd = epfd;
+  R->fds = NULL;
+  R->nfds = 0;
+  R->nwaiting = 0;
+  return R;
+}
+
+void reactor_close(struct reactor *R) {
+  close(R->epfd);
+  free(R->fds);
+  free(R);
+}
+
+// Returns NULL with errno ENOMEM if the table cannot grow to hold fd.
+static struct fd_waiters *_get(struct reactor *R, int fd) {
+  if (fd >= R->nfds) {
+    int n = R->nfds ? R->nfds : 64;
+    while (n <= fd) {
+      n *= 2;
+    }
+    struct fd_waiters *fds = realloc(R->fds, sizeof(struct fd_waiters) * n);
+    if (fds == NULL) {
+      errno = ENOMEM;
+      return NULL;
+    }
+    R->fds = fds;
+    int i;
+    for (i = R->nfds; i < n; i++) {
+      R->fds[i].reader = -1;
+      R->fds[i].writer = -1;
+      R->fds[i].registered = 0;
+    }
+    R->nfds = n;
+  }
+  return &R->fds[fd];
+}
+
+// Make fd non-blocking and add it to the epoll set, once.
+static int _track(struct reactor *R, int fd) {
+  if (fd < 0) {
+    errno = EBADF;
+    return -1;
+  }
+  struct fd_waiters *w = _get(R, fd);
+  if (w == NULL) {
+    return -1;
+  }
+  if (w->registered) {
+    return 0;
+  }
+  int flags = fcntl(fd, F_GETFL);
+  if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+    return -1;
+  }
+  struct epoll_event ev;
+  ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+  ev.data.fd = fd;
+  if (epoll_ctl(R->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+    return -1;
+  }
+  w->registered = 1;
+  return 0;
+}
+
+// Park the running coroutine until fd is readable (or writable), or until
+// the deadline. Returns -1 with errno ETIMEDOUT once the deadline passed.
+static int _wait(struct reactor *R, int fd, int writing, uint64_t deadline) {
+  int timeout_ms = -1;
+  if (deadline != NO_DEADLINE) {
+    uint64_t now = _now_ns();
+    if (now >= deadline) {
+      errno = ETIMEDOUT;
+      return -1;
+    }
+    timeout_ms = (int)((deadline - now + NS_PER_MS - 1) / NS_PER_MS);
+  }
+  struct fd_waiters *w = &R->fds[fd];
+  int *slot = writing ? &w->writer : &w->reader;
+  assert(*slot == -1);
+  *slot = coroutine_running(R->S);
+  R->nwaiting++;
+  int r = coroutine_park_timeout(R->S, timeout_ms);
+  // Woken by reactor_run, which cleared the slot, by the timeout or by
+  // someone else. R->fds may have moved meanwhile.
+  w = &R->fds[fd];
+  slot = writing ? &w->writer : &w->reader;
+  if (*slot != -1) {
+    *slot = -1;
+    R->nwaiting--;
+  }
+  if (r != 0) {
+    errno = ETIMEDOUT;
+  }
+  return r;
+}
+
+static void _dispatch(struct reactor *R, int fd, uint32_t events) {
+  if (fd >= R->nfds) {
+    return;
+  }
+  struct fd_waiters *w = &R->fds[fd];
+  const uint32_t errors = EPOLLERR | EPOLLHUP | EPOLLRDHUP;
+  if ((events & (EPOLLIN | errors)) && w->reader != -1) {
+    coroutine_wake(R->S, w->reader);
+    w->reader = -1;
+    R->nwaiting--;
+  }
+  if ((events & (EPOLLOUT | errors)) && w->writer != -1) {
+    coroutine_wake(R->S, w->writer);
+    w->writer = -1;
+    R->nwaiting--;
+  }
+}
+
+void reactor_run(struct reactor *R) {
+  struct epoll_event events[REACTOR_MAX_EVENTS];
+  for (;;) {
+    coroutine_run_timers(R->S);
+    coroutine_run_ready(R->S);
+    if (R->S->nrunq == 0 && R->nwaiting == 0 && R->S->timers.count == 0) {
+      break;
+    }
+    // Poll without blocking while there are coroutines to run, else until
+    // the next timer.
+    int timeout = R->S->nrunq > 0 ? 0 : coroutine_next_timer(R->S);
+    int n = epoll_wait(R->epfd, events, REACTOR_MAX_EVENTS, timeout);
+    int i;
+    for (i = 0; i < n; i++) {
+      _dispatch(R, events[i].data.fd, events[i].events);
+    }
+  }
+}
+
+ssize_t co_read(struct reactor *R, int fd, void *buf, size_t n,
+                int timeout_ms) {
+  if (_track(R, fd) != 0) {
+    return -1;
+  }
+  uint64_t deadline = _deadline(timeout_ms);
+  for (;;) {
+    ssize_t r = read(fd, buf, n);
+    if (r >= 0 || (errno != EAGAIN && errno != EINTR)) {
+      return r;
+    }
+    if (errno == EAGAIN && _wait(R, fd, 0, deadline) != 0) {
+      return -1;
+    }
+  }
+}
+
+ssize_t co_write(struct reactor *R, int fd, const void *buf, size_t n,
+                 int timeout_ms) {
+  if (_track(R, fd) != 0) {
+    return -1;
+  }
+  uint64_t deadline = _deadline(timeout_ms);
+  const char *p = buf;
+  size_t left = n;
+  while (left > 0) {
+    ssize_t r = write(fd, p, left);
+    if (r >= 0) {
+      p += r;
+      left -= r;
+    } else if (errno == EAGAIN) {
+      if (_wait(R, fd, 1, deadline) != 0) {
+        return -1;
+      }
+    } else if (errno != EINTR) {
+      return -1;
+    }
+  }
+  return n;
+}
+
+int co_accept(struct reactor *R, int fd, struct sockaddr *addr,
+              socklen_t *addrlen, int timeout_ms) {
+  if (_track(R, fd) != 0) {
+    return -1;
+  }
+  uint64_t deadline = _deadline(timeout_ms);
+  for (;;) {
+    int c = accept4(fd, addr, addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (c >= 0 || (errno != EAGAIN && errno != EINTR)) {
+      return c;
+    }
+    if (errno == EAGAIN && _wait(R, fd, 0, deadline) != 0) {
+      return -1;
+    }
+  }
+}
+
+int co_connect(struct reactor *R, int fd, const struct sockaddr *addr,
+               socklen_t addrlen, int timeout_ms) {
+  if (_track(R, fd) != 0) {
+    return -1;
+  }
+  uint64_t deadline = _deadline(timeout_ms);
+  if (connect(fd, addr, addrlen) == 0) {
+    return 0;
+  }
+  if (errno != EINPROGRESS && errno != EINTR) {
+    return -1;
+  }
+  // The connection completes in the background; the fd turns writable
+  // when it is done, one way or the other.
+  for (;;) {
+    if (_wait(R, fd, 1, deadline) != 0) {
+      return -1;
+    }
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0) {
+      return -1;
+    }
+    if (err == 0) {
+      // Spurious wakeups look just like success to SO_ERROR: check that
+      // the socket really is connected.
+      struct sockaddr_storage peer;
+      socklen_t peerlen = sizeof(peer);
+      if (getpeername(fd, (struct sockaddr *)&peer, &peerlen) == 0) {
+        return 0;
+      }
+      if (errno != ENOTCONN) {
+        return -1;
+      }
+    } else if (err != EINPROGRESS && err != EALREADY) {
+      errno = err;
+      return -1;
+    }
+  }
+}
+
+int co_close(struct reactor *R, int fd) {
+  if (fd >= 0 && fd < R->nfds) {
+    struct fd_waiters *w = &R->fds[fd];
+    // Closing the fd takes it out of the epoll set.
+    w->registered = 0;
+    if (w->reader != -1) {
+      coroutine_wake(R->S, w->reader);
+      w->reader = -1;
+      R->nwaiting--;
+    }
+    if (w->writer != -1) {
+      coroutine_wake(R->S, w->writer);
+      w->writer = -1;
+      R->nwaiting--;
+    }
+  }
+  return close(fd);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include "coroutine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Coroutines parked on one fd.
+struct fd_waiters {
+  int reader;      // coroutine id, or -1
+  int writer;      // coroutine id, or -1
+  int registered;  // fd is in the epoll set and non-blocking
+};
+
+/**
+ * @brief epoll-driven event loop for the coroutines of one schedule.
+ *
+ * @details The co_* calls below act like their blocking counterparts from
+ * the point of view of the calling coroutine. Underneath, the fd is
+ * non-blocking. On EAGAIN the coroutine records itself as the fd's
+ * reader or writer and parks, and reactor_run wakes it when epoll reports
+ * the fd ready. One thread thus serves as many connections as it has
+ * coroutines.
+ *
+ * An fd is added to the epoll set once, on first use, edge-triggered for
+ * both directions, so a wait costs no epoll_ctl. Every co_* call
+ * retries the operation first and only parks if it would block, so an
+ * edge that arrives in between is never lost. Close such fds with
+ * co_close, which also forgets them here.
+ *
+ * Every co_* wait takes a timeout in milliseconds, -1 for none. When it
+ * expires the call fails with ETIMEDOUT; it covers the whole call, all the
+ * waits co_write may need included. The timeouts and co_sleep are driven
+ * by the schedule's timer wheel, from reactor_run.
+ *
+ * At most one coroutine may wait to read and one to write on an fd at a
+ * time.
+ */
+struct reactor {
+  struct schedule *S;
+  int epfd;
+  struct fd_waiters *fds;  // indexed by fd
+  int nfds;
+  int nwaiting;  // coroutines parked on an fd
+};
+
+// Returns NULL if the epoll fd or the reactor cannot be allocated.
+struct reactor *reactor_open(struct schedule *S);
+void reactor_close(struct reactor *R);
+
+/**
+ * @brief run the schedule's coroutines until none can make progress: the
+ * run queue is empty, and no coroutine waits on an fd or for a timer.
+ */
+void reactor_run(struct reactor *R);
+
+// The calls below must be made from a coroutine of R->S. They return what
+// read(2), write(2), accept4(2) and connect(2) return, with errno set, and
+// fail with ENOMEM if the reactor's table of fds cannot grow to hold fd.
+ssize_t co_read(struct reactor *R, int fd, void *buf, size_t n,
+                int timeout_ms);
+// Writes all n bytes unless an error occurs or the timeout expires.
+ssize_t co_write(struct reactor *R, int fd, const void *buf, size_t n,
+                 int timeout_ms);
+// The accepted fd is non-blocking and close-on-exec.
+int co_accept(struct reactor *R, int fd, struct sockaddr *addr,
+              socklen_t *addrlen, int timeout_ms);
+int co_connect(struct reactor *R, int fd, const struct sockaddr *addr,
+               socklen_t addrlen, int timeout_ms);
+int co_close(struct reactor *R, int fd);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,284 @@
+// Tests of the epoll reactor over socketpairs and loopback TCP: a read and
+// a write that park on EAGAIN and are woken by the peer, a read that times
+// out, co_close waking the reader parked on the fd, and co_connect to a
+// closed port. Every case runs with shared and with private stacks, and
+// reactor_run must return with no coroutine left waiting.
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "reactor.h"
+
+#define CHECK(cond)                                                  \
+  do {                                                               \
+    if (!(cond)) {                                                   \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+              #cond);                                                \
+      exit(1);                                                       \
+    }                                                                \
+  } while (0)
+
+// Shared by the coroutines of a case. They live here rather than on a
+// stack, which is copied out while its coroutine waits on the shared one.
+static struct schedule *S;
+static struct reactor *R;
+static int stack_mode;
+static int sv[2];
+static char log_buf[64];  // events, in the order they happened
+static int done;
+
+enum { kBulk = 4 << 20 };
+static char *bulk_out, *bulk_in;
+
+static double now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+static void spawn(coroutine_func func) {
+  int id = coroutine_new_mode(S, func, NULL, stack_mode);
+  CHECK(id >= 0);
+  coroutine_wake(S, id);
+}
+
+static void append(const char *event) {
+  CHECK(strlen(log_buf) + strlen(event) < sizeof(log_buf));
+  strcat(log_buf, event);
+}
+
+static void begin(void) {
+  S = coroutine_open();
+  CHECK(S != NULL);
+  R = reactor_open(S);
+  CHECK(R != NULL);
+  CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+  log_buf[0] = '\0';
+  done = 0;
+}
+
+static void finish(void) {
+  reactor_run(R);
+  CHECK(R->nwaiting == 0);
+  CHECK(S->nco == 0);
+  reactor_close(R);
+  coroutine_close(S);
+}
+
+// --- A read parks until the peer writes, then a write of more than the
+// socket buffers hold parks until the peer reads.
+
+static void reader(struct schedule *S, void *ud) {
+  (void)S;
+  (void)ud;
+  char buf[16];
+  append("r");
+  ssize_t n = co_read(R, sv[0], buf, 5, -1);
+  CHECK(n == 5 && memcmp(buf, "hello", 5) == 0);
+  append("R");
+
+  size_t got = 0;
+  while (got < kBulk) {
+    n = co_read(R, sv[0], bulk_in + got, kBulk - got, -1);
+    CHECK(n > 0);
+    got += n;
+  }
+  CHECK(memcmp(bulk_in, bulk_out, kBulk) == 0);
+  done++;
+}
+
+static void writer(struct schedule *S, void *ud) {
+  (void)ud;
+  // Let the reader park first.
+  coroutine_yield(S);
+  CHECK(R->nwaiting == 1);
+  CHECK(R->fds[sv[0]].reader != -1);
+  append("w");
+  CHECK(co_write(R, sv[1], "hello", 5, -1) == 5);
+  CHECK(co_write(R, sv[1], bulk_out, kBulk, -1) == kBulk);
+  append("W");
+  done++;
+}
+
+static void test_park_and_wake(void) {
+  begin();
+  int i;
+  for (i = 0; i < kBulk; i++) {
+    bulk_out[i] = (char)(i * 7 + i / 4096);
+  }
+  memset(bulk_in, 0, kBulk);
+  spawn(reader);
+  spawn(writer);
+  finish();
+  CHECK(done == 2);
+  // The writer parked on the full buffer before the reader drained it.
+  CHECK(strcmp(log_buf, "rwRW") == 0);
+  close(sv[0]);
+  close(sv[1]);
+}
+
+// --- A read with nothing to read times out.
+
+static void timed_reader(struct schedule *S, void *ud) {
+  (void)S;
+  (void)ud;
+  char buf[16];
+  double start = now_ms();
+  errno = 0;
+  CHECK(co_read(R, sv[0], buf, sizeof(buf), 30) == -1);
+  CHECK(errno == ETIMEDOUT);
+  CHECK(now_ms() - start >= 30);
+  CHECK(R->nwaiting == 0);
+  CHECK(R->fds[sv[0]].reader == -1);
+  // A zero timeout fails right away rather than parking.
+  errno = 0;
+  CHECK(co_read(R, sv[0], buf, sizeof(buf), 0) == -1);
+  CHECK(errno == ETIMEDOUT);
+  done++;
+}
+
+static void test_timeout(void) {
+  begin();
+  spawn(timed_reader);
+  finish();
+  CHECK(done == 1);
+  close(sv[0]);
+  close(sv[1]);
+}
+
+// --- co_close wakes the coroutine parked on the fd; its read then fails.
+
+static void closed_reader(struct schedule *S, void *ud) {
+  (void)S;
+  (void)ud;
+  char buf[16];
+  append("r");
+  errno = 0;
+  CHECK(co_read(R, sv[0], buf, sizeof(buf), -1) == -1);
+  CHECK(errno == EBADF);
+  append("R");
+  done++;
+}
+
+static void closer(struct schedule *S, void *ud) {
+  (void)ud;
+  coroutine_yield(S);
+  CHECK(R->nwaiting == 1);
+  append("c");
+  CHECK(co_close(R, sv[0]) == 0);
+  CHECK(R->nwaiting == 0);
+  CHECK(R->fds[sv[0]].registered == 0);
+  done++;
+}
+
+static void test_close_wakes_reader(void) {
+  begin();
+  spawn(closed_reader);
+  spawn(closer);
+  finish();
+  CHECK(done == 2);
+  CHECK(strcmp(log_buf, "rcR") == 0);
+  close(sv[1]);
+}
+
+// --- co_connect to a loopback port nobody listens on is refused; to one
+// that listens it connects, and co_accept takes the connection.
+
+static struct sockaddr_in addr;
+static int listener;
+
+static void refused(struct schedule *S, void *ud) {
+  (void)S;
+  (void)ud;
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  CHECK(fd >= 0);
+  errno = 0;
+  CHECK(co_connect(R, fd, (struct sockaddr *)&addr, sizeof(addr), 1000) ==
+        -1);
+  CHECK(errno == ECONNREFUSED);
+  CHECK(co_close(R, fd) == 0);
+  done++;
+}
+
+static void acceptor(struct schedule *S, void *ud) {
+  (void)S;
+  (void)ud;
+  int c = co_accept(R, listener, NULL, NULL, 1000);
+  CHECK(c >= 0);
+  char buf[4];
+  CHECK(co_read(R, c, buf, sizeof(buf), 1000) == 4);
+  CHECK(memcmp(buf, "ping", 4) == 0);
+  CHECK(co_close(R, c) == 0);
+  done++;
+}
+
+static void connector(struct schedule *S, void *ud) {
+  (void)S;
+  (void)ud;
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  CHECK(fd >= 0);
+  CHECK(co_connect(R, fd, (struct sockaddr *)&addr, sizeof(addr), 1000) ==
+        0);
+  CHECK(co_write(R, fd, "ping", 4, 1000) == 4);
+  CHECK(co_close(R, fd) == 0);
+  done++;
+}
+
+static void test_connect(void) {
+  begin();
+  // Bind a port and close it again, so that it is free but unused.
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  CHECK(listener >= 0);
+  socklen_t len = sizeof(addr);
+  CHECK(bind(listener, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+  CHECK(getsockname(listener, (struct sockaddr *)&addr, &len) == 0);
+  CHECK(close(listener) == 0);
+  spawn(refused);
+  reactor_run(R);
+  CHECK(done == 1);
+
+  addr.sin_port = 0;
+  listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  CHECK(listener >= 0);
+  len = sizeof(addr);
+  CHECK(bind(listener, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+  CHECK(getsockname(listener, (struct sockaddr *)&addr, &len) == 0);
+  CHECK(listen(listener, 4) == 0);
+  spawn(acceptor);
+  spawn(connector);
+  finish();
+  CHECK(done == 3);
+  CHECK(close(listener) == 0);
+  close(sv[0]);
+  close(sv[1]);
+}
+
+int main() {
+  bulk_out = malloc(kBulk);
+  bulk_in = malloc(kBulk);
+  CHECK(bulk_out != NULL && bulk_in != NULL);
+  int modes[] = {COROUTINE_STACK_SHARED, COROUTINE_STACK_PRIVATE};
+  int i;
+  for (i = 0; i < 2; i++) {
+    stack_mode = modes[i];
+    test_park_and_wake();
+    test_timeout();
+    test_close_wakes_reader();
+    test_connect();
+  }
+  free(bulk_out);
+  free(bulk_in);
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,244 @@
+// The cost of each step of a coroutine's life, in one machine-readable
+// table, to compare the runtime before and after a scheduler change.
+//
+// Every line is "impl stack metric depth_kb value": impl is the coctx
+// implementation (COCTX_IMPL), stack "shared", "private" or "-", depth_kb
+// the live stack of the coroutine, in 1 KiB frames, when it switches.
+// Metrics:
+//   create_ns:          coroutine_new_mode, per coroutine, --coroutines of
+//                       them (--private_coroutines with private stacks,
+//                       which are limited by vm.max_map_count);
+//   rss_bytes_per_co:   RSS growth per coroutine once each has run up to
+//                       a yield;
+//   saved_bytes_per_co: stack bytes the schedule keeps for each of them
+//                       (shared only: private stacks are reserved whole);
+//   destroy_ns:         from the last line of a coroutine to the return of
+//                       the coroutine_resume that ran it, which frees it;
+//   resume_ns:          from coroutine_resume to the first line of the
+//                       coroutine after its yield;
+//   yield_ns:           from coroutine_yield to the return of that
+//                       coroutine_resume;
+//   round_trip_ns:      resume plus yield, untimed in between, --iters
+//                       times.
+// The last three are measured at depths doubling from 0 up to
+// --max_depth_kb: on the shared stack a yield copies the live stack out
+// and a resume copies it back. Steps timed one by one read the clock in
+// between; the cost of one read (clock_ns) is taken off each of them.
+//
+// Usage: runtime_bench [--iters=N] [--coroutines=N]
+//                      [--private_coroutines=N] [--max_depth_kb=N]
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "coroutine.h"
+
+static int FLAGS_iters = 200000;
+static int FLAGS_coroutines = 100000;
+static int FLAGS_private_coroutines = 10000;
+static int FLAGS_max_depth_kb = 64;
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static long rss_bytes(void) {
+  long pages = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f != NULL) {
+    long size;
+    if (fscanf(f, "%ld %ld", &size, &pages) != 2) {
+      pages = 0;
+    }
+    fclose(f);
+  }
+  return pages * sysconf(_SC_PAGESIZE);
+}
+
+static double clock_ns;
+
+// Cost of one now_seconds(), so that it can be taken off a timed step.
+static void calibrate(void) {
+  double total = 0;
+  int i;
+  for (i = 0; i < FLAGS_iters; i++) {
+    double t0 = now_seconds();
+    total += now_seconds() - t0;
+  }
+  clock_ns = total * 1e9 / FLAGS_iters;
+}
+
+static void report(const char *stack, const char *metric, int depth_kb,
+                   double value) {
+  printf("%s\t%s\t%s\t%d\t%.1f\n", COCTX_IMPL, stack, metric, depth_kb,
+         value);
+}
+
+// Set by a coroutine right after it is switched to, or right before it
+// returns.
+static double stamp;
+
+struct loop_args {
+  int frames;
+  int timed;  // stamp every switch
+  int stop;   // set by main to let the coroutine return
+};
+
+__attribute__((noinline)) static void descend(struct schedule *S,
+                                              struct loop_args *args,
+                                              int frames) {
+  volatile char pad[1024];
+  pad[0] = (char)frames;
+  if (frames > 0) {
+    descend(S, args, frames - 1);
+  } else {
+    while (!args->stop) {
+      coroutine_yield(S);
+      if (args->timed) {
+        stamp = now_seconds();
+      }
+    }
+  }
+  pad[sizeof(pad) - 1] = pad[0];  // keep the frame live across the call
+}
+
+static void loop(struct schedule *S, void *ud) {
+  struct loop_args *args = ud;
+  descend(S, args, args->frames);
+}
+
+static void bench_switch(const char *name, int mode, int depth_kb) {
+  struct schedule *S = coroutine_open();
+  struct loop_args args = {depth_kb, 0, 0};
+  int id = coroutine_new_mode(S, loop, &args, mode);
+  if (id < 0) {
+    fprintf(stderr, "%s: cannot create coroutine\n", name);
+    exit(1);
+  }
+  coroutine_resume(S, id);  // descend to the requested depth
+
+  double start = now_seconds();
+  int i;
+  for (i = 0; i < FLAGS_iters; i++) {
+    coroutine_resume(S, id);
+  }
+  double round_trip = now_seconds() - start;
+
+  args.timed = 1;
+  double resume = 0, yield = 0;
+  for (i = 0; i < FLAGS_iters; i++) {
+    double t0 = now_seconds();
+    coroutine_resume(S, id);
+    double t1 = now_seconds();
+    resume += stamp - t0;
+    yield += t1 - stamp;
+  }
+  args.stop = 1;
+  coroutine_resume(S, id);
+  coroutine_close(S);
+
+  report(name, "resume_ns", depth_kb, resume * 1e9 / FLAGS_iters - clock_ns);
+  report(name, "yield_ns", depth_kb, yield * 1e9 / FLAGS_iters - clock_ns);
+  report(name, "round_trip_ns", depth_kb, round_trip * 1e9 / FLAGS_iters);
+}
+
+static void parked(struct schedule *S, void *ud) {
+  (void)ud;
+  volatile char locals[256];
+  locals[0] = 1;
+  coroutine_yield(S);
+  locals[sizeof(locals) - 1] = locals[0];
+  stamp = now_seconds();
+}
+
+static void bench_lifecycle(const char *name, int mode, int n) {
+  int *ids = malloc(sizeof(int) * n);
+  struct schedule *S = coroutine_open();
+  // Map the shared stack outside of the measurement.
+  struct loop_args args = {0, 0, 1};
+  coroutine_resume(S, coroutine_new_mode(S, loop, &args, mode));
+  long rss = rss_bytes();
+
+  double start = now_seconds();
+  int i;
+  for (i = 0; i < n; i++) {
+    ids[i] = coroutine_new_mode(S, parked, NULL, mode);
+    if (ids[i] < 0) {
+      fprintf(stderr, "%s: cannot create coroutine %d\n", name, i);
+      exit(1);
+    }
+  }
+  double create = now_seconds() - start;
+
+  for (i = 0; i < n; i++) {
+    coroutine_resume(S, ids[i]);
+  }
+  double bytes = (double)(rss_bytes() - rss) / n;
+  double saved = 0;
+  for (i = 0; i < n; i++) {
+    saved += S->co[ids[i]]->cap;
+  }
+
+  double destroy = 0;
+  for (i = 0; i < n; i++) {
+    coroutine_resume(S, ids[i]);
+    destroy += now_seconds() - stamp;
+  }
+  coroutine_close(S);
+  free(ids);
+
+  report(name, "create_ns", 0, create * 1e9 / n);
+  report(name, "rss_bytes_per_co", 0, bytes);
+  if (mode == COROUTINE_STACK_SHARED) {
+    report(name, "saved_bytes_per_co", 0, saved / n);
+  }
+  report(name, "destroy_ns", 0, destroy * 1e9 / n - clock_ns);
+}
+
+int main(int argc, char **argv) {
+  int i;
+  for (i = 1; i < argc; i++) {
+    unsigned long long n;
+    char junk;
+    if (sscanf(argv[i], "--iters=%llu%c", &n, &junk) == 1) {
+      FLAGS_iters = (int)n;
+    } else if (sscanf(argv[i], "--coroutines=%llu%c", &n, &junk) == 1) {
+      FLAGS_coroutines = (int)n;
+    } else if (sscanf(argv[i], "--private_coroutines=%llu%c", &n, &junk) ==
+               1) {
+      FLAGS_private_coroutines = (int)n;
+    } else if (sscanf(argv[i], "--max_depth_kb=%llu%c", &n, &junk) == 1) {
+      FLAGS_max_depth_kb = (int)n;
+    } else {
+      fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+  if (FLAGS_iters <= 0 || FLAGS_coroutines <= 0 ||
+      FLAGS_private_coroutines <= 0) {
+    fprintf(stderr, "--iters and the coroutine counts must be > 0\n");
+    return 1;
+  }
+  // Leave room for the frames of the coroutine machinery itself.
+  if (FLAGS_max_depth_kb * 1024 + 16 * 1024 > PRIVATE_STACK_SIZE) {
+    fprintf(stderr, "need --max_depth_kb <= %d\n",
+            PRIVATE_STACK_SIZE / 1024 - 16);
+    return 1;
+  }
+
+  calibrate();
+  printf("impl\tstack\tmetric\tdepth_kb\tvalue\n");
+  report("-", "clock_ns", 0, clock_ns);
+  bench_lifecycle("shared", COROUTINE_STACK_SHARED, FLAGS_coroutines);
+  bench_lifecycle("private", COROUTINE_STACK_PRIVATE,
+                  FLAGS_private_coroutines);
+  int depth;
+  for (depth = 0; depth <= FLAGS_max_depth_kb; depth = depth ? depth * 2 : 1) {
+    bench_switch("shared", COROUTINE_STACK_SHARED, depth);
+    bench_switch("private", COROUTINE_STACK_PRIVATE, depth);
+  }
+  return 0;
+}
@@ -0,0 +1,189 @@
+// Create/destroy rate and memory per coroutine with many live coroutines.
+//
+// For each count from --min_live, doubling up to --max_live, a schedule
+// gets that many shared-stack coroutines, all alive at once:
+//   create:  coroutine_new for every one of them;
+//   deep:    each is resumed once and yields from --deep_kb of stack, so
+//            its saved stack grows to that size;
+//   shallow: each is resumed --shallow_yields more times and yields from
+//            near the top of its stack, which lets the saved stacks shrink
+//            back;
+//   destroy: each is resumed one last time and returns.
+// A second schedule then measures churn: with that many coroutines alive,
+// a random one finishes and a new one is created, --live / 4 times, so
+// that free slots are scattered all over the schedule.
+// Reported: creates, destroys and churn steps per second, the saved-stack
+// bytes held per coroutine after the deep and after the shallow phase,
+// and the RSS growth per live coroutine after the shallow phase.
+//
+// Usage: scale_bench [--min_live=N] [--max_live=N] [--deep_kb=N]
+//                    [--shallow_yields=N]
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "coroutine.h"
+
+static int FLAGS_min_live = 125000;
+static int FLAGS_max_live = 1000000;
+static int FLAGS_deep_kb = 1;
+static int FLAGS_shallow_yields = 40;
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static long rss_bytes(void) {
+  long pages = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f != NULL) {
+    long size;
+    if (fscanf(f, "%ld %ld", &size, &pages) != 2) {
+      pages = 0;
+    }
+    fclose(f);
+  }
+  return pages * sysconf(_SC_PAGESIZE);
+}
+
+__attribute__((noinline)) static void descend(struct schedule *S,
+                                              int frames) {
+  volatile char pad[1024];
+  pad[0] = (char)frames;
+  if (frames > 1) {
+    descend(S, frames - 1);
+  } else {
+    coroutine_yield(S);
+  }
+  pad[sizeof(pad) - 1] = pad[0];
+}
+
+static void body(struct schedule *S, void *ud) {
+  (void)ud;
+  descend(S, FLAGS_deep_kb);
+  int i;
+  for (i = 0; i < FLAGS_shallow_yields; i++) {
+    coroutine_yield(S);
+  }
+}
+
+static void quick(struct schedule *S, void *ud) {
+  (void)S;
+  (void)ud;
+}
+
+static double churn(int n, int *ids) {
+  struct schedule *S = coroutine_open();
+  int i;
+  for (i = 0; i < n; i++) {
+    ids[i] = coroutine_new(S, quick, NULL);
+  }
+  unsigned rnd = 301;
+  int steps = n / 4;
+  double start = now_seconds();
+  for (i = 0; i < steps; i++) {
+    rnd = rnd * 1103515245 + 12345;
+    int j = (int)((rnd >> 8) % n);
+    coroutine_resume(S, ids[j]);
+    ids[j] = coroutine_new(S, quick, NULL);
+  }
+  double secs = now_seconds() - start;
+  coroutine_close(S);
+  return steps / secs;
+}
+
+static double saved_bytes_per_co(struct schedule *S) {
+  double total = 0;
+  int live = 0;
+  int i;
+  for (i = 0; i < S->cap; i++) {
+    if (S->co[i] != NULL) {
+      total += S->co[i]->cap;
+      live++;
+    }
+  }
+  return live ? total / live : 0;
+}
+
+static void bench(int n) {
+  int *ids = malloc(sizeof(int) * n);
+  long rss_before = rss_bytes();
+  struct schedule *S = coroutine_open();
+
+  double start = now_seconds();
+  int i;
+  for (i = 0; i < n; i++) {
+    ids[i] = coroutine_new(S, body, NULL);
+  }
+  double create_secs = now_seconds() - start;
+
+  for (i = 0; i < n; i++) {
+    coroutine_resume(S, ids[i]);
+  }
+  double deep_saved = saved_bytes_per_co(S);
+  int r;
+  for (r = 0; r < FLAGS_shallow_yields; r++) {
+    for (i = 0; i < n; i++) {
+      coroutine_resume(S, ids[i]);
+    }
+  }
+  double shallow_saved = saved_bytes_per_co(S);
+  long rss = rss_bytes() - rss_before;
+
+  start = now_seconds();
+  for (i = 0; i < n; i++) {
+    coroutine_resume(S, ids[i]);
+  }
+  double destroy_secs = now_seconds() - start;
+  for (i = 0; i < n; i++) {
+    if (coroutine_status(S, ids[i]) != COROUTINE_DEAD) {
+      fprintf(stderr, "coroutine %d still alive\n", ids[i]);
+      exit(1);
+    }
+  }
+
+  coroutine_close(S);
+
+  double churn_rate = churn(n, ids);
+  printf("%d\t%.0f\t%.0f\t%.0f\t%.0f\t%.0f\t%.0f\n", n, n / create_secs,
+         n / destroy_secs, churn_rate, deep_saved, shallow_saved,
+         (double)rss / n);
+  free(ids);
+}
+
+int main(int argc, char **argv) {
+  int i;
+  for (i = 1; i < argc; i++) {
+    unsigned long long n;
+    char junk;
+    if (sscanf(argv[i], "--min_live=%llu%c", &n, &junk) == 1) {
+      FLAGS_min_live = (int)n;
+    } else if (sscanf(argv[i], "--max_live=%llu%c", &n, &junk) == 1) {
+      FLAGS_max_live = (int)n;
+    } else if (sscanf(argv[i], "--deep_kb=%llu%c", &n, &junk) == 1) {
+      FLAGS_deep_kb = (int)n;
+    } else if (sscanf(argv[i], "--shallow_yields=%llu%c", &n, &junk) == 1) {
+      FLAGS_shallow_yields = (int)n;
+    } else {
+      fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+  if (FLAGS_min_live <= 0 || FLAGS_min_live > FLAGS_max_live ||
+      FLAGS_deep_kb <= 0) {
+    fprintf(stderr, "need 0 < --min_live <= --max_live and --deep_kb > 0\n");
+    return 1;
+  }
+
+  printf(
+      "live\tcreates_per_sec\tdestroys_per_sec\tchurn_per_sec\t"
+      "saved_bytes_deep\tsaved_bytes_shallow\trss_bytes_per_co\n");
+  int n;
+  for (n = FLAGS_min_live; n <= FLAGS_max_live; n *= 2) {
+    bench(n);
+  }
+  return 0;
+}
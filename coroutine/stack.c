@@ -0,0 +1,83 @@
+#include "stack.h"
+
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static size_t _page_size(void) {
+  long page = sysconf(_SC_PAGESIZE);
+  return page > 0 ? (size_t)page : 4096;
+}
+
+int co_stack_map(struct co_stack *stack, size_t size) {
+  size_t page = _page_size();
+  size = (size + page - 1) / page * page;
+  // Reserve the guard page and the stack as one inaccessible mapping and
+  // then open up the stack, so that the guard page is always the one
+  // right below it. MAP_NORESERVE: pages are only committed when touched.
+  size_t len = page + size;
+  void *p = mmap(NULL, len, PROT_NONE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (p == MAP_FAILED) {
+    return -1;
+  }
+  if (mprotect((char *)p + page, size, PROT_READ | PROT_WRITE) != 0) {
+    munmap(p, len);
+    return -1;
+  }
+  stack->base = (char *)p + page;
+  stack->size = size;
+  return 0;
+}
+
+void co_stack_unmap(struct co_stack *stack) {
+  if (stack->base == NULL) {
+    return;
+  }
+  size_t page = _page_size();
+  munmap(stack->base - page, page + stack->size);
+  stack->base = NULL;
+  stack->size = 0;
+}
+
+void stack_pool_init(struct stack_pool *pool, size_t stack_size, int max_free) {
+  pool->stack_size = stack_size;
+  pool->nfree = 0;
+  pool->max_free = max_free;
+  pool->free = max_free > 0 ? malloc(sizeof(struct co_stack) * max_free) : NULL;
+  // Out of memory, the pool just keeps no stacks.
+  if (pool->free == NULL) {
+    pool->max_free = 0;
+  }
+}
+
+void stack_pool_destroy(struct stack_pool *pool) {
+  int i;
+  for (i = 0; i < pool->nfree; i++) {
+    co_stack_unmap(&pool->free[i]);
+  }
+  free(pool->free);
+  pool->free = NULL;
+  pool->nfree = 0;
+}
+
+int stack_pool_get(struct stack_pool *pool, struct co_stack *stack) {
+  if (pool->nfree > 0) {
+    *stack = pool->free[--pool->nfree];
+    return 0;
+  }
+  return co_stack_map(stack, pool->stack_size);
+}
+
+void stack_pool_put(struct stack_pool *pool, struct co_stack *stack) {
+  if (stack->base == NULL) {
+    return;
+  }
+  if (pool->nfree < pool->max_free) {
+    pool->free[pool->nfree++] = *stack;
+    stack->base = NULL;
+    stack->size = 0;
+  } else {
+    co_stack_unmap(stack);
+  }
+}
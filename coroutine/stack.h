@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A coroutine stack: "size" usable bytes from "base" up, mapped right
+// above a PROT_NONE guard page, so that running off the end of the stack
+// faults instead of silently overwriting whatever is mapped below it.
+struct co_stack {
+  char *base;   // lowest usable address; the guard page is right below
+  size_t size;  // usable bytes
+};
+
+/**
+ * @brief map a stack of at least size bytes, rounded up to whole pages.
+ * Pages are only committed when touched.
+ *
+ * @return 0 on success, -1 if the stack could not be mapped
+ */
+int co_stack_map(struct co_stack *stack, size_t size);
+
+/**
+ * @brief unmap a stack mapped by co_stack_map, if any
+ */
+void co_stack_unmap(struct co_stack *stack);
+
+// Stacks of finished coroutines are kept for the next ones, up to
+// "max_free" of them: mapping a fresh stack costs two syscalls plus a page
+// fault for every page it touches.
+struct stack_pool {
+  size_t stack_size;  // usable bytes per stack
+  int nfree;
+  int max_free;
+  struct co_stack *free;
+};
+
+/**
+ * @brief initialize an empty pool of stacks of at least stack_size bytes
+ *
+ * @param [in] pool
+ * @param [in] stack_size usable bytes per stack
+ * @param [in] max_free number of returned stacks to keep mapped
+ */
+void stack_pool_init(struct stack_pool *pool, size_t stack_size, int max_free);
+
+/**
+ * @brief unmap every stack kept in the pool
+ */
+void stack_pool_destroy(struct stack_pool *pool);
+
+/**
+ * @brief take a stack from the pool, mapping a new one if it is empty
+ *
+ * @return 0 on success, -1 if the stack could not be mapped
+ */
+int stack_pool_get(struct stack_pool *pool, struct co_stack *stack);
+
+/**
+ * @brief give a stack back; it is unmapped if the pool is full
+ */
+void stack_pool_put(struct stack_pool *pool, struct co_stack *stack);
+
+#ifdef __cplusplus
+}
+#endif
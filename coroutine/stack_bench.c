@@ -0,0 +1,105 @@
+// Switch latency against stack depth, for shared and private stacks.
+//
+// A coroutine recurses until it has --depth_kb of live stack in 1 KiB
+// frames, then yields in a loop; main resumes it --iters times and
+// reports the cost of one round trip (a resume plus a yield). Depths
+// double from 0 up to --max_depth_kb.
+//
+// With COROUTINE_STACK_SHARED every yield copies the live stack out of
+// schedule::stack and every resume copies it back, so the round trip grows
+// linearly with depth. With COROUTINE_STACK_PRIVATE nothing is copied and
+// the round trip stays flat.
+//
+// Usage: stack_bench [--iters=N] [--max_depth_kb=N]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "coroutine.h"
+
+static int FLAGS_iters = 200000;
+static int FLAGS_max_depth_kb = 128;
+
+struct bench_args {
+  int frames;
+  int stop;  // set by main to let the coroutine return
+};
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+__attribute__((noinline)) static void descend(struct schedule *S,
+                                              struct bench_args *args,
+                                              int frames) {
+  volatile char pad[1024];
+  pad[0] = (char)frames;
+  if (frames > 0) {
+    descend(S, args, frames - 1);
+  } else {
+    while (!args->stop) {
+      coroutine_yield(S);
+    }
+  }
+  pad[sizeof(pad) - 1] = pad[0];  // keep the frame live across the call
+}
+
+static void body(struct schedule *S, void *ud) {
+  struct bench_args *args = ud;
+  descend(S, args, args->frames);
+}
+
+static void bench(const char *name, int stack_mode, int depth_kb) {
+  struct schedule *S = coroutine_open();
+  struct bench_args args = {depth_kb, 0};
+  int id = coroutine_new_mode(S, body, &args, stack_mode);
+  if (id < 0) {
+    fprintf(stderr, "coroutine_new_mode failed\n");
+    exit(1);
+  }
+  coroutine_resume(S, id);  // descend to the requested depth
+  double start = now_seconds();
+  int i;
+  for (i = 0; i < FLAGS_iters; i++) {
+    coroutine_resume(S, id);
+  }
+  double secs = now_seconds() - start;
+  printf("%s\t%d\t%.1f\n", name, depth_kb, secs * 1e9 / FLAGS_iters);
+  args.stop = 1;
+  coroutine_resume(S, id);
+  coroutine_close(S);
+}
+
+int main(int argc, char **argv) {
+  int i;
+  for (i = 1; i < argc; i++) {
+    unsigned long long n;
+    char junk;
+    if (sscanf(argv[i], "--iters=%llu%c", &n, &junk) == 1) {
+      FLAGS_iters = (int)n;
+    } else if (sscanf(argv[i], "--max_depth_kb=%llu%c", &n, &junk) == 1) {
+      FLAGS_max_depth_kb = (int)n;
+    } else {
+      fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+  // Leave room for the frames of the coroutine machinery itself.
+  if (FLAGS_iters <= 0 || FLAGS_max_depth_kb * 1024 + 16 * 1024 >
+                              PRIVATE_STACK_SIZE) {
+    fprintf(stderr, "need --iters > 0 and --max_depth_kb <= %d\n",
+            PRIVATE_STACK_SIZE / 1024 - 16);
+    return 1;
+  }
+
+  printf("mode\tdepth_kb\tns_per_round_trip\n");
+  int depth;
+  for (depth = 0; depth <= FLAGS_max_depth_kb; depth = depth ? depth * 2 : 1) {
+    bench("shared", COROUTINE_STACK_SHARED, depth);
+    bench("private", COROUTINE_STACK_PRIVATE, depth);
+  }
+  return 0;
+}
@@ -0,0 +1,138 @@
+// Cost of a context switch: the coctx switch the runtime was built with
+// against glibc's swapcontext.
+//
+// Each line is the time of one round trip (two switches) between main and
+// a second context, averaged over --iters round trips:
+//   coctx_swap:       two bare contexts switching with coctx_swap;
+//   swapcontext:      the same with getcontext/makecontext/swapcontext,
+//                     which save the signal mask with a syscall each time;
+//   resume_private:   coroutine_resume + coroutine_yield of a coroutine
+//                     with a private stack;
+//   resume_shared:    the same on the shared stack, which also copies the
+//                     (small) live stack out and back.
+// The first column says which coctx implementation the runtime uses; build
+// with -DCOROUTINE_USE_UCONTEXT (:switch_bench_ucontext) to compare the
+// runtime numbers under the fallback.
+//
+// Usage: switch_bench [--iters=N]
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ucontext.h>
+
+#include "coroutine.h"
+
+static int FLAGS_iters = 1000000;
+
+#define BENCH_STACK_SIZE (64 * 1024)
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *op, double secs) {
+  printf("%s\t%s\t%.1f\n", COCTX_IMPL, op, secs * 1e9 / FLAGS_iters);
+}
+
+static struct coctx main_ctx, co_ctx;
+
+static void coctx_body(void *ud) {
+  (void)ud;
+  for (;;) {
+    coctx_swap(&co_ctx, &main_ctx);
+  }
+}
+
+static void bench_coctx(void) {
+  char *stack = malloc(BENCH_STACK_SIZE);
+  coctx_make(&co_ctx, stack, BENCH_STACK_SIZE, coctx_body, NULL);
+  coctx_swap(&main_ctx, &co_ctx);
+  double start = now_seconds();
+  int i;
+  for (i = 0; i < FLAGS_iters; i++) {
+    coctx_swap(&main_ctx, &co_ctx);
+  }
+  report("coctx_swap", now_seconds() - start);
+  free(stack);
+}
+
+static ucontext_t main_uc, co_uc;
+
+static void ucontext_body(void) {
+  for (;;) {
+    swapcontext(&co_uc, &main_uc);
+  }
+}
+
+static void bench_ucontext(void) {
+  char *stack = malloc(BENCH_STACK_SIZE);
+  getcontext(&co_uc);
+  co_uc.uc_stack.ss_sp = stack;
+  co_uc.uc_stack.ss_size = BENCH_STACK_SIZE;
+  co_uc.uc_link = NULL;
+  makecontext(&co_uc, ucontext_body, 0);
+  swapcontext(&main_uc, &co_uc);
+  double start = now_seconds();
+  int i;
+  for (i = 0; i < FLAGS_iters; i++) {
+    swapcontext(&main_uc, &co_uc);
+  }
+  report("swapcontext", now_seconds() - start);
+  free(stack);
+}
+
+static void coroutine_body(struct schedule *S, void *ud) {
+  int *stop = ud;
+  while (!*stop) {
+    coroutine_yield(S);
+  }
+}
+
+static void bench_coroutine(const char *op, int stack_mode) {
+  struct schedule *S = coroutine_open();
+  int stop = 0;
+  int id = coroutine_new_mode(S, coroutine_body, &stop, stack_mode);
+  if (id < 0) {
+    fprintf(stderr, "coroutine_new_mode failed\n");
+    exit(1);
+  }
+  coroutine_resume(S, id);
+  double start = now_seconds();
+  int i;
+  for (i = 0; i < FLAGS_iters; i++) {
+    coroutine_resume(S, id);
+  }
+  report(op, now_seconds() - start);
+  stop = 1;
+  coroutine_resume(S, id);
+  coroutine_close(S);
+}
+
+int main(int argc, char **argv) {
+  int i;
+  for (i = 1; i < argc; i++) {
+    unsigned long long n;
+    char junk;
+    if (sscanf(argv[i], "--iters=%llu%c", &n, &junk) == 1) {
+      FLAGS_iters = (int)n;
+    } else {
+      fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+  if (FLAGS_iters <= 0) {
+    fprintf(stderr, "need --iters > 0\n");
+    return 1;
+  }
+
+  printf("impl\top\tns_per_round_trip\n");
+  bench_coctx();
+  bench_ucontext();
+  bench_coroutine("resume_private", COROUTINE_STACK_PRIVATE);
+  bench_coroutine("resume_shared", COROUTINE_STACK_SHARED);
+  return 0;
+}
@@ -0,0 +1,289 @@
+#include "sync.h"
+
+#include <errno.h>
+
+void co_waitq_init(struct co_waitq *q) {
+  q->head = NULL;
+  q->tail = NULL;
+}
+
+/**
+ * @brief park the current coroutine at the back of q until woken from q
+ *
+ * @param [in] S
+ * @param [in] q
+ */
+void co_wait(struct schedule *S, struct co_waitq *q) {
+  assert(S->running >= 0);
+  struct coroutine *C = S->co[S->running];
+  C->waitq = q;
+  C->wait_next = NULL;
+  if (q->tail != NULL) {
+    q->tail->wait_next = C;
+  } else {
+    q->head = C;
+  }
+  q->tail = C;
+  // Only co_wake_one/co_wake_all take C off q.
+  while (C->waitq != NULL) {
+    coroutine_park(S);
+  }
+}
+
+int co_wake_one(struct schedule *S, struct co_waitq *q) {
+  struct coroutine *C = q->head;
+  if (C == NULL) {
+    return 0;
+  }
+  q->head = C->wait_next;
+  if (q->head == NULL) {
+    q->tail = NULL;
+  }
+  C->waitq = NULL;
+  C->wait_next = NULL;
+  coroutine_wake(S, C->id);
+  return 1;
+}
+
+int co_wake_all(struct schedule *S, struct co_waitq *q) {
+  int n = 0;
+  while (co_wake_one(S, q)) {
+    n++;
+  }
+  return n;
+}
+
+void co_mutex_init(struct co_mutex *m, struct schedule *S) {
+  m->S = S;
+  m->owner = -1;
+  co_waitq_init(&m->waiters);
+}
+
+void co_mutex_lock(struct co_mutex *m) {
+  int self = coroutine_running(m->S);
+  assert(self >= 0 && m->owner != self);
+  if (m->owner == -1) {
+    m->owner = self;
+    return;
+  }
+  // co_mutex_unlock hands the mutex over before waking us.
+  co_wait(m->S, &m->waiters);
+  assert(m->owner == self);
+}
+
+int co_mutex_trylock(struct co_mutex *m) {
+  int self = coroutine_running(m->S);
+  assert(self >= 0);
+  if (m->owner != -1) {
+    return 0;
+  }
+  m->owner = self;
+  return 1;
+}
+
+void co_mutex_unlock(struct co_mutex *m) {
+  assert(m->owner == coroutine_running(m->S));
+  struct coroutine *next = m->waiters.head;
+  if (next == NULL) {
+    m->owner = -1;
+    return;
+  }
+  m->owner = next->id;
+  co_wake_one(m->S, &m->waiters);
+}
+
+void co_waitgroup_init(struct co_waitgroup *wg, struct schedule *S) {
+  wg->S = S;
+  wg->count = 0;
+  co_waitq_init(&wg->waiters);
+}
+
+void co_waitgroup_add(struct co_waitgroup *wg, int n) {
+  wg->count += n;
+  assert(wg->count >= 0);
+  if (wg->count == 0) {
+    co_wake_all(wg->S, &wg->waiters);
+  }
+}
+
+void co_waitgroup_done(struct co_waitgroup *wg) { co_waitgroup_add(wg, -1); }
+
+void co_waitgroup_wait(struct co_waitgroup *wg) {
+  while (wg->count > 0) {
+    co_wait(wg->S, &wg->waiters);
+  }
+}
+
+#define CHAN_INITIAL_UNBOUNDED 16
+
+struct co_chan *co_chan_new(struct schedule *S, size_t elem_size, int cap,
+                            int flags) {
+  assert(elem_size > 0 && cap >= 0);
+  struct co_chan *ch = malloc(sizeof(*ch));
+  if (ch == NULL) {
+    return NULL;
+  }
+  ch->S = S;
+  ch->elem_size = elem_size;
+  ch->cap = cap;
+  ch->flags = flags;
+  ch->closed = 0;
+  ch->nbuf = cap == CO_CHAN_UNBOUNDED ? CHAN_INITIAL_UNBOUNDED : cap;
+  ch->buf = malloc(elem_size * ch->nbuf);
+  if (ch->buf == NULL) {
+    free(ch);
+    return NULL;
+  }
+  ch->head = 0;
+  ch->count = 0;
+  co_waitq_init(&ch->receivers);
+  co_waitq_init(&ch->senders);
+  ch->receiver = -1;
+  ch->sender = -1;
+  return ch;
+}
+
+void co_chan_delete(struct co_chan *ch) {
+  assert(ch->receivers.head == NULL && ch->senders.head == NULL);
+  assert(ch->receiver == -1 && ch->sender == -1);
+  free(ch->buf);
+  free(ch);
+}
+
+static char *_slot(struct co_chan *ch, int i) {
+  return ch->buf + (size_t)((ch->head + i) % ch->nbuf) * ch->elem_size;
+}
+
+static int _full(struct co_chan *ch) {
+  return ch->cap != CO_CHAN_UNBOUNDED && ch->count == ch->cap;
+}
+
+// Double the ring of an unbounded channel, keeping the order.
+static int _grow(struct co_chan *ch) {
+  int nbuf = ch->nbuf * 2;
+  char *buf = malloc(ch->elem_size * nbuf);
+  if (buf == NULL) {
+    return -1;
+  }
+  int first = ch->nbuf - ch->head;
+  if (first > ch->count) {
+    first = ch->count;
+  }
+  memcpy(buf, _slot(ch, 0), ch->elem_size * first);
+  memcpy(buf + ch->elem_size * first, ch->buf,
+         ch->elem_size * (ch->count - first));
+  free(ch->buf);
+  ch->buf = buf;
+  ch->nbuf = nbuf;
+  ch->head = 0;
+  return 0;
+}
+
+// Wait on one side of ch: as its single waiter with CO_CHAN_SPSC, or in
+// its queue.
+static void _wait(struct co_chan *ch, int *single, struct co_waitq *q) {
+  if (ch->flags & CO_CHAN_SPSC) {
+    int self = coroutine_running(ch->S);
+    assert(*single == -1);
+    *single = self;
+    // _wake clears the slot.
+    while (*single == self) {
+      coroutine_park(ch->S);
+    }
+  } else {
+    co_wait(ch->S, q);
+  }
+}
+
+static void _wake(struct co_chan *ch, int *single, struct co_waitq *q) {
+  if (ch->flags & CO_CHAN_SPSC) {
+    if (*single != -1) {
+      int id = *single;
+      *single = -1;
+      coroutine_wake(ch->S, id);
+    }
+  } else {
+    co_wake_one(ch->S, q);
+  }
+}
+
+static void _push(struct co_chan *ch, const void *elem) {
+  memcpy(_slot(ch, ch->count), elem, ch->elem_size);
+  ch->count++;
+  _wake(ch, &ch->receiver, &ch->receivers);
+}
+
+static void _pop(struct co_chan *ch, void *elem) {
+  memcpy(elem, _slot(ch, 0), ch->elem_size);
+  ch->head = (ch->head + 1) % ch->nbuf;
+  ch->count--;
+  if (ch->cap != CO_CHAN_UNBOUNDED) {
+    _wake(ch, &ch->sender, &ch->senders);
+  }
+}
+
+void co_chan_close(struct co_chan *ch) {
+  ch->closed = 1;
+  if (ch->flags & CO_CHAN_SPSC) {
+    _wake(ch, &ch->receiver, NULL);
+    _wake(ch, &ch->sender, NULL);
+  } else {
+    co_wake_all(ch->S, &ch->receivers);
+    co_wake_all(ch->S, &ch->senders);
+  }
+}
+
+int co_chan_send(struct co_chan *ch, const void *elem) {
+  for (;;) {
+    if (ch->closed) {
+      return -1;
+    }
+    if (!_full(ch)) {
+      if (ch->count == ch->nbuf && _grow(ch) != 0) {
+        return -1;
+      }
+      _push(ch, elem);
+      return 0;
+    }
+    _wait(ch, &ch->sender, &ch->senders);
+  }
+}
+
+int co_chan_recv(struct co_chan *ch, void *elem) {
+  for (;;) {
+    if (ch->count > 0) {
+      _pop(ch, elem);
+      return 1;
+    }
+    if (ch->closed) {
+      return 0;
+    }
+    _wait(ch, &ch->receiver, &ch->receivers);
+  }
+}
+
+int co_chan_trysend(struct co_chan *ch, const void *elem) {
+  if (ch->closed) {
+    errno = EPIPE;
+    return -1;
+  }
+  if (_full(ch)) {
+    errno = EAGAIN;
+    return -1;
+  }
+  if (ch->count == ch->nbuf && _grow(ch) != 0) {
+    errno = ENOMEM;
+    return -1;
+  }
+  _push(ch, elem);
+  return 0;
+}
+
+int co_chan_tryrecv(struct co_chan *ch, void *elem) {
+  if (ch->count > 0) {
+    _pop(ch, elem);
+    return 1;
+  }
+  errno = ch->closed ? EPIPE : EAGAIN;
+  return 0;
+}
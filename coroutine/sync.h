@@ -0,0 +1,133 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "coroutine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Synchronization between the coroutines of one schedule: wait queues,
+// and channels, mutexes and wait groups built on them. A coroutine that
+// has to wait parks in a wait queue, off the run queue, until another one
+// wakes it; nothing spins. The calls that wait must be made from a
+// coroutine; the others may also be made from outside of one. None of it
+// is thread-safe: everything belongs to one schedule.
+
+/**
+ * @brief FIFO of parked coroutines.
+ *
+ * @details co_wait parks the running coroutine at the back of the queue,
+ * and returns once co_wake_one or co_wake_all has taken it off the front:
+ * coroutine_wake from anyone else does not end the wait. The woken
+ * coroutine must recheck what it waited for, as other coroutines may run
+ * in between. The links live in struct coroutine, not on its stack, which
+ * is copied out while it waits on the shared stack.
+ */
+struct co_waitq {
+  struct coroutine *head;
+  struct coroutine *tail;
+};
+
+void co_waitq_init(struct co_waitq *q);
+void co_wait(struct schedule *S, struct co_waitq *q);
+// Returns 1 if a coroutine was woken, 0 if q was empty.
+int co_wake_one(struct schedule *S, struct co_waitq *q);
+// Returns how many coroutines were woken.
+int co_wake_all(struct schedule *S, struct co_waitq *q);
+
+/**
+ * @brief mutex, handed over to the coroutines waiting for it in FIFO
+ * order: unlock makes the first waiter the owner before waking it, so a
+ * coroutine that keeps locking cannot starve the others.
+ */
+struct co_mutex {
+  struct schedule *S;
+  int owner;  // coroutine id, or -1
+  struct co_waitq waiters;
+};
+
+void co_mutex_init(struct co_mutex *m, struct schedule *S);
+void co_mutex_lock(struct co_mutex *m);
+// Returns 1 if the mutex was taken, 0 if it is held.
+int co_mutex_trylock(struct co_mutex *m);
+void co_mutex_unlock(struct co_mutex *m);
+
+/**
+ * @brief wait group: co_waitgroup_wait parks until the counter, raised by
+ * co_waitgroup_add and lowered by co_waitgroup_done, drops to 0.
+ */
+struct co_waitgroup {
+  struct schedule *S;
+  int count;
+  struct co_waitq waiters;
+};
+
+void co_waitgroup_init(struct co_waitgroup *wg, struct schedule *S);
+void co_waitgroup_add(struct co_waitgroup *wg, int n);
+void co_waitgroup_done(struct co_waitgroup *wg);
+void co_waitgroup_wait(struct co_waitgroup *wg);
+
+// Capacity of a channel whose buffer grows as needed: sends never wait.
+#define CO_CHAN_UNBOUNDED 0
+// Flag of a channel with one sending and one receiving coroutine at most
+// at any time. A wait is then a single slot rather than a queue, and a
+// send or receive that finds the other side waiting wakes it directly.
+#define CO_CHAN_SPSC 1
+
+/**
+ * @brief channel of fixed-size elements, copied in and out.
+ *
+ * @details A bounded channel buffers up to cap elements, and senders wait
+ * while it is full. Receivers wait while it is empty. Once closed,
+ * sends fail, and receives drain what is left, then fail.
+ */
+struct co_chan {
+  struct schedule *S;
+  size_t elem_size;
+  int cap;  // CO_CHAN_UNBOUNDED or > 0
+  int flags;
+  int closed;
+  // Ring of nbuf elements.
+  char *buf;
+  int nbuf;
+  int head;
+  int count;
+  // Waiting coroutines. With CO_CHAN_SPSC: the one waiting to receive and
+  // to send, or -1.
+  struct co_waitq receivers;
+  struct co_waitq senders;
+  int receiver;
+  int sender;
+};
+
+/**
+ * @brief create a channel
+ *
+ * @param [in] cap buffered elements, or CO_CHAN_UNBOUNDED
+ * @param [in] flags 0 or CO_CHAN_SPSC
+ * @return NULL if out of memory
+ */
+struct co_chan *co_chan_new(struct schedule *S, size_t elem_size, int cap,
+                            int flags);
+// REQUIRES: no coroutine waits on ch.
+void co_chan_delete(struct co_chan *ch);
+// Wake every waiting coroutine; sends fail from now on.
+void co_chan_close(struct co_chan *ch);
+
+// Copy *elem into ch, waiting for room. Returns 0, or -1 if ch is closed
+// (or an unbounded ch cannot grow).
+int co_chan_send(struct co_chan *ch, const void *elem);
+// Copy the oldest element of ch to *elem, waiting for one. Returns 1, or 0
+// if ch is closed and empty.
+int co_chan_recv(struct co_chan *ch, void *elem);
+// Same without waiting: -1 (send) or 0 (recv) if they would have to wait,
+// with errno EAGAIN, if ch is closed, with errno EPIPE, or if an unbounded
+// ch cannot grow, with errno ENOMEM.
+int co_chan_trysend(struct co_chan *ch, const void *elem);
+int co_chan_tryrecv(struct co_chan *ch, void *elem);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,383 @@
+// Tests of sync.h: bounded, unbounded and CO_CHAN_SPSC channels, mutex
+// handoff, wait groups, and the wakeups of co_chan_close. Every case runs
+// with shared and with private stacks, and must leave no coroutine behind.
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sync.h"
+
+#define CHECK(cond)                                                  \
+  do {                                                               \
+    if (!(cond)) {                                                   \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+              #cond);                                                \
+      exit(1);                                                       \
+    }                                                                \
+  } while (0)
+
+// Shared by the coroutines of a case. They live here rather than on a
+// stack, which is copied out while its coroutine waits on the shared one.
+static struct schedule *S;
+static int stack_mode;
+static struct co_chan *chans[2];
+static struct co_mutex mutex;
+static struct co_waitgroup wg;
+static char log_buf[256];  // events, in the order they happened
+static int results[8];
+
+static void spawn(coroutine_func func, long arg) {
+  int id = coroutine_new_mode(S, func, (void *)arg, stack_mode);
+  CHECK(id >= 0);
+  coroutine_wake(S, id);
+}
+
+static void append(const char *event) {
+  CHECK(strlen(log_buf) + strlen(event) < sizeof(log_buf));
+  strcat(log_buf, event);
+}
+
+static void begin(void) {
+  S = coroutine_open();
+  log_buf[0] = '\0';
+  memset(results, 0, sizeof(results));
+}
+
+// Run everything queued, and whatever it queues in turn, to the end.
+static void finish(void) {
+  while (coroutine_run_ready(S) > 0) {
+  }
+  CHECK(S->nco == 0);
+  coroutine_close(S);
+}
+
+// --- Bounded channel: 3 producers, 2 consumers, capacity 4. A wait group
+// tells the closer when every producer is done.
+
+enum { kProducers = 3, kConsumers = 2, kPerProducer = 1000, kCap = 4 };
+static char received[kProducers * kPerProducer];
+static int last_from[kConsumers][kProducers];
+
+static void producer(struct schedule *S, void *ud) {
+  long p = (long)ud;
+  int i;
+  for (i = 0; i < kPerProducer; i++) {
+    int v = p * kPerProducer + i;
+    CHECK(co_chan_send(chans[0], &v) == 0);
+    CHECK(chans[0]->count <= kCap);
+    if (i % 7 == 0) {
+      coroutine_yield(S);
+    }
+  }
+  co_waitgroup_done(&wg);
+}
+
+static void consumer(struct schedule *S, void *ud) {
+  long c = (long)ud;
+  int v, n = 0;
+  while (co_chan_recv(chans[0], &v) == 1) {
+    CHECK(v >= 0 && v < kProducers * kPerProducer);
+    CHECK(received[v] == 0);
+    received[v] = 1;
+    // Each producer's values come out in the order it sent them.
+    int p = v / kPerProducer;
+    CHECK(v % kPerProducer >= last_from[c][p]);
+    last_from[c][p] = v % kPerProducer;
+    if (++n % 5 == 0) {
+      coroutine_yield(S);
+    }
+  }
+  results[c] = n;
+}
+
+static void closer(struct schedule *S, void *ud) {
+  (void)S;
+  (void)ud;
+  co_waitgroup_wait(&wg);
+  co_chan_close(chans[0]);
+}
+
+static void test_bounded(void) {
+  begin();
+  memset(received, 0, sizeof(received));
+  memset(last_from, 0, sizeof(last_from));
+  chans[0] = co_chan_new(S, sizeof(int), kCap, 0);
+  CHECK(chans[0] != NULL);
+  co_waitgroup_init(&wg, S);
+  co_waitgroup_add(&wg, kProducers);
+  long i;
+  for (i = 0; i < kProducers; i++) {
+    spawn(producer, i);
+  }
+  for (i = 0; i < kConsumers; i++) {
+    spawn(consumer, i);
+  }
+  spawn(closer, 0);
+  finish();
+  CHECK(results[0] + results[1] == kProducers * kPerProducer);
+  CHECK(results[0] > 0 && results[1] > 0);
+  for (i = 0; i < kProducers * kPerProducer; i++) {
+    CHECK(received[i] == 1);
+  }
+  co_chan_delete(chans[0]);
+}
+
+// --- Unbounded channel, from outside of any coroutine: fill it with the
+// ring's head at every offset, so that _grow has to unwrap the ring.
+
+static void test_unbounded_grow(void) {
+  S = coroutine_open();
+  int head;
+  for (head = 0; head < 16; head++) {
+    struct co_chan *ch = co_chan_new(S, sizeof(int), CO_CHAN_UNBOUNDED, 0);
+    CHECK(ch != NULL);
+    int next = 0, expect = 0, v;
+    // Move the head along, then fill the ring past its size.
+    while (next < head) {
+      CHECK(co_chan_trysend(ch, &next) == 0);
+      next++;
+    }
+    while (expect < head) {
+      CHECK(co_chan_tryrecv(ch, &v) == 1 && v == expect++);
+    }
+    CHECK(ch->head == head);
+    while (next < head + 100) {
+      CHECK(co_chan_trysend(ch, &next) == 0);
+      next++;
+    }
+    CHECK(ch->nbuf >= 100);
+    while (co_chan_tryrecv(ch, &v) == 1) {
+      CHECK(v == expect++);
+    }
+    CHECK(errno == EAGAIN);
+    CHECK(expect == next);
+    co_chan_close(ch);
+    CHECK(co_chan_trysend(ch, &v) == -1 && errno == EPIPE);
+    CHECK(co_chan_tryrecv(ch, &v) == 0 && errno == EPIPE);
+    co_chan_delete(ch);
+  }
+  coroutine_close(S);
+}
+
+// --- CO_CHAN_SPSC: one sender and one receiver, in order, until close.
+
+enum { kSpscMessages = 2000 };
+
+static void spsc_sender(struct schedule *S, void *ud) {
+  (void)ud;
+  int i;
+  for (i = 0; i < kSpscMessages; i++) {
+    CHECK(co_chan_send(chans[0], &i) == 0);
+    if (i % 3 == 0) {
+      coroutine_yield(S);
+    }
+  }
+  co_chan_close(chans[0]);
+}
+
+static void spsc_receiver(struct schedule *S, void *ud) {
+  (void)S;
+  (void)ud;
+  int v, n = 0;
+  while (co_chan_recv(chans[0], &v) == 1) {
+    CHECK(v == n);
+    n++;
+  }
+  results[0] = n;
+}
+
+static void test_spsc(void) {
+  int caps[] = {1, 3, CO_CHAN_UNBOUNDED};
+  int i;
+  for (i = 0; i < 3; i++) {
+    begin();
+    chans[0] = co_chan_new(S, sizeof(int), caps[i], CO_CHAN_SPSC);
+    CHECK(chans[0] != NULL);
+    // Receiver first, so that it waits on an empty channel at the start.
+    spawn(spsc_receiver, 0);
+    spawn(spsc_sender, 0);
+    finish();
+    CHECK(results[0] == kSpscMessages);
+    co_chan_delete(chans[0]);
+  }
+}
+
+// --- Mutex: every unlock hands the mutex to the longest waiter.
+
+enum { kLockers = 4, kRounds = 3 };
+
+static void locker(struct schedule *S, void *ud) {
+  long id = (long)ud;
+  int i;
+  for (i = 0; i < kRounds; i++) {
+    co_mutex_lock(&mutex);
+    CHECK(mutex.owner == coroutine_running(S));
+    char event[2] = {(char)('0' + id), '\0'};
+    append(event);
+    // The others queue up while we hold it.
+    coroutine_yield(S);
+    CHECK(co_mutex_trylock(&mutex) == 0 || mutex.owner != -1);
+    co_mutex_unlock(&mutex);
+  }
+}
+
+static void test_mutex_handoff(void) {
+  begin();
+  co_mutex_init(&mutex, S);
+  long i;
+  for (i = 0; i < kLockers; i++) {
+    spawn(locker, i);
+  }
+  finish();
+  CHECK(strcmp(log_buf, "012301230123") == 0);
+  CHECK(mutex.owner == -1);
+}
+
+// --- Wait group: the waiters resume once, after the last done.
+
+static void worker(struct schedule *S, void *ud) {
+  long yields = (long)ud;
+  while (yields-- > 0) {
+    coroutine_yield(S);
+  }
+  append("d");
+  co_waitgroup_done(&wg);
+}
+
+static void wg_waiter(struct schedule *S, void *ud) {
+  (void)S;
+  (void)ud;
+  co_waitgroup_wait(&wg);
+  append("w");
+}
+
+static void test_waitgroup(void) {
+  begin();
+  co_waitgroup_init(&wg, S);
+  // Nothing to wait for: returns at once.
+  spawn(wg_waiter, 0);
+  finish();
+  CHECK(strcmp(log_buf, "w") == 0);
+
+  begin();
+  co_waitgroup_init(&wg, S);
+  co_waitgroup_add(&wg, 5);
+  spawn(wg_waiter, 0);
+  spawn(wg_waiter, 0);
+  long i;
+  for (i = 0; i < 5; i++) {
+    spawn(worker, 5 - i);
+  }
+  finish();
+  CHECK(strcmp(log_buf, "dddddww") == 0);
+  CHECK(wg.count == 0);
+}
+
+// --- co_chan_close wakes every waiter, senders and receivers alike.
+
+static void close_sender(struct schedule *S, void *ud) {
+  (void)S;
+  long i = (long)ud;
+  int v = (int)i;
+  results[i] = co_chan_send(chans[0], &v);
+}
+
+// Receives once, which frees a slot and wakes a sender, and waits on the
+// now empty channel.
+static void close_receiver(struct schedule *S, void *ud) {
+  (void)S;
+  (void)ud;
+  int v = -1;
+  results[4] = co_chan_recv(chans[0], &v);
+  results[5] = v;
+  results[6] = co_chan_recv(chans[0], &v);
+}
+
+static void close_chan(struct schedule *S, void *ud) {
+  (void)S;
+  long i = (long)ud;
+  // Senders and receivers are both waiting on chans[0] here.
+  if (i == 0) {
+    CHECK(chans[0]->senders.head != NULL && chans[0]->receivers.head != NULL);
+  }
+  co_chan_close(chans[i]);
+}
+
+static void test_close_wakes_both_sides(void) {
+  begin();
+  chans[0] = co_chan_new(S, sizeof(int), 1, 0);
+  CHECK(chans[0] != NULL);
+  // Sender 0 fills the channel, 1 and 2 wait. The receiver takes 0's
+  // value, which wakes 1, and waits. Close runs before 1 gets to send.
+  spawn(close_sender, 0);
+  spawn(close_sender, 1);
+  spawn(close_sender, 2);
+  spawn(close_receiver, 0);
+  spawn(close_chan, 0);
+  finish();
+  CHECK(results[0] == 0);
+  CHECK(results[1] == -1 && results[2] == -1);
+  CHECK(results[4] == 1 && results[5] == 0);
+  CHECK(results[6] == 0);
+  co_chan_delete(chans[0]);
+}
+
+static void spsc_close_sender(struct schedule *S, void *ud) {
+  (void)S;
+  (void)ud;
+  int v = 1;
+  results[0] = co_chan_send(chans[0], &v);  // fills it
+  results[1] = co_chan_send(chans[0], &v);  // waits
+}
+
+static void spsc_close_receiver(struct schedule *S, void *ud) {
+  (void)S;
+  (void)ud;
+  int v;
+  results[2] = co_chan_recv(chans[1], &v);  // waits on an empty channel
+}
+
+static void spsc_close(struct schedule *S, void *ud) {
+  (void)S;
+  (void)ud;
+  CHECK(chans[0]->sender != -1 && chans[1]->receiver != -1);
+  co_chan_close(chans[0]);
+  co_chan_close(chans[1]);
+}
+
+static void test_spsc_close(void) {
+  begin();
+  chans[0] = co_chan_new(S, sizeof(int), 1, CO_CHAN_SPSC);
+  chans[1] = co_chan_new(S, sizeof(int), 1, CO_CHAN_SPSC);
+  CHECK(chans[0] != NULL && chans[1] != NULL);
+  spawn(spsc_close_sender, 0);
+  spawn(spsc_close_receiver, 0);
+  spawn(spsc_close, 0);
+  finish();
+  CHECK(results[0] == 0 && results[1] == -1);
+  CHECK(results[2] == 0);
+  CHECK(chans[0]->sender == -1 && chans[1]->receiver == -1);
+  // What was sent before the close is still there to receive.
+  int v;
+  CHECK(co_chan_tryrecv(chans[0], &v) == 1 && v == 1);
+  co_chan_delete(chans[0]);
+  co_chan_delete(chans[1]);
+}
+
+int main() {
+  int modes[] = {COROUTINE_STACK_SHARED, COROUTINE_STACK_PRIVATE};
+  int i;
+  for (i = 0; i < 2; i++) {
+    stack_mode = modes[i];
+    test_bounded();
+    test_unbounded_grow();
+    test_spsc();
+    test_mutex_handoff();
+    test_waitgroup();
+    test_close_wakes_both_sides();
+    test_spsc_close();
+  }
+  printf("ok\n");
+  return 0;
+}
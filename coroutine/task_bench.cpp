@@ -0,0 +1,278 @@
+// Stackless (co_task.h) against stackful (coroutine.h) coroutines.
+//
+// For each kind, --coroutines of them (--private_coroutines for private
+// stacks, which are limited by vm.max_map_count) are created, started and
+// left suspended in a yield, a few hundred bytes of locals deep. Reported:
+//   bytes_per_co: RSS growth per suspended coroutine;
+//   create_ns:    creating one (a task, or coroutine_new);
+//   resume_ns:    resuming one directly and having it suspend again
+//                 (a generator step, or coroutine_resume/coroutine_yield);
+//   runq_ns:      the same through the run queue (co::yield, or
+//                 coroutine_yield from a coroutine woken by
+//                 coroutine_run_ready), per resume.
+// Then the cost of one call across the two kinds, --calls times:
+//   task_awaits_task:         co_await of a task that returns at once;
+//   stackful_awaits_task:     co::await of such a task from a stackful
+//                             coroutine;
+//   task_awaits_stackful:     co_await co::stackful(S, f), with f running
+//                             to completion on a new stackful coroutine;
+//   stackful_calls_stackful:  coroutine_new and coroutine_resume of a
+//                             coroutine that returns at once.
+//
+// Usage: task_bench [--coroutines=N] [--private_coroutines=N]
+//                   [--resumes=N] [--calls=N]
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <unistd.h>
+
+#include "co_task.h"
+#include "coroutine.h"
+
+static int FLAGS_coroutines = 100000;
+static int FLAGS_private_coroutines = 10000;
+static int FLAGS_resumes = 10000000;
+static int FLAGS_calls = 1000000;
+
+static double now_seconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static long rss_bytes() {
+  long pages = 0;
+  FILE* f = fopen("/proc/self/statm", "r");
+  if (f != nullptr) {
+    long size;
+    if (fscanf(f, "%ld %ld", &size, &pages) != 2) {
+      pages = 0;
+    }
+    fclose(f);
+  }
+  return pages * sysconf(_SC_PAGESIZE);
+}
+
+// Keeps "locals" alive across the suspension, as real code would.
+static volatile long sink;
+
+static void touch(volatile char* locals, int n) {
+  for (int i = 0; i < n; i += 64) {
+    locals[i] = static_cast<char>(i);
+  }
+}
+
+static co::task<void> parked_task(struct schedule* S) {
+  volatile char locals[256];
+  touch(locals, sizeof(locals));
+  co_await co::yield(S);
+  sink = sink + locals[0];
+}
+
+static void parked_stackful(struct schedule* S, void* ud) {
+  (void)ud;
+  volatile char locals[256];
+  touch(locals, sizeof(locals));
+  coroutine_yield(S);
+  sink = sink + locals[0];
+}
+
+static co::generator<int> counter() {
+  for (int i = 0;; i++) {
+    co_yield i;
+  }
+}
+
+static co::task<void> yield_loop(struct schedule* S, int n) {
+  for (int i = 0; i < n; i++) {
+    co_await co::yield(S);
+  }
+}
+
+static void stackful_loop(struct schedule* S, void* ud) {
+  int n = static_cast<int>(reinterpret_cast<intptr_t>(ud));
+  for (int i = 0; i < n; i++) {
+    coroutine_yield(S);
+  }
+}
+
+static void drain(struct schedule* S) {
+  while (coroutine_run_ready(S) > 0) {
+  }
+}
+
+static void bench_stackless() {
+  int n = FLAGS_coroutines;
+  struct schedule* S = coroutine_open();
+  long rss = rss_bytes();
+  double start = now_seconds();
+  for (int i = 0; i < n; i++) {
+    co::spawn(S, parked_task(S));
+  }
+  double create = now_seconds() - start;
+  coroutine_run_ready(S);  // each one runs up to its yield
+  double bytes = static_cast<double>(rss_bytes() - rss) / n;
+  drain(S);
+
+  co::generator<int> g = counter();
+  auto it = g.begin();
+  start = now_seconds();
+  for (int i = 0; i < FLAGS_resumes; i++) {
+    ++it;
+  }
+  double resume = now_seconds() - start;
+  sink = sink + *it;
+
+  co::spawn(S, yield_loop(S, FLAGS_resumes));
+  start = now_seconds();
+  drain(S);
+  double runq = now_seconds() - start;
+  coroutine_close(S);
+
+  printf("stackless\t%d\t%.0f\t%.1f\t%.1f\t%.1f\n", n, bytes, create * 1e9 / n,
+         resume * 1e9 / FLAGS_resumes, runq * 1e9 / FLAGS_resumes);
+}
+
+static void bench_stackful(const char* name, int mode, int n) {
+  struct schedule* S = coroutine_open();
+  // Map the shared stack outside of the measurement.
+  coroutine_resume(S, coroutine_new_mode(S, stackful_loop, nullptr, mode));
+  long rss = rss_bytes();
+  double start = now_seconds();
+  for (int i = 0; i < n; i++) {
+    int id = coroutine_new_mode(S, parked_stackful, nullptr, mode);
+    if (id < 0) {
+      fprintf(stderr, "%s: cannot create coroutine %d\n", name, i);
+      exit(1);
+    }
+    coroutine_wake(S, id);
+  }
+  double create = now_seconds() - start;
+  coroutine_run_ready(S);
+  double bytes = static_cast<double>(rss_bytes() - rss) / n;
+  drain(S);
+
+  void* rounds = reinterpret_cast<void*>(static_cast<intptr_t>(FLAGS_resumes));
+  int id = coroutine_new_mode(S, stackful_loop, rounds, mode);
+  start = now_seconds();
+  while (coroutine_status(S, id) != COROUTINE_DEAD) {
+    coroutine_resume(S, id);
+  }
+  double resume = now_seconds() - start;
+
+  coroutine_wake(S, coroutine_new_mode(S, stackful_loop, rounds, mode));
+  start = now_seconds();
+  drain(S);
+  double runq = now_seconds() - start;
+  coroutine_close(S);
+
+  printf("%s\t%d\t%.0f\t%.1f\t%.1f\t%.1f\n", name, n, bytes, create * 1e9 / n,
+         resume * 1e9 / FLAGS_resumes, runq * 1e9 / FLAGS_resumes);
+}
+
+static co::task<int> answer(int x) { co_return x + 1; }
+
+static co::task<void> await_tasks(int n, double* secs) {
+  long sum = 0;
+  double start = now_seconds();
+  for (int i = 0; i < n; i++) {
+    sum += co_await answer(i);
+  }
+  *secs = now_seconds() - start;
+  sink = sink + sum;
+}
+
+static co::task<void> await_stackful(struct schedule* S, int n,
+                                     double* secs) {
+  long sum = 0;
+  double start = now_seconds();
+  for (int i = 0; i < n; i++) {
+    sum += co_await co::stackful(S, [i] { return i + 1; });
+  }
+  *secs = now_seconds() - start;
+  sink = sink + sum;
+}
+
+static double* stackful_await_secs;
+
+static void stackful_awaits_tasks(struct schedule* S, void* ud) {
+  int n = static_cast<int>(reinterpret_cast<intptr_t>(ud));
+  long sum = 0;
+  double start = now_seconds();
+  for (int i = 0; i < n; i++) {
+    sum += co::await(S, answer(i));
+  }
+  *stackful_await_secs = now_seconds() - start;
+  sink = sink + sum;
+}
+
+static void returns(struct schedule* S, void* ud) {
+  (void)S;
+  sink = sink + reinterpret_cast<intptr_t>(ud);
+}
+
+static void bench_calls() {
+  int n = FLAGS_calls;
+  struct schedule* S = coroutine_open();
+  double task_task = 0;
+  co::spawn(S, await_tasks(n, &task_task));
+  drain(S);
+
+  double stackful_task = 0;
+  stackful_await_secs = &stackful_task;
+  coroutine_spawn(S, stackful_awaits_tasks,
+                  reinterpret_cast<void*>(static_cast<intptr_t>(n)));
+  drain(S);
+
+  double task_stackful = 0;
+  co::spawn(S, await_stackful(S, n, &task_stackful));
+  drain(S);
+
+  double start = now_seconds();
+  for (int i = 0; i < n; i++) {
+    coroutine_resume(S, coroutine_new(S, returns, nullptr));
+  }
+  double stackful_stackful = now_seconds() - start;
+  coroutine_close(S);
+
+  printf("task_awaits_task\t%.1f\n", task_task * 1e9 / n);
+  printf("stackful_awaits_task\t%.1f\n", stackful_task * 1e9 / n);
+  printf("task_awaits_stackful\t%.1f\n", task_stackful * 1e9 / n);
+  printf("stackful_calls_stackful\t%.1f\n", stackful_stackful * 1e9 / n);
+}
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    unsigned long long n;
+    char junk;
+    if (sscanf(argv[i], "--coroutines=%llu%c", &n, &junk) == 1) {
+      FLAGS_coroutines = static_cast<int>(n);
+    } else if (sscanf(argv[i], "--private_coroutines=%llu%c", &n, &junk) ==
+               1) {
+      FLAGS_private_coroutines = static_cast<int>(n);
+    } else if (sscanf(argv[i], "--resumes=%llu%c", &n, &junk) == 1) {
+      FLAGS_resumes = static_cast<int>(n);
+    } else if (sscanf(argv[i], "--calls=%llu%c", &n, &junk) == 1) {
+      FLAGS_calls = static_cast<int>(n);
+    } else {
+      fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+  if (FLAGS_coroutines <= 0 || FLAGS_private_coroutines <= 0 ||
+      FLAGS_resumes <= 0 || FLAGS_calls <= 0) {
+    fprintf(stderr, "all flags must be > 0\n");
+    return 1;
+  }
+
+  printf("impl\tcoroutines\tbytes_per_co\tcreate_ns\tresume_ns\trunq_ns\n");
+  bench_stackless();
+  bench_stackful("stackful_shared", COROUTINE_STACK_SHARED,
+                 FLAGS_coroutines);
+  bench_stackful("stackful_private", COROUTINE_STACK_PRIVATE,
+                 FLAGS_private_coroutines);
+
+  printf("\ncall\tns\n");
+  bench_calls();
+  return 0;
+}
@@ -0,0 +1,336 @@
+// Timer wheel throughput, and wakeup jitter of co_sleep.
+//
+// Throughput: --timers timers, expiring at random within --horizon_ms of
+// now, are put into the schedule's timer wheel and into a binary heap
+// (the usual alternative, O(log n) per operation), and reported per
+// operation:
+//   insert: adding all of them;
+//   rearm:  with all of them pending, cancelling a random one and adding
+//           it again with a new expiry, --rearms times, the fate of most
+//           I/O timeouts;
+//   cancel: cancelling all of them, in random order;
+//   expire: adding them back and advancing past the horizon, so that all
+//           of them fire.
+// Jitter: with --timers dummy timers pending an hour ahead, --sleepers
+// coroutines under reactor_run each co_sleep --rounds times for a random
+// 1 to --max_sleep_ms ms. Reported: how late they woke up (p50, p99, max,
+// in microseconds), how many woke up early (must be 0), and the CPU time
+// used as a share of the elapsed time, which is low when waiting does not
+// spin.
+//
+// Usage: timer_bench [--timers=N] [--horizon_ms=N] [--rearms=N]
+//                    [--sleepers=N] [--rounds=N] [--max_sleep_ms=N]
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "coroutine.h"
+#include "reactor.h"
+
+static int FLAGS_timers = 1000000;
+static int FLAGS_horizon_ms = 600000;
+static int FLAGS_rearms = 1000000;
+static int FLAGS_sleepers = 1000;
+static int FLAGS_rounds = 20;
+static int FLAGS_max_sleep_ms = 20;
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double cpu_seconds(void) {
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6 +
+         ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+}
+
+static unsigned rnd = 1;
+
+static unsigned next_rand(void) {
+  rnd = rnd * 1103515245 + 12345;
+  return rnd >> 8;
+}
+
+// Binary min-heap of timers; each knows its index, for cancel.
+struct htimer {
+  uint64_t expires;
+  int index;  // -1 while not pending
+};
+
+struct heap {
+  struct htimer **h;
+  int n;
+};
+
+static void heap_swap(struct heap *H, int i, int j) {
+  struct htimer *t = H->h[i];
+  H->h[i] = H->h[j];
+  H->h[j] = t;
+  H->h[i]->index = i;
+  H->h[j]->index = j;
+}
+
+static void heap_up(struct heap *H, int i) {
+  while (i > 0 && H->h[(i - 1) / 2]->expires > H->h[i]->expires) {
+    heap_swap(H, i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+}
+
+static void heap_down(struct heap *H, int i) {
+  for (;;) {
+    int m = i;
+    int l = 2 * i + 1;
+    int r = l + 1;
+    if (l < H->n && H->h[l]->expires < H->h[m]->expires) m = l;
+    if (r < H->n && H->h[r]->expires < H->h[m]->expires) m = r;
+    if (m == i) break;
+    heap_swap(H, i, m);
+    i = m;
+  }
+}
+
+static void heap_add(struct heap *H, struct htimer *t, uint64_t expires) {
+  t->expires = expires;
+  t->index = H->n;
+  H->h[H->n++] = t;
+  heap_up(H, t->index);
+}
+
+static void heap_cancel(struct heap *H, struct htimer *t) {
+  int i = t->index;
+  if (i < 0) return;
+  H->n--;
+  if (i != H->n) {
+    H->h[i] = H->h[H->n];
+    H->h[i]->index = i;
+    heap_down(H, i);
+    heap_up(H, i);
+  }
+  t->index = -1;
+}
+
+static long fired;
+
+static void count_fired(struct timer *t) {
+  (void)t;
+  fired++;
+}
+
+static void shuffle(int *order, int n) {
+  int i;
+  for (i = 0; i < n; i++) order[i] = i;
+  for (i = n - 1; i > 0; i--) {
+    int j = (int)(next_rand() % (i + 1));
+    int t = order[i];
+    order[i] = order[j];
+    order[j] = t;
+  }
+}
+
+static void bench_wheel(int n, int *order) {
+  struct timer_wheel *W = malloc(sizeof(*W));
+  struct timer *timers = malloc(sizeof(struct timer) * n);
+  uint64_t now = 1000;
+  timer_wheel_init(W, now);
+  int i;
+  for (i = 0; i < n; i++) timer_init(&timers[i], count_fired);
+
+  rnd = 1;
+  double start = now_seconds();
+  for (i = 0; i < n; i++) {
+    timer_add(W, &timers[i], now + 1 + next_rand() % FLAGS_horizon_ms);
+  }
+  double insert = now_seconds() - start;
+
+  start = now_seconds();
+  for (i = 0; i < FLAGS_rearms; i++) {
+    struct timer *t = &timers[next_rand() % n];
+    timer_cancel(W, t);
+    timer_add(W, t, now + 1 + next_rand() % FLAGS_horizon_ms);
+  }
+  double rearm = now_seconds() - start;
+
+  start = now_seconds();
+  for (i = 0; i < n; i++) timer_cancel(W, &timers[order[i]]);
+  double cancel = now_seconds() - start;
+
+  for (i = 0; i < n; i++) {
+    timer_add(W, &timers[i], now + 1 + next_rand() % FLAGS_horizon_ms);
+  }
+  fired = 0;
+  start = now_seconds();
+  timer_wheel_advance(W, now + FLAGS_horizon_ms);
+  double expire = now_seconds() - start;
+  if (fired != n || W->count != 0) {
+    fprintf(stderr, "wheel: %ld of %d timers fired\n", fired, n);
+    exit(1);
+  }
+
+  printf("wheel\t%d\t%.1f\t%.1f\t%.1f\t%.1f\n", n, insert * 1e9 / n,
+         rearm * 1e9 / FLAGS_rearms, cancel * 1e9 / n, expire * 1e9 / n);
+  free(timers);
+  free(W);
+}
+
+static void bench_heap(int n, int *order) {
+  struct heap H;
+  H.h = malloc(sizeof(struct htimer *) * n);
+  H.n = 0;
+  struct htimer *timers = malloc(sizeof(struct htimer) * n);
+  uint64_t now = 1000;
+  int i;
+
+  rnd = 1;
+  double start = now_seconds();
+  for (i = 0; i < n; i++) {
+    heap_add(&H, &timers[i], now + 1 + next_rand() % FLAGS_horizon_ms);
+  }
+  double insert = now_seconds() - start;
+
+  start = now_seconds();
+  for (i = 0; i < FLAGS_rearms; i++) {
+    struct htimer *t = &timers[next_rand() % n];
+    heap_cancel(&H, t);
+    heap_add(&H, t, now + 1 + next_rand() % FLAGS_horizon_ms);
+  }
+  double rearm = now_seconds() - start;
+
+  start = now_seconds();
+  for (i = 0; i < n; i++) heap_cancel(&H, &timers[order[i]]);
+  double cancel = now_seconds() - start;
+
+  for (i = 0; i < n; i++) {
+    heap_add(&H, &timers[i], now + 1 + next_rand() % FLAGS_horizon_ms);
+  }
+  start = now_seconds();
+  uint64_t last = 0;
+  while (H.n > 0) {
+    struct htimer *t = H.h[0];
+    if (t->expires < last) {
+      fprintf(stderr, "heap: out of order\n");
+      exit(1);
+    }
+    last = t->expires;
+    heap_cancel(&H, t);
+  }
+  double expire = now_seconds() - start;
+
+  printf("heap\t%d\t%.1f\t%.1f\t%.1f\t%.1f\n", n, insert * 1e9 / n,
+         rearm * 1e9 / FLAGS_rearms, cancel * 1e9 / n, expire * 1e9 / n);
+  free(timers);
+  free(H.h);
+}
+
+static double *lateness;  // microseconds, one per wakeup
+static long nlate;
+static long early;
+static int sleeping;
+static struct timer *dummies;
+static int ndummies;
+
+static void sleeper(struct schedule *S, void *ud) {
+  (void)ud;
+  int r;
+  for (r = 0; r < FLAGS_rounds; r++) {
+    int ms = 1 + (int)(next_rand() % FLAGS_max_sleep_ms);
+    double start = now_seconds();
+    co_sleep(S, ms);
+    double late = (now_seconds() - start) * 1e6 - ms * 1000.0;
+    if (late < 0) early++;
+    lateness[nlate++] = late;
+  }
+  // reactor_run returns once no timer is pending.
+  if (--sleeping == 0) {
+    int i;
+    for (i = 0; i < ndummies; i++) timer_cancel(&S->timers, &dummies[i]);
+  }
+}
+
+static int compare_double(const void *a, const void *b) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static void bench_jitter(int n) {
+  struct schedule *S = coroutine_open();
+  struct reactor *R = reactor_open(S);
+  dummies = malloc(sizeof(struct timer) * n);
+  ndummies = n;
+  int i;
+  for (i = 0; i < n; i++) {
+    timer_init(&dummies[i], count_fired);
+    timer_add(&S->timers, &dummies[i],
+              S->timers.now + 3600 * 1000 + next_rand() % FLAGS_horizon_ms);
+  }
+  lateness = malloc(sizeof(double) * FLAGS_sleepers * FLAGS_rounds);
+  nlate = 0;
+  early = 0;
+  sleeping = FLAGS_sleepers;
+  for (i = 0; i < FLAGS_sleepers; i++) {
+    coroutine_spawn(S, sleeper, NULL);
+  }
+
+  double cpu = cpu_seconds();
+  double start = now_seconds();
+  reactor_run(R);
+  double elapsed = now_seconds() - start;
+  cpu = cpu_seconds() - cpu;
+
+  qsort(lateness, nlate, sizeof(double), compare_double);
+  printf("%d\t%d\t%ld\t%.0f\t%.0f\t%.0f\t%ld\t%.1f\n", n, FLAGS_sleepers,
+         nlate, lateness[nlate / 2], lateness[nlate * 99 / 100],
+         lateness[nlate - 1], early, 100 * cpu / elapsed);
+
+  free(lateness);
+  free(dummies);
+  reactor_close(R);
+  coroutine_close(S);
+}
+
+int main(int argc, char **argv) {
+  int i;
+  for (i = 1; i < argc; i++) {
+    unsigned long long n;
+    char junk;
+    if (sscanf(argv[i], "--timers=%llu%c", &n, &junk) == 1) {
+      FLAGS_timers = (int)n;
+    } else if (sscanf(argv[i], "--horizon_ms=%llu%c", &n, &junk) == 1) {
+      FLAGS_horizon_ms = (int)n;
+    } else if (sscanf(argv[i], "--rearms=%llu%c", &n, &junk) == 1) {
+      FLAGS_rearms = (int)n;
+    } else if (sscanf(argv[i], "--sleepers=%llu%c", &n, &junk) == 1) {
+      FLAGS_sleepers = (int)n;
+    } else if (sscanf(argv[i], "--rounds=%llu%c", &n, &junk) == 1) {
+      FLAGS_rounds = (int)n;
+    } else if (sscanf(argv[i], "--max_sleep_ms=%llu%c", &n, &junk) == 1) {
+      FLAGS_max_sleep_ms = (int)n;
+    } else {
+      fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+  if (FLAGS_timers <= 0 || FLAGS_horizon_ms <= 0 || FLAGS_sleepers <= 0 ||
+      FLAGS_rounds <= 0 || FLAGS_max_sleep_ms <= 0) {
+    fprintf(stderr, "all flags must be > 0\n");
+    return 1;
+  }
+
+  int *order = malloc(sizeof(int) * FLAGS_timers);
+  shuffle(order, FLAGS_timers);
+  printf("impl\tpending\tinsert_ns\trearm_ns\tcancel_ns\texpire_ns\n");
+  bench_wheel(FLAGS_timers, order);
+  bench_heap(FLAGS_timers, order);
+  free(order);
+
+  printf(
+      "\npending\tsleepers\twakeups\tlate_p50_us\tlate_p99_us\tlate_max_us\t"
+      "early\tcpu_pct\n");
+  bench_jitter(FLAGS_timers);
+  return 0;
+}
@@ -0,0 +1,150 @@
+#include "timer_wheel.h"
+
+#define MASK (TIMER_WHEEL_SLOTS - 1)
+#define MAX_DELTA ((1ull << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1)
+
+static void _list_init(struct timer *head) {
+  head->next = head;
+  head->prev = head;
+}
+
+static void _list_append(struct timer *head, struct timer *t) {
+  t->prev = head->prev;
+  t->next = head;
+  head->prev->next = t;
+  head->prev = t;
+}
+
+static void _list_unlink(struct timer *t) {
+  t->prev->next = t->next;
+  t->next->prev = t->prev;
+  t->next = NULL;
+  t->prev = NULL;
+}
+
+// Move the list at "head" to "out", leaving "head" empty.
+static void _list_splice(struct timer *head, struct timer *out) {
+  if (head->next == head) {
+    _list_init(out);
+    return;
+  }
+  out->next = head->next;
+  out->prev = head->prev;
+  out->next->prev = out;
+  out->prev->next = out;
+  _list_init(head);
+}
+
+void timer_wheel_init(struct timer_wheel *W, uint64_t now) {
+  W->now = now;
+  W->count = 0;
+  int l, i;
+  for (l = 0; l < TIMER_WHEEL_LEVELS; l++) {
+    for (i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+      _list_init(&W->slots[l][i]);
+    }
+  }
+}
+
+void timer_init(struct timer *t, void (*fn)(struct timer *)) {
+  t->next = NULL;
+  t->prev = NULL;
+  t->expires = 0;
+  t->fn = fn;
+}
+
+// Put t in the slot for its expiry, relative to W->now.
+static void _place(struct timer_wheel *W, struct timer *t) {
+  uint64_t e = t->expires;
+  if (e < W->now) {
+    e = W->now;
+  } else if (e - W->now > MAX_DELTA) {
+    e = W->now + MAX_DELTA;  // placed again once it comes down
+  }
+  uint64_t delta = e - W->now;
+  int level = 0;
+  while (level < TIMER_WHEEL_LEVELS - 1 &&
+         delta >= (1ull << (TIMER_WHEEL_BITS * (level + 1)))) {
+    level++;
+  }
+  int slot = (int)((e >> (TIMER_WHEEL_BITS * level)) & MASK);
+  _list_append(&W->slots[level][slot], t);
+}
+
+void timer_add(struct timer_wheel *W, struct timer *t, uint64_t expires) {
+  t->expires = expires;
+  _place(W, t);
+  W->count++;
+}
+
+void timer_cancel(struct timer_wheel *W, struct timer *t) {
+  if (t->next == NULL) {
+    return;
+  }
+  _list_unlink(t);
+  W->count--;
+}
+
+// Move the timers of slot "slot" of level "level" down.
+static void _cascade(struct timer_wheel *W, int level, int slot) {
+  struct timer list;
+  _list_splice(&W->slots[level][slot], &list);
+  while (list.next != &list) {
+    struct timer *t = list.next;
+    _list_unlink(t);
+    _place(W, t);
+  }
+}
+
+int timer_wheel_advance(struct timer_wheel *W, uint64_t to) {
+  int fired = 0;
+  while (W->now <= to) {
+    if (W->count == 0) {
+      W->now = to + 1;
+      break;
+    }
+    uint64_t tick = W->now;
+    int slot = (int)(tick & MASK);
+    if (slot == 0) {
+      int l;
+      for (l = 1; l < TIMER_WHEEL_LEVELS; l++) {
+        int s = (int)((tick >> (TIMER_WHEEL_BITS * l)) & MASK);
+        _cascade(W, l, s);
+        if (s != 0) {
+          break;
+        }
+      }
+    }
+    struct timer due;
+    _list_splice(&W->slots[0][slot], &due);
+    // Timers the callbacks add from here on go to the next tick at the
+    // earliest.
+    W->now = tick + 1;
+    while (due.next != &due) {
+      struct timer *t = due.next;
+      _list_unlink(t);
+      W->count--;
+      t->fn(t);
+      fired++;
+    }
+  }
+  return fired;
+}
+
+uint64_t timer_wheel_next(const struct timer_wheel *W) {
+  if (W->count == 0) {
+    return UINT64_MAX;
+  }
+  // Higher levels only hold timers that expire once they have been moved
+  // down, which happens no earlier than the next multiple of 64 ticks: now
+  // itself if it is one, as it has not been processed yet.
+  uint64_t boundary = (W->now + MASK) & ~(uint64_t)MASK;
+  uint64_t tick;
+  for (tick = W->now; tick < boundary; tick++) {
+    const struct timer *head = &W->slots[0][tick & MASK];
+    if (head->next != head) {
+      return tick;
+    }
+  }
+  return boundary;
+}
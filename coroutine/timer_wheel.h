@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 5
+
+// A timer, embedded in whatever it times out. "fn" is called with the
+// timer once it expires; it may add or cancel any timer, this one too.
+struct timer {
+  struct timer *next;  // NULL while not pending
+  struct timer *prev;
+  uint64_t expires;  // tick
+  void (*fn)(struct timer *);
+};
+
+/**
+ * @brief hierarchical timing wheel (Varghese and Lauck, 1987).
+ *
+ * @details Level l has TIMER_WHEEL_SLOTS slots of 64^l ticks each, so the
+ * five levels cover 2^30 ticks ahead; a timer further out than that waits
+ * in the last level and is placed again when it gets there. A timer goes
+ * to the lowest level whose range covers it, into the slot of its expiry
+ * tick, on a doubly linked list: adding and cancelling are O(1) whatever
+ * the number of pending timers.
+ *
+ * Advancing processes one tick at a time. A tick fires the whole level-0
+ * slot it maps to, as a batch; every 64^l ticks it first moves the timers
+ * of the next level-l slot down to the levels below, where they now fit.
+ * Each timer is thus moved at most once per level.
+ */
+struct timer_wheel {
+  uint64_t now;  // next tick to process
+  long count;    // pending timers
+  struct timer slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];  // list heads
+};
+
+void timer_wheel_init(struct timer_wheel *W, uint64_t now);
+
+void timer_init(struct timer *t, void (*fn)(struct timer *));
+
+static inline int timer_pending(const struct timer *t) {
+  return t->next != NULL;
+}
+
+/**
+ * @brief arm t to fire at tick "expires", or on the next tick if that is
+ * already past. REQUIRES: t is not pending.
+ */
+void timer_add(struct timer_wheel *W, struct timer *t, uint64_t expires);
+
+/**
+ * @brief disarm t; does nothing if it is not pending
+ */
+void timer_cancel(struct timer_wheel *W, struct timer *t);
+
+/**
+ * @brief fire every timer that expires at or before tick "to"
+ *
+ * @return number of timers fired
+ */
+int timer_wheel_advance(struct timer_wheel *W, uint64_t to);
+
+/**
+ * @brief a tick at or before the next expiry, for a poll timeout:
+ * the next non-empty level-0 slot, or the next time a higher level is
+ * moved down, whichever comes first. UINT64_MAX if nothing is pending.
+ */
+uint64_t timer_wheel_next(const struct timer_wheel *W);
+
+#ifdef __cplusplus
+}
+#endif
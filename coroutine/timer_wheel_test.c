@@ -0,0 +1,378 @@
+// Tests of the timer wheel against a model, driven by a fake clock: every
+// timer fires exactly on its tick, never early and never twice, and a
+// cancelled one never fires. Random expiries reach every level; fixed ones
+// sit right at the 64^l boundaries where levels cascade, and beyond the
+// 2^30 ticks the wheel covers. Callbacks add and cancel timers while the
+// wheel advances. The last cases run co_sleep and coroutine_park_timeout
+// of coroutine.h on the real clock.
+//
+// Usage: timer_wheel_test [--seed=N]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "coroutine.h"
+#include "timer_wheel.h"
+
+#define CHECK(cond)                                                  \
+  do {                                                               \
+    if (!(cond)) {                                                   \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+              #cond);                                                \
+      exit(1);                                                       \
+    }                                                                \
+  } while (0)
+
+#define TICKS_PER_LEVEL(l) (1ull << (TIMER_WHEEL_BITS * (l)))
+#define MAX_DELTA (TICKS_PER_LEVEL(TIMER_WHEEL_LEVELS) - 1)
+
+static unsigned FLAGS_seed = 301;
+
+// A timer and what the model expects of it. The timer comes first, so
+// that the callback can cast back.
+struct model_timer {
+  struct timer t;
+  int pending;   // added and neither fired nor cancelled
+  uint64_t due;  // tick it must fire at, while pending
+  int fired;     // times it fired
+};
+
+enum { kTimers = 4000 };
+static struct timer_wheel W;
+static struct model_timer timers[kTimers];
+static long npending;
+static uint64_t rng;
+// While set, callbacks add and cancel other timers.
+static int chain;
+static long chained_adds, chained_cancels;
+
+static uint64_t next_random(void) {
+  // xorshift64*
+  rng ^= rng >> 12;
+  rng ^= rng << 25;
+  rng ^= rng >> 27;
+  return rng * 0x2545f4914f6cdd1dull;
+}
+
+static void add(struct model_timer *m, uint64_t expires) {
+  CHECK(!m->pending && !timer_pending(&m->t));
+  timer_add(&W, &m->t, expires);
+  m->pending = 1;
+  // In the past, it fires on the next tick to process.
+  m->due = expires < W.now ? W.now : expires;
+  npending++;
+}
+
+static void cancel(struct model_timer *m) {
+  timer_cancel(&W, &m->t);
+  CHECK(!timer_pending(&m->t));
+  if (m->pending) {
+    m->pending = 0;
+    npending--;
+  }
+}
+
+static void fired(struct timer *t) {
+  struct model_timer *m = (struct model_timer *)t;
+  // W.now is already the tick after the one firing.
+  uint64_t tick = W.now - 1;
+  CHECK(m->pending);
+  CHECK(tick == m->due);
+  CHECK(!timer_pending(t));
+  m->pending = 0;
+  m->fired++;
+  npending--;
+  if (!chain) {
+    return;
+  }
+  struct model_timer *other = &timers[next_random() % kTimers];
+  switch (next_random() % 4) {
+    case 0:
+      // Possibly this very tick, which is over: it fires on the next.
+      if (!other->pending) {
+        add(other, tick + next_random() % 3);
+        chained_adds++;
+      }
+      break;
+    case 1:
+      if (!other->pending) {
+        add(other, tick + next_random() % TICKS_PER_LEVEL(2));
+        chained_adds++;
+      }
+      break;
+    case 2:
+      // Possibly one due on this tick too, still to be called.
+      if (other->pending) {
+        cancel(other);
+        chained_cancels++;
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+static void begin(uint64_t now) {
+  timer_wheel_init(&W, now);
+  memset(timers, 0, sizeof(timers));
+  int i;
+  for (i = 0; i < kTimers; i++) {
+    timer_init(&timers[i].t, fired);
+  }
+  npending = 0;
+  chain = 0;
+  chained_adds = 0;
+  chained_cancels = 0;
+}
+
+// Advance to tick "to", then check the wheel against the model: whatever
+// was due by then fired, the rest is still pending, and timer_wheel_next
+// is no later than the earliest of it.
+static void advance(uint64_t to) {
+  timer_wheel_advance(&W, to);
+  CHECK(W.now == to + 1);
+  CHECK(W.count == npending);
+  uint64_t earliest = UINT64_MAX;
+  int i;
+  for (i = 0; i < kTimers; i++) {
+    const struct model_timer *m = &timers[i];
+    CHECK(m->pending == timer_pending(&m->t));
+    if (m->pending) {
+      CHECK(m->due > to);
+      if (m->due < earliest) earliest = m->due;
+    }
+  }
+  uint64_t next = timer_wheel_next(&W);
+  if (npending == 0) {
+    CHECK(next == UINT64_MAX);
+  } else {
+    CHECK(next >= W.now && next <= earliest);
+  }
+}
+
+// Random expiries at every level and random steps of the clock, with
+// timers cancelled along the way, some of them after a cascade moved them.
+static void test_random(void) {
+  // Just before a tick where all the levels cascade at once.
+  begin(3 * TICKS_PER_LEVEL(TIMER_WHEEL_LEVELS) - 5000);
+  chain = 1;
+  long adds = 0, cancels = 0, fires_before;
+  int round;
+  for (round = 0; round < 3000; round++) {
+    int n = next_random() % 20;
+    int i;
+    for (i = 0; i < n; i++) {
+      struct model_timer *m = &timers[next_random() % kTimers];
+      if (m->pending) {
+        continue;
+      }
+      // Up to level 3, and sometimes in the past.
+      int level = 1 + next_random() % 4;
+      uint64_t delta = next_random() % TICKS_PER_LEVEL(level);
+      if (next_random() % 16 == 0 && W.now > delta) {
+        add(m, W.now - delta);
+      } else {
+        add(m, W.now + delta);
+      }
+      adds++;
+    }
+    for (i = 0; i < 3; i++) {
+      struct model_timer *m = &timers[next_random() % kTimers];
+      if (m->pending) {
+        cancel(m);
+        cancels++;
+      }
+    }
+    static const uint64_t steps[] = {1, 63, 64, 4096, 300000};
+    uint64_t step = next_random() % steps[next_random() % 5];
+    advance(W.now + step);
+  }
+  // Fire the rest.
+  chain = 0;
+  fires_before = npending;
+  while (npending > 0) {
+    advance(W.now + TICKS_PER_LEVEL(3));
+  }
+  // Every timer added was cancelled or fired, once.
+  int i;
+  long fires = 0;
+  for (i = 0; i < kTimers; i++) {
+    fires += timers[i].fired;
+  }
+  CHECK(fires + cancels + chained_cancels == adds + chained_adds);
+  CHECK(fires_before > 0);
+  CHECK(adds > 10000 && cancels > 500 && fires > 10000);
+  CHECK(chained_adds > 100 && chained_cancels > 100);
+}
+
+// Timers around the boundaries of every level, fired one tick at a time:
+// each must come out on its tick, whether it was placed directly in level
+// 0 or cascaded there through any number of levels.
+static void test_boundaries(void) {
+  int l;
+  for (l = 1; l < TIMER_WHEEL_LEVELS; l++) {
+    uint64_t boundary = 7 * TICKS_PER_LEVEL(TIMER_WHEEL_LEVELS);
+    begin(boundary - TICKS_PER_LEVEL(l) - 2);
+    int i = 0;
+    int64_t d;
+    for (d = -3; d <= 3; d++) {
+      add(&timers[i++], boundary + d);
+      add(&timers[i++], boundary + TICKS_PER_LEVEL(l) + d);
+      add(&timers[i++], boundary - TICKS_PER_LEVEL(l) + d);
+    }
+    // One to cancel once it has been cascaded down, right before it is due.
+    struct model_timer *victim = &timers[i++];
+    add(victim, boundary + 10);
+    // Step to just before the boundary, then one tick at a time.
+    uint64_t to = W.now;
+    while (to < boundary + TICKS_PER_LEVEL(l) + 5) {
+      if (to + 8 < boundary || (to > boundary + 16 &&
+                                to + 8 < boundary + TICKS_PER_LEVEL(l))) {
+        to += (to + 8 < boundary ? boundary - 8 - to
+                                 : boundary + TICKS_PER_LEVEL(l) - 8 - to);
+      } else {
+        to++;
+      }
+      advance(to);
+      if (to == boundary + 5) {
+        cancel(victim);
+      }
+    }
+    CHECK(npending == 0);
+    CHECK(victim->fired == 0);
+    int j;
+    for (j = 0; j < i - 1; j++) {
+      CHECK(timers[j].fired == 1);
+    }
+  }
+}
+
+// Beyond MAX_DELTA a timer waits in the last level and is placed again
+// once it comes down; it still fires exactly on its tick. Getting there
+// takes 2^30 ticks, so all of it happens in a single pass.
+static void test_beyond_range(void) {
+  uint64_t start = 5 * TICKS_PER_LEVEL(TIMER_WHEEL_LEVELS) + 12345;
+  begin(start);
+  add(&timers[0], start + MAX_DELTA);
+  add(&timers[1], start + MAX_DELTA + 1);
+  add(&timers[2], start + MAX_DELTA + 777);
+  // Further out than the last level reaches even once it has turned.
+  add(&timers[3], start + MAX_DELTA + 2 * TICKS_PER_LEVEL(4) + 5);
+  add(&timers[4], start + MAX_DELTA + 2 * TICKS_PER_LEVEL(4) + 5);
+  const uint64_t step = TICKS_PER_LEVEL(TIMER_WHEEL_LEVELS - 1) / 3;
+  uint64_t to = start;
+  while (to + step < start + MAX_DELTA) {
+    to += step;
+    advance(to);
+  }
+  CHECK(npending == 5);
+  advance(start + MAX_DELTA + 777);
+  CHECK(timers[0].fired == 1 && timers[1].fired == 1 && timers[2].fired == 1);
+  CHECK(npending == 2);
+  // Cancelled after it has been placed again, short of its expiry.
+  cancel(&timers[4]);
+  to = W.now;
+  while (npending > 0) {
+    to += TICKS_PER_LEVEL(3);
+    advance(to);
+  }
+  CHECK(timers[3].fired == 1 && timers[4].fired == 0);
+}
+
+// --- co_sleep and coroutine_park_timeout, on the real clock of S.
+
+static struct schedule *S;
+static int stack_mode;
+static int sleeper_id;
+static int results[4];
+
+static double now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+static void spawn(coroutine_func func) {
+  int id = coroutine_new_mode(S, func, NULL, stack_mode);
+  CHECK(id >= 0);
+  coroutine_wake(S, id);
+}
+
+// Drive the run queue and the timers until no coroutine is left.
+static void run(void) {
+  while (S->nco > 0) {
+    coroutine_run_ready(S);
+    coroutine_run_timers(S);
+    if (S->nco > 0 && S->nrunq == 0) {
+      int ms = coroutine_next_timer(S);
+      CHECK(ms >= 0);  // somebody waits for a timer
+      struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+      nanosleep(&ts, NULL);
+    }
+  }
+  CHECK(S->timers.count == 0);
+}
+
+static void sleeper(struct schedule *S, void *ud) {
+  (void)ud;
+  double start = now_ms();
+  co_sleep(S, 30);
+  results[0] = now_ms() - start >= 30;
+  // Timed out, then woken before the timeout.
+  start = now_ms();
+  results[1] = coroutine_park_timeout(S, 20);
+  results[2] = now_ms() - start >= 20;
+  sleeper_id = coroutine_running(S);
+  results[3] = coroutine_park_timeout(S, 10000);
+}
+
+// Wakes the sleeper early: co_sleep must go back to sleep, and the long
+// park must return at once, its timer cancelled.
+static void waker(struct schedule *S, void *ud) {
+  (void)ud;
+  co_sleep(S, 5);
+  CHECK(sleeper_id == -1);
+  coroutine_wake(S, 0);  // the sleeper, spawned first
+  while (sleeper_id == -1) {
+    co_sleep(S, 1);
+  }
+  coroutine_wake(S, sleeper_id);
+}
+
+static void test_sleep_and_park_timeout(void) {
+  S = coroutine_open();
+  CHECK(S != NULL);
+  sleeper_id = -1;
+  memset(results, 0, sizeof(results));
+  double start = now_ms();
+  spawn(sleeper);
+  spawn(waker);
+  run();
+  CHECK(results[0] == 1);
+  CHECK(results[1] == -1 && results[2] == 1);
+  CHECK(results[3] == 0);
+  CHECK(now_ms() - start < 5000);
+  coroutine_close(S);
+}
+
+int main(int argc, char **argv) {
+  int i;
+  for (i = 1; i < argc; i++) {
+    if (sscanf(argv[i], "--seed=%u", &FLAGS_seed) != 1) {
+      fprintf(stderr, "usage: %s [--seed=N]\n", argv[0]);
+      return 2;
+    }
+  }
+  rng = FLAGS_seed * 0x9e3779b97f4a7c15ull + 1;
+  test_random();
+  test_boundaries();
+  test_beyond_range();
+  int modes[] = {COROUTINE_STACK_SHARED, COROUTINE_STACK_PRIVATE};
+  for (i = 0; i < 2; i++) {
+    stack_mode = modes[i];
+    test_sleep_and_park_timeout();
+  }
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,115 @@
+#include "ws_deque.h"
+
+#include <stdlib.h>
+
+static struct ws_ring *_ring_new(long cap) {
+  struct ws_ring *r = malloc(sizeof(*r) + sizeof(_Atomic(void *)) * cap);
+  if (r == NULL) {
+    return NULL;
+  }
+  r->cap = cap;
+  r->prev = NULL;
+  return r;
+}
+
+static inline _Atomic(void *) *_slot(struct ws_ring *r, long i) {
+  return &r->items[i & (r->cap - 1)];
+}
+
+int ws_deque_init(struct ws_deque *q, long cap) {
+  long c = 16;
+  while (c < cap) {
+    c *= 2;
+  }
+  struct ws_ring *r = _ring_new(c);
+  atomic_init(&q->top, 0);
+  atomic_init(&q->bottom, 0);
+  atomic_init(&q->ring, r);
+  return r != NULL ? 0 : -1;
+}
+
+void ws_deque_destroy(struct ws_deque *q) {
+  struct ws_ring *r = atomic_load_explicit(&q->ring, memory_order_relaxed);
+  while (r != NULL) {
+    struct ws_ring *prev = r->prev;
+    free(r);
+    r = prev;
+  }
+  atomic_store_explicit(&q->ring, NULL, memory_order_relaxed);
+}
+
+int ws_deque_push(struct ws_deque *q, void *item) {
+  long b = atomic_load_explicit(&q->bottom, memory_order_relaxed);
+  long t = atomic_load_explicit(&q->top, memory_order_acquire);
+  struct ws_ring *r = atomic_load_explicit(&q->ring, memory_order_relaxed);
+  if (b - t > r->cap - 1) {
+    struct ws_ring *bigger = _ring_new(r->cap * 2);
+    if (bigger == NULL) {
+      return -1;
+    }
+    long i;
+    for (i = t; i < b; i++) {
+      atomic_store_explicit(
+          _slot(bigger, i),
+          atomic_load_explicit(_slot(r, i), memory_order_relaxed),
+          memory_order_relaxed);
+    }
+    bigger->prev = r;
+    atomic_store_explicit(&q->ring, bigger, memory_order_release);
+    r = bigger;
+  }
+  atomic_store_explicit(_slot(r, b), item, memory_order_relaxed);
+  // Publishes the item, and whatever it points to, to a thief that reads
+  // the new bottom.
+  atomic_store_explicit(&q->bottom, b + 1, memory_order_release);
+  return 0;
+}
+
+void *ws_deque_take(struct ws_deque *q) {
+  long b = atomic_load_explicit(&q->bottom, memory_order_relaxed) - 1;
+  struct ws_ring *r = atomic_load_explicit(&q->ring, memory_order_relaxed);
+  atomic_store_explicit(&q->bottom, b, memory_order_relaxed);
+  // The store to bottom must be visible before top is read: a thief does
+  // the opposite, so that at most one of the two gets the last item.
+  atomic_thread_fence(memory_order_seq_cst);
+  long t = atomic_load_explicit(&q->top, memory_order_relaxed);
+  if (t > b) {
+    // Empty.
+    atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+    return NULL;
+  }
+  void *item = atomic_load_explicit(_slot(r, b), memory_order_relaxed);
+  if (t == b) {
+    // Last item: race the thieves for it.
+    if (!atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1,
+                                                 memory_order_seq_cst,
+                                                 memory_order_relaxed)) {
+      item = NULL;
+    }
+    atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+  }
+  return item;
+}
+
+void *ws_deque_steal(struct ws_deque *q) {
+  long t = atomic_load_explicit(&q->top, memory_order_acquire);
+  atomic_thread_fence(memory_order_seq_cst);
+  long b = atomic_load_explicit(&q->bottom, memory_order_acquire);
+  if (t >= b) {
+    return NULL;
+  }
+  struct ws_ring *r = atomic_load_explicit(&q->ring, memory_order_acquire);
+  void *item = atomic_load_explicit(_slot(r, t), memory_order_relaxed);
+  if (!atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1,
+                                               memory_order_seq_cst,
+                                               memory_order_relaxed)) {
+    return NULL;
+  }
+  return item;
+}
+
+long ws_deque_size(struct ws_deque *q) {
+  long b = atomic_load_explicit(&q->bottom, memory_order_relaxed);
+  long t = atomic_load_explicit(&q->top, memory_order_relaxed);
+  return b > t ? b - t : 0;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdatomic.h>
+
+// Chase-Lev work-stealing deque of non-NULL pointers (Chase and Lev, SPAA
+// 2005, with the C11 orderings of Le et al., PPoPP 2013).
+//
+// The owner thread pushes and takes at the bottom, LIFO, without any
+// read-modify-write unless the deque is down to its last item. Any other
+// thread may steal from the top, FIFO, with a single CAS. The ring grows
+// as needed; a replaced ring is kept until the deque is destroyed since a
+// thief may still be reading from it.
+struct ws_ring {
+  long cap;  // a power of two
+  struct ws_ring *prev;  // replaced rings, freed by ws_deque_destroy
+  _Atomic(void *) items[];
+};
+
+struct ws_deque {
+  _Atomic long top;
+  _Atomic long bottom;
+  _Atomic(struct ws_ring *) ring;
+};
+
+/**
+ * @brief set up an empty deque with room for at least cap items
+ *
+ * @return 0 on success, -1 if the ring could not be allocated
+ */
+int ws_deque_init(struct ws_deque *q, long cap);
+void ws_deque_destroy(struct ws_deque *q);
+
+/**
+ * @brief push an item at the bottom. Owner only.
+ *
+ * @return 0 on success, -1 if the ring could not grow
+ */
+int ws_deque_push(struct ws_deque *q, void *item);
+
+/**
+ * @brief take the item at the bottom. Owner only.
+ *
+ * @return the item, or NULL if the deque is empty
+ */
+void *ws_deque_take(struct ws_deque *q);
+
+/**
+ * @brief steal the item at the top. Any thread.
+ *
+ * @return the item, or NULL if the deque is empty or another thread won
+ * the race for the same item
+ */
+void *ws_deque_steal(struct ws_deque *q);
+
+/**
+ * @brief approximate number of items, exact for the owner
+ */
+long ws_deque_size(struct ws_deque *q);
@@ -0,0 +1,132 @@
+// Stress test of the work-stealing deque: the owner pushes and takes at
+// the bottom while --thieves threads steal from the top, and the ring
+// starts small enough to grow several times under the thieves' feet.
+// Every item must come out exactly once, either taken or stolen.
+//
+// Usage: ws_deque_test [--items=N] [--thieves=N]
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ws_deque.h"
+
+#define CHECK(cond)                                                  \
+  do {                                                               \
+    if (!(cond)) {                                                   \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+              #cond);                                                \
+      exit(1);                                                       \
+    }                                                                \
+  } while (0)
+
+static int FLAGS_items = 1000000;
+static int FLAGS_thieves = 4;
+
+static struct ws_deque q;
+static atomic_int done;
+// seen[i] counts how often item i + 1 came out of the deque.
+static atomic_int *seen;
+static atomic_long stolen;
+
+static void _seen(void *item) {
+  long i = (long)(intptr_t)item - 1;
+  CHECK(i >= 0 && i < FLAGS_items);
+  atomic_fetch_add_explicit(&seen[i], 1, memory_order_relaxed);
+}
+
+static void *thief(void *arg) {
+  (void)arg;
+  while (!atomic_load_explicit(&done, memory_order_acquire)) {
+    void *item = ws_deque_steal(&q);
+    if (item != NULL) {
+      _seen(item);
+      atomic_fetch_add_explicit(&stolen, 1, memory_order_relaxed);
+    }
+  }
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  int i;
+  for (i = 1; i < argc; i++) {
+    int n;
+    char junk;
+    if (sscanf(argv[i], "--items=%d%c", &n, &junk) == 1 && n > 0) {
+      FLAGS_items = n;
+    } else if (sscanf(argv[i], "--thieves=%d%c", &n, &junk) == 1 &&
+               n > 0) {
+      FLAGS_thieves = n;
+    } else {
+      fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+
+  seen = calloc(FLAGS_items, sizeof(atomic_int));
+  CHECK(seen != NULL);
+  CHECK(ws_deque_init(&q, 16) == 0);
+  pthread_t *thieves = malloc(sizeof(pthread_t) * FLAGS_thieves);
+  CHECK(thieves != NULL);
+  for (i = 0; i < FLAGS_thieves; i++) {
+    CHECK(pthread_create(&thieves[i], NULL, thief, NULL) == 0);
+  }
+
+  // Push in bursts that outgrow the ring, and take back part of each
+  // burst, so that pushes, takes and steals of the last item all race.
+  long taken = 0;
+  unsigned rng = 301;
+  long next = 1;
+  while (next <= FLAGS_items) {
+    rng = rng * 1103515245 + 12345;
+    long burst = 1 + (rng >> 16) % 4096;
+    for (; burst > 0 && next <= FLAGS_items; burst--, next++) {
+      CHECK(ws_deque_push(&q, (void *)(intptr_t)next) == 0);
+    }
+    rng = rng * 1103515245 + 12345;
+    long takes = (rng >> 16) % 4096;
+    for (; takes > 0; takes--) {
+      void *item = ws_deque_take(&q);
+      if (item == NULL) {
+        break;
+      }
+      _seen(item);
+      taken++;
+    }
+  }
+  void *item;
+  while ((item = ws_deque_take(&q)) != NULL) {
+    _seen(item);
+    taken++;
+  }
+  CHECK(ws_deque_size(&q) == 0);
+  atomic_store_explicit(&done, 1, memory_order_release);
+  for (i = 0; i < FLAGS_thieves; i++) {
+    pthread_join(thieves[i], NULL);
+  }
+
+  for (i = 0; i < FLAGS_items; i++) {
+    if (atomic_load(&seen[i]) != 1) {
+      fprintf(stderr, "item %d seen %d times\n", i + 1,
+              atomic_load(&seen[i]));
+      return 1;
+    }
+  }
+  CHECK(taken + atomic_load(&stolen) == FLAGS_items);
+  CHECK(atomic_load(&stolen) > 0);
+
+  int rings = 0;
+  struct ws_ring *r;
+  for (r = atomic_load(&q.ring); r != NULL; r = r->prev) {
+    rings++;
+  }
+  CHECK(rings > 1);
+
+  printf("%d items: %ld taken, %ld stolen, %d rings\n", FLAGS_items, taken,
+         atomic_load(&stolen), rings);
+  ws_deque_destroy(&q);
+  free(thieves);
+  free(seen);
+  return 0;
+}
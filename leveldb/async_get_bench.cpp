@@ -0,0 +1,248 @@
+// Cold point lookups per second against thread count: blocking Table::Get
+// against Table::MultiGet on an AsyncReader per thread.
+//
+// A table of --table_mb is built once. For every run it is dropped from the
+// page cache (posix_fadvise) and opened again with an empty block cache,
+// and --lookups random keys are split over the threads:
+//   blocking: each thread calls Table::Get for its keys one at a time, so a
+//             thread has one block read in flight at most;
+//   async:    each thread has its own IOBackend and AsyncReader and looks
+//             up its keys --batch at a time with Table::MultiGet, which
+//             keeps up to --concurrency lookups (coroutines) in flight.
+// Thread counts double from 1 up to --max_threads. The async line also
+// names the backend (io_uring, or the pread thread pool where io_uring is
+// not available) and reports the reads that parked a coroutine.
+//
+// Usage: async_get_bench [--dir=PATH] [--table_mb=N] [--value_size=N]
+//                        [--lookups=N] [--max_threads=N] [--concurrency=N]
+//                        [--batch=N]
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "async_reader.h"
+#include "block_cache.h"
+#include "env.h"
+#include "io_backend.h"
+#include "options.h"
+#include "table.h"
+#include "table_builder.h"
+#include "utils/random.h"
+
+namespace leveldb {
+namespace {
+
+std::string FLAGS_dir = "/tmp";
+uint64_t FLAGS_table_mb = 1024;
+uint64_t FLAGS_value_size = 100;
+uint64_t FLAGS_lookups = 200000;
+int FLAGS_max_threads = 16;
+int FLAGS_concurrency = 256;
+uint64_t FLAGS_batch = 4096;
+
+double NowSeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void DropFromPageCache(const std::string& fname) {
+  int fd = ::open(fname.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+  }
+}
+
+std::string MakeKey(uint64_t i) {
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%016llu",
+                static_cast<unsigned long long>(i));
+  return buf;
+}
+
+void Check(const Status& s) {
+  if (!s.ok()) {
+    std::fprintf(stderr, "%s\n", s.ToString().c_str());
+    std::exit(1);
+  }
+}
+
+uint64_t Build(const Options& options, const std::string& fname) {
+  WritableFile* file;
+  Check(options.env->NewWritableFile(fname, &file));
+  TableBuilder builder(options, file);
+  Random rnd(301);
+  std::string value(FLAGS_value_size, 'x');
+  const uint64_t target = FLAGS_table_mb << 20;
+  uint64_t n = 0;
+  while (builder.FileSize() < target) {
+    for (size_t i = 0; i < value.size(); i += 4) {
+      value[i] = 'a' + rnd.Uniform(26);
+    }
+    builder.Add(MakeKey(n++), value);
+  }
+  Status s = builder.Finish();
+  if (s.ok()) s = file->Sync();
+  if (s.ok()) s = file->Close();
+  delete file;
+  Check(s);
+  return n;
+}
+
+// The keys of thread "t".
+std::vector<std::string> ThreadKeys(int t, uint64_t count, uint64_t num_keys) {
+  Random rnd(17 + t);
+  std::vector<std::string> keys(count);
+  for (uint64_t i = 0; i < count; i++) {
+    keys[i] = MakeKey(rnd.Next() % num_keys);
+  }
+  return keys;
+}
+
+void CheckFound(const Status& s, const std::string& key) {
+  if (!s.ok()) {
+    std::fprintf(stderr, "lookup of %s: %s\n", key.c_str(),
+                 s.ToString().c_str());
+    std::exit(1);
+  }
+}
+
+void Blocking(const Table* table, const std::vector<std::string>& keys) {
+  ReadOptions ro;
+  std::string value;
+  for (const std::string& key : keys) {
+    CheckFound(table->Get(ro, key, &value), key);
+  }
+}
+
+void Async(const Table* table, const std::vector<std::string>& keys,
+           std::atomic<uint64_t>* reads, std::string* backend_name) {
+  std::unique_ptr<IOBackend> backend(NewDefaultIOBackend(FLAGS_concurrency));
+  if (backend_name != nullptr) {
+    *backend_name = backend->Name();
+  }
+  AsyncReader reader(backend.get(), FLAGS_concurrency);
+  ReadOptions ro;
+  ro.async_reader = &reader;
+  std::vector<Slice> batch_keys(FLAGS_batch);
+  std::vector<std::string> values(FLAGS_batch);
+  std::vector<Status> statuses(FLAGS_batch);
+  for (size_t begin = 0; begin < keys.size(); begin += FLAGS_batch) {
+    const size_t n = std::min<size_t>(FLAGS_batch, keys.size() - begin);
+    for (size_t i = 0; i < n; i++) {
+      batch_keys[i] = keys[begin + i];
+    }
+    table->MultiGet(ro, n, batch_keys.data(), values.data(),
+                    statuses.data());
+    for (size_t i = 0; i < n; i++) {
+      CheckFound(statuses[i], keys[begin + i]);
+    }
+  }
+  reads->fetch_add(reader.reads());
+}
+
+void Run(const char* mode, const std::string& fname, uint64_t file_size,
+         uint64_t num_keys, int threads) {
+  std::vector<std::vector<std::string>> keys(threads);
+  for (int t = 0; t < threads; t++) {
+    keys[t] = ThreadKeys(t, FLAGS_lookups / threads, num_keys);
+  }
+
+  DropFromPageCache(fname);
+  BlockCache cache(FLAGS_table_mb << 20);
+  Options options;
+  options.block_cache = &cache;
+  RandomAccessFile* file;
+  Check(options.env->NewRandomAccessFile(fname, &file));
+  Table* table;
+  Check(Table::Open(options, file, 0, file_size, &table));
+
+  std::atomic<uint64_t> reads{0};
+  std::string backend_name;
+  std::vector<std::thread> workers;
+  const bool async = strcmp(mode, "async") == 0;
+  double start = NowSeconds();
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      if (async) {
+        Async(table, keys[t], &reads, t == 0 ? &backend_name : nullptr);
+      } else {
+        Blocking(table, keys[t]);
+      }
+    });
+  }
+  for (std::thread& w : workers) {
+    w.join();
+  }
+  double secs = NowSeconds() - start;
+
+  const uint64_t lookups = FLAGS_lookups / threads * threads;
+  std::printf("%s\t%s\t%d\t%.0f\t%.2f\t%llu\n", mode,
+              async ? backend_name.c_str() : "-", threads, lookups / secs,
+              secs / lookups * threads * 1e6,
+              static_cast<unsigned long long>(reads.load()));
+  delete table;
+  delete file;
+}
+
+}  // namespace
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  using namespace leveldb;
+  for (int i = 1; i < argc; i++) {
+    unsigned long long n;
+    char junk;
+    if (strncmp(argv[i], "--dir=", 6) == 0) {
+      FLAGS_dir = argv[i] + 6;
+    } else if (sscanf(argv[i], "--table_mb=%llu%c", &n, &junk) == 1) {
+      FLAGS_table_mb = n;
+    } else if (sscanf(argv[i], "--value_size=%llu%c", &n, &junk) == 1) {
+      FLAGS_value_size = n;
+    } else if (sscanf(argv[i], "--lookups=%llu%c", &n, &junk) == 1) {
+      FLAGS_lookups = n;
+    } else if (sscanf(argv[i], "--max_threads=%llu%c", &n, &junk) == 1) {
+      FLAGS_max_threads = static_cast<int>(n);
+    } else if (sscanf(argv[i], "--concurrency=%llu%c", &n, &junk) == 1) {
+      FLAGS_concurrency = static_cast<int>(n);
+    } else if (sscanf(argv[i], "--batch=%llu%c", &n, &junk) == 1) {
+      FLAGS_batch = n;
+    } else {
+      std::fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+  if (FLAGS_max_threads <= 0 || FLAGS_concurrency <= 0 || FLAGS_batch == 0 ||
+      FLAGS_lookups < static_cast<uint64_t>(FLAGS_max_threads)) {
+    std::fprintf(stderr,
+                 "need --lookups >= --max_threads and the other flags > 0\n");
+    return 1;
+  }
+
+  Options options;
+  const std::string fname = FLAGS_dir + "/async_get_bench.ldb";
+  const uint64_t num_keys = Build(options, fname);
+  uint64_t file_size;
+  Check(options.env->GetFileSize(fname, &file_size));
+
+  std::printf(
+      "mode\tbackend\tthreads\tlookups_per_sec\tus_per_lookup_per_thread\t"
+      "parked_reads\n");
+  for (int threads = 1; threads <= FLAGS_max_threads; threads *= 2) {
+    Run("blocking", fname, file_size, num_keys, threads);
+    Run("async", fname, file_size, num_keys, threads);
+  }
+  options.env->RemoveFile(fname);
+  return 0;
+}
@@ -0,0 +1,136 @@
+#include "async_reader.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include "coroutine/coroutine.h"
+#include "env.h"
+
+namespace leveldb {
+
+// A read in flight. The backend writes to it while the coroutine that
+// submitted it is parked, so it lives on the heap.
+struct AsyncReader::InFlight {
+  InFlight(int fd) : batch(fd, &req, 1) {}
+
+  ReadRequest req;
+  ReadBatch batch;
+  int coroutine = -1;
+};
+
+// Sends the reads of ReadBlock() through the reader.
+class AsyncReader::ParkingFile : public RandomAccessFile {
+ public:
+  ParkingFile(AsyncReader* reader, int fd) : reader_(reader), fd_(fd) {}
+
+  Status Read(uint64_t offset, size_t n, Slice* result,
+              char* scratch) const override {
+    return reader_->Read(fd_, offset, n, result, scratch);
+  }
+
+ private:
+  AsyncReader* const reader_;
+  const int fd_;
+};
+
+namespace {
+
+struct SpawnArgs {
+  void (*fn)(void*);
+  void* arg;
+};
+
+}  // namespace
+
+AsyncReader::AsyncReader(IOBackend* backend, int max_coroutines)
+    : backend_(backend),
+      max_coroutines_(max_coroutines < 1 ? 1 : max_coroutines),
+      schedule_(coroutine_open()) {
+  if (schedule_ == nullptr) {
+    std::fprintf(stderr, "AsyncReader: cannot create a schedule\n");
+    std::abort();
+  }
+}
+
+AsyncReader::~AsyncReader() {
+  assert(in_flight_.empty());
+  coroutine_close(schedule_);
+}
+
+void AsyncReader::Trampoline(struct schedule*, void* ud) {
+  SpawnArgs args = *reinterpret_cast<SpawnArgs*>(ud);
+  delete reinterpret_cast<SpawnArgs*>(ud);
+  (*args.fn)(args.arg);
+}
+
+void AsyncReader::Spawn(void (*fn)(void* arg), void* arg) {
+  if (coroutine_spawn(schedule_, &AsyncReader::Trampoline,
+                      new SpawnArgs{fn, arg}) < 0) {
+    std::fprintf(stderr, "AsyncReader: cannot create a coroutine\n");
+    std::abort();
+  }
+}
+
+bool AsyncReader::InCoroutine() const {
+  return coroutine_running(schedule_) >= 0;
+}
+
+void AsyncReader::Run() {
+  assert(!InCoroutine());
+  while (true) {
+    if (coroutine_run_ready(schedule_) > 0) continue;
+    if (in_flight_.empty()) break;
+    // Every coroutine waits for a read. Waiting for the oldest one also
+    // collects whatever else completed in the meantime.
+    backend_->Wait(&in_flight_.front()->batch);
+    WakeCompleted();
+  }
+  assert(schedule_->nco == 0);
+}
+
+void AsyncReader::WakeCompleted() {
+  size_t kept = 0;
+  for (InFlight* f : in_flight_) {
+    if (f->batch.pending.load(std::memory_order_acquire) == 0) {
+      coroutine_wake(schedule_, f->coroutine);
+    } else {
+      in_flight_[kept++] = f;
+    }
+  }
+  in_flight_.resize(kept);
+}
+
+Status AsyncReader::Read(int fd, uint64_t offset, size_t n, Slice* result,
+                         char* scratch) {
+  InFlight* f = new InFlight(fd);
+  f->req.offset = offset;
+  f->req.len = n;
+  f->req.scratch = scratch;
+  f->coroutine = coroutine_running(schedule_);
+  backend_->Submit(&f->batch);
+  in_flight_.push_back(f);
+  reads_++;
+  // Only WakeCompleted() wakes us, once the read is done.
+  coroutine_park(schedule_);
+  assert(f->batch.pending.load(std::memory_order_acquire) == 0);
+  *result = f->req.result;
+  Status s = f->req.status;
+  delete f;
+  return s;
+}
+
+Status AsyncReader::ReadBlock(RandomAccessFile* file,
+                              const ReadOptions& options,
+                              const BlockHandle& handle,
+                              BlockContents* result) {
+  assert(InCoroutine());
+  const int fd = file->FileDescriptor();
+  if (fd < 0) {
+    return leveldb::ReadBlock(file, options, handle, result);
+  }
+  ParkingFile parking(this, fd);
+  return leveldb::ReadBlock(&parking, options, handle, result);
+}
+
+}  // namespace leveldb
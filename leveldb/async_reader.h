@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "format.h"
+#include "io_backend.h"
+#include "options.h"
+
+struct schedule;
+
+namespace leveldb {
+
+/**
+ * @brief AsyncReader
+ *
+ * @details Runs lookups as coroutines (coroutine/coroutine.h) on the
+ * calling thread, so that one thread keeps the block reads of many lookups
+ * in flight at once. A lookup given this reader in ReadOptions::async_reader
+ * that misses the block cache submits the block read to the IOBackend and
+ * parks its coroutine; the reader runs the other coroutines meanwhile, and
+ * once all of them wait, blocks in the backend until a read completes and
+ * resumes the coroutines whose reads are done.
+ *
+ * Not thread-safe: a reader belongs to one thread. Use one per thread, and
+ * preferably one backend per reader as well: threads that share an io_uring
+ * backend take turns reaping its completions.
+ *
+ * The coroutines run on the schedule's shared stack, which is copied out
+ * while they are parked. Nothing a read in flight refers to may live on
+ * the coroutine's stack, and the requests are allocated accordingly.
+ */
+class AsyncReader {
+ public:
+  // "backend" must outlive the reader. Table::MultiGet keeps at most
+  // "max_coroutines" lookups in flight.
+  AsyncReader(IOBackend* backend, int max_coroutines);
+
+  AsyncReader(const AsyncReader&) = delete;
+  AsyncReader& operator=(const AsyncReader&) = delete;
+
+  // REQUIRES: Run() returned.
+  ~AsyncReader();
+
+  // Start "(*fn)(arg)" on a new coroutine at the next Run().
+  void Spawn(void (*fn)(void* arg), void* arg);
+
+  // Run the coroutines until every one of them returned.
+  // REQUIRES: !InCoroutine(), the coroutines only wait for reads.
+  void Run();
+
+  // True when called from one of the reader's coroutines.
+  bool InCoroutine() const;
+
+  // ReadBlock() from format.h, parking the calling coroutine while the read
+  // is in flight. Files without a FileDescriptor() are read blocking.
+  // REQUIRES: InCoroutine()
+  Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
+                   const BlockHandle& handle, BlockContents* result);
+
+  int max_coroutines() const { return max_coroutines_; }
+
+  // Reads that parked a coroutine.
+  uint64_t reads() const { return reads_; }
+
+ private:
+  class ParkingFile;
+  struct InFlight;
+
+  static void Trampoline(struct schedule* S, void* ud);
+
+  // REQUIRES: "scratch" is not on the coroutine's stack.
+  Status Read(int fd, uint64_t offset, size_t n, Slice* result,
+              char* scratch);
+
+  // Wake the coroutines whose reads are done.
+  void WakeCompleted();
+
+  IOBackend* const backend_;
+  const int max_coroutines_;
+  struct schedule* const schedule_;
+  std::vector<InFlight*> in_flight_;  // oldest first
+  uint64_t reads_ = 0;
+};
+
+}  // namespace leveldb
@@ -0,0 +1,407 @@
+// Write amplification and throughput of large values, inline versus
+// separated into blob files.
+//
+// For each value size (4 KB to 64 KB) and mode, --data_mb of random
+// overwrites over a key space half the number of writes are pushed through
+// a MemTable, flushed to level 0 and compacted into a single sorted level 1
+// once level 0 has options.level0_file_num_compaction_trigger files. In blob mode the
+// flush separates the values, compaction feeds the references it drops into
+// BlobDiscardStats, and blob files over the garbage ratio are collected
+// with the live records written back through the memtable. Write
+// amplification counts every table and blob byte written, including
+// garbage collection output, over the user bytes.
+//
+// Usage: blob_bench [--dir=PATH] [--data_mb=N] [--write_buffer_mb=N]
+//                   [--file_mb=N] [--gc_ratio_pct=N]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "blob_file.h"
+#include "blob_gc.h"
+#include "builder.h"
+#include "dbformat.h"
+#include "env.h"
+#include "filename.h"
+#include "iterator.h"
+#include "memtable.h"
+#include "options.h"
+#include "table.h"
+#include "table_builder.h"
+#include "version_edit.h"
+#include "version_set.h"
+#include "utils/random.h"
+
+namespace leveldb {
+namespace {
+
+std::string FLAGS_dir = "/tmp/blob_bench";
+uint64_t FLAGS_data_mb = 512;
+uint64_t FLAGS_write_buffer_mb = 16;
+uint64_t FLAGS_file_mb = 8;
+uint64_t FLAGS_gc_ratio_pct = 50;
+
+double NowSeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void Check(const Status& s) {
+  if (!s.ok()) {
+    std::fprintf(stderr, "%s\n", s.ToString().c_str());
+    std::exit(1);
+  }
+}
+
+struct TableFile {
+  FileMetaData meta;
+  RandomAccessFile* file = nullptr;
+  Table* table = nullptr;
+};
+
+// A two-level tree without a manifest: just enough structure to make
+// flushes and compactions write what they would in a DB.
+class Tree {
+ public:
+  Tree(const Options& options, bool separate)
+      : options_(options),
+        env_(options.env),
+        icmp_(options.comparator),
+        separate_(separate) {
+    table_options_ = options;
+    table_options_.comparator = &icmp_;
+    mem_ = new MemTable(icmp_);
+    mem_->Ref();
+  }
+
+  ~Tree() {
+    mem_->Unref();
+    for (TableFile* f : level0_) Drop(f);
+    for (TableFile* f : level1_) Drop(f);
+    for (const auto& kvp : blobs_) {
+      env_->RemoveFile(BlobFileName(FLAGS_dir, kvp.first));
+    }
+  }
+
+  void Put(const Slice& key, const Slice& value) {
+    mem_->Add(++sequence_, kTypeValue, key, value);
+    MaybeFlush();
+  }
+
+  void Finish() {
+    Flush();
+    if (!level0_.empty()) Compact();
+  }
+
+  uint64_t bytes_written() const { return bytes_written_; }
+  uint64_t gc_bytes_written() const { return gc_bytes_written_; }
+  int num_blob_files() const { return blobs_.size(); }
+
+ private:
+  void Drop(TableFile* f) {
+    delete f->table;
+    delete f->file;
+    env_->RemoveFile(TableFileName(FLAGS_dir, f->meta.number));
+    delete f;
+  }
+
+  TableFile* OpenTable(const FileMetaData& meta) {
+    TableFile* f = new TableFile;
+    f->meta = meta;
+    Check(env_->NewRandomAccessFile(TableFileName(FLAGS_dir, meta.number),
+                                    &f->file));
+    Check(Table::Open(table_options_, f->file, meta.number, meta.file_size,
+                      &f->table));
+    return f;
+  }
+
+  void MaybeFlush() {
+    if (mem_->ApproximateMemoryUsage() < options_.write_buffer_size) return;
+    Flush();
+    if (level0_.size() >=
+        static_cast<size_t>(options_.level0_file_num_compaction_trigger)) {
+      Compact();
+      if (separate_) CollectGarbage();
+    }
+  }
+
+  void Flush() {
+    FileMetaData meta;
+    meta.number = next_file_++;
+    Iterator* iter = mem_->NewIterator();
+    WritableFile* blob_file = nullptr;
+    BlobFileBuilder* blobs = nullptr;
+    if (separate_) {
+      Check(env_->NewWritableFile(BlobFileName(FLAGS_dir, next_file_),
+                                  &blob_file));
+      blobs = new BlobFileBuilder(blob_file, next_file_++);
+    }
+    Check(BuildTable(FLAGS_dir, env_, table_options_, iter, &meta, blobs));
+    delete iter;
+    if (blobs != nullptr) {
+      Check(blob_file->Close());
+      if (blobs->NumEntries() > 0) {
+        BlobFileMetaData& b = blobs_[blobs->file_number()];
+        b.number = blobs->file_number();
+        b.total_count = blobs->NumEntries();
+        b.total_bytes = blobs->ValueBytes();
+        bytes_written_ += blobs->FileSize();
+      } else {
+        env_->RemoveFile(BlobFileName(FLAGS_dir, blobs->file_number()));
+      }
+      delete blobs;
+      delete blob_file;
+    }
+    if (meta.file_size > 0) {
+      bytes_written_ += meta.file_size;
+      level0_.insert(level0_.begin(), OpenTable(meta));  // newest first
+    }
+    mem_->Unref();
+    mem_ = new MemTable(icmp_);
+    mem_->Ref();
+  }
+
+  // Merge all of level 0 and level 1 into a new level 1.
+  void Compact() {
+    struct Input {
+      Iterator* iter;
+      size_t rank;  // lower is newer
+    };
+    auto greater = [this](const Input& a, const Input& b) {
+      int r = icmp_.Compare(a.iter->key(), b.iter->key());
+      return r != 0 ? r > 0 : a.rank > b.rank;
+    };
+    std::priority_queue<Input, std::vector<Input>, decltype(greater)> heap(
+        greater);
+    std::vector<TableFile*> inputs(level0_);
+    inputs.insert(inputs.end(), level1_.begin(), level1_.end());
+    ReadOptions ro;
+    ro.fill_cache = false;
+    for (size_t i = 0; i < inputs.size(); i++) {
+      Iterator* iter = inputs[i]->table->NewIterator(ro);
+      iter->SeekToFirst();
+      if (iter->Valid()) {
+        heap.push({iter, i});
+      } else {
+        delete iter;
+      }
+    }
+
+    std::vector<TableFile*> outputs;
+    WritableFile* file = nullptr;
+    TableBuilder* builder = nullptr;
+    FileMetaData meta;
+    std::string last_user_key, last_key;
+    bool has_last = false;
+    BlobDiscardStats discards;
+    auto close_output = [&]() {
+      Check(builder->Finish());
+      meta.file_size = builder->FileSize();
+      meta.largest.DecodeFrom(last_key);
+      Check(file->Close());
+      delete builder;
+      delete file;
+      builder = nullptr;
+      bytes_written_ += meta.file_size;
+      outputs.push_back(OpenTable(meta));
+    };
+
+    while (!heap.empty()) {
+      Input top = heap.top();
+      heap.pop();
+      Slice key = top.iter->key();
+      ParsedInternalKey ikey;
+      if (!ParseInternalKey(key, &ikey)) std::abort();
+      if (has_last && ikey.user_key == Slice(last_user_key)) {
+        // Shadowed by a newer entry already written.
+        if (ikey.type == kTypeBlobIndex) Check(discards.Add(top.iter->value()));
+      } else {
+        if (builder == nullptr) {
+          meta = FileMetaData();
+          meta.number = next_file_++;
+          Check(env_->NewWritableFile(TableFileName(FLAGS_dir, meta.number),
+                                      &file));
+          builder = new TableBuilder(table_options_, file);
+          meta.smallest.DecodeFrom(key);
+        }
+        builder->Add(key, top.iter->value());
+        last_user_key.assign(ikey.user_key.data(), ikey.user_key.size());
+        last_key.assign(key.data(), key.size());
+        has_last = true;
+        if (builder->FileSize() >= options_.max_file_size) close_output();
+      }
+      top.iter->Next();
+      if (top.iter->Valid()) {
+        heap.push(top);
+      } else {
+        delete top.iter;
+      }
+    }
+    if (builder != nullptr) close_output();
+
+    for (TableFile* f : inputs) Drop(f);
+    level0_.clear();
+    level1_ = outputs;
+
+    for (const auto& kvp : discards.stats()) {
+      auto it = blobs_.find(kvp.first);
+      if (it == blobs_.end()) continue;  // already collected
+      it->second.garbage_count += kvp.second.first;
+      it->second.garbage_bytes += kvp.second.second;
+    }
+  }
+
+  // Stand-in for a DB Get: level 1 is the whole tree right after Compact().
+  bool IsLive(const Slice& user_key, const BlobIndex& index) {
+    InternalKey target(user_key, kMaxSequenceNumber, kValueTypeForSeek);
+    std::vector<FileMetaData*> files;
+    for (TableFile* f : level1_) files.push_back(&f->meta);
+    const int i = FindFile(icmp_, files, target.Encode());
+    if (i >= static_cast<int>(files.size())) return false;
+    Iterator* iter = level1_[i]->table->NewIterator(ReadOptions());
+    iter->Seek(target.Encode());
+    bool live = false;
+    ParsedInternalKey ikey;
+    if (iter->Valid() && ParseInternalKey(iter->key(), &ikey) &&
+        ikey.user_key == user_key && ikey.type == kTypeBlobIndex) {
+      Slice input = iter->value();
+      BlobIndex found;
+      live = found.DecodeFrom(&input).ok() &&
+             found.file_number == index.file_number &&
+             found.offset == index.offset;
+    }
+    delete iter;
+    return live;
+  }
+
+  void CollectGarbage() {
+    std::vector<BlobFileMetaData> files;
+    for (const auto& kvp : blobs_) files.push_back(kvp.second);
+    std::vector<uint64_t> victims =
+        PickBlobFilesForGC(files, options_.blob_gc_garbage_ratio);
+    if (victims.empty()) return;
+
+    BlobGarbageCollector gc(
+        FLAGS_dir, options_,
+        [this](const Slice& k, const BlobIndex& i) { return IsLive(k, i); },
+        [this]() { return next_file_++; });
+    for (uint64_t number : victims) Check(gc.Collect(number));
+    VersionEdit edit;
+    Check(gc.Finish(&edit));
+    for (const auto& kvp : gc.relocated()) {
+      mem_->Add(++sequence_, kTypeBlobIndex, kvp.first, kvp.second);
+    }
+    if (!gc.relocated().empty()) {
+      Slice input = gc.relocated()[0].second;
+      BlobIndex index;
+      Check(index.DecodeFrom(&input));
+      BlobFileMetaData& b = blobs_[index.file_number];
+      b.number = index.file_number;
+      for (const auto& kvp : gc.relocated()) {
+        Slice in = kvp.second;
+        Check(index.DecodeFrom(&in));
+        b.total_count++;
+        b.total_bytes += index.size;
+      }
+    }
+    gc_bytes_written_ += gc.bytes_written();
+    bytes_written_ += gc.bytes_written();
+    // Nothing reads values here, so the old files can go right away.
+    for (uint64_t number : victims) {
+      blobs_.erase(number);
+      env_->RemoveFile(BlobFileName(FLAGS_dir, number));
+    }
+  }
+
+  const Options options_;
+  Env* const env_;
+  const InternalKeyComparator icmp_;
+  const bool separate_;
+  Options table_options_;
+  MemTable* mem_;
+  SequenceNumber sequence_ = 0;
+  uint64_t next_file_ = 1;
+  uint64_t bytes_written_ = 0;
+  uint64_t gc_bytes_written_ = 0;
+  std::vector<TableFile*> level0_;
+  std::vector<TableFile*> level1_;
+  std::map<uint64_t, BlobFileMetaData> blobs_;
+};
+
+void Bench(size_t value_size, bool separate) {
+  Options options;
+  options.write_buffer_size = FLAGS_write_buffer_mb << 20;
+  options.max_file_size = FLAGS_file_mb << 20;
+  options.min_blob_size = separate ? 1024 : 0;
+  options.blob_gc_garbage_ratio = FLAGS_gc_ratio_pct / 100.0;
+  options.env->CreateDir(FLAGS_dir);
+
+  const uint64_t num = (FLAGS_data_mb << 20) / value_size;
+  const uint64_t keys = num / 2 > 0 ? num / 2 : 1;
+  Random rnd(301);
+  std::string value(value_size, 'x');
+  char key[17];
+  uint64_t user_bytes = 0;
+
+  double start = NowSeconds();
+  {
+    Tree tree(options, separate);
+    for (uint64_t i = 0; i < num; i++) {
+      std::snprintf(key, sizeof(key), "%016llu",
+                    static_cast<unsigned long long>(rnd.Next() % keys));
+      for (size_t j = 0; j < value.size(); j += 64) {
+        value[j] = 'a' + rnd.Uniform(26);
+      }
+      tree.Put(Slice(key, 16), value);
+      user_bytes += 16 + value.size();
+    }
+    tree.Finish();
+    double secs = NowSeconds() - start;
+    std::printf("%s\t%zu\t%llu\t%.2f\t%.1f\t%.1f\t%d\n",
+                separate ? "blob" : "inline", value_size / 1024,
+                static_cast<unsigned long long>(num),
+                static_cast<double>(tree.bytes_written()) / user_bytes,
+                user_bytes / secs / 1048576.0,
+                tree.gc_bytes_written() / 1048576.0, tree.num_blob_files());
+  }
+}
+
+}  // namespace
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  using namespace leveldb;
+  for (int i = 1; i < argc; i++) {
+    unsigned long long n;
+    char junk;
+    if (strncmp(argv[i], "--dir=", 6) == 0) {
+      FLAGS_dir = argv[i] + 6;
+    } else if (sscanf(argv[i], "--data_mb=%llu%c", &n, &junk) == 1) {
+      FLAGS_data_mb = n;
+    } else if (sscanf(argv[i], "--write_buffer_mb=%llu%c", &n, &junk) == 1) {
+      FLAGS_write_buffer_mb = n;
+    } else if (sscanf(argv[i], "--file_mb=%llu%c", &n, &junk) == 1) {
+      FLAGS_file_mb = n;
+    } else if (sscanf(argv[i], "--gc_ratio_pct=%llu%c", &n, &junk) == 1) {
+      FLAGS_gc_ratio_pct = n;
+    } else {
+      std::fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+
+  std::printf(
+      "mode\tvalue_kb\twrites\twrite_amp\tuser_mb_per_sec\tgc_mb\t"
+      "blob_files\n");
+  for (size_t kb = 4; kb <= 64; kb *= 4) {
+    Bench(kb << 10, false);
+    Bench(kb << 10, true);
+  }
+  return 0;
+}
@@ -0,0 +1,130 @@
+#include "blob_file.h"
+
+#include "env.h"
+#include "utils/coding.h"
+#include "utils/crc32c.h"
+
+namespace leveldb {
+
+void BlobIndex::EncodeTo(std::string* dst) const {
+  PutVarint64(dst, file_number);
+  PutVarint64(dst, offset);
+  PutVarint64(dst, size);
+}
+
+Status BlobIndex::DecodeFrom(Slice* input) {
+  if (GetVarint64(input, &file_number) && GetVarint64(input, &offset) &&
+      GetVarint64(input, &size)) {
+    return Status::OK();
+  }
+  return Status::Corruption("bad blob index");
+}
+
+BlobFileBuilder::BlobFileBuilder(WritableFile* file, uint64_t file_number)
+    : file_(file), file_number_(file_number) {}
+
+Status BlobFileBuilder::Add(const Slice& key, const Slice& value,
+                            BlobIndex* index) {
+  header_.clear();
+  PutFixed32(&header_, key.size());
+  PutFixed32(&header_, value.size());
+  header_.append(key.data(), key.size());
+  PutFixed32(&header_, crc32c::Mask(crc32c::Value(value.data(), value.size())));
+  Status s = file_->Append(header_);
+  if (s.ok()) {
+    s = file_->Append(value);
+  }
+  if (s.ok()) {
+    index->file_number = file_number_;
+    index->offset = offset_ + header_.size();
+    index->size = value.size();
+    offset_ += header_.size() + value.size();
+    num_entries_++;
+    value_bytes_ += value.size();
+  }
+  return s;
+}
+
+Status BlobFileBuilder::Finish() { return file_->Flush(); }
+
+BlobFileReader::BlobFileReader(RandomAccessFile* file, uint64_t file_number,
+                               uint64_t file_size)
+    : file_(file), file_number_(file_number), file_size_(file_size) {}
+
+Status BlobFileReader::Get(const BlobIndex& index, bool verify_checksums,
+                           std::string* value) const {
+  if (index.file_number != file_number_ || index.offset < 4 ||
+      index.offset + index.size > file_size_) {
+    return Status::Corruption("blob index out of range");
+  }
+  const size_t n = index.size + 4;
+  value->resize(n);
+  char* scratch = &(*value)[0];
+  Slice result;
+  Status s = file_->Read(index.offset - 4, n, &result, scratch);
+  if (!s.ok()) {
+    return s;
+  }
+  if (result.size() != n) {
+    return Status::Corruption("truncated blob read");
+  }
+  if (verify_checksums) {
+    const uint32_t crc = crc32c::Unmask(DecodeFixed32(result.data()));
+    if (crc32c::Value(result.data() + 4, index.size) != crc) {
+      return Status::Corruption("blob checksum mismatch");
+    }
+  }
+  if (result.data() != scratch) {
+    // The file implementation returned data from elsewhere (e.g. mmap).
+    value->assign(result.data() + 4, index.size);
+  } else {
+    value->erase(0, 4);
+  }
+  return Status::OK();
+}
+
+BlobFileIterator::BlobFileIterator(SequentialFile* file, uint64_t file_number)
+    : file_(file), file_number_(file_number) {}
+
+bool BlobFileIterator::Next() {
+  if (!status_.ok()) {
+    return false;
+  }
+  char header[kBlobRecordHeaderSize];
+  Slice result;
+  status_ = file_->Read(kBlobRecordHeaderSize, &result, header);
+  if (!status_.ok() || result.empty()) {
+    return false;
+  }
+  if (result.size() != kBlobRecordHeaderSize) {
+    status_ = Status::Corruption("truncated blob record header");
+    return false;
+  }
+  const uint32_t key_size = DecodeFixed32(result.data());
+  const uint32_t value_size = DecodeFixed32(result.data() + 4);
+  const size_t n = key_size + 4 + value_size;
+  buf_.resize(n);
+  status_ = file_->Read(n, &result, &buf_[0]);
+  if (!status_.ok()) {
+    return false;
+  }
+  if (result.size() != n) {
+    status_ = Status::Corruption("truncated blob record");
+    return false;
+  }
+  const char* p = result.data();
+  key_ = Slice(p, key_size);
+  value_ = Slice(p + key_size + 4, value_size);
+  const uint32_t crc = crc32c::Unmask(DecodeFixed32(p + key_size));
+  if (crc32c::Value(value_.data(), value_.size()) != crc) {
+    status_ = Status::Corruption("blob checksum mismatch");
+    return false;
+  }
+  index_.file_number = file_number_;
+  index_.offset = offset_ + kBlobRecordHeaderSize + key_size + 4;
+  index_.size = value_size;
+  offset_ += kBlobRecordHeaderSize + n;
+  return true;
+}
+
+}  // namespace leveldb
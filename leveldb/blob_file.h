@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "slice.h"
+#include "status.h"
+
+namespace leveldb {
+
+class RandomAccessFile;
+class SequentialFile;
+class WritableFile;
+
+// Blob files hold the values that were separated from the LSM tree. They
+// are written once, front to back, and never modified; space is reclaimed
+// by copying the live records into a new file.
+//
+// Record format:
+//    key_size    fixed32
+//    value_size  fixed32
+//    key         char[key_size]
+//    crc         fixed32 (masked crc32c of value)
+//    value       char[value_size]
+//
+// The key is only there for garbage collection, which has to find out
+// whether the LSM still points at a record. Point reads fetch the crc and
+// the value in one read starting 4 bytes before the value.
+static const size_t kBlobRecordHeaderSize = 8;
+
+// The LSM-side reference to a value stored in a blob file.
+struct BlobIndex {
+  uint64_t file_number = 0;
+  uint64_t offset = 0;  // of the value
+  uint64_t size = 0;    // of the value
+
+  void EncodeTo(std::string* dst) const;
+  Status DecodeFrom(Slice* input);
+};
+
+class BlobFileBuilder {
+ public:
+  // Appends to *file, which must be empty. Does not close the file.
+  BlobFileBuilder(WritableFile* file, uint64_t file_number);
+
+  BlobFileBuilder(const BlobFileBuilder&) = delete;
+  BlobFileBuilder& operator=(const BlobFileBuilder&) = delete;
+
+  // Append a record and store the reference to its value in *index.
+  Status Add(const Slice& key, const Slice& value, BlobIndex* index);
+
+  // Flush buffered data to the file.
+  Status Finish();
+
+  uint64_t file_number() const { return file_number_; }
+  uint64_t NumEntries() const { return num_entries_; }
+  uint64_t FileSize() const { return offset_; }
+  // Sum of the value sizes, the quantity garbage is measured in.
+  uint64_t ValueBytes() const { return value_bytes_; }
+
+ private:
+  WritableFile* const file_;
+  const uint64_t file_number_;
+  uint64_t offset_ = 0;
+  uint64_t num_entries_ = 0;
+  uint64_t value_bytes_ = 0;
+  std::string header_;
+};
+
+// Point reads from one blob file. Safe for concurrent use.
+class BlobFileReader {
+ public:
+  // Does not take ownership of "file".
+  BlobFileReader(RandomAccessFile* file, uint64_t file_number,
+                 uint64_t file_size);
+
+  BlobFileReader(const BlobFileReader&) = delete;
+  BlobFileReader& operator=(const BlobFileReader&) = delete;
+
+  Status Get(const BlobIndex& index, bool verify_checksums,
+             std::string* value) const;
+
+ private:
+  RandomAccessFile* const file_;
+  const uint64_t file_number_;
+  const uint64_t file_size_;
+};
+
+// Sequential scan over all records of a blob file, for garbage collection.
+class BlobFileIterator {
+ public:
+  // Does not take ownership of "file", which must be positioned at the
+  // start of the blob file.
+  BlobFileIterator(SequentialFile* file, uint64_t file_number);
+
+  BlobFileIterator(const BlobFileIterator&) = delete;
+  BlobFileIterator& operator=(const BlobFileIterator&) = delete;
+
+  // Advance to the next record. Returns false at the end of the file or
+  // on error; status() tells the two apart.
+  bool Next();
+
+  // REQUIRES: the last Next() returned true.
+  Slice key() const { return key_; }
+  Slice value() const { return value_; }
+  const BlobIndex& index() const { return index_; }
+
+  Status status() const { return status_; }
+
+ private:
+  SequentialFile* const file_;
+  const uint64_t file_number_;
+  uint64_t offset_ = 0;
+  std::string buf_;
+  Slice key_;
+  Slice value_;
+  BlobIndex index_;
+  Status status_;
+};
+
+}  // namespace leveldb
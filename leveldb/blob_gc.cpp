@@ -0,0 +1,126 @@
+#include "blob_gc.h"
+
+#include <algorithm>
+
+#include "env.h"
+#include "filename.h"
+
+namespace leveldb {
+
+Status BlobDiscardStats::Add(const Slice& blob_index) {
+  Slice input = blob_index;
+  BlobIndex index;
+  Status s = index.DecodeFrom(&input);
+  if (s.ok()) {
+    auto& stat = stats_[index.file_number];
+    stat.first++;
+    stat.second += index.size;
+  }
+  return s;
+}
+
+void BlobDiscardStats::AppendTo(VersionEdit* edit) const {
+  for (const auto& kvp : stats_) {
+    edit->AddBlobGarbage(kvp.first, kvp.second.first, kvp.second.second);
+  }
+}
+
+std::vector<uint64_t> PickBlobFilesForGC(
+    const std::vector<BlobFileMetaData>& files, double garbage_ratio) {
+  std::vector<uint64_t> result;
+  for (const BlobFileMetaData& f : files) {
+    if (f.GarbageRatio() >= garbage_ratio) {
+      result.push_back(f.number);
+    }
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+BlobGarbageCollector::BlobGarbageCollector(
+    const std::string& dbname, const Options& options, IsLiveFunction is_live,
+    std::function<uint64_t()> new_file_number)
+    : dbname_(dbname),
+      options_(options),
+      is_live_(std::move(is_live)),
+      new_file_number_(std::move(new_file_number)),
+      file_(nullptr),
+      builder_(nullptr),
+      bytes_written_(0) {}
+
+BlobGarbageCollector::~BlobGarbageCollector() {
+  if (builder_ != nullptr) {
+    // Finish() was not called or failed: the output is not referenced.
+    const uint64_t number = builder_->file_number();
+    delete builder_;
+    delete file_;
+    options_.env->RemoveFile(BlobFileName(dbname_, number));
+  }
+}
+
+Status BlobGarbageCollector::Collect(uint64_t number) {
+  Env* env = options_.env;
+  SequentialFile* in;
+  Status s = env->NewSequentialFile(BlobFileName(dbname_, number), &in);
+  if (!s.ok()) {
+    return s;
+  }
+  BlobFileIterator iter(in, number);
+  while (s.ok() && iter.Next()) {
+    if (!is_live_(iter.key(), iter.index())) {
+      continue;
+    }
+    if (builder_ == nullptr) {
+      const uint64_t out = new_file_number_();
+      s = env->NewWritableFile(BlobFileName(dbname_, out), &file_);
+      if (!s.ok()) break;
+      builder_ = new BlobFileBuilder(file_, out);
+    }
+    BlobIndex index;
+    s = builder_->Add(iter.key(), iter.value(), &index);
+    if (s.ok()) {
+      relocated_.emplace_back(iter.key().ToString(), std::string());
+      index.EncodeTo(&relocated_.back().second);
+    }
+  }
+  if (s.ok()) {
+    s = iter.status();
+  }
+  delete in;
+  if (s.ok()) {
+    inputs_.push_back(number);
+  }
+  return s;
+}
+
+Status BlobGarbageCollector::Finish(VersionEdit* edit) {
+  Status s;
+  if (builder_ != nullptr) {
+    s = builder_->Finish();
+    if (s.ok()) {
+      s = file_->Sync();
+    }
+    if (s.ok()) {
+      s = file_->Close();
+    }
+    if (!s.ok()) {
+      return s;
+    }
+    edit->AddBlobFile(builder_->file_number(), builder_->NumEntries(),
+                      builder_->ValueBytes());
+    bytes_written_ = builder_->FileSize();
+    delete builder_;
+    delete file_;
+    builder_ = nullptr;
+    file_ = nullptr;
+  }
+  return s;
+}
+
+void BlobGarbageCollector::RemoveInputs(VersionEdit* edit) const {
+  for (uint64_t number : inputs_) {
+    edit->RemoveBlobFile(number);
+  }
+}
+
+}  // namespace leveldb
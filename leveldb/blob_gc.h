@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "blob_file.h"
+#include "options.h"
+#include "status.h"
+#include "version_edit.h"
+
+namespace leveldb {
+
+class WritableFile;
+
+// Accumulates, per blob file, the references that a compaction dropped
+// (overwritten or deleted keys). The compaction appends the result to its
+// VersionEdit so the garbage counts become part of the manifest.
+class BlobDiscardStats {
+ public:
+  // "blob_index" is the value of a dropped kTypeBlobIndex entry.
+  Status Add(const Slice& blob_index);
+
+  bool empty() const { return stats_.empty(); }
+
+  void AppendTo(VersionEdit* edit) const;
+
+  void Clear() { stats_.clear(); }
+
+  // file number -> (count, bytes)
+  const std::map<uint64_t, std::pair<uint64_t, uint64_t>>& stats() const {
+    return stats_;
+  }
+
+ private:
+  std::map<uint64_t, std::pair<uint64_t, uint64_t>> stats_;
+};
+
+// Return the numbers of the blob files whose garbage ratio reached
+// "garbage_ratio", oldest file first.
+std::vector<uint64_t> PickBlobFilesForGC(
+    const std::vector<BlobFileMetaData>& files, double garbage_ratio);
+
+/**
+ * @brief BlobGarbageCollector
+ *
+ * @details Copies the records of old blob files that the LSM still points
+ * at into a new blob file. Liveness is decided by the caller, normally by
+ * looking the key up and comparing the BlobIndex it finds with the
+ * record's.
+ *
+ * The collector does not touch the LSM. The caller applies the edit of
+ * Finish(), so that the new file is live before anything points at it,
+ * writes every pair of relocated() back as a kTypeBlobIndex entry, then
+ * applies an edit with RemoveInputs() and deletes the old files once no
+ * Version references them.
+ */
+class BlobGarbageCollector {
+ public:
+  typedef std::function<bool(const Slice& user_key, const BlobIndex& index)>
+      IsLiveFunction;
+
+  BlobGarbageCollector(const std::string& dbname, const Options& options,
+                       IsLiveFunction is_live,
+                       std::function<uint64_t()> new_file_number);
+
+  BlobGarbageCollector(const BlobGarbageCollector&) = delete;
+  BlobGarbageCollector& operator=(const BlobGarbageCollector&) = delete;
+
+  ~BlobGarbageCollector();
+
+  // Copy the live records of blob file "number".
+  Status Collect(uint64_t number);
+
+  // Close the output and record it in *edit.
+  Status Finish(VersionEdit* edit);
+
+  // Record the removal of the collected files in *edit.
+  void RemoveInputs(VersionEdit* edit) const;
+
+  // (user key, encoded BlobIndex) for every record that moved.
+  const std::vector<std::pair<std::string, std::string>>& relocated() const {
+    return relocated_;
+  }
+
+  // Size of the output file, valid after Finish().
+  uint64_t bytes_written() const { return bytes_written_; }
+
+ private:
+  const std::string dbname_;
+  const Options options_;
+  const IsLiveFunction is_live_;
+  const std::function<uint64_t()> new_file_number_;
+
+  WritableFile* file_;
+  BlobFileBuilder* builder_;
+  uint64_t bytes_written_;
+  std::vector<uint64_t> inputs_;
+  std::vector<std::pair<std::string, std::string>> relocated_;
+};
+
+}  // namespace leveldb
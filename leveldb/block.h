@@ -1,26 +1,36 @@
-#include <iostream>
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
 
 namespace leveldb {
 
 struct BlockContents;
-class Comparators;
-class Iter;
+class Comparator;
 class Iterator;
+
 class Block {
  public:
-  explicit Block(const BlockContents&);
+  // Initialize the block with the specified contents.
+  explicit Block(const BlockContents& contents);
+
   Block(const Block&) = delete;
   Block& operator=(const Block&) = delete;
+
   ~Block();
 
-  size_t size() const { return size_; };
-  Iterator* NewIterator(const Comparators&);
+  size_t size() const { return size_; }
+  Iterator* NewIterator(const Comparator* comparator);
 
  private:
+  class Iter;
+
   uint32_t NumRestarts() const;
+
   const char* data_;
   size_t size_;
-  uint32_t restart_offset_;
-  bool owned_;
+  uint32_t restart_offset_;  // Offset in data_ of restart array
+  bool owned_;               // Block owns data_[]
 };
-};  // namespace leveldb
\ No newline at end of file
+
+}  // namespace leveldb
@@ -0,0 +1,416 @@
+#include "block_cache.h"
+
+#include <cassert>
+
+namespace leveldb {
+
+namespace {
+
+// Slot::meta packs the slot state into the top two bits and the number of
+// outstanding pins into the remaining 30 bits.
+enum SlotState : uint32_t {
+  kEmpty = 0,
+  kConstruction = 1,  // owned by the shard mutex holder
+  kVisible = 2,       // can be found and pinned by Lookup
+  kInvisible = 3,     // erased or replaced, freed by the last Release
+};
+
+const int kStateShift = 30;
+const uint32_t kRefMask = (1u << kStateShift) - 1;
+
+inline uint32_t StateOf(uint32_t meta) { return meta >> kStateShift; }
+inline uint32_t RefsOf(uint32_t meta) { return meta & kRefMask; }
+inline uint32_t MakeMeta(uint32_t state, uint32_t refs) {
+  return (state << kStateShift) | refs;
+}
+
+struct Slot {
+  std::atomic<uint32_t> meta{0};
+  // CLOCK reference bit, set by hits and cleared by the sweeping hand.
+  std::atomic<uint8_t> clock{0};
+  // Number of resident entries whose probe sequence passes over this slot.
+  // A probe can stop at a non-matching slot once this drops to zero.
+  std::atomic<uint32_t> displacements{0};
+
+  // Written in kConstruction, read only while the slot is pinned.
+  uint64_t hash;
+  uint64_t file_number;
+  uint64_t offset;
+  void* value;
+  size_t charge;
+  BlockCache::Deleter deleter;
+};
+
+// Hits and misses are counted in stripes picked by thread, each on a cache
+// line of its own, so that concurrent hits do not all write the same line.
+const int kCounterStripes = 16;
+
+struct alignas(64) CounterStripe {
+  std::atomic<uint64_t> hits{0};
+  std::atomic<uint64_t> misses{0};
+};
+
+inline int ThreadStripe() {
+  static std::atomic<int> next_stripe{0};
+  thread_local int stripe =
+      next_stripe.fetch_add(1, std::memory_order_relaxed) % kCounterStripes;
+  return stripe;
+}
+
+// Keep the probe sequences short: at most 7/8 of the slots are ever used.
+inline size_t MaxOccupancy(size_t num_slots) {
+  return num_slots - num_slots / 8;
+}
+
+}  // namespace
+
+class alignas(64) BlockCache::Shard {
+ public:
+  Shard() = default;
+  ~Shard();
+
+  void Init(size_t capacity, size_t num_slots);
+
+  Handle* Insert(uint64_t hash, uint64_t file_number, uint64_t offset,
+                 void* value, size_t charge, Deleter deleter);
+  Handle* Lookup(uint64_t hash, uint64_t file_number, uint64_t offset);
+  void Release(Slot* slot);
+  void Erase(uint64_t hash, uint64_t file_number, uint64_t offset);
+
+  size_t usage() const { return usage_.load(std::memory_order_relaxed); }
+  uint64_t hits() const;
+  uint64_t misses() const;
+
+ private:
+  static bool Matches(const Slot& slot, uint64_t hash, uint64_t file_number,
+                      uint64_t offset) {
+    return slot.hash == hash && slot.file_number == file_number &&
+           slot.offset == offset;
+  }
+
+  // Try to add one pin to a visible slot. Fails for any other state.
+  static bool TryPin(Slot* slot);
+
+  // Turn a visible entry into an invisible one. Returns true if the caller
+  // is now responsible for reclaiming it, i.e. it had no pins.
+  static bool MakeInvisible(Slot* slot);
+
+  // REQUIRES: mutex_ held.
+  Slot* FindVisible(uint64_t hash, uint64_t file_number, uint64_t offset);
+  // REQUIRES: mutex_ held.
+  void EvictFor(size_t charge);
+  // REQUIRES: mutex_ held, slot in kConstruction.
+  void Reclaim(Slot* slot);
+
+  size_t capacity_ = 0;
+  size_t mask_ = 0;
+  Slot* slots_ = nullptr;
+
+  std::atomic<size_t> usage_{0};
+  CounterStripe counters_[kCounterStripes];
+
+  std::mutex mutex_;
+  size_t occupancy_ = 0;  // guarded by mutex_
+  size_t clock_hand_ = 0;  // guarded by mutex_
+};
+
+void BlockCache::Shard::Init(size_t capacity, size_t num_slots) {
+  assert((num_slots & (num_slots - 1)) == 0);
+  capacity_ = capacity;
+  mask_ = num_slots - 1;
+  slots_ = new Slot[num_slots];
+}
+
+uint64_t BlockCache::Shard::hits() const {
+  uint64_t total = 0;
+  for (const CounterStripe& c : counters_) {
+    total += c.hits.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+uint64_t BlockCache::Shard::misses() const {
+  uint64_t total = 0;
+  for (const CounterStripe& c : counters_) {
+    total += c.misses.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+BlockCache::Shard::~Shard() {
+  if (slots_ == nullptr) return;
+  for (size_t i = 0; i <= mask_; i++) {
+    Slot* slot = &slots_[i];
+    uint32_t meta = slot->meta.load(std::memory_order_relaxed);
+    if (StateOf(meta) == kEmpty) continue;
+    assert(RefsOf(meta) == 0);  // Error if caller has an unreleased handle
+    (*slot->deleter)(slot->file_number, slot->offset, slot->value);
+  }
+  delete[] slots_;
+}
+
+bool BlockCache::Shard::TryPin(Slot* slot) {
+  uint32_t meta = slot->meta.load(std::memory_order_acquire);
+  while (StateOf(meta) == kVisible) {
+    if (slot->meta.compare_exchange_weak(meta, meta + 1,
+                                         std::memory_order_acq_rel,
+                                         std::memory_order_acquire)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool BlockCache::Shard::MakeInvisible(Slot* slot) {
+  uint32_t meta = slot->meta.load(std::memory_order_acquire);
+  while (StateOf(meta) == kVisible) {
+    uint32_t refs = RefsOf(meta);
+    uint32_t next = MakeMeta(refs == 0 ? kConstruction : kInvisible, refs);
+    if (slot->meta.compare_exchange_weak(meta, next,
+                                         std::memory_order_acq_rel,
+                                         std::memory_order_acquire)) {
+      return refs == 0;
+    }
+  }
+  return false;
+}
+
+BlockCache::Handle* BlockCache::Shard::Lookup(uint64_t hash,
+                                              uint64_t file_number,
+                                              uint64_t offset) {
+  for (size_t i = 0; i <= mask_; i++) {
+    Slot* slot = &slots_[(hash + i) & mask_];
+    if (TryPin(slot)) {
+      if (Matches(*slot, hash, file_number, offset)) {
+        // A hit only marks the entry as recently used; nothing is relinked.
+        if (slot->clock.load(std::memory_order_relaxed) == 0) {
+          slot->clock.store(1, std::memory_order_relaxed);
+        }
+        counters_[ThreadStripe()].hits.fetch_add(1, std::memory_order_relaxed);
+        return reinterpret_cast<Handle*>(slot);
+      }
+      Release(slot);
+    }
+    if (slot->displacements.load(std::memory_order_acquire) == 0) {
+      break;
+    }
+  }
+  counters_[ThreadStripe()].misses.fetch_add(1, std::memory_order_relaxed);
+  return nullptr;
+}
+
+void BlockCache::Shard::Release(Slot* slot) {
+  uint32_t old = slot->meta.fetch_sub(1, std::memory_order_acq_rel);
+  assert(RefsOf(old) > 0);
+  if (StateOf(old) == kInvisible && RefsOf(old) == 1) {
+    // Last pin of an erased entry. Nobody can pin an invisible slot, so we
+    // are the only one left to free it.
+    std::lock_guard<std::mutex> l(mutex_);
+    uint32_t expected = MakeMeta(kInvisible, 0);
+    if (slot->meta.compare_exchange_strong(expected, MakeMeta(kConstruction, 0),
+                                           std::memory_order_acq_rel)) {
+      Reclaim(slot);
+    }
+  }
+}
+
+Slot* BlockCache::Shard::FindVisible(uint64_t hash, uint64_t file_number,
+                                     uint64_t offset) {
+  for (size_t i = 0; i <= mask_; i++) {
+    Slot* slot = &slots_[(hash + i) & mask_];
+    uint32_t meta = slot->meta.load(std::memory_order_acquire);
+    // Fields of visible slots only change under mutex_, which we hold.
+    if (StateOf(meta) == kVisible && Matches(*slot, hash, file_number, offset)) {
+      return slot;
+    }
+    if (slot->displacements.load(std::memory_order_relaxed) == 0) {
+      break;
+    }
+  }
+  return nullptr;
+}
+
+void BlockCache::Shard::Reclaim(Slot* slot) {
+  (*slot->deleter)(slot->file_number, slot->offset, slot->value);
+  usage_.fetch_sub(slot->charge, std::memory_order_relaxed);
+  for (size_t i = slot->hash & mask_; &slots_[i] != slot; i = (i + 1) & mask_) {
+    slots_[i].displacements.fetch_sub(1, std::memory_order_relaxed);
+  }
+  occupancy_--;
+  slot->meta.store(MakeMeta(kEmpty, 0), std::memory_order_release);
+}
+
+void BlockCache::Shard::EvictFor(size_t charge) {
+  // Two full sweeps: the first may only clear reference bits.
+  const size_t max_steps = 2 * (mask_ + 1);
+  for (size_t step = 0; step < max_steps; step++) {
+    if (usage() + charge <= capacity_ && occupancy_ < MaxOccupancy(mask_ + 1)) {
+      return;
+    }
+    Slot* slot = &slots_[clock_hand_];
+    clock_hand_ = (clock_hand_ + 1) & mask_;
+
+    uint32_t meta = slot->meta.load(std::memory_order_acquire);
+    if (StateOf(meta) != kVisible || RefsOf(meta) != 0) {
+      continue;
+    }
+    if (slot->clock.load(std::memory_order_relaxed) != 0) {
+      slot->clock.store(0, std::memory_order_relaxed);
+      continue;
+    }
+    // Fails if a concurrent Lookup pinned the entry in the meantime.
+    if (slot->meta.compare_exchange_strong(meta, MakeMeta(kConstruction, 0),
+                                           std::memory_order_acq_rel)) {
+      Reclaim(slot);
+    }
+  }
+}
+
+BlockCache::Handle* BlockCache::Shard::Insert(uint64_t hash,
+                                              uint64_t file_number,
+                                              uint64_t offset, void* value,
+                                              size_t charge, Deleter deleter) {
+  std::lock_guard<std::mutex> l(mutex_);
+
+  Slot* old = FindVisible(hash, file_number, offset);
+  if (old != nullptr && MakeInvisible(old)) {
+    Reclaim(old);
+  }
+
+  EvictFor(charge);
+
+  if (occupancy_ < MaxOccupancy(mask_ + 1)) {
+    const size_t home = hash & mask_;
+    for (size_t i = 0; i <= mask_; i++) {
+      Slot* slot = &slots_[(home + i) & mask_];
+      if (StateOf(slot->meta.load(std::memory_order_acquire)) != kEmpty) {
+        continue;
+      }
+      for (size_t j = 0; j < i; j++) {
+        slots_[(home + j) & mask_].displacements.fetch_add(
+            1, std::memory_order_relaxed);
+      }
+      slot->hash = hash;
+      slot->file_number = file_number;
+      slot->offset = offset;
+      slot->value = value;
+      slot->charge = charge;
+      slot->deleter = deleter;
+      slot->clock.store(0, std::memory_order_relaxed);
+      occupancy_++;
+      usage_.fetch_add(charge, std::memory_order_relaxed);
+      // Publish the fields together with the caller's pin.
+      slot->meta.store(MakeMeta(kVisible, 1), std::memory_order_release);
+      return reinterpret_cast<Handle*>(slot);
+    }
+  }
+
+  // Every slot is pinned: the caller keeps the block, uncached.
+  return nullptr;
+}
+
+void BlockCache::Shard::Erase(uint64_t hash, uint64_t file_number,
+                              uint64_t offset) {
+  std::lock_guard<std::mutex> l(mutex_);
+  Slot* slot = FindVisible(hash, file_number, offset);
+  if (slot != nullptr && MakeInvisible(slot)) {
+    Reclaim(slot);
+  }
+}
+
+BlockCache::BlockCache(size_t capacity, size_t estimated_block_size,
+                       int num_shard_bits)
+    : capacity_(capacity), num_shard_bits_(num_shard_bits) {
+  assert(num_shard_bits >= 0 && num_shard_bits < 20);
+  assert(estimated_block_size > 0);
+  const int num_shards = 1 << num_shard_bits;
+  const size_t per_shard = (capacity + (num_shards - 1)) / num_shards;
+
+  // Aim for a load factor of about one half when the shard is full of
+  // blocks of the estimated size.
+  size_t wanted = 2 * (per_shard / estimated_block_size) + 1;
+  size_t num_slots = 16;
+  while (num_slots < wanted) {
+    num_slots <<= 1;
+  }
+
+  shards_ = new Shard[num_shards];
+  for (int s = 0; s < num_shards; s++) {
+    shards_[s].Init(per_shard, num_slots);
+  }
+}
+
+BlockCache::~BlockCache() { delete[] shards_; }
+
+uint64_t BlockCache::HashKey(uint64_t file_number, uint64_t offset) {
+  // 128 -> 64 bit mix; the finalizer of MurmurHash3.
+  uint64_t h = file_number * 0x9e3779b97f4a7c15ull ^ offset;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+BlockCache::Shard* BlockCache::ShardFor(uint64_t hash) const {
+  return &shards_[num_shard_bits_ > 0 ? hash >> (64 - num_shard_bits_) : 0];
+}
+
+BlockCache::Handle* BlockCache::Insert(uint64_t file_number, uint64_t offset,
+                                       void* value, size_t charge,
+                                       Deleter deleter) {
+  const uint64_t hash = HashKey(file_number, offset);
+  return ShardFor(hash)->Insert(hash, file_number, offset, value, charge,
+                                deleter);
+}
+
+BlockCache::Handle* BlockCache::Lookup(uint64_t file_number, uint64_t offset) {
+  const uint64_t hash = HashKey(file_number, offset);
+  return ShardFor(hash)->Lookup(hash, file_number, offset);
+}
+
+void BlockCache::Release(Handle* handle) {
+  Slot* slot = reinterpret_cast<Slot*>(handle);
+  ShardFor(slot->hash)->Release(slot);
+}
+
+void* BlockCache::Value(Handle* handle) const {
+  return reinterpret_cast<Slot*>(handle)->value;
+}
+
+void BlockCache::Erase(uint64_t file_number, uint64_t offset) {
+  const uint64_t hash = HashKey(file_number, offset);
+  ShardFor(hash)->Erase(hash, file_number, offset);
+}
+
+size_t BlockCache::TotalCharge() const {
+  size_t total = 0;
+  for (int s = 0; s < NumShards(); s++) {
+    total += shards_[s].usage();
+  }
+  return total;
+}
+
+size_t BlockCache::ShardUsage(int shard) const {
+  assert(shard >= 0 && shard < NumShards());
+  return shards_[shard].usage();
+}
+
+uint64_t BlockCache::hits() const {
+  uint64_t total = 0;
+  for (int s = 0; s < NumShards(); s++) {
+    total += shards_[s].hits();
+  }
+  return total;
+}
+
+uint64_t BlockCache::misses() const {
+  uint64_t total = 0;
+  for (int s = 0; s < NumShards(); s++) {
+    total += shards_[s].misses();
+  }
+  return total;
+}
+
+}  // namespace leveldb
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace leveldb {
+
+/**
+ * @brief BlockCache
+ *
+ * @details A byte-capacity cache for uncompressed data blocks, keyed by
+ * (file number, BlockHandle offset). The cache is split into shards; every
+ * shard is an open-addressing table of fixed-size slots evicted with the
+ * CLOCK algorithm.
+ *
+ * Lookup and Release never take a lock: a hit pins the slot with a CAS on
+ * the slot's meta word and sets its reference bit. Insert, Erase and eviction
+ * are serialized per shard by a mutex, so the clock hand and the probe
+ * bookkeeping only have a single writer.
+ *
+ * A pinned entry is never evicted. If every resident entry is pinned, the
+ * shard is allowed to go over capacity, like the LRU cache in leveldb.
+ */
+class BlockCache {
+ public:
+  struct Handle {};
+
+  typedef void (*Deleter)(uint64_t file_number, uint64_t offset, void* value);
+
+  // "estimated_block_size" is only used to size the slot tables; entries of
+  // any charge can be inserted.
+  explicit BlockCache(size_t capacity, size_t estimated_block_size = 4096,
+                      int num_shard_bits = 4);
+
+  BlockCache(const BlockCache&) = delete;
+  BlockCache& operator=(const BlockCache&) = delete;
+
+  // Destroys all entries. REQUIRES: no outstanding handles.
+  ~BlockCache();
+
+  // Insert a block into the cache and return a handle pinning it. An entry
+  // already cached under the same key is replaced. The caller must call
+  // Release() when the handle is no longer needed.
+  //
+  // Returns nullptr if the shard's slot table is full of pinned entries; in
+  // that case "value" was not cached and still belongs to the caller.
+  Handle* Insert(uint64_t file_number, uint64_t offset, void* value,
+                 size_t charge, Deleter deleter);
+
+  // Return a pinned handle for the block, or nullptr on a miss.
+  Handle* Lookup(uint64_t file_number, uint64_t offset);
+
+  // Unpin an entry returned by Insert() or Lookup().
+  void Release(Handle* handle);
+
+  void* Value(Handle* handle) const;
+
+  // Drop the entry for the key. It is destroyed once its last pin goes away.
+  void Erase(uint64_t file_number, uint64_t offset);
+
+  size_t capacity() const { return capacity_; }
+
+  // Sum of the charges of all resident entries.
+  size_t TotalCharge() const;
+
+  int NumShards() const { return 1 << num_shard_bits_; }
+  size_t ShardUsage(int shard) const;
+
+  uint64_t hits() const;
+  uint64_t misses() const;
+
+ private:
+  class Shard;
+
+  static uint64_t HashKey(uint64_t file_number, uint64_t offset);
+
+  Shard* ShardFor(uint64_t hash) const;
+
+  const size_t capacity_;
+  const int num_shard_bits_;
+  Shard* shards_;
+};
+
+}  // namespace leveldb
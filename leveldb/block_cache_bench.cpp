@@ -0,0 +1,227 @@
+// YCSB-C style read benchmark for BlockCache.
+//
+// Every thread draws (file, offset) keys from a scrambled zipfian
+// distribution, looks the block up and inserts it on a miss. The CLOCK
+// BlockCache is compared with a sharded mutex + LRU list cache, which is how
+// leveldb's ShardedLRUCache behaves: every hit locks the shard twice, once to
+// relink the node and once to unpin it.
+//
+// Usage: block_cache_bench [--keys=N] [--ops=N] [--cache_mb=N]
+//                          [--block_size=N] [--theta=F] [--max_threads=N]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "block_cache.h"
+#include "utils/zipfian.h"
+
+namespace leveldb {
+namespace {
+
+uint64_t FLAGS_keys = 1000000;
+uint64_t FLAGS_ops = 2000000;  // per thread
+uint64_t FLAGS_cache_mb = 1024;
+uint64_t FLAGS_block_size = 4096;
+double FLAGS_theta = 0.99;
+int FLAGS_max_threads = 32;
+const int kNumShardBits = 4;
+
+// Blocks are not materialized: the benchmark is about the cache's own
+// synchronization, not about malloc.
+void DeleteNothing(uint64_t, uint64_t, void*) {}
+
+class MutexLRUCache {
+ public:
+  MutexLRUCache(size_t capacity) {
+    for (auto& s : shards_) {
+      s.capacity = capacity >> kNumShardBits;
+    }
+  }
+
+  struct Entry {
+    uint64_t key;
+    void* value;
+    size_t charge;
+    int refs;
+    bool in_cache;
+    std::list<Entry*>::iterator lru_pos;
+  };
+
+  Entry* Lookup(uint64_t key) {
+    Shard& s = ShardFor(key);
+    std::lock_guard<std::mutex> l(s.mu);
+    auto it = s.table.find(key);
+    if (it == s.table.end()) {
+      s.misses++;
+      return nullptr;
+    }
+    Entry* e = it->second;
+    e->refs++;
+    s.lru.splice(s.lru.begin(), s.lru, e->lru_pos);
+    s.hits++;
+    return e;
+  }
+
+  Entry* Insert(uint64_t key, void* value, size_t charge) {
+    Shard& s = ShardFor(key);
+    std::lock_guard<std::mutex> l(s.mu);
+    Entry* e = new Entry{key, value, charge, 2, true, {}};
+    auto it = s.table.find(key);
+    if (it != s.table.end()) {
+      Remove(s, it->second);
+    }
+    s.lru.push_front(e);
+    e->lru_pos = s.lru.begin();
+    s.table[key] = e;
+    s.usage += charge;
+    while (s.usage > s.capacity && s.lru.size() > 1) {
+      Remove(s, s.lru.back());
+    }
+    return e;
+  }
+
+  void Release(Entry* e) {
+    Shard& s = ShardFor(e->key);
+    std::lock_guard<std::mutex> l(s.mu);
+    Unref(e);
+  }
+
+  double HitRatio() {
+    uint64_t hits = 0, misses = 0;
+    for (auto& s : shards_) {
+      hits += s.hits;
+      misses += s.misses;
+    }
+    return static_cast<double>(hits) / (hits + misses);
+  }
+
+ private:
+  struct alignas(64) Shard {
+    std::mutex mu;
+    size_t capacity;
+    size_t usage = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    std::list<Entry*> lru;
+    std::unordered_map<uint64_t, Entry*> table;
+  };
+
+  Shard& ShardFor(uint64_t key) {
+    return shards_[(key * 0x9e3779b97f4a7c15ull) >> (64 - kNumShardBits)];
+  }
+
+  void Remove(Shard& s, Entry* e) {
+    s.lru.erase(e->lru_pos);
+    s.table.erase(e->key);
+    s.usage -= e->charge;
+    e->in_cache = false;
+    Unref(e);
+  }
+
+  void Unref(Entry* e) {
+    if (--e->refs == 0) delete e;
+  }
+
+  Shard shards_[1 << kNumShardBits];
+};
+
+// Keys are laid out like the blocks of 64 MB table files.
+inline void KeyOf(uint64_t k, uint64_t* file_number, uint64_t* offset) {
+  const uint64_t blocks_per_file = (64 << 20) / FLAGS_block_size;
+  *file_number = k / blocks_per_file;
+  *offset = (k % blocks_per_file) * FLAGS_block_size;
+}
+
+template <typename Body>
+double RunThreads(int n, Body body) {
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (int t = 0; t < n; t++) {
+    threads.emplace_back(body, t);
+  }
+  for (auto& t : threads) t.join();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+void BenchClock(int threads) {
+  BlockCache cache(FLAGS_cache_mb << 20, FLAGS_block_size, kNumShardBits);
+  double secs = RunThreads(threads, [&](int t) {
+    ZipfianGenerator gen(FLAGS_keys, FLAGS_theta, 301 + t);
+    for (uint64_t i = 0; i < FLAGS_ops; i++) {
+      uint64_t file, offset;
+      KeyOf(gen.Scrambled(), &file, &offset);
+      BlockCache::Handle* h = cache.Lookup(file, offset);
+      if (h == nullptr) {
+        h = cache.Insert(file, offset, nullptr, FLAGS_block_size,
+                         &DeleteNothing);
+      }
+      if (h != nullptr) cache.Release(h);
+    }
+  });
+  double total = static_cast<double>(cache.hits() + cache.misses());
+  std::printf("clock\t%d\t%.0f\t%.4f\n", threads, threads * FLAGS_ops / secs,
+              cache.hits() / total);
+}
+
+void BenchMutexLRU(int threads) {
+  MutexLRUCache cache(FLAGS_cache_mb << 20);
+  double secs = RunThreads(threads, [&](int t) {
+    ZipfianGenerator gen(FLAGS_keys, FLAGS_theta, 301 + t);
+    for (uint64_t i = 0; i < FLAGS_ops; i++) {
+      uint64_t file, offset;
+      KeyOf(gen.Scrambled(), &file, &offset);
+      uint64_t key = file * (64 << 20) + offset;
+      MutexLRUCache::Entry* e = cache.Lookup(key);
+      if (e == nullptr) {
+        e = cache.Insert(key, nullptr, FLAGS_block_size);
+      }
+      cache.Release(e);
+    }
+  });
+  std::printf("mutex_lru\t%d\t%.0f\t%.4f\n", threads,
+              threads * FLAGS_ops / secs, cache.HitRatio());
+}
+
+}  // namespace
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  using namespace leveldb;
+  for (int i = 1; i < argc; i++) {
+    double d;
+    unsigned long long n;
+    char junk;
+    if (sscanf(argv[i], "--keys=%llu%c", &n, &junk) == 1) {
+      FLAGS_keys = n;
+    } else if (sscanf(argv[i], "--ops=%llu%c", &n, &junk) == 1) {
+      FLAGS_ops = n;
+    } else if (sscanf(argv[i], "--cache_mb=%llu%c", &n, &junk) == 1) {
+      FLAGS_cache_mb = n;
+    } else if (sscanf(argv[i], "--block_size=%llu%c", &n, &junk) == 1) {
+      FLAGS_block_size = n;
+    } else if (sscanf(argv[i], "--theta=%lf%c", &d, &junk) == 1) {
+      FLAGS_theta = d;
+    } else if (sscanf(argv[i], "--max_threads=%llu%c", &n, &junk) == 1) {
+      FLAGS_max_threads = static_cast<int>(n);
+    } else {
+      std::fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+
+  std::printf("cache\tthreads\tops_per_sec\thit_ratio\n");
+  for (int threads = 1; threads <= FLAGS_max_threads; threads *= 2) {
+    BenchClock(threads);
+    BenchMutexLRU(threads);
+  }
+  return 0;
+}
@@ -0,0 +1,106 @@
+#include "builder.h"
+
+#include "blob_file.h"
+#include "dbformat.h"
+#include "env.h"
+#include "filename.h"
+#include "iterator.h"
+#include "options.h"
+#include "rate_limiter.h"
+#include "table_builder.h"
+#include "version_edit.h"
+
+namespace leveldb {
+
+Status BuildTable(const std::string& dbname, Env* env, const Options& options,
+                  Iterator* iter, FileMetaData* meta,
+                  BlobFileBuilder* blobs) {
+  Status s;
+  meta->file_size = 0;
+  iter->SeekToFirst();
+
+  std::string fname = TableFileName(dbname, meta->number);
+  if (iter->Valid()) {
+    WritableFile* file;
+    s = env->NewWritableFile(fname, &file);
+    if (!s.ok()) {
+      return s;
+    }
+    if (options.rate_limiter != nullptr) {
+      file = NewRateLimitedFile(file, options.rate_limiter, RateLimiter::kHigh);
+    }
+
+    TableBuilder* builder = new TableBuilder(options, file);
+    const bool separate = blobs != nullptr && options.min_blob_size > 0;
+    std::string blob_key, blob_index;
+    Slice key;
+    for (; s.ok() && iter->Valid(); iter->Next()) {
+      key = iter->key();
+      Slice value = iter->value();
+      ParsedInternalKey ikey;
+      if (separate && value.size() >= options.min_blob_size &&
+          ParseInternalKey(key, &ikey) && ikey.type == kTypeValue) {
+        BlobIndex index;
+        s = blobs->Add(ikey.user_key, value, &index);
+        if (!s.ok()) {
+          break;
+        }
+        blob_index.clear();
+        index.EncodeTo(&blob_index);
+        blob_key.clear();
+        AppendInternalKey(&blob_key, ParsedInternalKey(ikey.user_key,
+                                                       ikey.sequence,
+                                                       kTypeBlobIndex));
+        builder->Add(blob_key, blob_index);
+        key = blob_key;
+      } else {
+        builder->Add(key, value);
+      }
+      if (builder->NumEntries() == 1) {
+        meta->smallest.DecodeFrom(key);
+      }
+    }
+    if (!key.empty()) {
+      meta->largest.DecodeFrom(key);
+    }
+
+    // Finish and check for builder errors
+    if (s.ok() && blobs != nullptr) {
+      s = blobs->Finish();
+    }
+    if (s.ok()) {
+      s = builder->Finish();
+    } else {
+      builder->Abandon();
+    }
+    if (s.ok()) {
+      meta->file_size = builder->FileSize();
+      assert(meta->file_size > 0);
+    }
+    delete builder;
+
+    // Finish and check for file errors
+    if (s.ok()) {
+      s = file->Sync();
+    }
+    if (s.ok()) {
+      s = file->Close();
+    }
+    delete file;
+    file = nullptr;
+  }
+
+  // Check for input iterator errors
+  if (!iter->status().ok()) {
+    s = iter->status();
+  }
+
+  if (s.ok() && meta->file_size > 0) {
+    // Keep it
+  } else {
+    env->RemoveFile(fname);
+  }
+  return s;
+}
+
+}  // namespace leveldb
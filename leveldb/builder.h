@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+
+#include "status.h"
+
+namespace leveldb {
+
+struct Options;
+struct FileMetaData;
+
+class BlobFileBuilder;
+class Env;
+class Iterator;
+
+// Build a Table file from the contents of *iter.  The generated file
+// will be named according to meta->number.  On success, the rest of
+// *meta will be filled with metadata about the generated table.
+// If no data is present in *iter, meta->file_size will be set to
+// zero, and no Table file will be produced.
+//
+// If "blobs" is non-null, values of at least options.min_blob_size bytes
+// are appended to it and the table stores kTypeBlobIndex entries instead.
+Status BuildTable(const std::string& dbname, Env* env, const Options& options,
+                  Iterator* iter, FileMetaData* meta,
+                  BlobFileBuilder* blobs = nullptr);
+
+}  // namespace leveldb
@@ -0,0 +1,211 @@
+// Wall time of one large L0->L1 compaction against the number of
+// subcompactions.
+//
+// For every thread count the same layout is written from scratch:
+// --l0_files overlapping level-0 files of --file_mb each, with random keys
+// over the whole key space, on top of --l1_mb of level-1 files. The
+// whole level-0 range is compacted (VersionSet::CompactRange), which takes
+// in every file of both levels, and a CompactionJob runs it with
+// options.max_subcompactions set to the thread count.
+//
+// Usage: compaction_bench [--dir=PATH] [--l0_files=N] [--file_mb=N]
+//                         [--l1_mb=N] [--max_threads=N]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "compaction_job.h"
+#include "dbformat.h"
+#include "env.h"
+#include "filename.h"
+#include "options.h"
+#include "table_builder.h"
+#include "table_cache.h"
+#include "utils/random.h"
+#include "version_edit.h"
+#include "version_set.h"
+
+namespace leveldb {
+namespace {
+
+std::string FLAGS_dir = "/tmp/compaction_bench";
+int FLAGS_l0_files = 8;
+uint64_t FLAGS_file_mb = 16;
+uint64_t FLAGS_l1_mb = 128;
+int FLAGS_max_threads = 16;
+
+const int kValueSize = 100;
+
+double NowSeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+std::string UserKey(uint64_t n) {
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%016llx",
+                static_cast<unsigned long long>(n));
+  return buf;
+}
+
+void CleanDir(Env* env) {
+  std::vector<std::string> children;
+  env->CreateDir(FLAGS_dir);
+  env->GetChildren(FLAGS_dir, &children);
+  for (const std::string& child : children) {
+    uint64_t number;
+    FileType type;
+    if (ParseFileName(child, &number, &type)) {
+      env->RemoveFile(FLAGS_dir + "/" + child);
+    }
+  }
+}
+
+// Writes the sorted user keys "keys" as one table at "level".
+Status WriteTable(const Options& options, VersionSet* versions, int level,
+                  const std::vector<uint64_t>& keys, SequenceNumber* seq,
+                  VersionEdit* edit) {
+  const uint64_t number = versions->NewFileNumber();
+  WritableFile* file;
+  Status s =
+      options.env->NewWritableFile(TableFileName(FLAGS_dir, number), &file);
+  if (!s.ok()) return s;
+  TableBuilder builder(options, file);
+  std::string value(kValueSize, 'v');
+  InternalKey smallest, largest;
+  for (uint64_t k : keys) {
+    InternalKey ikey(UserKey(k), (*seq)++, kTypeValue);
+    if (builder.NumEntries() == 0) smallest = ikey;
+    largest = ikey;
+    builder.Add(ikey.Encode(), value);
+  }
+  s = builder.Finish();
+  if (s.ok()) s = file->Sync();
+  if (s.ok()) s = file->Close();
+  delete file;
+  if (s.ok()) {
+    edit->AddFile(level, number, builder.FileSize(), smallest, largest);
+  }
+  return s;
+}
+
+Status Load(const Options& options, VersionSet* versions, std::mutex* mu) {
+  VersionEdit edit;
+  edit.SetComparatorName(options.comparator->Name());
+  const uint64_t entry_bytes = kValueSize + 24;
+  const uint64_t keys_per_file = (FLAGS_file_mb << 20) / entry_bytes;
+  const uint64_t l1_keys = (FLAGS_l1_mb << 20) / entry_bytes;
+  const uint64_t l1_files = std::max<uint64_t>(1, FLAGS_l1_mb / 2);
+  Random rnd(301);
+  SequenceNumber seq = 1;
+  std::vector<uint64_t> keys;
+  Status s;
+
+  // Level 1: evenly spaced keys, 2MB files.
+  const uint64_t stride = (1ull << 48) / l1_keys;
+  for (uint64_t f = 0; s.ok() && f < l1_files; f++) {
+    keys.clear();
+    for (uint64_t i = f * l1_keys / l1_files; i < (f + 1) * l1_keys / l1_files;
+         i++) {
+      keys.push_back(i * stride);
+    }
+    s = WriteTable(options, versions, 1, keys, &seq, &edit);
+  }
+  // Level 0: random keys over the same space, newer than level 1.
+  for (int f = 0; s.ok() && f < FLAGS_l0_files; f++) {
+    keys.clear();
+    for (uint64_t i = 0; i < keys_per_file; i++) {
+      keys.push_back(((static_cast<uint64_t>(rnd.Next()) << 17) ^ rnd.Next()) &
+                     ((1ull << 48) - 1));
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    s = WriteTable(options, versions, 0, keys, &seq, &edit);
+  }
+  if (s.ok()) {
+    mu->lock();
+    versions->SetLastSequence(seq);
+    s = versions->LogAndApply(&edit, mu);
+    mu->unlock();
+  }
+  return s;
+}
+
+void Bench(int threads) {
+  Env* env = Env::Default();
+  CleanDir(env);
+  Options options;
+  InternalKeyComparator icmp(options.comparator);
+  Options table_options = options;
+  table_options.comparator = &icmp;
+  table_options.max_subcompactions = threads;
+  TableCache table_cache(FLAGS_dir, table_options, 1000);
+  VersionSet versions(FLAGS_dir, &options, &table_cache, &icmp);
+  std::mutex mu;
+
+  Status s = Load(table_options, &versions, &mu);
+  if (!s.ok()) {
+    std::fprintf(stderr, "%s\n", s.ToString().c_str());
+    std::exit(1);
+  }
+
+  mu.lock();
+  Compaction* c = versions.CompactRange(0, nullptr, nullptr);
+  if (c == nullptr) {
+    std::fprintf(stderr, "nothing to compact\n");
+    std::exit(1);
+  }
+  CompactionJob job(FLAGS_dir, table_options, &versions, &table_cache, c,
+                    versions.LastSequence());
+  const double start = NowSeconds();
+  s = job.Run(&mu);
+  const double secs = NowSeconds() - start;
+  mu.unlock();
+  if (!s.ok()) {
+    std::fprintf(stderr, "%s\n", s.ToString().c_str());
+    std::exit(1);
+  }
+
+  const CompactionJob::Stats& stats = job.stats();
+  std::printf("%d\t%d\t%.0f\t%d\t%.2f\t%.1f\n", threads,
+              stats.num_subcompactions, stats.bytes_read / 1048576.0,
+              stats.num_output_files, secs,
+              stats.bytes_read / 1048576.0 / secs);
+}
+
+}  // namespace
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  using namespace leveldb;
+  for (int i = 1; i < argc; i++) {
+    unsigned long long n;
+    char junk;
+    if (strncmp(argv[i], "--dir=", 6) == 0) {
+      FLAGS_dir = argv[i] + 6;
+    } else if (sscanf(argv[i], "--l0_files=%llu%c", &n, &junk) == 1) {
+      FLAGS_l0_files = static_cast<int>(n);
+    } else if (sscanf(argv[i], "--file_mb=%llu%c", &n, &junk) == 1) {
+      FLAGS_file_mb = n;
+    } else if (sscanf(argv[i], "--l1_mb=%llu%c", &n, &junk) == 1) {
+      FLAGS_l1_mb = n;
+    } else if (sscanf(argv[i], "--max_threads=%llu%c", &n, &junk) == 1) {
+      FLAGS_max_threads = static_cast<int>(n);
+    } else {
+      std::fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+
+  std::printf(
+      "threads\tsubcompactions\tinput_mb\toutput_files\tsecs\tmb_per_sec\n");
+  for (int threads = 1; threads <= FLAGS_max_threads; threads *= 2) {
+    Bench(threads);
+  }
+  return 0;
+}
@@ -0,0 +1,382 @@
+#include "compaction_job.h"
+
+#include <thread>
+
+#include "blob_file.h"
+#include "env.h"
+#include "filename.h"
+#include "iterator.h"
+#include "rate_limiter.h"
+#include "table_builder.h"
+#include "table_cache.h"
+
+namespace leveldb {
+
+CompactionJob::CompactionJob(const std::string& dbname,
+                             const Options& options, VersionSet* versions,
+                             TableCache* table_cache, Compaction* c,
+                             SequenceNumber smallest_snapshot)
+    : dbname_(dbname),
+      options_(options),
+      versions_(versions),
+      table_cache_(table_cache),
+      compact_(c),
+      smallest_snapshot_(smallest_snapshot),
+      mu_(nullptr),
+      installed_(false) {}
+
+CompactionJob::~CompactionJob() {
+  for (Subcompaction& sub : subcompactions_) {
+    if (sub.builder != nullptr) {
+      // May happen if we get a shutdown call in the middle of compaction
+      sub.builder->Abandon();
+      delete sub.builder;
+    }
+    delete sub.outfile;
+    if (sub.blob_builder != nullptr) {
+      const uint64_t number = sub.blob_builder->file_number();
+      delete sub.blob_builder;
+      delete sub.blob_file;
+      options_.env->RemoveFile(BlobFileName(dbname_, number));
+    }
+    if (!installed_) {
+      for (const Output& out : sub.outputs) {
+        options_.env->RemoveFile(TableFileName(dbname_, out.number));
+      }
+      for (const BlobFileMetaData& blob : sub.blob_outputs) {
+        options_.env->RemoveFile(BlobFileName(dbname_, blob.number));
+      }
+    }
+  }
+  delete compact_;
+}
+
+Status CompactionJob::Run(std::mutex* mu) {
+  mu_ = mu;
+  Compaction* c = compact_;
+  Status s;
+  if (c->IsTrivialMove()) {
+    // Move file to the output level
+    FileMetaData* f = c->input(0, 0);
+    c->edit()->RemoveFile(c->level(), f->number);
+    c->edit()->AddFile(c->output_level(), f->number, f->file_size, f->smallest,
+                       f->largest);
+    s = versions_->LogAndApply(c->edit(), mu);
+  } else {
+    mu->unlock();
+    std::vector<std::string> boundaries;
+    c->GetSplitPoints(options_.max_subcompactions, &boundaries);
+    subcompactions_.resize(boundaries.size() + 1);
+    for (size_t i = 0; i < boundaries.size(); i++) {
+      subcompactions_[i].has_end = true;
+      subcompactions_[i].end = boundaries[i];
+      subcompactions_[i + 1].has_start = true;
+      subcompactions_[i + 1].start = boundaries[i];
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < subcompactions_.size(); i++) {
+      threads.emplace_back(&CompactionJob::ProcessRange, this,
+                           &subcompactions_[i]);
+    }
+    ProcessRange(&subcompactions_[0]);
+    for (std::thread& t : threads) {
+      t.join();
+    }
+    mu->lock();
+
+    for (const Subcompaction& sub : subcompactions_) {
+      if (s.ok()) s = sub.status;
+      stats_.bytes_written += sub.stats.bytes_written;
+      stats_.num_output_files += sub.stats.num_output_files;
+    }
+    stats_.bytes_read = c->TotalInputBytes();
+    stats_.num_subcompactions = subcompactions_.size();
+    if (s.ok()) {
+      s = Install();
+    }
+  }
+  installed_ = s.ok();
+  c->ReleaseInputs();
+  return s;
+}
+
+Status CompactionJob::OpenOutput(Subcompaction* sub) {
+  assert(sub->builder == nullptr);
+  Output out;
+  {
+    std::lock_guard<std::mutex> l(*mu_);
+    out.number = versions_->NewFileNumber();
+  }
+  out.file_size = 0;
+  out.smallest.Clear();
+  out.largest.Clear();
+  sub->outputs.push_back(out);
+
+  std::string fname = TableFileName(dbname_, out.number);
+  Status s = options_.env->NewWritableFile(fname, &sub->outfile);
+  if (s.ok() && options_.rate_limiter != nullptr) {
+    sub->outfile = NewRateLimitedFile(sub->outfile, options_.rate_limiter,
+                                      RateLimiter::kLow);
+  }
+  if (s.ok()) {
+    sub->builder = new TableBuilder(options_, sub->outfile);
+  }
+  return s;
+}
+
+Status CompactionJob::FinishOutput(Subcompaction* sub, Iterator* input) {
+  assert(sub->outfile != nullptr);
+  assert(sub->builder != nullptr);
+
+  const uint64_t output_number = sub->outputs.back().number;
+  assert(output_number != 0);
+
+  // Check for iterator errors
+  Status s = input->status();
+  const uint64_t current_entries = sub->builder->NumEntries();
+  if (s.ok()) {
+    s = sub->builder->Finish();
+  } else {
+    sub->builder->Abandon();
+  }
+  const uint64_t current_bytes = sub->builder->FileSize();
+  sub->outputs.back().file_size = current_bytes;
+  sub->stats.bytes_written += current_bytes;
+  delete sub->builder;
+  sub->builder = nullptr;
+
+  // Finish and check for file errors
+  if (s.ok()) {
+    s = sub->outfile->Sync();
+  }
+  if (s.ok()) {
+    s = sub->outfile->Close();
+  }
+  delete sub->outfile;
+  sub->outfile = nullptr;
+
+  if (s.ok() && current_entries > 0) {
+    // Verify that the table is usable
+    Iterator* iter =
+        table_cache_->NewIterator(ReadOptions(), output_number, current_bytes);
+    s = iter->status();
+    delete iter;
+  }
+  sub->stats.num_output_files++;
+  return s;
+}
+
+Status CompactionJob::SeparateValue(Subcompaction* sub,
+                                    const ParsedInternalKey& ikey,
+                                    const Slice& value, std::string* key,
+                                    std::string* blob_index) {
+  Status s;
+  if (sub->blob_builder == nullptr) {
+    uint64_t number;
+    {
+      std::lock_guard<std::mutex> l(*mu_);
+      number = versions_->NewFileNumber();
+    }
+    s = options_.env->NewWritableFile(BlobFileName(dbname_, number),
+                                      &sub->blob_file);
+    if (!s.ok()) {
+      return s;
+    }
+    if (options_.rate_limiter != nullptr) {
+      sub->blob_file = NewRateLimitedFile(sub->blob_file,
+                                          options_.rate_limiter,
+                                          RateLimiter::kLow);
+    }
+    sub->blob_builder = new BlobFileBuilder(sub->blob_file, number);
+  }
+
+  BlobIndex index;
+  s = sub->blob_builder->Add(ikey.user_key, value, &index);
+  if (s.ok()) {
+    blob_index->clear();
+    index.EncodeTo(blob_index);
+    key->clear();
+    AppendInternalKey(key, ParsedInternalKey(ikey.user_key, ikey.sequence,
+                                             kTypeBlobIndex));
+  }
+  return s;
+}
+
+Status CompactionJob::FinishBlobOutput(Subcompaction* sub) {
+  BlobFileBuilder* builder = sub->blob_builder;
+  Status s = builder->Finish();
+  if (s.ok()) {
+    s = sub->blob_file->Sync();
+  }
+  if (s.ok()) {
+    s = sub->blob_file->Close();
+  }
+  if (s.ok()) {
+    BlobFileMetaData blob;
+    blob.number = builder->file_number();
+    blob.total_count = builder->NumEntries();
+    blob.total_bytes = builder->ValueBytes();
+    sub->blob_outputs.push_back(blob);
+    sub->stats.bytes_written += builder->FileSize();
+    delete builder;
+    delete sub->blob_file;
+    sub->blob_builder = nullptr;
+    sub->blob_file = nullptr;
+  }
+  return s;
+}
+
+void CompactionJob::ProcessRange(Subcompaction* sub) {
+  Compaction* c = compact_;
+  Iterator* input;
+  {
+    std::lock_guard<std::mutex> l(*mu_);
+    input = versions_->MakeInputIterator(c);
+  }
+
+  const Comparator* ucmp = versions_->icmp().user_comparator();
+  if (sub->has_start) {
+    InternalKey start(sub->start, kMaxSequenceNumber, kValueTypeForSeek);
+    input->Seek(start.Encode());
+    // The start key itself belongs to the previous range.
+    while (input->Valid() &&
+           ucmp->Compare(ExtractUserKey(input->key()), sub->start) <= 0) {
+      input->Next();
+    }
+  } else {
+    input->SeekToFirst();
+  }
+
+  Status status;
+  ParsedInternalKey ikey;
+  std::string blob_key, blob_index;
+  std::string current_user_key;
+  bool has_current_user_key = false;
+  SequenceNumber last_sequence_for_key = kMaxSequenceNumber;
+  while (input->Valid()) {
+    Slice key = input->key();
+    if (sub->has_end &&
+        ucmp->Compare(ExtractUserKey(key), Slice(sub->end)) > 0) {
+      break;
+    }
+    if (c->ShouldStopBefore(key, &sub->cursor) && sub->builder != nullptr) {
+      status = FinishOutput(sub, input);
+      if (!status.ok()) {
+        break;
+      }
+    }
+
+    // Handle key/value, add to state, etc.
+    bool drop = false;
+    const bool parsed = ParseInternalKey(key, &ikey);
+    if (!parsed) {
+      // Do not hide error keys
+      current_user_key.clear();
+      has_current_user_key = false;
+      last_sequence_for_key = kMaxSequenceNumber;
+    } else {
+      if (!has_current_user_key ||
+          ucmp->Compare(ikey.user_key, Slice(current_user_key)) != 0) {
+        // First occurrence of this user key
+        current_user_key.assign(ikey.user_key.data(), ikey.user_key.size());
+        has_current_user_key = true;
+        last_sequence_for_key = kMaxSequenceNumber;
+      }
+
+      if (last_sequence_for_key <= smallest_snapshot_) {
+        // Hidden by an newer entry for same user key
+        drop = true;  // (A)
+      } else if (ikey.type == kTypeDeletion &&
+                 ikey.sequence <= smallest_snapshot_ &&
+                 c->IsBaseLevelForKey(ikey.user_key, &sub->cursor)) {
+        // For this user key:
+        // (1) there is no data in higher levels
+        // (2) data in lower levels will have larger sequence numbers
+        // (3) data in layers that are being compacted here and have
+        //     smaller sequence numbers will be dropped in the next
+        //     few iterations of this loop (by rule (A) above).
+        // Therefore this deletion marker is obsolete and can be dropped.
+        drop = true;
+      }
+
+      last_sequence_for_key = ikey.sequence;
+    }
+
+    if (drop) {
+      if (ikey.type == kTypeBlobIndex) {
+        // The blob record stays in its file until blob GC collects it.
+        status = sub->blob_garbage.Add(input->value());
+        if (!status.ok()) {
+          break;
+        }
+      }
+    } else {
+      Slice value = input->value();
+      if (parsed && ikey.type == kTypeValue && options_.min_blob_size > 0 &&
+          value.size() >= options_.min_blob_size) {
+        status = SeparateValue(sub, ikey, value, &blob_key, &blob_index);
+        if (!status.ok()) {
+          break;
+        }
+        key = blob_key;
+        value = blob_index;
+      }
+
+      // Open output file if necessary
+      if (sub->builder == nullptr) {
+        status = OpenOutput(sub);
+        if (!status.ok()) {
+          break;
+        }
+      }
+      if (sub->builder->NumEntries() == 0) {
+        sub->outputs.back().smallest.DecodeFrom(key);
+      }
+      sub->outputs.back().largest.DecodeFrom(key);
+      sub->builder->Add(key, value);
+
+      // Close output file if it is big enough
+      if (sub->builder->FileSize() >= c->MaxOutputFileSize()) {
+        status = FinishOutput(sub, input);
+        if (!status.ok()) {
+          break;
+        }
+      }
+    }
+
+    input->Next();
+  }
+
+  if (status.ok() && sub->builder != nullptr) {
+    status = FinishOutput(sub, input);
+  }
+  if (status.ok() && sub->blob_builder != nullptr) {
+    status = FinishBlobOutput(sub);
+  }
+  if (status.ok()) {
+    status = input->status();
+  }
+  delete input;
+  sub->status = status;
+}
+
+Status CompactionJob::Install() {
+  Compaction* c = compact_;
+  // Add compaction outputs
+  c->AddInputDeletions(c->edit());
+  const int output_level = c->output_level();
+  for (const Subcompaction& sub : subcompactions_) {
+    for (const Output& out : sub.outputs) {
+      c->edit()->AddFile(output_level, out.number, out.file_size, out.smallest,
+                         out.largest);
+    }
+    for (const BlobFileMetaData& blob : sub.blob_outputs) {
+      c->edit()->AddBlobFile(blob.number, blob.total_count, blob.total_bytes);
+    }
+    sub.blob_garbage.AppendTo(c->edit());
+  }
+  return versions_->LogAndApply(c->edit(), mu_);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "blob_gc.h"
+#include "dbformat.h"
+#include "options.h"
+#include "status.h"
+#include "version_edit.h"
+#include "version_set.h"
+
+namespace leveldb {
+
+class BlobFileBuilder;
+class Iterator;
+class TableBuilder;
+class TableCache;
+class WritableFile;
+
+/**
+ * @brief CompactionJob
+ *
+ * @details Runs one Compaction picked by VersionSet::PickCompaction():
+ * merges the input files, drops entries that are shadowed or deleted and
+ * invisible to every snapshot, writes the output tables and installs the
+ * result with one VersionEdit. A trivial move only rewrites the manifest.
+ *
+ * With options.max_subcompactions > 1 the key range of the inputs is cut
+ * at input file boundaries (Compaction::GetSplitPoints) into ranges of
+ * about equal size. Each range is merged by its own thread into its own
+ * output files; the outputs of all ranges are still committed together.
+ *
+ * With options.min_blob_size set, inline values of at least that size are
+ * moved into a blob file of the range, like a flush does; dropped
+ * kTypeBlobIndex entries are recorded as blob garbage in the same edit. The input files are left on disk: once no live Version references
+ * them (VersionSet::AddLiveFiles) the caller removes them and evicts them
+ * from the table cache.
+ */
+class CompactionJob {
+ public:
+  struct Stats {
+    int64_t bytes_read = 0;
+    int64_t bytes_written = 0;
+    int num_output_files = 0;
+    int num_subcompactions = 0;
+  };
+
+  // Takes ownership of "c". Entries with a sequence number at or below
+  // "smallest_snapshot" are only kept when they are the newest of their key.
+  CompactionJob(const std::string& dbname, const Options& options,
+                VersionSet* versions, TableCache* table_cache, Compaction* c,
+                SequenceNumber smallest_snapshot);
+
+  CompactionJob(const CompactionJob&) = delete;
+  CompactionJob& operator=(const CompactionJob&) = delete;
+
+  // Removes the output files unless Run() installed them.
+  ~CompactionJob();
+
+  // Releases the input Version on return, so the job may be destroyed
+  // without the lock afterwards.
+  // REQUIRES: *mu is held; it is released while tables are read and
+  // written, and held again on return.
+  Status Run(std::mutex* mu);
+
+  const Stats& stats() const { return stats_; }
+
+ private:
+  struct Output {
+    uint64_t number;
+    uint64_t file_size;
+    InternalKey smallest, largest;
+  };
+
+  // One key range of the compaction: user keys in (start, end], where a
+  // missing bound is unbounded.
+  struct Subcompaction {
+    Subcompaction()
+        : has_start(false), has_end(false), outfile(nullptr),
+          builder(nullptr), blob_file(nullptr), blob_builder(nullptr) {}
+
+    bool has_start;
+    bool has_end;
+    std::string start;
+    std::string end;
+
+    Compaction::Cursor cursor;
+    std::vector<Output> outputs;
+    std::vector<BlobFileMetaData> blob_outputs;
+    BlobDiscardStats blob_garbage;
+    Stats stats;
+    Status status;
+
+    // State kept for the output being generated
+    WritableFile* outfile;
+    TableBuilder* builder;
+
+    // Blob file of the values separated so far, opened on the first one
+    WritableFile* blob_file;
+    BlobFileBuilder* blob_builder;
+  };
+
+  // REQUIRES: *mu_ not held.
+  void ProcessRange(Subcompaction* sub);
+  Status OpenOutput(Subcompaction* sub);
+  Status FinishOutput(Subcompaction* sub, Iterator* input);
+  // Append "value" to the blob file of "sub" and store the kTypeBlobIndex
+  // entry that replaces it in *key and *blob_index.
+  Status SeparateValue(Subcompaction* sub, const ParsedInternalKey& ikey,
+                       const Slice& value, std::string* key,
+                       std::string* blob_index);
+  Status FinishBlobOutput(Subcompaction* sub);
+  // REQUIRES: *mu_ held.
+  Status Install();
+
+  const std::string dbname_;
+  const Options options_;
+  VersionSet* const versions_;
+  TableCache* const table_cache_;
+  Compaction* const compact_;
+  const SequenceNumber smallest_snapshot_;
+  std::mutex* mu_;
+
+  std::vector<Subcompaction> subcompactions_;
+  bool installed_;
+
+  Stats stats_;
+};
+
+}  // namespace leveldb
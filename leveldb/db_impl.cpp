@@ -0,0 +1,1006 @@
+#include "db_impl.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "blob_file.h"
+#include "blob_gc.h"
+#include "builder.h"
+#include "compaction_job.h"
+#include "env.h"
+#include "filename.h"
+#include "io_backend.h"
+#include "iterator.h"
+#include "log_parallel_reader.h"
+#include "memtable.h"
+#include "rate_limiter.h"
+#include "table_cache.h"
+#include "thread_pool.h"
+#include "version_set.h"
+#include "write_batch.h"
+#include "write_batch_internal.h"
+
+namespace leveldb {
+
+static const int kNumNonTableCacheFiles = 10;
+
+// Information kept for every waiting writer
+struct DBImpl::Writer {
+  explicit Writer(WriteBatch* b, bool s) : batch(b), sync(s), done(false) {}
+
+  Status status;
+  WriteBatch* batch;
+  bool sync;
+  bool done;
+  std::condition_variable cv;
+};
+
+static int TableCacheSize(const Options& sanitized_options) {
+  // Reserve ten files or so for other uses and give the rest to TableCache.
+  return std::max(sanitized_options.max_open_files - kNumNonTableCacheFiles,
+                  64);
+}
+
+// Room for the readahead of every subcompaction. A compaction has more
+// inputs than that (each level-0 file is one); their reads then wait for
+// a free entry.
+static unsigned CompactionQueueDepth(const Options& options) {
+  return static_cast<unsigned>(options.compaction_readahead) *
+         std::max(options.max_subcompactions, 1);
+}
+
+DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
+    : env_(raw_options.env),
+      internal_comparator_(raw_options.comparator),
+      options_(raw_options),
+      table_options_(raw_options),
+      dbname_(dbname),
+      table_cache_(new TableCache(dbname_, table_options_,
+                                  TableCacheSize(raw_options))),
+      owned_pool_(raw_options.background_pool == nullptr
+                      ? new ThreadPool(1, 1)
+                      : nullptr),
+      pool_(raw_options.background_pool != nullptr
+                ? raw_options.background_pool
+                : owned_pool_.get()),
+      owned_io_backend_(raw_options.io_backend == nullptr &&
+                                raw_options.compaction_readahead > 0
+                            ? NewDefaultIOBackend(CompactionQueueDepth(
+                                  raw_options))
+                            : nullptr),
+      io_backend_(raw_options.compaction_readahead <= 0 ? nullptr
+                  : raw_options.io_backend != nullptr
+                      ? raw_options.io_backend
+                      : owned_io_backend_.get()),
+      shutting_down_(false),
+      mem_(nullptr),
+      imm_(nullptr),
+      logfile_(nullptr),
+      logfile_number_(0),
+      log_(nullptr),
+      tmp_batch_(new WriteBatch),
+      write_controller_(raw_options),
+      versions_(new VersionSet(dbname_, &options_, table_cache_,
+                               &internal_comparator_, io_backend_)),
+      bg_flush_scheduled_(false),
+      bg_compaction_scheduled_(false),
+      blob_gc_queued_(false) {
+  table_options_.comparator = &internal_comparator_;
+}
+
+DBImpl::~DBImpl() {
+  // Wait for background work to finish.  Jobs still queued in the pool
+  // return as soon as they run.
+  {
+    std::unique_lock<std::mutex> l(mutex_);
+    shutting_down_ = true;
+    background_work_finished_signal_.wait(l, [this] {
+      return !bg_flush_scheduled_ && !bg_compaction_scheduled_;
+    });
+  }
+  owned_pool_.reset();
+
+  delete versions_;
+  if (mem_ != nullptr) mem_->Unref();
+  if (imm_ != nullptr) imm_->Unref();
+  delete tmp_batch_;
+  delete log_;
+  delete logfile_;
+  delete table_cache_;
+}
+
+void DBImpl::RemoveObsoleteFiles() {
+  if (!bg_error_.ok()) {
+    // After a background error, we don't know whether a new version may
+    // or may not have been committed, so we cannot safely garbage collect.
+    return;
+  }
+
+  // Make a set of all of the live files.  Outputs of running jobs are not
+  // in any version yet; they are numbered from the smallest pending output
+  // on.
+  std::set<uint64_t> live;
+  versions_->AddLiveFiles(&live);
+  const uint64_t min_pending_output = pending_outputs_.empty()
+                                          ? ~uint64_t{0}
+                                          : *pending_outputs_.begin();
+
+  std::vector<std::string> filenames;
+  env_->GetChildren(dbname_, &filenames);  // Ignoring errors on purpose
+  uint64_t number;
+  FileType type;
+  std::vector<std::string> files_to_delete;
+  for (std::string& filename : filenames) {
+    if (ParseFileName(filename, &number, &type)) {
+      bool keep = true;
+      switch (type) {
+        case kLogFile:
+          keep = ((number >= versions_->LogNumber()) ||
+                  (number == versions_->PrevLogNumber()));
+          break;
+        case kDescriptorFile:
+          // Keep my manifest file, and any newer incarnations'
+          // (in case there is a race that allows other incarnations)
+          keep = (number >= versions_->ManifestFileNumber());
+          break;
+        case kTableFile:
+        case kBlobFile:
+        case kTempFile:
+          keep = (live.find(number) != live.end() ||
+                  number >= min_pending_output);
+          break;
+        case kCurrentFile:
+        case kDBLockFile:
+        case kInfoLogFile:
+          keep = true;
+          break;
+      }
+
+      if (!keep) {
+        files_to_delete.push_back(std::move(filename));
+        if (type == kTableFile || type == kBlobFile) {
+          table_cache_->Evict(number);
+        }
+      }
+    }
+  }
+
+  // While deleting all files unblock other threads. All files being deleted
+  // have unique names which will not collide with newly created files and
+  // are therefore safe to delete while allowing other threads to proceed.
+  mutex_.unlock();
+  for (const std::string& filename : files_to_delete) {
+    env_->RemoveFile(dbname_ + "/" + filename);
+  }
+  mutex_.lock();
+}
+
+Status DBImpl::Recover(VersionEdit* edit) {
+  // Ignore error from CreateDir since the creation of the DB is
+  // committed only when the descriptor is created, and this directory
+  // may already exist from a previous failed creation attempt.
+  env_->CreateDir(dbname_);
+
+  Status s;
+  if (!env_->FileExists(CurrentFileName(dbname_))) {
+    if (!options_.create_if_missing) {
+      return Status::InvalidArgument(
+          dbname_, "does not exist (create_if_missing is false)");
+    }
+    // The first LogAndApply() writes the initial descriptor.
+    edit->SetComparatorName(internal_comparator_.user_comparator()->Name());
+  } else {
+    s = versions_->Recover();
+    if (!s.ok()) {
+      return s;
+    }
+  }
+
+  // Recover from all newer log files than the ones named in the
+  // descriptor (new log files may have been added by the previous
+  // incarnation without registering them in the descriptor).
+  //
+  // Note that PrevLogNumber() is no longer used, but we pay
+  // attention to it in case we are recovering a database
+  // produced by an older version of leveldb.
+  const uint64_t min_log = versions_->LogNumber();
+  const uint64_t prev_log = versions_->PrevLogNumber();
+  std::vector<std::string> filenames;
+  s = env_->GetChildren(dbname_, &filenames);
+  if (!s.ok()) {
+    return s;
+  }
+  std::set<uint64_t> expected;
+  versions_->AddLiveFiles(&expected);
+  uint64_t number;
+  FileType type;
+  std::vector<uint64_t> logs;
+  for (const std::string& filename : filenames) {
+    if (ParseFileName(filename, &number, &type)) {
+      expected.erase(number);
+      if (type == kLogFile && ((number >= min_log) || (number == prev_log)))
+        logs.push_back(number);
+    }
+  }
+  if (!expected.empty()) {
+    char buf[50];
+    std::snprintf(buf, sizeof(buf), "%d missing files; e.g.",
+                  static_cast<int>(expected.size()));
+    return Status::Corruption(buf, TableFileName(dbname_, *(expected.begin())));
+  }
+
+  // Recover in the order in which the logs were generated
+  std::sort(logs.begin(), logs.end());
+  SequenceNumber max_sequence(0);
+  for (size_t i = 0; i < logs.size(); i++) {
+    s = RecoverLogFile(logs[i], edit, &max_sequence);
+    if (!s.ok()) {
+      return s;
+    }
+
+    // The previous incarnation may not have written any MANIFEST
+    // records after allocating this log number.  So we manually
+    // update the file number allocation counter in VersionSet.
+    versions_->MarkFileNumberUsed(logs[i]);
+  }
+
+  if (versions_->LastSequence() < max_sequence) {
+    versions_->SetLastSequence(max_sequence);
+  }
+
+  return Status::OK();
+}
+
+Status DBImpl::RecoverLogFile(uint64_t log_number, VersionEdit* edit,
+                              SequenceNumber* max_sequence) {
+  struct LogReporter : public log::Reader::Reporter {
+    Status* status;
+    void Corruption(size_t bytes, const Status& s) override {
+      if (this->status->ok()) *this->status = s;
+    }
+  };
+
+  // Open the log file
+  std::string fname = LogFileName(dbname_, log_number);
+  SequentialFile* file;
+  Status status = env_->NewSequentialFile(fname, &file);
+  if (!status.ok()) {
+    return status;
+  }
+
+  // Read all the records and add to a memtable
+  MemTable* mem = nullptr;
+  {
+    // Create the log reader.  Records are always checksummed so that
+    // corruptions cause entire commits to be skipped instead of
+    // propagating bad information (like overly large sequence numbers).
+    // The checks run on recovery_threads threads while this thread
+    // applies the batches in log order.
+    LogReporter reporter;
+    reporter.status = &status;
+    log::ParallelReader reader(file, &reporter, options_.recovery_threads);
+
+    std::string scratch;
+    Slice record;
+    WriteBatch batch;
+    while (reader.ReadRecord(&record, &scratch) && status.ok()) {
+      if (record.size() < 12) {
+        reporter.Corruption(record.size(),
+                            Status::Corruption("log record too small"));
+        continue;
+      }
+      WriteBatchInternal::SetContents(&batch, record);
+
+      if (mem == nullptr) {
+        mem = new MemTable(internal_comparator_);
+        mem->Ref();
+      }
+      status = WriteBatchInternal::InsertInto(&batch, mem);
+      if (!status.ok()) {
+        break;
+      }
+      const SequenceNumber last_seq = WriteBatchInternal::Sequence(&batch) +
+                                      WriteBatchInternal::Count(&batch) - 1;
+      if (last_seq > *max_sequence) {
+        *max_sequence = last_seq;
+      }
+
+      if (mem->ApproximateMemoryUsage() > options_.write_buffer_size) {
+        status = WriteLevel0Table(mem, edit, false);
+        mem->Unref();
+        mem = nullptr;
+        if (!status.ok()) {
+          // Reflect errors immediately so that conditions like full
+          // file-systems cause the DB::Open() to fail.
+          break;
+        }
+      }
+    }
+  }  // The reader stops its threads before the file goes away.
+
+  delete file;
+
+  if (mem != nullptr) {
+    // mem did not get reused; compact it.
+    if (status.ok()) {
+      status = WriteLevel0Table(mem, edit, false);
+    }
+    mem->Unref();
+  }
+
+  return status;
+}
+
+Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
+                                bool push_down) {
+  FileMetaData meta;
+  meta.number = versions_->NewFileNumber();
+  // Large values go to a blob file of their own.
+  const uint64_t blob_number =
+      options_.min_blob_size > 0 ? versions_->NewFileNumber() : 0;
+  Iterator* iter = mem->NewIterator();
+
+  Status s;
+  WritableFile* blob_file = nullptr;
+  std::unique_ptr<BlobFileBuilder> blobs;
+  {
+    mutex_.unlock();
+    if (blob_number != 0) {
+      s = env_->NewWritableFile(BlobFileName(dbname_, blob_number),
+                                &blob_file);
+      if (s.ok()) {
+        if (options_.rate_limiter != nullptr) {
+          blob_file = NewRateLimitedFile(blob_file, options_.rate_limiter,
+                                         RateLimiter::kHigh);
+        }
+        blobs.reset(new BlobFileBuilder(blob_file, blob_number));
+      }
+    }
+    if (s.ok()) {
+      s = BuildTable(dbname_, env_, table_options_, iter, &meta, blobs.get());
+    }
+    if (blobs != nullptr) {
+      if (s.ok() && blobs->NumEntries() > 0) {
+        s = blob_file->Sync();
+        if (s.ok()) {
+          s = blob_file->Close();
+        }
+      }
+      delete blob_file;
+      if (!s.ok() || blobs->NumEntries() == 0) {
+        env_->RemoveFile(BlobFileName(dbname_, blob_number));
+      }
+    }
+    mutex_.lock();
+  }
+  delete iter;
+
+  // Note that if file_size is zero, the file has been deleted and
+  // should not be added to the manifest.
+  int level = 0;
+  if (s.ok() && meta.file_size > 0) {
+    const Slice min_user_key = meta.smallest.user_key();
+    const Slice max_user_key = meta.largest.user_key();
+    // A compaction that is running may write tables into the range of
+    // this one at any level but 0.  One that finished meanwhile changed
+    // the levels, hence the current version instead of the one the flush
+    // started from.
+    if (push_down && !bg_compaction_scheduled_) {
+      level = versions_->current()->PickLevelForMemTableOutput(min_user_key,
+                                                               max_user_key);
+    }
+    edit->AddFile(level, meta.number, meta.file_size, meta.smallest,
+                  meta.largest);
+    if (blobs != nullptr && blobs->NumEntries() > 0) {
+      edit->AddBlobFile(blob_number, blobs->NumEntries(),
+                        blobs->ValueBytes());
+    }
+  }
+  return s;
+}
+
+void DBImpl::CompactMemTable() {
+  assert(imm_ != nullptr);
+
+  // Save the contents of the memtable as a new Table.  No compaction
+  // starts while imm_ is set, so the level picked for the table stays
+  // valid until the edit is applied.
+  VersionEdit edit;
+  const auto pending = pending_outputs_.insert(versions_->NextFileNumber());
+  Status s = WriteLevel0Table(imm_, &edit, true);
+
+  // Replace immutable memtable with the generated Table
+  if (s.ok()) {
+    edit.SetPrevLogNumber(0);
+    edit.SetLogNumber(logfile_number_);  // Earlier logs no longer needed
+    s = versions_->LogAndApply(&edit, &mutex_);
+  }
+  pending_outputs_.erase(pending);
+
+  if (s.ok()) {
+    // Commit to the new state
+    imm_->Unref();
+    imm_ = nullptr;
+    RemoveObsoleteFiles();
+  } else {
+    RecordBackgroundError(s);
+  }
+}
+
+void DBImpl::RecordBackgroundError(const Status& s) {
+  if (bg_error_.ok()) {
+    bg_error_ = s;
+    background_work_finished_signal_.notify_all();
+  }
+}
+
+void DBImpl::UpdateWriteController() {
+  write_controller_.Update(versions_->NumLevelFiles(0),
+                           versions_->EstimatedPendingCompactionBytes());
+}
+
+void DBImpl::MaybeScheduleCompaction() {
+  if (shutting_down_ || !bg_error_.ok()) {
+    return;
+  }
+  if (imm_ != nullptr && !bg_flush_scheduled_) {
+    bg_flush_scheduled_ = true;
+    pool_->Schedule(ThreadPool::kHigh, [this] { BackgroundFlushCall(); });
+  }
+  // Compactions give way to flushes: writers may be waiting for imm_ to
+  // go, and a flush that does not overlap a running compaction may place
+  // its table below level 0.
+  if (imm_ == nullptr && !bg_compaction_scheduled_ &&
+      (versions_->NeedsCompaction() || !BlobFilesToCollect().empty())) {
+    bg_compaction_scheduled_ = true;
+    pool_->Schedule(ThreadPool::kLow, [this] { BackgroundCompactionCall(); });
+  }
+}
+
+void DBImpl::BackgroundFlushCall() {
+  std::lock_guard<std::mutex> l(mutex_);
+  assert(bg_flush_scheduled_);
+  if (!shutting_down_ && bg_error_.ok() && imm_ != nullptr) {
+    CompactMemTable();
+    UpdateWriteController();
+  }
+  bg_flush_scheduled_ = false;
+  MaybeScheduleCompaction();
+  background_work_finished_signal_.notify_all();
+}
+
+std::vector<uint64_t> DBImpl::BlobFilesToCollect() const {
+  // Files without garbage are never worth collecting, whatever the ratio.
+  std::vector<BlobFileMetaData> files;
+  for (const auto& kvp : versions_->current()->blob_files()) {
+    if (kvp.second.garbage_count > 0) {
+      files.push_back(kvp.second);
+    }
+  }
+  return PickBlobFilesForGC(files, options_.blob_gc_garbage_ratio);
+}
+
+void DBImpl::BackgroundCompactionCall() {
+  std::unique_lock<std::mutex> l(mutex_);
+  assert(bg_compaction_scheduled_);
+  // A flush that became pending while this job was queued goes first;
+  // it schedules the compaction again when it is done.
+  if (!shutting_down_ && bg_error_.ok() && imm_ == nullptr) {
+    BackgroundCompaction(&l);
+    UpdateWriteController();
+  }
+  bg_compaction_scheduled_ = false;
+  // The compaction may have produced too many files in a level, so
+  // reschedule another compaction if needed.
+  MaybeScheduleCompaction();
+  background_work_finished_signal_.notify_all();
+}
+
+void DBImpl::BackgroundCompaction(std::unique_lock<std::mutex>* lock) {
+  Compaction* c = versions_->PickCompaction();
+  std::vector<uint64_t> blob_files;
+  if (c == nullptr) {
+    blob_files = BlobFilesToCollect();
+    if (blob_files.empty()) {
+      // Nothing to do
+      return;
+    }
+  }
+  const auto pending = pending_outputs_.insert(versions_->NextFileNumber());
+  Status status;
+  if (c != nullptr) {
+    // Without snapshots every entry older than the last sequence is only
+    // visible through its newest version.
+    CompactionJob job(dbname_, table_options_, versions_, table_cache_, c,
+                      versions_->LastSequence());
+    status = job.Run(&mutex_);
+  } else {
+    status = CollectBlobGarbage(lock, blob_files);
+  }
+  pending_outputs_.erase(pending);
+  if (status.ok()) {
+    RemoveObsoleteFiles();
+  } else {
+    RecordBackgroundError(status);
+  }
+}
+
+// Find the blob reference that the newest entry of "user_key" as of
+// "snapshot" holds. *found is false if that entry is none.
+static Status FindBlobIndex(MemTable* mem, MemTable* imm, Version* current,
+                            SequenceNumber snapshot, const Slice& user_key,
+                            bool* found, BlobIndex* index) {
+  LookupKey lkey(user_key, snapshot);
+  std::string value;
+  Status s;
+  bool is_blob_index = false;
+  if (!mem->Get(lkey, &value, &s, &is_blob_index) &&
+      (imm == nullptr || !imm->Get(lkey, &value, &s, &is_blob_index))) {
+    Version::GetStats stats;
+    s = current->Get(ReadOptions(), lkey, &value, &stats, &is_blob_index);
+  }
+  *found = false;
+  if (s.IsNotFound()) {
+    return Status::OK();
+  }
+  if (s.ok() && is_blob_index) {
+    Slice input(value);
+    s = index->DecodeFrom(&input);
+    *found = s.ok();
+  }
+  return s;
+}
+
+Status DBImpl::CollectBlobGarbage(std::unique_lock<std::mutex>* lock,
+                                  const std::vector<uint64_t>& blob_files) {
+  // A record is live while the newest entry of its key points at it. No
+  // write can make a dead record live again, so a lookup as of now is
+  // good enough to leave the dead ones behind.
+  MemTable* mem = mem_;
+  MemTable* imm = imm_;
+  Version* current = versions_->current();
+  mem->Ref();
+  if (imm != nullptr) imm->Ref();
+  current->Ref();
+  const SequenceNumber snapshot = versions_->LastSequence();
+
+  Status lookup_status;
+  BlobGarbageCollector gc(
+      dbname_, options_,
+      [&](const Slice& user_key, const BlobIndex& index) {
+        bool found;
+        BlobIndex newest;
+        Status s = FindBlobIndex(mem, imm, current, snapshot, user_key,
+                                 &found, &newest);
+        if (!s.ok() && lookup_status.ok()) {
+          lookup_status = s;
+        }
+        return found && newest.file_number == index.file_number &&
+               newest.offset == index.offset;
+      },
+      [this] {
+        std::lock_guard<std::mutex> l(mutex_);
+        return versions_->NewFileNumber();
+      });
+
+  lock->unlock();
+  Status s;
+  for (uint64_t number : blob_files) {
+    s = gc.Collect(number);
+    if (!s.ok()) break;
+  }
+  if (s.ok()) {
+    s = lookup_status;
+  }
+  VersionEdit add;
+  if (s.ok()) {
+    s = gc.Finish(&add);
+  }
+  lock->lock();
+  mem->Unref();
+  if (imm != nullptr) imm->Unref();
+  current->Unref();
+
+  // The new file is live before any entry points at it, and the old ones
+  // until none does.
+  VersionEdit remove;
+  if (s.ok() && !gc.relocated().empty()) {
+    s = versions_->LogAndApply(&add, &mutex_);
+    if (s.ok()) {
+      s = WriteRelocatedBlobs(lock, gc, blob_files, &remove);
+    }
+  }
+  if (s.ok()) {
+    gc.RemoveInputs(&remove);
+    s = versions_->LogAndApply(&remove, &mutex_);
+  }
+  return s;
+}
+
+Status DBImpl::WriteRelocatedBlobs(std::unique_lock<std::mutex>* lock,
+                                   const BlobGarbageCollector& gc,
+                                   const std::vector<uint64_t>& blob_files,
+                                   VersionEdit* edit) {
+  Writer w(nullptr, true);
+  writers_.push_back(&w);
+  blob_gc_queued_ = true;
+  background_work_finished_signal_.notify_all();
+  while (&w != writers_.front()) {
+    w.cv.wait(*lock);
+  }
+  blob_gc_queued_ = false;
+
+  // Every write queued before this one is in the memtable now, and none
+  // behind it can be until it is done. A key that still points into one
+  // of the collected files thus points at the record that was moved.
+  Status status = bg_error_;
+  if (status.ok()) {
+    MemTable* mem = mem_;
+    MemTable* imm = imm_;
+    Version* current = versions_->current();
+    mem->Ref();
+    if (imm != nullptr) imm->Ref();
+    current->Ref();
+    const SequenceNumber last_sequence = versions_->LastSequence();
+    lock->unlock();
+
+    WriteBatch batch;
+    BlobIndex index;
+    uint64_t garbage_count = 0;
+    uint64_t garbage_bytes = 0;
+    for (const auto& kvp : gc.relocated()) {
+      bool found;
+      BlobIndex newest;
+      status = FindBlobIndex(mem, imm, current, last_sequence, kvp.first,
+                             &found, &newest);
+      if (!status.ok()) {
+        break;
+      }
+      if (found && std::find(blob_files.begin(), blob_files.end(),
+                             newest.file_number) != blob_files.end()) {
+        WriteBatchInternal::PutBlobIndex(&batch, kvp.first, kvp.second);
+      } else {
+        // Overwritten or deleted while the file was collected
+        Slice input(kvp.second);
+        index.DecodeFrom(&input);
+        garbage_count++;
+        garbage_bytes += index.size;
+      }
+    }
+
+    // The collected files are removed once this returns, so the new
+    // references have to be durable first.
+    const int count = WriteBatchInternal::Count(&batch);
+    bool sync_error = false;
+    if (status.ok() && count > 0) {
+      WriteBatchInternal::SetSequence(&batch, last_sequence + 1);
+      status = log_->AddRecord(WriteBatchInternal::Contents(&batch));
+      if (status.ok()) {
+        status = logfile_->Sync();
+        sync_error = !status.ok();
+      }
+      if (status.ok()) {
+        status = WriteBatchInternal::InsertInto(&batch, mem);
+      }
+    }
+    lock->lock();
+    mem->Unref();
+    if (imm != nullptr) imm->Unref();
+    current->Unref();
+    if (sync_error) {
+      RecordBackgroundError(status);
+    }
+    if (status.ok()) {
+      versions_->SetLastSequence(last_sequence + count);
+      if (garbage_count > 0) {
+        edit->AddBlobGarbage(index.file_number, garbage_count, garbage_bytes);
+      }
+    }
+  }
+
+  writers_.pop_front();
+  if (!writers_.empty()) {
+    writers_.front()->cv.notify_one();
+  }
+  return status;
+}
+
+Status DBImpl::Get(const ReadOptions& options, const Slice& key,
+                   std::string* value) {
+  Status s;
+  std::unique_lock<std::mutex> l(mutex_);
+  SequenceNumber snapshot = versions_->LastSequence();
+
+  MemTable* mem = mem_;
+  MemTable* imm = imm_;
+  Version* current = versions_->current();
+  mem->Ref();
+  if (imm != nullptr) imm->Ref();
+  current->Ref();
+
+  bool have_stat_update = false;
+  Version::GetStats stats;
+
+  // Unlock while reading from files and memtables
+  {
+    l.unlock();
+    // First look in the memtable, then in the immutable memtable (if any).
+    LookupKey lkey(key, snapshot);
+    bool is_blob_index = false;
+    if (mem->Get(lkey, value, &s, &is_blob_index)) {
+      // Done
+    } else if (imm != nullptr && imm->Get(lkey, value, &s, &is_blob_index)) {
+      // Done
+    } else {
+      s = current->Get(options, lkey, value, &stats, &is_blob_index);
+      have_stat_update = true;
+    }
+    if (s.ok() && is_blob_index) {
+      // The blob file stays live while "current" or a newer version
+      // refers to it, and whatever was read comes from one of those.
+      BlobIndex index;
+      Slice input(*value);
+      s = index.DecodeFrom(&input);
+      if (s.ok()) {
+        s = table_cache_->GetBlob(options, index, value);
+      }
+    }
+    l.lock();
+  }
+
+  if (have_stat_update && current->UpdateStats(stats)) {
+    MaybeScheduleCompaction();
+  }
+  mem->Unref();
+  if (imm != nullptr) imm->Unref();
+  current->Unref();
+  return s;
+}
+
+Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
+  assert(updates != nullptr);
+  Writer w(updates, options.sync);
+
+  std::unique_lock<std::mutex> l(mutex_);
+  writers_.push_back(&w);
+  while (!w.done && &w != writers_.front()) {
+    w.cv.wait(l);
+  }
+  if (w.done) {
+    return w.status;
+  }
+
+  // May temporarily unlock and wait.
+  Status status = MakeRoomForWrite(&l);
+  uint64_t last_sequence = versions_->LastSequence();
+  Writer* last_writer = &w;
+  if (status.ok()) {
+    WriteBatch* write_batch = BuildBatchGroup(&last_writer);
+    const size_t group_bytes = WriteBatchInternal::ByteSize(write_batch);
+    WriteBatchInternal::SetSequence(write_batch, last_sequence + 1);
+    last_sequence += WriteBatchInternal::Count(write_batch);
+
+    // Add to log and apply to memtable.  We can release the lock
+    // during this phase since &w is currently responsible for logging
+    // and protects against concurrent loggers and concurrent writes
+    // into mem_.
+    {
+      // While compaction is behind the whole group pays for its bytes.
+      const uint64_t delay =
+          write_controller_.GetDelay(env_->NowMicros(), group_bytes);
+      l.unlock();
+      if (delay > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(delay));
+      }
+      status = log_->AddRecord(WriteBatchInternal::Contents(write_batch));
+      bool sync_error = false;
+      if (status.ok() && options.sync) {
+        status = logfile_->Sync();
+        if (!status.ok()) {
+          sync_error = true;
+        }
+      }
+      if (status.ok()) {
+        status = WriteBatchInternal::InsertInto(write_batch, mem_);
+      }
+      l.lock();
+      if (sync_error) {
+        // The state of the log file is indeterminate: the log record we
+        // just added may or may not show up when the DB is re-opened.
+        // So we force the DB into a mode where all future writes fail.
+        RecordBackgroundError(status);
+      }
+    }
+    if (write_batch == tmp_batch_) tmp_batch_->Clear();
+
+    versions_->SetLastSequence(last_sequence);
+  }
+
+  while (true) {
+    Writer* ready = writers_.front();
+    writers_.pop_front();
+    if (ready != &w) {
+      ready->status = status;
+      ready->done = true;
+      ready->cv.notify_one();
+    }
+    if (ready == last_writer) break;
+  }
+
+  // Notify new head of write queue
+  if (!writers_.empty()) {
+    writers_.front()->cv.notify_one();
+  }
+
+  return status;
+}
+
+WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
+  assert(!writers_.empty());
+  Writer* first = writers_.front();
+  WriteBatch* result = first->batch;
+  assert(result != nullptr);
+
+  size_t size = WriteBatchInternal::ByteSize(first->batch);
+
+  // Allow the group to grow up to a maximum size, but if the
+  // original write is small, limit the growth so we do not slow
+  // down the small write too much.
+  size_t max_size = 1 << 20;
+  if (size <= (128 << 10)) {
+    max_size = size + (128 << 10);
+  }
+
+  *last_writer = first;
+  std::deque<Writer*>::iterator iter = writers_.begin();
+  ++iter;  // Advance past "first"
+  for (; iter != writers_.end(); ++iter) {
+    Writer* w = *iter;
+    if (w->batch == nullptr) {
+      // Blob garbage collection writes on its own.
+      break;
+    }
+    if (w->sync && !first->sync) {
+      // Do not include a sync write into a batch handled by a non-sync write.
+      break;
+    }
+
+    size += WriteBatchInternal::ByteSize(w->batch);
+    if (size > max_size) {
+      // Do not make batch too big
+      break;
+    }
+
+    // Append to *result
+    if (result == first->batch) {
+      // Switch to temporary batch instead of disturbing caller's batch
+      result = tmp_batch_;
+      assert(WriteBatchInternal::Count(result) == 0);
+      WriteBatchInternal::Append(result, first->batch);
+    }
+    WriteBatchInternal::Append(result, w->batch);
+    *last_writer = w;
+  }
+  return result;
+}
+
+Status DBImpl::MakeRoomForWrite(std::unique_lock<std::mutex>* lock) {
+  assert(!writers_.empty());
+  Status s;
+  while (true) {
+    if (!bg_error_.ok()) {
+      // Yield previous error
+      s = bg_error_;
+      break;
+    } else if (mem_->ApproximateMemoryUsage() <= options_.write_buffer_size) {
+      // There is room in current memtable
+      break;
+    } else if (imm_ != nullptr) {
+      // We have filled up the current memtable, but the previous
+      // one is still being compacted, so we wait.
+      background_work_finished_signal_.wait(*lock);
+    } else if (write_controller_.state() == WriteController::kStopped &&
+               !blob_gc_queued_) {
+      // Too much compaction debt; wait until it is paid down.
+      background_work_finished_signal_.wait(*lock);
+    } else {
+      // Attempt to switch to a new memtable and trigger compaction of old
+      uint64_t new_log_number = versions_->NewFileNumber();
+      WritableFile* lfile = nullptr;
+      s = env_->NewWritableFile(LogFileName(dbname_, new_log_number), &lfile);
+      if (!s.ok()) {
+        // Avoid chewing through file number space in a tight loop.
+        versions_->ReuseFileNumber(new_log_number);
+        break;
+      }
+
+      delete log_;
+
+      s = logfile_->Close();
+      if (!s.ok()) {
+        // We may have lost some data written to the previous log file.
+        // Switch to the new log file anyway, but record as a background
+        // error so we do not attempt any more writes.
+        //
+        // We could perhaps attempt to save the memtable corresponding
+        // to log file and suppress the error if that works, but that
+        // would add more complexity in a critical code path.
+        RecordBackgroundError(s);
+      }
+      delete logfile_;
+
+      logfile_ = lfile;
+      logfile_number_ = new_log_number;
+      log_ = new log::Writer(lfile);
+      imm_ = mem_;
+      mem_ = new MemTable(internal_comparator_);
+      mem_->Ref();
+      MaybeScheduleCompaction();
+    }
+  }
+  return s;
+}
+
+// Default implementations of convenience methods that subclasses of DB
+// can call if they wish
+Status DB::Put(const WriteOptions& opt, const Slice& key, const Slice& value) {
+  WriteBatch batch;
+  batch.Put(key, value);
+  return Write(opt, &batch);
+}
+
+Status DB::Delete(const WriteOptions& opt, const Slice& key) {
+  WriteBatch batch;
+  batch.Delete(key);
+  return Write(opt, &batch);
+}
+
+DB::~DB() = default;
+
+Status DB::Open(const Options& options, const std::string& dbname,
+                DB** dbptr) {
+  *dbptr = nullptr;
+
+  DBImpl* impl = new DBImpl(options, dbname);
+  impl->mutex_.lock();
+  VersionEdit edit;
+  Status s = impl->Recover(&edit);
+  if (s.ok()) {
+    // Recovery flushed every log, so always start a new one.
+    uint64_t new_log_number = impl->versions_->NewFileNumber();
+    WritableFile* lfile;
+    s = options.env->NewWritableFile(LogFileName(dbname, new_log_number),
+                                     &lfile);
+    if (s.ok()) {
+      impl->logfile_ = lfile;
+      impl->logfile_number_ = new_log_number;
+      impl->log_ = new log::Writer(lfile);
+      impl->mem_ = new MemTable(impl->internal_comparator_);
+      impl->mem_->Ref();
+    }
+  }
+  if (s.ok()) {
+    edit.SetPrevLogNumber(0);  // No older logs needed after recovery.
+    edit.SetLogNumber(impl->logfile_number_);
+    s = impl->versions_->LogAndApply(&edit, &impl->mutex_);
+  }
+  if (s.ok()) {
+    impl->RemoveObsoleteFiles();
+    impl->UpdateWriteController();
+    impl->MaybeScheduleCompaction();
+  }
+  impl->mutex_.unlock();
+  if (s.ok()) {
+    assert(impl->mem_ != nullptr);
+    *dbptr = impl;
+  } else {
+    delete impl;
+  }
+  return s;
+}
+
+}  // namespace leveldb
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "db.h"
+#include "dbformat.h"
+#include "log_writer.h"
+#include "options.h"
+#include "write_controller.h"
+
+namespace leveldb {
+
+class BlobGarbageCollector;
+class MemTable;
+class TableCache;
+class ThreadPool;
+class Version;
+class VersionEdit;
+class VersionSet;
+
+/**
+ * @brief DBImpl
+ *
+ * @details Writes go to a write-ahead log and then to the memtable; a
+ * full memtable is switched for a new one (and a new log) and flushed to
+ * a table in the background. Open() replays the logs that were not
+ * flushed yet.
+ *
+ * Flushes run as kHigh jobs and the compactions the VersionSet picks as
+ * kLow jobs of a ThreadPool, one of each at a time. A flush never waits
+ * for a running compaction, and no compaction starts while a flush is
+ * pending. While a compaction runs, flushes go to level 0 so that they
+ * cannot overlap its output.
+ *
+ * Writers queue up in writers_. The writer at the front is the leader:
+ * it merges the batches queued behind it into one group, appends the
+ * group to the log as one record (a single vectored write), syncs once
+ * if asked to, inserts the group into the memtable and then hands the
+ * status to every follower in the group. Throughput thus grows with the
+ * number of writer threads instead of paying one log write, and one
+ * fsync, per Write().
+ *
+ * A WriteController paces or stops the leader while compaction is behind.
+ *
+ * With options.min_blob_size set, flushes and compactions move large values
+ * into blob files (see BuildTable) and Get() reads them back through the
+ * TableCache. When no compaction is needed, the compaction job collects
+ * the blob files whose garbage ratio reached options.blob_gc_garbage_ratio
+ * instead: their live records are copied to a new blob file and the new
+ * references go through the write queue like a write of their own.
+ */
+class DBImpl : public DB {
+ public:
+  DBImpl(const Options& options, const std::string& dbname);
+
+  DBImpl(const DBImpl&) = delete;
+  DBImpl& operator=(const DBImpl&) = delete;
+
+  ~DBImpl() override;
+
+  // Implementations of the DB interface
+  Status Write(const WriteOptions& options, WriteBatch* updates) override;
+  Status Get(const ReadOptions& options, const Slice& key,
+             std::string* value) override;
+
+ private:
+  friend class DB;
+  struct Writer;
+
+  // Recover the descriptor from persistent storage and replay the logs it
+  // does not cover.  Any changes that need to be made to the descriptor
+  // are added to *edit.
+  // REQUIRES: mutex_ held.
+  Status Recover(VersionEdit* edit);
+
+  Status RecoverLogFile(uint64_t log_number, VersionEdit* edit,
+                        SequenceNumber* max_sequence);
+
+  // Write the contents of "mem" to a table, its values of at least
+  // options_.min_blob_size bytes to a blob file, and record both in *edit.
+  // With "push_down" the table may be placed below level 0, in the current
+  // version as of when the table is done.
+  // REQUIRES: mutex_ held; it is released while the table is written.
+  Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, bool push_down);
+
+  // Make sure mem_ has room for the next write group, switching to a new
+  // memtable and log when it is full.
+  // REQUIRES: *lock holds mutex_ and this thread is the front writer.
+  Status MakeRoomForWrite(std::unique_lock<std::mutex>* lock);
+
+  // Merge the batches of the writers behind the front one into a group.
+  // REQUIRES: mutex_ held and writers_ is not empty.
+  WriteBatch* BuildBatchGroup(Writer** last_writer);
+
+  // REQUIRES: mutex_ held.
+  void RecordBackgroundError(const Status& s);
+  void UpdateWriteController();
+  void MaybeScheduleCompaction();
+  void RemoveObsoleteFiles();
+
+  // Numbers of the blob files due for garbage collection.
+  // REQUIRES: mutex_ held.
+  std::vector<uint64_t> BlobFilesToCollect() const;
+
+  void BackgroundFlushCall();
+  void BackgroundCompactionCall();
+  // REQUIRES: *lock holds mutex_.
+  void BackgroundCompaction(std::unique_lock<std::mutex>* lock);
+  Status CollectBlobGarbage(std::unique_lock<std::mutex>* lock,
+                            const std::vector<uint64_t>& blob_files);
+  // Point the keys of gc.relocated() that still refer to one of
+  // "blob_files" at their new location, as the front writer; the others
+  // are recorded in *edit as garbage of the new file.
+  Status WriteRelocatedBlobs(std::unique_lock<std::mutex>* lock,
+                             const BlobGarbageCollector& gc,
+                             const std::vector<uint64_t>& blob_files,
+                             VersionEdit* edit);
+  // REQUIRES: mutex_ held.
+  void CompactMemTable();
+
+  // Constant after construction
+  Env* const env_;
+  const InternalKeyComparator internal_comparator_;
+  const Options options_;
+  Options table_options_;  // comparator == &internal_comparator_
+  const std::string dbname_;
+
+  // table_cache_ provides its own synchronization
+  TableCache* const table_cache_;
+
+  // options_.background_pool, or a pool owned by this DB.
+  std::unique_ptr<ThreadPool> owned_pool_;
+  ThreadPool* const pool_;
+
+  // options_.io_backend, or a backend owned by this DB. Null when
+  // compaction readahead is off.
+  std::unique_ptr<IOBackend> owned_io_backend_;
+  IOBackend* const io_backend_;
+
+  // State below is protected by mutex_
+  std::mutex mutex_;
+  // Signalled whenever a background job finished.
+  std::condition_variable background_work_finished_signal_;
+  bool shutting_down_;
+  MemTable* mem_;
+  MemTable* imm_;  // Memtable being flushed
+  WritableFile* logfile_;
+  uint64_t logfile_number_;
+  log::Writer* log_;
+
+  // Queue of writers.
+  std::deque<Writer*> writers_;
+  WriteBatch* tmp_batch_;
+
+  WriteController write_controller_;
+  VersionSet* const versions_;
+  bool bg_flush_scheduled_;
+  bool bg_compaction_scheduled_;
+  // Blob garbage collection waits in writers_ while holding the compaction
+  // job, so writers ahead of it must not wait for compactions.
+  bool blob_gc_queued_;
+
+  // First file number a running background job may write.  Files at or
+  // past the smallest are not in any version yet but must not be removed.
+  std::multiset<uint64_t> pending_outputs_;
+
+  // Sticky error of a background job or of a failed log sync.
+  Status bg_error_;
+};
+
+}  // namespace leveldb
@@ -0,0 +1,130 @@
+// Write throughput of DB::Put against the number of writer threads, with
+// and without WriteOptions::sync.
+//
+// For every configuration a fresh DB is opened and each of N threads puts
+// --value_size values under random keys for --seconds. Concurrent writers
+// are committed in groups, one log write (and one fsync with --sync) per
+// group, so ops/s should keep growing with the thread count, most of all
+// when every write is synced.
+//
+// Usage: db_write_bench [--dir=PATH] [--seconds=N] [--value_size=N]
+//                       [--max_threads=N]
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "db.h"
+#include "env.h"
+#include "filename.h"
+#include "options.h"
+#include "utils/random.h"
+
+namespace leveldb {
+namespace {
+
+std::string FLAGS_dir = "/tmp/db_write_bench";
+int FLAGS_seconds = 2;
+int FLAGS_value_size = 100;
+int FLAGS_max_threads = 16;
+
+double NowSeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void CleanDir(Env* env) {
+  std::vector<std::string> children;
+  env->CreateDir(FLAGS_dir);
+  env->GetChildren(FLAGS_dir, &children);
+  for (const std::string& child : children) {
+    uint64_t number;
+    FileType type;
+    if (ParseFileName(child, &number, &type)) {
+      env->RemoveFile(FLAGS_dir + "/" + child);
+    }
+  }
+}
+
+void Bench(int threads, bool sync) {
+  Env* env = Env::Default();
+  CleanDir(env);
+  Options options;
+  options.create_if_missing = true;
+  DB* db;
+  Status s = DB::Open(options, FLAGS_dir, &db);
+  if (!s.ok()) {
+    std::fprintf(stderr, "open: %s\n", s.ToString().c_str());
+    std::exit(1);
+  }
+
+  std::atomic<uint64_t> total_ops(0);
+  const double deadline = NowSeconds() + FLAGS_seconds;
+  const double start = NowSeconds();
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      Random rnd(301 + t);
+      WriteOptions wo;
+      wo.sync = sync;
+      std::string value(FLAGS_value_size, 'v');
+      char key[32];
+      uint64_t ops = 0;
+      while (NowSeconds() < deadline) {
+        std::snprintf(key, sizeof(key), "%08x%08x", rnd.Next(), rnd.Next());
+        Status st = db->Put(wo, key, value);
+        if (!st.ok()) {
+          std::fprintf(stderr, "put: %s\n", st.ToString().c_str());
+          std::exit(1);
+        }
+        ops++;
+      }
+      total_ops += ops;
+    });
+  }
+  for (std::thread& w : workers) {
+    w.join();
+  }
+  const double secs = NowSeconds() - start;
+  delete db;
+
+  const uint64_t ops = total_ops.load();
+  std::printf("%s\t%d\t%llu\t%.0f\t%.2f\n", sync ? "on" : "off", threads,
+              static_cast<unsigned long long>(ops), ops / secs,
+              secs * 1e6 / ops);
+}
+
+}  // namespace
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  using namespace leveldb;
+  for (int i = 1; i < argc; i++) {
+    unsigned long long n;
+    char junk;
+    if (strncmp(argv[i], "--dir=", 6) == 0) {
+      FLAGS_dir = argv[i] + 6;
+    } else if (sscanf(argv[i], "--seconds=%llu%c", &n, &junk) == 1) {
+      FLAGS_seconds = static_cast<int>(n);
+    } else if (sscanf(argv[i], "--value_size=%llu%c", &n, &junk) == 1) {
+      FLAGS_value_size = static_cast<int>(n);
+    } else if (sscanf(argv[i], "--max_threads=%llu%c", &n, &junk) == 1) {
+      FLAGS_max_threads = static_cast<int>(n);
+    } else {
+      std::fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+
+  std::printf("sync\tthreads\tops\tops_per_sec\tmicros_per_op\n");
+  for (int sync = 0; sync <= 1; sync++) {
+    for (int threads = 1; threads <= FLAGS_max_threads; threads *= 2) {
+      Bench(threads, sync != 0);
+    }
+  }
+  return 0;
+}
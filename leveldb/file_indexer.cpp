@@ -0,0 +1,177 @@
+#include "file_indexer.h"
+
+#include <algorithm>
+
+#include "version_set.h"
+
+namespace leveldb {
+
+void FileIndexer::Build(const Version* v) {
+  size_t bytes = 0;
+  for (int level = 0; level < config::kNumLevels; level++) {
+    for (const FileMetaData* f : v->files(level)) {
+      bytes += f->smallest.Encode().size() + f->largest.Encode().size();
+    }
+  }
+  keys_.clear();
+  keys_.reserve(bytes);  // pointers into keys_ stay valid from here on
+
+  auto make_entry = [this](FileMetaData* f) {
+    Entry e;
+    Slice smallest = f->smallest.Encode();
+    Slice largest = f->largest.Encode();
+    e.smallest = keys_.data() + keys_.size();
+    keys_.append(smallest.data(), smallest.size());
+    e.largest = keys_.data() + keys_.size();
+    keys_.append(largest.data(), largest.size());
+    e.smallest_size = smallest.size();
+    e.largest_size = largest.size();
+    e.file = f;
+    e.smallest_lb = e.largest_lb = 0;
+    e.smallest_rb = e.largest_rb = -1;
+    return e;
+  };
+
+  level0_.clear();
+  for (FileMetaData* f : v->files(0)) {
+    level0_.push_back(make_entry(f));
+  }
+  std::sort(level0_.begin(), level0_.end(), [](const Entry& a, const Entry& b) {
+    return a.file->number > b.file->number;
+  });
+
+  for (int level = 1; level < config::kNumLevels; level++) {
+    levels_[level].clear();
+    levels_[level].reserve(v->files(level).size());
+    for (FileMetaData* f : v->files(level)) {
+      levels_[level].push_back(make_entry(f));
+    }
+  }
+
+  int next = config::kNumLevels;
+  for (int level = config::kNumLevels - 1; level >= 1; level--) {
+    next_level_[level] = next;
+    if (!levels_[level].empty()) next = level;
+  }
+  next_level_[0] = next;
+
+  // Both sides are sorted, so every bound is found with one merge-like
+  // pass per pair of adjacent non-empty levels.
+  for (int level = 1; level < config::kNumLevels; level++) {
+    if (levels_[level].empty() || next_level_[level] == config::kNumLevels) {
+      continue;
+    }
+    std::vector<Entry>& upper = levels_[level];
+    const std::vector<Entry>& lower = levels_[next_level_[level]];
+    const int32_t n = lower.size();
+
+    // lb: first j with lower[j].largest >= key
+    int32_t j = 0;
+    for (Entry& e : upper) {
+      while (j < n && icmp_->Compare(lower[j].largest_key(),
+                                     e.smallest_key()) < 0) {
+        j++;
+      }
+      e.smallest_lb = j;
+      while (j < n && icmp_->Compare(lower[j].largest_key(),
+                                     e.largest_key()) < 0) {
+        j++;
+      }
+      e.largest_lb = j;
+    }
+
+    // rb: last j with lower[j].smallest <= key
+    j = 0;
+    for (Entry& e : upper) {
+      while (j < n && icmp_->Compare(lower[j].smallest_key(),
+                                     e.smallest_key()) <= 0) {
+        j++;
+      }
+      e.smallest_rb = j - 1;
+      while (j < n && icmp_->Compare(lower[j].smallest_key(),
+                                     e.largest_key()) <= 0) {
+        j++;
+      }
+      e.largest_rb = j - 1;
+    }
+  }
+}
+
+int32_t FileIndexer::FindInRange(int level, const Slice& ikey, int32_t lb,
+                                 int32_t rb) const {
+  const std::vector<Entry>& files = levels_[level];
+  int32_t left = lb;
+  int32_t right = rb + 1;
+  while (left < right) {
+    int32_t mid = left + (right - left) / 2;
+    if (icmp_->Compare(files[mid].largest_key(), ikey) < 0) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  return right;
+}
+
+FileIndexer::Picker::Picker(const FileIndexer* index, const Slice& user_key,
+                            const Slice& ikey)
+    : index_(index),
+      user_key_(user_key),
+      ikey_(ikey),
+      l0_pos_(0),
+      level_(index->next_level_[0]),
+      lb_(0),
+      rb_(-1) {
+  if (level_ < config::kNumLevels) {
+    rb_ = static_cast<int32_t>(index_->levels_[level_].size()) - 1;
+  }
+}
+
+FileMetaData* FileIndexer::Picker::Next(int* level) {
+  const Comparator* ucmp = index_->icmp_->user_comparator();
+  while (l0_pos_ < index_->level0_.size()) {
+    const Entry& e = index_->level0_[l0_pos_++];
+    if (ucmp->Compare(user_key_, ExtractUserKey(e.smallest_key())) >= 0 &&
+        ucmp->Compare(user_key_, ExtractUserKey(e.largest_key())) <= 0) {
+      *level = 0;
+      return e.file;
+    }
+  }
+
+  while (level_ < config::kNumLevels) {
+    const int cur = level_;
+    const std::vector<Entry>& files = index_->levels_[cur];
+    const int32_t n = files.size();
+    const int32_t i = index_->FindInRange(cur, ikey_, lb_, rb_);
+
+    // Narrow the search range of the next non-empty level.
+    const int next = index_->next_level_[cur];
+    int32_t next_n = 0;
+    if (next < config::kNumLevels) {
+      next_n = index_->levels_[next].size();
+    }
+    FileMetaData* candidate = nullptr;
+    if (i < n && ucmp->Compare(user_key_,
+                               ExtractUserKey(files[i].smallest_key())) >= 0) {
+      candidate = files[i].file;
+    }
+    if (i < n && index_->icmp_->Compare(ikey_, files[i].smallest_key()) >= 0) {
+      // smallest <= ikey <= largest
+      lb_ = files[i].smallest_lb;
+      rb_ = files[i].largest_rb;
+    } else {
+      // Between files i - 1 and i.
+      lb_ = i > 0 ? files[i - 1].largest_lb : 0;
+      rb_ = i < n ? files[i].smallest_rb : next_n - 1;
+    }
+    level_ = next;
+
+    if (candidate != nullptr) {
+      *level = cur;
+      return candidate;
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace leveldb
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "dbformat.h"
+#include "slice.h"
+
+namespace leveldb {
+
+struct FileMetaData;
+class Version;
+
+/**
+ * @brief FileIndexer
+ *
+ * @details Search structure over the files of one Version, built once when
+ * the Version is installed. The boundary keys of every file are copied into
+ * one contiguous buffer and each level is a flat array of entries, so a
+ * lookup walks a few cache lines instead of chasing FileMetaData pointers.
+ *
+ * Each entry of level L also carries fractional-cascading bounds into the
+ * next non-empty level L': knowing where a key falls relative to a file of
+ * L bounds the range of L' files that can hold the first file with
+ * largest >= key. Only the first level below 0 is binary searched over all
+ * its files; below that each search is confined to the few files between
+ * the bounds.
+ *
+ * The bounds, for an entry f of L and the files g[] of L' (internal keys):
+ *   smallest_lb: first j with g[j].largest >= f.smallest
+ *   largest_lb:  first j with g[j].largest >= f.largest
+ *   smallest_rb: last j with g[j].smallest <= f.smallest
+ *   largest_rb:  last j with g[j].smallest <= f.largest
+ */
+class FileIndexer {
+ public:
+  explicit FileIndexer(const InternalKeyComparator* icmp) : icmp_(icmp) {}
+
+  FileIndexer(const FileIndexer&) = delete;
+  FileIndexer& operator=(const FileIndexer&) = delete;
+
+  // Index the files of "v", which must outlive the index.
+  void Build(const Version* v);
+
+  // Returns the files that may contain a user key, in the order a point
+  // lookup has to consult them: level-0 files newest first, then at most
+  // one file per deeper level.
+  class Picker {
+   public:
+    // "ikey" is the internal lookup key for "user_key".
+    Picker(const FileIndexer* index, const Slice& user_key, const Slice& ikey);
+
+    // Returns the next candidate and its level, or nullptr when done.
+    FileMetaData* Next(int* level);
+
+   private:
+    const FileIndexer* const index_;
+    const Slice user_key_;
+    const Slice ikey_;
+    size_t l0_pos_;
+    int level_;  // next level > 0 to search
+    int32_t lb_;
+    int32_t rb_;
+  };
+
+ private:
+  struct Entry {
+    const char* smallest;
+    const char* largest;
+    uint32_t smallest_size;
+    uint32_t largest_size;
+    FileMetaData* file;
+    int32_t smallest_lb;
+    int32_t largest_lb;
+    int32_t smallest_rb;
+    int32_t largest_rb;
+
+    Slice smallest_key() const { return Slice(smallest, smallest_size); }
+    Slice largest_key() const { return Slice(largest, largest_size); }
+  };
+
+  // First index in [lb, rb] whose largest key is >= ikey, or rb + 1.
+  int32_t FindInRange(int level, const Slice& ikey, int32_t lb,
+                      int32_t rb) const;
+
+  const InternalKeyComparator* const icmp_;
+  std::string keys_;  // every boundary key, back to back
+  std::vector<Entry> level0_;  // newest first
+  std::vector<Entry> levels_[config::kNumLevels];
+  int next_level_[config::kNumLevels];  // next non-empty level, or kNumLevels
+};
+
+}  // namespace leveldb
@@ -0,0 +1,244 @@
+// CPU cost of finding the candidate files of a point lookup.
+//
+// Installs a synthetic Version with every level populated (level L > 0
+// holds --fanout times the files of level L - 1, up to --bottom_files on
+// the last level) and resolves random keys to the files Version::Get would
+// consult. "binary_search" is the per-level search over FileMetaData
+// pointers; "cascade" walks the FileIndexer of the same Version. Both must
+// agree on every lookup.
+//
+// Usage: file_indexer_bench [--dir=PATH] [--bottom_files=N] [--fanout=N]
+//                           [--l0_files=N] [--lookups=N]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "dbformat.h"
+#include "env.h"
+#include "file_indexer.h"
+#include "filename.h"
+#include "options.h"
+#include "utils/random.h"
+#include "version_edit.h"
+#include "version_set.h"
+
+namespace leveldb {
+namespace {
+
+std::string FLAGS_dir = "/tmp/file_indexer_bench";
+uint64_t FLAGS_bottom_files = 16384;
+uint64_t FLAGS_fanout = 4;
+uint64_t FLAGS_l0_files = 4;
+uint64_t FLAGS_lookups = 2000000;
+
+// User keys are fixed-width numbers in [0, kKeySpace).
+const uint64_t kKeySpace = 1ull << 40;
+
+double NowSeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+std::string UserKey(uint64_t n) {
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%016llx",
+                static_cast<unsigned long long>(n));
+  return buf;
+}
+
+void CleanDir(Env* env) {
+  std::vector<std::string> children;
+  env->CreateDir(FLAGS_dir);
+  env->GetChildren(FLAGS_dir, &children);
+  for (const std::string& child : children) {
+    uint64_t number;
+    FileType type;
+    if (ParseFileName(child, &number, &type)) {
+      env->RemoveFile(FLAGS_dir + "/" + child);
+    }
+  }
+}
+
+// Level L > 0 partitions the key space into equal slices, each file
+// covering a random sub-range of its slice so that lookups also land in
+// the gaps between files.
+void FillEdit(VersionSet* versions, VersionEdit* edit) {
+  Random rnd(301);
+  SequenceNumber seq = 1;
+  uint64_t files = FLAGS_bottom_files;
+  for (int level = config::kNumLevels - 1; level > 0; level--) {
+    const uint64_t width = kKeySpace / files;
+    for (uint64_t i = 0; i < files; i++) {
+      const uint64_t lo = i * width + (rnd.Next() % (width / 8));
+      const uint64_t hi = (i + 1) * width - 1 - (rnd.Next() % (width / 8));
+      edit->AddFile(level, versions->NewFileNumber(), 2 << 20,
+                    InternalKey(UserKey(lo), seq, kTypeValue),
+                    InternalKey(UserKey(hi), seq, kTypeValue));
+      seq++;
+    }
+    files = files / FLAGS_fanout > 0 ? files / FLAGS_fanout : 1;
+  }
+  // Overlapping level-0 files, each over a random tenth of the key space.
+  for (uint64_t i = 0; i < FLAGS_l0_files; i++) {
+    const uint64_t lo = rnd.Next() % (kKeySpace / 10 * 9);
+    edit->AddFile(0, versions->NewFileNumber(), 2 << 20,
+                  InternalKey(UserKey(lo), seq, kTypeValue),
+                  InternalKey(UserKey(lo + kKeySpace / 10), seq, kTypeValue));
+    seq++;
+  }
+  edit->SetLastSequence(seq);
+}
+
+// The search Version::Get did before it had an index.
+struct BinarySearch {
+  const Version* v;
+  const InternalKeyComparator* icmp;
+  std::vector<FileMetaData*> level0;  // newest first
+
+  BinarySearch(const Version* version, const InternalKeyComparator* cmp)
+      : v(version), icmp(cmp), level0(version->files(0)) {
+    std::sort(level0.begin(), level0.end(),
+              [](FileMetaData* a, FileMetaData* b) {
+                return a->number > b->number;
+              });
+  }
+
+  uint64_t Lookup(const Slice& user_key, const Slice& ikey) const {
+    const Comparator* ucmp = icmp->user_comparator();
+    uint64_t sum = 0;
+    for (FileMetaData* f : level0) {
+      if (ucmp->Compare(user_key, f->smallest.user_key()) >= 0 &&
+          ucmp->Compare(user_key, f->largest.user_key()) <= 0) {
+        sum = sum * 31 + f->number;
+      }
+    }
+    for (int level = 1; level < config::kNumLevels; level++) {
+      const std::vector<FileMetaData*>& files = v->files(level);
+      uint32_t left = 0;
+      uint32_t right = files.size();
+      while (left < right) {
+        uint32_t mid = (left + right) / 2;
+        if (icmp->Compare(files[mid]->largest.Encode(), ikey) < 0) {
+          left = mid + 1;
+        } else {
+          right = mid;
+        }
+      }
+      if (left < files.size() &&
+          ucmp->Compare(user_key, files[left]->smallest.user_key()) >= 0) {
+        sum = sum * 31 + files[left]->number;
+      }
+    }
+    return sum;
+  }
+};
+
+uint64_t CascadeLookup(const FileIndexer* index, const Slice& user_key,
+                       const Slice& ikey) {
+  uint64_t sum = 0;
+  FileIndexer::Picker picker(index, user_key, ikey);
+  int level;
+  while (FileMetaData* f = picker.Next(&level)) {
+    sum = sum * 31 + f->number;
+  }
+  return sum;
+}
+
+}  // namespace
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  using namespace leveldb;
+  for (int i = 1; i < argc; i++) {
+    unsigned long long n;
+    char junk;
+    if (strncmp(argv[i], "--dir=", 6) == 0) {
+      FLAGS_dir = argv[i] + 6;
+    } else if (sscanf(argv[i], "--bottom_files=%llu%c", &n, &junk) == 1) {
+      FLAGS_bottom_files = n;
+    } else if (sscanf(argv[i], "--fanout=%llu%c", &n, &junk) == 1) {
+      FLAGS_fanout = n;
+    } else if (sscanf(argv[i], "--l0_files=%llu%c", &n, &junk) == 1) {
+      FLAGS_l0_files = n;
+    } else if (sscanf(argv[i], "--lookups=%llu%c", &n, &junk) == 1) {
+      FLAGS_lookups = n;
+    } else {
+      std::fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+
+  Env* env = Env::Default();
+  CleanDir(env);
+  Options options;
+  InternalKeyComparator icmp(options.comparator);
+  VersionSet versions(FLAGS_dir, &options, nullptr, &icmp);
+  std::mutex mu;
+  VersionEdit edit;
+  edit.SetComparatorName(icmp.user_comparator()->Name());
+  FillEdit(&versions, &edit);
+  mu.lock();
+  Status s = versions.LogAndApply(&edit, &mu);
+  mu.unlock();
+  if (!s.ok()) {
+    std::fprintf(stderr, "%s\n", s.ToString().c_str());
+    return 1;
+  }
+  const Version* v = versions.current();
+
+  uint64_t total = 0;
+  for (int level = 0; level < config::kNumLevels; level++) {
+    total += v->NumFiles(level);
+  }
+  double start = NowSeconds();
+  FileIndexer index(&icmp);
+  index.Build(v);
+  const double build_us = (NowSeconds() - start) * 1e6;
+
+  // Precompute the lookup keys so that both searches pay the same.
+  std::vector<std::string> user_keys(FLAGS_lookups);
+  std::vector<LookupKey*> keys(FLAGS_lookups);
+  Random rnd(17);
+  for (uint64_t i = 0; i < FLAGS_lookups; i++) {
+    const uint64_t n = (static_cast<uint64_t>(rnd.Next()) << 9) % kKeySpace;
+    user_keys[i] = UserKey(n);
+    keys[i] = new LookupKey(user_keys[i], kMaxSequenceNumber);
+  }
+
+  BinarySearch binary(v, &icmp);
+  std::vector<uint64_t> expected(FLAGS_lookups);
+  start = NowSeconds();
+  for (uint64_t i = 0; i < FLAGS_lookups; i++) {
+    expected[i] = binary.Lookup(keys[i]->user_key(), keys[i]->internal_key());
+  }
+  const double binary_secs = NowSeconds() - start;
+
+  uint64_t mismatches = 0;
+  start = NowSeconds();
+  for (uint64_t i = 0; i < FLAGS_lookups; i++) {
+    if (CascadeLookup(&index, keys[i]->user_key(), keys[i]->internal_key()) !=
+        expected[i]) {
+      mismatches++;
+    }
+  }
+  const double cascade_secs = NowSeconds() - start;
+
+  std::printf("files\tlevels\tindex_build_us\n%llu\t%d\t%.0f\n\n",
+              static_cast<unsigned long long>(total), config::kNumLevels,
+              build_us);
+  std::printf("search\tns_per_lookup\n");
+  std::printf("binary_search\t%.1f\n", binary_secs / FLAGS_lookups * 1e9);
+  std::printf("cascade\t%.1f\n", cascade_secs / FLAGS_lookups * 1e9);
+  for (LookupKey* k : keys) delete k;
+  if (mismatches > 0) {
+    std::fprintf(stderr, "%llu lookups disagree\n",
+                 static_cast<unsigned long long>(mismatches));
+    return 1;
+  }
+  return 0;
+}
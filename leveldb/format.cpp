@@ -0,0 +1,131 @@
+#include "format.h"
+
+#include "env.h"
+#include "utils/coding.h"
+#include "utils/crc32c.h"
+
+namespace leveldb {
+
+BlockHandle::BlockHandle()
+    : offset_(~static_cast<uint64_t>(0)), size_(~static_cast<uint64_t>(0)) {}
+
+void BlockHandle::EncodeTo(std::string* dst) const {
+  // Sanity check that all fields have been set
+  assert(offset_ != ~static_cast<uint64_t>(0));
+  assert(size_ != ~static_cast<uint64_t>(0));
+  PutVarint64(dst, offset_);
+  PutVarint64(dst, size_);
+}
+
+Status BlockHandle::DecodeFrom(Slice* input) {
+  if (GetVarint64(input, &offset_) && GetVarint64(input, &size_)) {
+    return Status::OK();
+  } else {
+    return Status::Corruption("bad block handle");
+  }
+}
+
+void Footer::EncodeTo(std::string* dst) const {
+  const size_t original_size = dst->size();
+  metaindex_handle_.EncodeTo(dst);
+  index_handle_.EncodeTo(dst);
+  dst->resize(2 * BlockHandle::kMaxEncodedLength);  // Padding
+  PutFixed64(dst, index_type_ == kTwoLevelIndexSearch
+                      ? kPartitionedIndexTableMagicNumber
+                      : kTableMagicNumber);
+  assert(dst->size() == original_size + kEncodedLength);
+  (void)original_size;  // Disable unused variable warning.
+}
+
+Status Footer::DecodeFrom(Slice* input) {
+  if (input->size() < kEncodedLength) {
+    return Status::Corruption("not an sstable (footer too short)");
+  }
+
+  const char* magic_ptr = input->data() + kEncodedLength - 8;
+  const uint64_t magic = DecodeFixed64(magic_ptr);
+  if (magic == kTableMagicNumber) {
+    index_type_ = kBinarySearchIndex;
+  } else if (magic == kPartitionedIndexTableMagicNumber) {
+    index_type_ = kTwoLevelIndexSearch;
+  } else {
+    return Status::Corruption("not an sstable (bad magic number)");
+  }
+
+  Status result = metaindex_handle_.DecodeFrom(input);
+  if (result.ok()) {
+    result = index_handle_.DecodeFrom(input);
+  }
+  if (result.ok()) {
+    // We skip over any leftover data (just padding for now) in "input"
+    const char* end = magic_ptr + 8;
+    *input = Slice(end, input->data() + input->size() - end);
+  }
+  return result;
+}
+
+Status ParseBlockWithTrailer(const Slice& data, const ReadOptions& options,
+                             Slice* result) {
+  if (data.size() < kBlockTrailerSize) {
+    return Status::Corruption("truncated block read");
+  }
+  const size_t n = data.size() - kBlockTrailerSize;
+  const char* p = data.data();
+  if (options.verify_checksums) {
+    const uint32_t crc = crc32c::Unmask(DecodeFixed32(p + n + 1));
+    const uint32_t actual = crc32c::Value(p, n + 1);
+    if (actual != crc) {
+      return Status::Corruption("block checksum mismatch");
+    }
+  }
+  if (p[n] != kNoCompression) {
+    return Status::Corruption("bad block type");
+  }
+  *result = Slice(p, n);
+  return Status::OK();
+}
+
+Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
+                 const BlockHandle& handle, BlockContents* result) {
+  result->data = Slice();
+  result->cachable = false;
+  result->heap_allocated = false;
+
+  // Read the block contents as well as the type/crc footer.
+  // See table_builder.cpp for the code that built this structure.
+  size_t n = static_cast<size_t>(handle.size());
+  char* buf = new char[n + kBlockTrailerSize];
+  Slice contents;
+  Status s = file->Read(handle.offset(), n + kBlockTrailerSize, &contents, buf);
+  if (!s.ok()) {
+    delete[] buf;
+    return s;
+  }
+  if (contents.size() != n + kBlockTrailerSize) {
+    delete[] buf;
+    return Status::Corruption("truncated block read");
+  }
+
+  Slice data;
+  s = ParseBlockWithTrailer(contents, options, &data);
+  if (!s.ok()) {
+    delete[] buf;
+    return s;
+  }
+  if (data.data() != buf) {
+    // File implementation gave us pointer to some other data.
+    // Use it directly under the assumption that it will be live
+    // while the file is open.
+    delete[] buf;
+    result->data = data;
+    result->heap_allocated = false;
+    result->cachable = false;  // Do not double-cache
+  } else {
+    result->data = data;
+    result->heap_allocated = true;
+    result->cachable = true;
+  }
+  return Status::OK();
+}
+
+}  // namespace leveldb
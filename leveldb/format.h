@@ -1,5 +1,8 @@
+#pragma once
+
 #include <iostream>
 
+#include "options.h"
 #include "slice.h"
 #include "status.h"
 
@@ -30,4 +33,69 @@ class BlockHandle {
   uint64_t size_;
 };
 
+/**
+ * @brief Footer
+ *
+ * @details Footer encapsulates the fixed information stored at the tail
+ * end of every table file. The magic number also tells which IndexType the
+ * index handle points to, so opening a table needs no extra metadata read.
+ */
+class Footer {
+ public:
+  // Encoded length of a Footer.  Note that the serialization of a
+  // Footer will always occupy exactly this many bytes.  It consists
+  // of two block handles and a magic number.
+  enum { kEncodedLength = 2 * BlockHandle::kMaxEncodedLength + 8 };
+
+  Footer() = default;
+
+  // The block handle for the metaindex block of the table
+  const BlockHandle& metaindex_handle() const { return metaindex_handle_; }
+  void set_metaindex_handle(const BlockHandle& h) { metaindex_handle_ = h; }
+
+  // The block handle for the index block of the table. For
+  // kTwoLevelIndexSearch this is the top-level index over the partitions.
+  const BlockHandle& index_handle() const { return index_handle_; }
+  void set_index_handle(const BlockHandle& h) { index_handle_ = h; }
+
+  IndexType index_type() const { return index_type_; }
+  void set_index_type(IndexType t) { index_type_ = t; }
+
+  void EncodeTo(std::string* dst) const;
+  Status DecodeFrom(Slice* input);
+
+ private:
+  BlockHandle metaindex_handle_;
+  BlockHandle index_handle_;
+  IndexType index_type_ = kBinarySearchIndex;
+};
+
+// kTableMagicNumber was picked by running
+//    echo http://code.google.com/p/leveldb/ | sha1sum
+// and taking the leading 64 bits.
+static const uint64_t kTableMagicNumber = 0xdb4775248b80fb57ull;
+// Same table layout, but the index handle points to a partitioned index.
+static const uint64_t kPartitionedIndexTableMagicNumber = 0xdb4775248b80fb58ull;
+
+// 1-byte type + 32-bit crc
+static const size_t kBlockTrailerSize = 5;
+
+struct BlockContents {
+  Slice data;           // Actual contents of data
+  bool cachable;        // True iff data can be cached
+  bool heap_allocated;  // True iff caller should delete[] data.data()
+};
+
+class RandomAccessFile;
+
+// Read the block identified by "handle" from "file".  On failure
+// return non-OK.  On success fill *result and return OK.
+Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
+                 const BlockHandle& handle, BlockContents* result);
+
+// Check the trailer of a block read together with its kBlockTrailerSize
+// trailer bytes and return its contents in *result (pointing into "data").
+Status ParseBlockWithTrailer(const Slice& data, const ReadOptions& options,
+                             Slice* result);
+
 }  // namespace leveldb
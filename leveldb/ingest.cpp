@@ -0,0 +1,172 @@
+#include "ingest.h"
+
+#include "env.h"
+#include "filename.h"
+#include "iterator.h"
+#include "table.h"
+#include "table_builder.h"
+#include "version_set.h"
+
+namespace leveldb {
+
+TableIngestor::TableIngestor(const std::string& dbname, const Options& options,
+                             VersionSet* versions)
+    : dbname_(dbname),
+      env_(options.env),
+      icmp_(options.comparator),
+      table_options_(options),
+      versions_(versions),
+      sequence_(versions->LastSequence() + 1),
+      file_(nullptr),
+      builder_(nullptr),
+      has_last_key_(false),
+      finished_(false),
+      committed_(false) {
+  table_options_.comparator = &icmp_;
+}
+
+TableIngestor::~TableIngestor() {
+  if (!committed_) {
+    Abandon();
+  }
+}
+
+void TableIngestor::Commit() {
+  assert(finished_ && status_.ok());
+  committed_ = true;
+}
+
+void TableIngestor::Abandon() {
+  assert(!committed_);
+  if (builder_ != nullptr) {
+    builder_->Abandon();
+    delete builder_;
+    delete file_;
+    builder_ = nullptr;
+    file_ = nullptr;
+  }
+  for (const FileMetaData& f : files_) {
+    env_->RemoveFile(TableFileName(dbname_, f.number));
+  }
+  files_.clear();
+}
+
+Status TableIngestor::OpenFile() {
+  FileMetaData meta;
+  meta.number = versions_->NewFileNumber();
+  Status s = env_->NewWritableFile(TableFileName(dbname_, meta.number), &file_);
+  if (!s.ok()) {
+    return s;
+  }
+  files_.push_back(meta);
+  builder_ = new TableBuilder(table_options_, file_);
+  return s;
+}
+
+Status TableIngestor::CloseFile() {
+  FileMetaData& meta = files_.back();
+  Status s = builder_->Finish();
+  if (s.ok()) {
+    meta.file_size = builder_->FileSize();
+    s = file_->Sync();
+  }
+  if (s.ok()) {
+    s = file_->Close();
+  }
+  delete builder_;
+  delete file_;
+  builder_ = nullptr;
+  file_ = nullptr;
+  meta.largest.DecodeFrom(ikey_);
+  return s;
+}
+
+Status TableIngestor::Add(Iterator* input) {
+  const Comparator* ucmp = icmp_.user_comparator();
+  for (input->SeekToFirst(); status_.ok() && input->Valid(); input->Next()) {
+    Slice key = input->key();
+    if (has_last_key_ && ucmp->Compare(key, last_key_) <= 0) {
+      status_ = Status::InvalidArgument("ingested keys are not increasing",
+                                        key);
+      break;
+    }
+    if (builder_ == nullptr) {
+      status_ = OpenFile();
+      if (!status_.ok()) break;
+    }
+
+    ikey_.clear();
+    AppendInternalKey(&ikey_, ParsedInternalKey(key, sequence_, kTypeValue));
+    if (builder_->NumEntries() == 0) {
+      files_.back().smallest.DecodeFrom(ikey_);
+    }
+    builder_->Add(ikey_, input->value());
+    last_key_.assign(key.data(), key.size());
+    has_last_key_ = true;
+
+    if (builder_->FileSize() >= table_options_.max_file_size) {
+      status_ = CloseFile();
+    }
+  }
+  if (status_.ok()) {
+    status_ = input->status();
+  }
+  return status_;
+}
+
+Status TableIngestor::AddFile(const std::string& fname) {
+  if (!status_.ok()) {
+    return status_;
+  }
+  uint64_t file_size;
+  RandomAccessFile* file = nullptr;
+  Table* table = nullptr;
+  Status s = env_->GetFileSize(fname, &file_size);
+  if (s.ok()) {
+    s = env_->NewRandomAccessFile(fname, &file);
+  }
+  if (s.ok()) {
+    // Not shared with anything else, so no block cache.
+    Options options;
+    options.comparator = icmp_.user_comparator();
+    s = Table::Open(options, file, 0, file_size, &table);
+  }
+  if (s.ok()) {
+    ReadOptions ro;
+    ro.verify_checksums = true;
+    ro.fill_cache = false;
+    Iterator* iter = table->NewIterator(ro);
+    s = Add(iter);
+    delete iter;
+  }
+  delete table;
+  delete file;
+  if (!s.ok()) {
+    status_ = s;
+  }
+  return s;
+}
+
+Status TableIngestor::Finish(VersionEdit* edit) {
+  assert(!finished_);
+  if (status_.ok() && builder_ != nullptr) {
+    status_ = CloseFile();
+  }
+  if (!status_.ok()) {
+    return status_;
+  }
+
+  Version* current = versions_->current();
+  for (const FileMetaData& f : files_) {
+    const int level = current->PickLevelForIngestedFile(f.smallest.user_key(),
+                                                        f.largest.user_key());
+    edit->AddFile(level, f.number, f.file_size, f.smallest, f.largest);
+  }
+  if (!files_.empty()) {
+    edit->SetLastSequence(sequence_);
+  }
+  finished_ = true;
+  return status_;
+}
+
+}  // namespace leveldb
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "dbformat.h"
+#include "options.h"
+#include "status.h"
+#include "version_edit.h"
+
+namespace leveldb {
+
+class Iterator;
+class TableBuilder;
+class VersionSet;
+class WritableFile;
+
+/**
+ * @brief TableIngestor
+ *
+ * @details Bulk loads already sorted data straight into table files,
+ * bypassing the memtable: no skiplist inserts, no arena, no flush. Every
+ * key of one ingestion is stamped with the same global sequence number,
+ * one past the last sequence of "versions", so the ingested data shadows
+ * anything already in the DB. Finish() places each file at the deepest
+ * level it does not overlap and describes the result in a single
+ * VersionEdit for the caller to apply with VersionSet::LogAndApply(), which
+ * also advances the last sequence. The files stay the ingestor's until the
+ * caller reports the edit applied with Commit(); Abandon() or the
+ * destructor removes them otherwise.
+ *
+ * Input keys are user keys and must be strictly increasing (by
+ * options.comparator) across all Add()/AddFile() calls.
+ *
+ * REQUIRES: no other writes to "versions" between construction and
+ * applying the edit, and no memtable data overlapping the ingested range
+ * (flush it first), otherwise a later flush could shadow the ingested
+ * values.
+ */
+class TableIngestor {
+ public:
+  TableIngestor(const std::string& dbname, const Options& options,
+                VersionSet* versions);
+
+  TableIngestor(const TableIngestor&) = delete;
+  TableIngestor& operator=(const TableIngestor&) = delete;
+
+  // Abandon()s the files unless they were committed.
+  ~TableIngestor();
+
+  // Append all entries of "input", which is positioned by SeekToFirst().
+  Status Add(Iterator* input);
+
+  // Append the contents of the table file "fname", which was written by a
+  // TableBuilder with user keys (e.g. by an offline job).
+  Status AddFile(const std::string& fname);
+
+  // Close the last file and record every file in *edit at its level,
+  // together with the new last sequence number. Neither the DB nor
+  // LastSequence() changes until the caller applies *edit.
+  Status Finish(VersionEdit* edit);
+
+  // The edit of Finish() was applied: the files belong to the DB now.
+  // REQUIRES: Finish() succeeded.
+  void Commit();
+
+  // Remove the files written so far, e.g. because applying the edit
+  // failed. REQUIRES: not committed.
+  void Abandon();
+
+  // The sequence number every ingested key carries.
+  SequenceNumber sequence() const { return sequence_; }
+
+  const std::vector<FileMetaData>& files() const { return files_; }
+
+ private:
+  Status OpenFile();
+  Status CloseFile();
+
+  const std::string dbname_;
+  Env* const env_;
+  const InternalKeyComparator icmp_;
+  Options table_options_;  // comparator == &icmp_
+  VersionSet* const versions_;
+  const SequenceNumber sequence_;
+
+  std::vector<FileMetaData> files_;
+  WritableFile* file_;
+  TableBuilder* builder_;
+  std::string last_key_;  // last user key added
+  std::string ikey_;      // scratch for the internal key
+  bool has_last_key_;
+  bool finished_;
+  bool committed_;
+  Status status_;
+};
+
+}  // namespace leveldb
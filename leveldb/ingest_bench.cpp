@@ -0,0 +1,193 @@
+// Bulk load throughput: memtable path versus direct table ingestion.
+//
+// Loads --num sorted keys into an empty directory twice. The memtable path
+// inserts every record into a MemTable and flushes it with BuildTable each
+// time it reaches --write_buffer_mb, as a backfill through the normal write
+// path does (minus the log). The ingest path hands the same sorted stream to
+// a TableIngestor. We report records/s, MB/s and the number of files.
+//
+// Usage: ingest_bench [--dir=PATH] [--num=N] [--value_size=N]
+//                     [--write_buffer_mb=N] [--file_mb=N]
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "builder.h"
+#include "dbformat.h"
+#include "env.h"
+#include "filename.h"
+#include "ingest.h"
+#include "iterator.h"
+#include "memtable.h"
+#include "options.h"
+#include "version_edit.h"
+#include "version_set.h"
+#include "utils/random.h"
+
+namespace leveldb {
+namespace {
+
+std::string FLAGS_dir = "/tmp/ingest_bench";
+uint64_t FLAGS_num = 2000000;
+uint64_t FLAGS_value_size = 100;
+uint64_t FLAGS_write_buffer_mb = 4;
+uint64_t FLAGS_file_mb = 2;
+
+double NowSeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Yields FLAGS_num sorted keys with pseudo-random values.
+class SortedInput : public Iterator {
+ public:
+  SortedInput() : rnd_(301), value_(FLAGS_value_size, 'x') {}
+
+  bool Valid() const override { return i_ < FLAGS_num; }
+  void SeekToFirst() override {
+    i_ = 0;
+    Fill();
+  }
+  void Next() override {
+    i_++;
+    Fill();
+  }
+  Slice key() const override { return Slice(key_, 16); }
+  Slice value() const override { return value_; }
+  Status status() const override { return Status::OK(); }
+
+  // Not needed for a one-pass load.
+  void SeekToLast() override { i_ = FLAGS_num; }
+  void Seek(const Slice&) override { i_ = FLAGS_num; }
+  void Prev() override { i_ = FLAGS_num; }
+
+ private:
+  void Fill() {
+    std::snprintf(key_, sizeof(key_), "%016llu",
+                  static_cast<unsigned long long>(i_));
+    for (size_t j = 0; j < value_.size(); j += 4) {
+      value_[j] = 'a' + rnd_.Uniform(26);
+    }
+  }
+
+  Random rnd_;
+  uint64_t i_ = 0;
+  char key_[17];
+  std::string value_;
+};
+
+void Check(const Status& s) {
+  if (!s.ok()) {
+    std::fprintf(stderr, "%s\n", s.ToString().c_str());
+    std::exit(1);
+  }
+}
+
+void CleanDir(Env* env) {
+  std::vector<std::string> children;
+  env->CreateDir(FLAGS_dir);
+  env->GetChildren(FLAGS_dir, &children);
+  for (const std::string& child : children) {
+    uint64_t number;
+    FileType type;
+    if (ParseFileName(child, &number, &type)) {
+      env->RemoveFile(FLAGS_dir + "/" + child);
+    }
+  }
+}
+
+void Report(const char* name, double secs, int files) {
+  const double bytes = FLAGS_num * (16.0 + FLAGS_value_size);
+  std::printf("%s\t%llu\t%.0f\t%.1f\t%d\n", name,
+              static_cast<unsigned long long>(FLAGS_num), FLAGS_num / secs,
+              bytes / secs / 1048576.0, files);
+}
+
+void BenchMemTable(const Options& options) {
+  Env* env = options.env;
+  CleanDir(env);
+  InternalKeyComparator icmp(options.comparator);
+  Options table_options = options;
+  table_options.comparator = &icmp;
+  VersionSet versions(FLAGS_dir, &options, nullptr, &icmp);
+
+  double start = NowSeconds();
+  SequenceNumber seq = versions.LastSequence();
+  int files = 0;
+  MemTable* mem = nullptr;
+  auto flush = [&]() {
+    FileMetaData meta;
+    meta.number = versions.NewFileNumber();
+    Iterator* iter = mem->NewIterator();
+    Check(BuildTable(FLAGS_dir, env, table_options, iter, &meta));
+    delete iter;
+    mem->Unref();
+    mem = nullptr;
+    files++;
+  };
+  SortedInput input;
+  for (input.SeekToFirst(); input.Valid(); input.Next()) {
+    if (mem == nullptr) {
+      mem = new MemTable(icmp);
+      mem->Ref();
+    }
+    mem->Add(++seq, kTypeValue, input.key(), input.value());
+    if (mem->ApproximateMemoryUsage() >= options.write_buffer_size) {
+      flush();
+    }
+  }
+  if (mem != nullptr) flush();
+  versions.SetLastSequence(seq);
+  Report("memtable", NowSeconds() - start, files);
+}
+
+void BenchIngest(const Options& options) {
+  CleanDir(options.env);
+  InternalKeyComparator icmp(options.comparator);
+  VersionSet versions(FLAGS_dir, &options, nullptr, &icmp);
+
+  double start = NowSeconds();
+  TableIngestor ingestor(FLAGS_dir, options, &versions);
+  SortedInput input;
+  Check(ingestor.Add(&input));
+  VersionEdit edit;
+  Check(ingestor.Finish(&edit));
+  Report("ingest", NowSeconds() - start, ingestor.files().size());
+}
+
+}  // namespace
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  using namespace leveldb;
+  for (int i = 1; i < argc; i++) {
+    unsigned long long n;
+    char junk;
+    if (strncmp(argv[i], "--dir=", 6) == 0) {
+      FLAGS_dir = argv[i] + 6;
+    } else if (sscanf(argv[i], "--num=%llu%c", &n, &junk) == 1) {
+      FLAGS_num = n;
+    } else if (sscanf(argv[i], "--value_size=%llu%c", &n, &junk) == 1) {
+      FLAGS_value_size = n;
+    } else if (sscanf(argv[i], "--write_buffer_mb=%llu%c", &n, &junk) == 1) {
+      FLAGS_write_buffer_mb = n;
+    } else if (sscanf(argv[i], "--file_mb=%llu%c", &n, &junk) == 1) {
+      FLAGS_file_mb = n;
+    } else {
+      std::fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+
+  Options options;
+  options.write_buffer_size = FLAGS_write_buffer_mb << 20;
+  options.max_file_size = FLAGS_file_mb << 20;
+
+  std::printf("path\trecords\trecords_per_sec\tmb_per_sec\tfiles\n");
+  BenchMemTable(options);
+  BenchIngest(options);
+  CleanDir(options.env);
+  return 0;
+}
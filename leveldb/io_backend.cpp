@@ -0,0 +1,185 @@
+#include "io_backend.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace leveldb {
+
+Status IOBackend::MultiRead(int fd, ReadRequest* reqs, size_t n) {
+  ReadBatch batch(fd, reqs, n);
+  Submit(&batch);
+  Wait(&batch);
+  for (size_t i = 0; i < n; i++) {
+    if (!reqs[i].status.ok()) {
+      return reqs[i].status;
+    }
+  }
+  return Status::OK();
+}
+
+class ThreadPoolBackend : public IOBackend {
+ public:
+  explicit ThreadPoolBackend(int num_threads) {
+    for (int i = 0; i < num_threads; i++) {
+      threads_.emplace_back(&ThreadPoolBackend::WorkerLoop, this);
+    }
+  }
+
+  ~ThreadPoolBackend() override {
+    {
+      std::lock_guard<std::mutex> l(mu_);
+      shutting_down_ = true;
+    }
+    work_cv_.notify_all();
+    for (auto& t : threads_) {
+      t.join();
+    }
+  }
+
+  void Submit(ReadBatch* batch) override {
+    if (batch->n == 0) return;
+    std::lock_guard<std::mutex> l(mu_);
+    batch->pending.store(batch->n, std::memory_order_relaxed);
+    for (size_t i = 0; i < batch->n; i++) {
+      ReadRequest* req = &batch->reqs[i];
+      req->batch_ = batch;
+      req->bytes_done_ = 0;
+      queue_.push_back(req);
+    }
+    work_cv_.notify_all();
+  }
+
+  void Wait(ReadBatch* batch) override {
+    std::unique_lock<std::mutex> l(mu_);
+    done_cv_.wait(l, [batch] {
+      return batch->pending.load(std::memory_order_acquire) == 0;
+    });
+  }
+
+  const char* Name() const override { return "threadpool"; }
+
+ private:
+  static void Read(ReadRequest* req) {
+    const int fd = req->batch_->fd;
+    while (req->bytes_done_ < req->len) {
+      ssize_t r = ::pread(fd, req->scratch + req->bytes_done_,
+                          req->len - req->bytes_done_,
+                          req->offset + req->bytes_done_);
+      if (r < 0) {
+        if (errno == EINTR) continue;
+        req->status = Status::IOError("pread", strerror(errno));
+        break;
+      }
+      if (r == 0) break;  // EOF
+      req->bytes_done_ += r;
+    }
+    req->result = Slice(req->scratch, req->bytes_done_);
+  }
+
+  void WorkerLoop() {
+    std::unique_lock<std::mutex> l(mu_);
+    while (true) {
+      work_cv_.wait(l, [this] { return shutting_down_ || !queue_.empty(); });
+      if (queue_.empty()) return;  // shutting down
+      ReadRequest* req = queue_.front();
+      queue_.pop_front();
+
+      l.unlock();
+      req->status = Status::OK();
+      Read(req);
+      l.lock();
+
+      if (req->batch_->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        done_cv_.notify_all();
+      }
+    }
+  }
+
+  std::mutex mu_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  std::deque<ReadRequest*> queue_;
+  bool shutting_down_ = false;
+  std::vector<std::thread> threads_;
+};
+
+IOBackend* NewThreadPoolBackend(int num_threads) {
+  return new ThreadPoolBackend(num_threads < 1 ? 1 : num_threads);
+}
+
+IOBackend* NewDefaultIOBackend(unsigned queue_depth) {
+  Status s;
+  IOBackend* backend = NewIoUringBackend(queue_depth, &s);
+  if (backend == nullptr) {
+    // A pread thread per in-flight read, within reason.
+    backend = NewThreadPoolBackend(queue_depth > 64 ? 64 : queue_depth);
+  }
+  return backend;
+}
+
+BlockReadahead::BlockReadahead(IOBackend* backend, int fd,
+                               std::vector<BlockHandle> handles, int depth)
+    : backend_(backend), handles_(std::move(handles)) {
+  if (depth < 1) depth = 1;
+  for (int i = 0; i < depth; i++) {
+    slots_.emplace_back(new Slot(fd));
+  }
+  for (size_t b = 0; b < handles_.size() && b < slots_.size(); b++) {
+    StartRead(b);
+  }
+}
+
+BlockReadahead::~BlockReadahead() {
+  for (auto& slot : slots_) {
+    if (slot->in_flight) {
+      backend_->Wait(&slot->batch);
+    }
+  }
+}
+
+void BlockReadahead::StartRead(size_t block) {
+  Slot* slot = slots_[block % slots_.size()].get();
+  assert(!slot->in_flight);
+  const size_t n = handles_[block].size() + kBlockTrailerSize;
+  if (slot->buf_size < n) {
+    slot->buf.reset(new char[n]);
+    slot->buf_size = n;
+  }
+  slot->req.offset = handles_[block].offset();
+  slot->req.len = n;
+  slot->req.scratch = slot->buf.get();
+  slot->in_flight = true;
+  backend_->Submit(&slot->batch);
+}
+
+Status BlockReadahead::Next(Slice* contents) {
+  assert(!Done());
+  // The caller is done with the previous block: reuse its slot for the read
+  // "depth" blocks ahead.
+  if (next_ > 0 && next_ - 1 + slots_.size() < handles_.size()) {
+    StartRead(next_ - 1 + slots_.size());
+  }
+
+  const size_t block = next_++;
+  Slot* slot = slots_[block % slots_.size()].get();
+  backend_->Wait(&slot->batch);
+  slot->in_flight = false;
+
+  if (!slot->req.status.ok()) {
+    return slot->req.status;
+  }
+  const size_t n = handles_[block].size();
+  if (slot->req.result.size() != n + kBlockTrailerSize) {
+    return Status::Corruption("truncated block read");
+  }
+  *contents = Slice(slot->req.result.data(), n);
+  return Status::OK();
+}
+
+}  // namespace leveldb
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "format.h"
+#include "slice.h"
+#include "status.h"
+
+namespace leveldb {
+
+struct ReadBatch;
+
+// One positional read. The caller owns "scratch", which must hold at least
+// "len" bytes and stay alive until the read completes.
+struct ReadRequest {
+  uint64_t offset = 0;
+  size_t len = 0;
+  char* scratch = nullptr;
+
+  // Set on completion. "result" is shorter than "len" only at end of file.
+  Slice result;
+  Status status;
+
+ private:
+  friend class IoUringBackend;
+  friend class ThreadPoolBackend;
+
+  ReadBatch* batch_ = nullptr;
+  size_t bytes_done_ = 0;
+};
+
+// A group of reads against one file that is submitted together and waited
+// for as a unit.
+struct ReadBatch {
+  ReadBatch(int fd, ReadRequest* reqs, size_t n) : fd(fd), reqs(reqs), n(n) {}
+
+  ReadBatch(const ReadBatch&) = delete;
+  ReadBatch& operator=(const ReadBatch&) = delete;
+
+  const int fd;
+  ReadRequest* const reqs;
+  const size_t n;
+
+  // Number of requests not completed yet.
+  std::atomic<size_t> pending{0};
+};
+
+/**
+ * @brief IOBackend
+ *
+ * @details Issues block reads asynchronously so that callers with many
+ * independent reads (multi-get, compaction input scans) can keep them in
+ * flight together instead of paying one blocking pread per block.
+ *
+ * Backends are thread-safe. A batch must stay alive until Wait() returned.
+ */
+class IOBackend {
+ public:
+  IOBackend() = default;
+  IOBackend(const IOBackend&) = delete;
+  IOBackend& operator=(const IOBackend&) = delete;
+  virtual ~IOBackend() = default;
+
+  // Start all reads of "batch" and return without waiting for them.
+  virtual void Submit(ReadBatch* batch) = 0;
+
+  // Block until every read of "batch" completed.
+  virtual void Wait(ReadBatch* batch) = 0;
+
+  virtual const char* Name() const = 0;
+
+  // Submit the reads as one batch and wait for all of them. Returns the
+  // first error, the per-request status is in each ReadRequest.
+  Status MultiRead(int fd, ReadRequest* reqs, size_t n);
+};
+
+// Returns an io_uring backend with "queue_depth" submission entries, or
+// nullptr with *status set if the kernel does not support io_uring (or
+// IORING_OP_READ, which needs Linux 5.6).
+IOBackend* NewIoUringBackend(unsigned queue_depth, Status* status);
+
+// Portable fallback: "num_threads" threads issuing blocking preads.
+IOBackend* NewThreadPoolBackend(int num_threads);
+
+// io_uring if the kernel supports it, otherwise the thread pool.
+IOBackend* NewDefaultIOBackend(unsigned queue_depth);
+
+/**
+ * @brief BlockReadahead
+ *
+ * @details Sequential reader for a list of blocks in file order, as consumed
+ * by compaction input iterators. Up to "depth" blocks ahead of the one
+ * being consumed are kept in flight, so the next block is usually already in
+ * memory when the caller asks for it.
+ *
+ * Each read covers the block and its kBlockTrailerSize trailer; the trailer
+ * bytes directly follow the returned contents.
+ */
+class BlockReadahead {
+ public:
+  BlockReadahead(IOBackend* backend, int fd, std::vector<BlockHandle> handles,
+                 int depth);
+
+  BlockReadahead(const BlockReadahead&) = delete;
+  BlockReadahead& operator=(const BlockReadahead&) = delete;
+
+  ~BlockReadahead();
+
+  bool Done() const { return next_ >= handles_.size(); }
+
+  // Return the contents of the next block. The data stays valid until the
+  // next call. REQUIRES: !Done()
+  Status Next(Slice* contents);
+
+ private:
+  struct Slot {
+    Slot(int fd) : batch(fd, &req, 1) {}
+    ReadRequest req;
+    ReadBatch batch;
+    std::unique_ptr<char[]> buf;
+    size_t buf_size = 0;
+    bool in_flight = false;
+  };
+
+  void StartRead(size_t block);
+
+  IOBackend* const backend_;
+  const std::vector<BlockHandle> handles_;
+  std::vector<std::unique_ptr<Slot>> slots_;
+  size_t next_ = 0;  // next block handed out by Next()
+};
+
+}  // namespace leveldb
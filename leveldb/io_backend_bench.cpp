@@ -0,0 +1,148 @@
+// Random block read throughput against queue depth.
+//
+// Creates (or reuses) a local file and issues random block-aligned reads,
+// "depth" at a time, through each available IOBackend. With --direct=1 the
+// file is opened with O_DIRECT so the numbers reflect the device rather
+// than the page cache.
+//
+// Usage: io_backend_bench [--file=PATH] [--file_mb=N] [--block_size=N]
+//                         [--reads=N] [--max_depth=N] [--direct=0|1]
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "io_backend.h"
+#include "utils/random.h"
+
+namespace leveldb {
+namespace {
+
+std::string FLAGS_file = "/tmp/io_backend_bench.dat";
+uint64_t FLAGS_file_mb = 1024;
+uint64_t FLAGS_block_size = 4096;
+uint64_t FLAGS_reads = 200000;
+unsigned FLAGS_max_depth = 128;
+bool FLAGS_direct = true;
+
+bool PrepareFile() {
+  const uint64_t size = FLAGS_file_mb << 20;
+  int fd = ::open(FLAGS_file.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    std::perror("open");
+    return false;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) == 0 && static_cast<uint64_t>(st.st_size) >= size) {
+    ::close(fd);
+    return true;
+  }
+  std::string buf(1 << 20, 'x');
+  for (uint64_t written = 0; written < size; written += buf.size()) {
+    if (::write(fd, buf.data(), buf.size()) != static_cast<ssize_t>(buf.size())) {
+      std::perror("write");
+      ::close(fd);
+      return false;
+    }
+  }
+  ::fsync(fd);
+  ::close(fd);
+  return true;
+}
+
+void Bench(IOBackend* backend, int fd, unsigned depth) {
+  const uint64_t num_blocks = (FLAGS_file_mb << 20) / FLAGS_block_size;
+  std::vector<ReadRequest> reqs(depth);
+  char* buf;
+  if (posix_memalign(reinterpret_cast<void**>(&buf), 4096,
+                     depth * FLAGS_block_size) != 0) {
+    std::abort();
+  }
+  for (unsigned i = 0; i < depth; i++) {
+    reqs[i].len = FLAGS_block_size;
+    reqs[i].scratch = buf + i * FLAGS_block_size;
+  }
+
+  Random rnd(301);
+  auto start = std::chrono::steady_clock::now();
+  uint64_t done = 0;
+  while (done < FLAGS_reads) {
+    for (unsigned i = 0; i < depth; i++) {
+      reqs[i].offset = (rnd.Next() % num_blocks) * FLAGS_block_size;
+    }
+    Status s = backend->MultiRead(fd, reqs.data(), depth);
+    if (!s.ok()) {
+      std::fprintf(stderr, "%s\n", s.ToString().c_str());
+      std::abort();
+    }
+    done += depth;
+  }
+  std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+  double iops = done / secs.count();
+  std::printf("%s\t%u\t%.0f\t%.1f\n", backend->Name(), depth, iops,
+              iops * FLAGS_block_size / 1048576.0);
+  free(buf);
+}
+
+}  // namespace
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  using namespace leveldb;
+  for (int i = 1; i < argc; i++) {
+    unsigned long long n;
+    char junk;
+    if (strncmp(argv[i], "--file=", 7) == 0) {
+      FLAGS_file = argv[i] + 7;
+    } else if (sscanf(argv[i], "--file_mb=%llu%c", &n, &junk) == 1) {
+      FLAGS_file_mb = n;
+    } else if (sscanf(argv[i], "--block_size=%llu%c", &n, &junk) == 1) {
+      FLAGS_block_size = n;
+    } else if (sscanf(argv[i], "--reads=%llu%c", &n, &junk) == 1) {
+      FLAGS_reads = n;
+    } else if (sscanf(argv[i], "--max_depth=%llu%c", &n, &junk) == 1) {
+      FLAGS_max_depth = static_cast<unsigned>(n);
+    } else if (sscanf(argv[i], "--direct=%llu%c", &n, &junk) == 1) {
+      FLAGS_direct = (n != 0);
+    } else {
+      std::fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+
+  if (!PrepareFile()) return 1;
+  int fd = -1;
+  if (FLAGS_direct) {
+    fd = ::open(FLAGS_file.c_str(), O_RDONLY | O_DIRECT);
+    if (fd < 0) {
+      std::fprintf(stderr, "O_DIRECT not supported here, using page cache\n");
+    }
+  }
+  if (fd < 0) fd = ::open(FLAGS_file.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::perror("open");
+    return 1;
+  }
+
+  std::printf("backend\tdepth\tiops\tmb_per_sec\n");
+  for (unsigned depth = 1; depth <= FLAGS_max_depth; depth *= 2) {
+    Status s;
+    std::unique_ptr<IOBackend> uring(NewIoUringBackend(depth, &s));
+    if (uring != nullptr) {
+      Bench(uring.get(), fd, depth);
+    } else if (depth == 1) {
+      std::fprintf(stderr, "skipping io_uring: %s\n", s.ToString().c_str());
+    }
+    std::unique_ptr<IOBackend> pool(NewThreadPoolBackend(depth));
+    Bench(pool.get(), fd, depth);
+  }
+  ::close(fd);
+  return 0;
+}
@@ -0,0 +1,257 @@
+// io_uring implementation of IOBackend.
+//
+// Talks to the kernel through the raw io_uring_setup/io_uring_enter system
+// calls so that the build does not depend on liburing.
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+
+#include "io_backend.h"
+
+namespace leveldb {
+
+namespace {
+
+int SysSetup(unsigned entries, struct io_uring_params* p) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+int SysEnter(int fd, unsigned to_submit, unsigned min_complete,
+             unsigned flags) {
+  return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit,
+                                    min_complete, flags, nullptr, 0));
+}
+
+}  // namespace
+
+class IoUringBackend : public IOBackend {
+ public:
+  static IoUringBackend* Open(unsigned queue_depth, Status* status);
+
+  ~IoUringBackend() override;
+
+  void Submit(ReadBatch* batch) override;
+  void Wait(ReadBatch* batch) override;
+
+  const char* Name() const override { return "io_uring"; }
+
+ private:
+  IoUringBackend() = default;
+
+  // REQUIRES: mu_ held, a free submission entry.
+  void Queue(ReadRequest* req);
+  // Push queued entries to the kernel. REQUIRES: mu_ held.
+  void Enter();
+  // Process all available completions. REQUIRES: mu_ held, reaping_ set
+  // by this thread.
+  void Reap();
+  // Wait until some reads completed and were reaped. One thread at a time
+  // blocks in the kernel, with mu_ released so that others can submit;
+  // the other waiters sleep on reaped_cv_ until it reaped.
+  // REQUIRES: *l holds mu_, reads in flight.
+  void AwaitCompletions(std::unique_lock<std::mutex>* l);
+
+  int ring_fd_ = -1;
+  unsigned depth_ = 0;
+
+  void* ring_ptr_ = MAP_FAILED;
+  size_t ring_len_ = 0;
+  io_uring_sqe* sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+  size_t sqes_len_ = 0;
+
+  unsigned* sq_tail_ = nullptr;
+  unsigned* sq_mask_ = nullptr;
+  unsigned* sq_array_ = nullptr;
+  unsigned* cq_head_ = nullptr;
+  unsigned* cq_tail_ = nullptr;
+  unsigned* cq_mask_ = nullptr;
+  io_uring_cqe* cqes_ = nullptr;
+
+  std::mutex mu_;
+  std::condition_variable reaped_cv_;
+  // A thread waits for completions in the kernel. Only it reaps: anyone
+  // else could take the completions it waits for and leave it blocked.
+  bool reaping_ = false;
+  unsigned in_flight_ = 0;    // queued or submitted, not yet reaped
+  unsigned unsubmitted_ = 0;  // queued but not yet passed to the kernel
+};
+
+IoUringBackend* IoUringBackend::Open(unsigned queue_depth, Status* status) {
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  int fd = SysSetup(queue_depth, &p);
+  if (fd < 0) {
+    *status = Status::NotSupported("io_uring_setup", strerror(errno));
+    return nullptr;
+  }
+  // IORING_FEAT_RW_CUR_POS arrived together with IORING_OP_READ (5.6).
+  if (!(p.features & IORING_FEAT_SINGLE_MMAP) ||
+      !(p.features & IORING_FEAT_RW_CUR_POS)) {
+    ::close(fd);
+    *status = Status::NotSupported("io_uring: kernel too old");
+    return nullptr;
+  }
+
+  IoUringBackend* r = new IoUringBackend;
+  r->ring_fd_ = fd;
+  r->depth_ = p.sq_entries;
+
+  size_t sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  size_t cq_len = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+  r->ring_len_ = sq_len > cq_len ? sq_len : cq_len;
+  r->ring_ptr_ = ::mmap(nullptr, r->ring_len_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  r->sqes_len_ = p.sq_entries * sizeof(io_uring_sqe);
+  r->sqes_ = static_cast<io_uring_sqe*>(
+      ::mmap(nullptr, r->sqes_len_, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+  if (r->ring_ptr_ == MAP_FAILED || r->sqes_ == MAP_FAILED) {
+    *status = Status::IOError("io_uring mmap", strerror(errno));
+    delete r;
+    return nullptr;
+  }
+
+  char* ring = static_cast<char*>(r->ring_ptr_);
+  r->sq_tail_ = reinterpret_cast<unsigned*>(ring + p.sq_off.tail);
+  r->sq_mask_ = reinterpret_cast<unsigned*>(ring + p.sq_off.ring_mask);
+  r->sq_array_ = reinterpret_cast<unsigned*>(ring + p.sq_off.array);
+  r->cq_head_ = reinterpret_cast<unsigned*>(ring + p.cq_off.head);
+  r->cq_tail_ = reinterpret_cast<unsigned*>(ring + p.cq_off.tail);
+  r->cq_mask_ = reinterpret_cast<unsigned*>(ring + p.cq_off.ring_mask);
+  r->cqes_ = reinterpret_cast<io_uring_cqe*>(ring + p.cq_off.cqes);
+  return r;
+}
+
+IoUringBackend::~IoUringBackend() {
+  assert(in_flight_ == 0);
+  if (sqes_ != MAP_FAILED) ::munmap(sqes_, sqes_len_);
+  if (ring_ptr_ != MAP_FAILED) ::munmap(ring_ptr_, ring_len_);
+  if (ring_fd_ >= 0) ::close(ring_fd_);
+}
+
+void IoUringBackend::Queue(ReadRequest* req) {
+  assert(in_flight_ < depth_);
+  // Only we write the tail, the kernel only reads it.
+  unsigned tail = *sq_tail_;
+  unsigned index = tail & *sq_mask_;
+  io_uring_sqe* sqe = &sqes_[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = req->batch_->fd;
+  sqe->addr = reinterpret_cast<uint64_t>(req->scratch + req->bytes_done_);
+  sqe->len = static_cast<uint32_t>(req->len - req->bytes_done_);
+  sqe->off = req->offset + req->bytes_done_;
+  sqe->user_data = reinterpret_cast<uint64_t>(req);
+  sq_array_[index] = index;
+  __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+  in_flight_++;
+  unsubmitted_++;
+}
+
+void IoUringBackend::Enter() {
+  while (unsubmitted_ > 0) {
+    int r = SysEnter(ring_fd_, unsubmitted_, 0, 0);
+    if (r < 0) {
+      if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+      // The ring itself is broken; there is nothing sensible to recover.
+      std::fprintf(stderr, "io_uring_enter: %s\n", strerror(errno));
+      std::abort();
+    }
+    unsubmitted_ -= static_cast<unsigned>(r);
+  }
+}
+
+void IoUringBackend::Reap() {
+  unsigned head = *cq_head_;
+  unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+  while (head != tail) {
+    const io_uring_cqe* cqe = &cqes_[head & *cq_mask_];
+    ReadRequest* req = reinterpret_cast<ReadRequest*>(cqe->user_data);
+    int res = cqe->res;
+    head++;
+    in_flight_--;
+
+    bool finished = true;
+    if (res == -EAGAIN || res == -EINTR) {
+      finished = false;
+    } else if (res < 0) {
+      req->status = Status::IOError("io_uring read", strerror(-res));
+    } else if (res > 0) {
+      req->bytes_done_ += res;
+      finished = req->bytes_done_ >= req->len;
+    }
+    if (!finished) {
+      // Short read or transient error: queue the remainder. The slot of the
+      // completion we just consumed is free again.
+      Queue(req);
+      continue;
+    }
+    req->result = Slice(req->scratch, req->bytes_done_);
+    req->batch_->pending.fetch_sub(1, std::memory_order_release);
+  }
+  __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+}
+
+void IoUringBackend::AwaitCompletions(std::unique_lock<std::mutex>* l) {
+  assert(in_flight_ > 0);
+  if (reaping_) {
+    reaped_cv_.wait(*l);
+    return;
+  }
+  reaping_ = true;
+  Enter();
+  l->unlock();
+  // Submission and completion waits may share the ring: the kernel
+  // serializes submissions, and we submit nothing here.
+  while (SysEnter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS) < 0) {
+    if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+    std::fprintf(stderr, "io_uring_enter: %s\n", strerror(errno));
+    std::abort();
+  }
+  l->lock();
+  Reap();
+  // Reap() queues the remainder of short reads.
+  Enter();
+  reaping_ = false;
+  reaped_cv_.notify_all();
+}
+
+void IoUringBackend::Submit(ReadBatch* batch) {
+  if (batch->n == 0) return;
+  std::unique_lock<std::mutex> l(mu_);
+  batch->pending.store(batch->n, std::memory_order_relaxed);
+  for (size_t i = 0; i < batch->n; i++) {
+    ReadRequest* req = &batch->reqs[i];
+    req->batch_ = batch;
+    req->bytes_done_ = 0;
+    req->status = Status::OK();
+    while (in_flight_ == depth_) {
+      // Ring is full: make room by retiring at least one read.
+      AwaitCompletions(&l);
+    }
+    Queue(req);
+  }
+  Enter();
+}
+
+void IoUringBackend::Wait(ReadBatch* batch) {
+  std::unique_lock<std::mutex> l(mu_);
+  while (batch->pending.load(std::memory_order_acquire) > 0) {
+    AwaitCompletions(&l);
+  }
+}
+
+IOBackend* NewIoUringBackend(unsigned queue_depth, Status* status) {
+  return IoUringBackend::Open(queue_depth, status);
+}
+
+}  // namespace leveldb
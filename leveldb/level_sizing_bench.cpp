@@ -0,0 +1,281 @@
+// Write and space amplification of static and dynamic level targets.
+//
+// A simulation: the real VersionSet picks every flush level and every
+// compaction, but tables only exist as the sorted key lists this program
+// keeps for them, so a run over a gigabyte of user data takes seconds.
+// Each round, a memtable of --write_buffer_mb of random updates over
+// --keys keys (of --entry_size bytes each) is flushed, and the compactions
+// the VersionSet asks for are run to completion. A compaction merges the
+// key lists of its inputs, dropping overwritten entries, and cuts the
+// result into tables the way CompactionJob would.
+//
+//   write_amp: table bytes written by flushes and compactions per user
+//              byte written;
+//   space_amp: table bytes per byte of live data, averaged over the
+//              second half of the run.
+//
+// With static targets (10MB, 100MB, 1GB, ...) a DB whose size falls just
+// past a power of the multiplier keeps a nearly empty last level under
+// full upper levels. Dynamic targets are sized from the last level, so
+// the levels above it hold about a tenth of the data whatever its size.
+//
+// Usage: level_sizing_bench [--dir=PATH] [--keys_min=N] [--keys_max=N]
+//                           [--writes_per_key=N] [--entry_size=N]
+//                           [--write_buffer_mb=N]
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "dbformat.h"
+#include "env.h"
+#include "filename.h"
+#include "options.h"
+#include "utils/random.h"
+#include "version_edit.h"
+#include "version_set.h"
+
+namespace leveldb {
+namespace {
+
+std::string FLAGS_dir = "/tmp/level_sizing_bench";
+uint64_t FLAGS_keys_min = 1 << 20;
+uint64_t FLAGS_keys_max = 4 << 20;
+uint64_t FLAGS_writes_per_key = 3;
+uint64_t FLAGS_entry_size = 100;
+uint64_t FLAGS_write_buffer_mb = 4;
+
+void CleanDir(Env* env) {
+  std::vector<std::string> children;
+  env->CreateDir(FLAGS_dir);
+  env->GetChildren(FLAGS_dir, &children);
+  for (const std::string& child : children) {
+    uint64_t number;
+    FileType type;
+    if (ParseFileName(child, &number, &type)) {
+      env->RemoveFile(FLAGS_dir + "/" + child);
+    }
+  }
+}
+
+void Check(const Status& s) {
+  if (!s.ok()) {
+    std::fprintf(stderr, "%s\n", s.ToString().c_str());
+    std::exit(1);
+  }
+}
+
+std::string Key(uint32_t k) {
+  char buf[16];
+  std::snprintf(buf, sizeof(buf), "%08x", k);
+  return buf;
+}
+
+class Simulation {
+ public:
+  explicit Simulation(const Options& options)
+      : options_(options),
+        icmp_(options.comparator),
+        versions_(FLAGS_dir, &options_, nullptr, &icmp_),
+        written_bytes_(0) {}
+
+  // Flush one memtable of "keys" and run the compactions it triggers.
+  void Flush(std::vector<uint32_t>* keys) {
+    std::sort(keys->begin(), keys->end());
+    keys->erase(std::unique(keys->begin(), keys->end()), keys->end());
+    VersionEdit edit;
+    if (written_bytes_ == 0) {
+      edit.SetComparatorName(icmp_.user_comparator()->Name());
+    }
+    const int level = versions_.current()->PickLevelForMemTableOutput(
+        Key(keys->front()), Key(keys->back()));
+    AddTable(&edit, level, keys->begin(), keys->end());
+    Apply(&edit);
+
+    while (versions_.NeedsCompaction()) {
+      Compaction* c = versions_.PickCompaction();
+      Compact(c);
+      delete c;
+    }
+  }
+
+  // Table bytes written by flushes and compactions.
+  uint64_t written_bytes() const { return written_bytes_; }
+
+  uint64_t LevelBytes(int level) const {
+    return versions_.NumLevelBytes(level);
+  }
+
+  uint64_t TotalBytes() const {
+    uint64_t sum = 0;
+    for (int level = 0; level < config::kNumLevels; level++) {
+      sum += LevelBytes(level);
+    }
+    return sum;
+  }
+
+ private:
+  void AddTable(VersionEdit* edit, int level,
+                std::vector<uint32_t>::const_iterator begin,
+                std::vector<uint32_t>::const_iterator end) {
+    const uint64_t number = versions_.NewFileNumber();
+    const uint64_t file_size = (end - begin) * FLAGS_entry_size;
+    const SequenceNumber seq = versions_.LastSequence() + 1;
+    versions_.SetLastSequence(seq);
+    edit->AddFile(level, number, file_size,
+                  InternalKey(Key(*begin), seq, kTypeValue),
+                  InternalKey(Key(*(end - 1)), seq, kTypeValue));
+    tables_[number].assign(begin, end);
+    written_bytes_ += file_size;
+  }
+
+  void Apply(VersionEdit* edit) {
+    std::lock_guard<std::mutex> l(mu_);
+    Check(versions_.LogAndApply(edit, &mu_));
+  }
+
+  void Compact(Compaction* c) {
+    VersionEdit* edit = c->edit();
+    if (c->IsTrivialMove()) {
+      FileMetaData* f = c->input(0, 0);
+      edit->RemoveFile(c->level(), f->number);
+      edit->AddFile(c->output_level(), f->number, f->file_size, f->smallest,
+                    f->largest);
+      Apply(edit);
+      return;
+    }
+
+    std::vector<uint32_t> keys;
+    std::vector<uint64_t> inputs;
+    for (int which = 0; which < 2; which++) {
+      for (int i = 0; i < c->num_input_files(which); i++) {
+        const uint64_t number = c->input(which, i)->number;
+        const std::vector<uint32_t>& table = tables_[number];
+        keys.insert(keys.end(), table.begin(), table.end());
+        inputs.push_back(number);
+      }
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    c->AddInputDeletions(edit);
+    const uint64_t max_entries = c->MaxOutputFileSize() / FLAGS_entry_size;
+    auto start = keys.cbegin();
+    for (auto it = keys.cbegin(); it != keys.cend(); ++it) {
+      const InternalKey ikey(Key(*it), 0, kTypeValue);
+      if (it != start && (static_cast<uint64_t>(it - start) >= max_entries ||
+                          c->ShouldStopBefore(ikey.Encode()))) {
+        AddTable(edit, c->output_level(), start, it);
+        start = it;
+      }
+    }
+    if (start != keys.cend()) {
+      AddTable(edit, c->output_level(), start, keys.cend());
+    }
+    Apply(edit);
+    for (uint64_t number : inputs) {
+      tables_.erase(number);
+    }
+  }
+
+  Options options_;
+  const InternalKeyComparator icmp_;
+  VersionSet versions_;
+  std::mutex mu_;
+
+  // Keys of every live table, by file number.
+  std::map<uint64_t, std::vector<uint32_t>> tables_;
+  uint64_t written_bytes_;
+};
+
+void Bench(uint64_t num_keys, bool dynamic) {
+  CleanDir(Env::Default());
+  Options options;
+  options.level_compaction_dynamic_level_bytes = dynamic;
+  Simulation sim(options);
+
+  Random rnd(301);
+  std::vector<bool> written(num_keys);
+  uint64_t live_keys = 0;
+  const uint64_t writes = num_keys * FLAGS_writes_per_key;
+  const uint64_t per_memtable = (FLAGS_write_buffer_mb << 20) / FLAGS_entry_size;
+  double space_amp_sum = 0;
+  int samples = 0;
+  std::vector<uint32_t> memtable;
+  for (uint64_t done = 0; done < writes;) {
+    memtable.clear();
+    for (uint64_t i = 0; i < per_memtable && done < writes; i++, done++) {
+      const uint32_t k =
+          (static_cast<uint64_t>(rnd.Next()) << 31 | rnd.Next()) % num_keys;
+      if (!written[k]) {
+        written[k] = true;
+        live_keys++;
+      }
+      memtable.push_back(k);
+    }
+    sim.Flush(&memtable);
+    if (done >= writes / 2) {
+      space_amp_sum += static_cast<double>(sim.TotalBytes()) /
+                       (live_keys * FLAGS_entry_size);
+      samples++;
+    }
+  }
+
+  std::string levels;
+  for (int level = 0; level < config::kNumLevels; level++) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%s%.0f", level == 0 ? "" : ",",
+                  sim.LevelBytes(level) / 1048576.0);
+    levels += buf;
+  }
+  std::printf("%s\t%.0f\t%.0f\t%.2f\t%.3f\t%s\n",
+              dynamic ? "dynamic" : "static",
+              live_keys * FLAGS_entry_size / 1048576.0,
+              writes * FLAGS_entry_size / 1048576.0,
+              static_cast<double>(sim.written_bytes()) /
+                  (writes * FLAGS_entry_size),
+              space_amp_sum / samples, levels.c_str());
+}
+
+}  // namespace
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  using namespace leveldb;
+  for (int i = 1; i < argc; i++) {
+    unsigned long long n;
+    char junk;
+    if (strncmp(argv[i], "--dir=", 6) == 0) {
+      FLAGS_dir = argv[i] + 6;
+    } else if (sscanf(argv[i], "--keys_min=%llu%c", &n, &junk) == 1) {
+      FLAGS_keys_min = n;
+    } else if (sscanf(argv[i], "--keys_max=%llu%c", &n, &junk) == 1) {
+      FLAGS_keys_max = n;
+    } else if (sscanf(argv[i], "--writes_per_key=%llu%c", &n, &junk) == 1) {
+      FLAGS_writes_per_key = n;
+    } else if (sscanf(argv[i], "--entry_size=%llu%c", &n, &junk) == 1) {
+      FLAGS_entry_size = n;
+    } else if (sscanf(argv[i], "--write_buffer_mb=%llu%c", &n, &junk) == 1) {
+      FLAGS_write_buffer_mb = n;
+    } else {
+      std::fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+  if (FLAGS_keys_min == 0 || FLAGS_keys_min > FLAGS_keys_max ||
+      FLAGS_keys_max > (uint64_t{1} << 32) || FLAGS_entry_size == 0 ||
+      FLAGS_writes_per_key == 0) {
+    std::fprintf(stderr, "bad flags\n");
+    return 1;
+  }
+
+  std::printf("policy\tlive_mb\tuser_mb\twrite_amp\tspace_amp\tlevel_mb\n");
+  for (uint64_t keys = FLAGS_keys_min; keys <= FLAGS_keys_max; keys *= 2) {
+    Bench(keys, false);
+    Bench(keys, true);
+  }
+  return 0;
+}
@@ -0,0 +1,288 @@
+#include "log_parallel_reader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "env.h"
+#include "utils/coding.h"
+#include "utils/crc32c.h"
+
+namespace leveldb {
+namespace log {
+
+// 1MB per chunk: large enough to amortize the hand-off between threads.
+static const size_t kChunkSize = 32 * kBlockSize;
+
+// Fragment types beyond the record types.
+enum {
+  // Data was dropped; "bytes" and "status" say how much and why.  A zero
+  // length padding record is dropped without a report (status is ok).
+  kBadFragment = kMaxRecordType + 1,
+};
+
+struct ParallelReader::Fragment {
+  unsigned int type;
+  Slice data;
+  uint64_t bytes;  // dropped, for kBadFragment
+  Status status;
+};
+
+struct ParallelReader::Chunk {
+  std::string buf;  // whole blocks, the last one may be partial
+  std::vector<Fragment> fragments;
+  bool last = false;   // no more chunks follow
+  bool ready = false;  // fragments are filled in
+};
+
+ParallelReader::ParallelReader(SequentialFile* file,
+                               Reader::Reporter* reporter, int threads)
+    : file_(file),
+      reporter_(reporter),
+      max_chunks_(2 * std::max(threads, 1)),
+      eof_(false),
+      closing_(false),
+      current_(nullptr),
+      next_fragment_(0) {
+  for (int i = 0; i < std::max(threads, 1); i++) {
+    workers_.emplace_back(&ParallelReader::Work, this);
+  }
+}
+
+ParallelReader::~ParallelReader() {
+  {
+    std::lock_guard<std::mutex> l(mu_);
+    closing_ = true;
+  }
+  work_cv_.notify_all();
+  for (std::thread& t : workers_) {
+    t.join();
+  }
+}
+
+void ParallelReader::Work() {
+  std::unique_lock<std::mutex> l(mu_);
+  while (true) {
+    work_cv_.wait(l, [this] {
+      return closing_ || eof_ || chunks_.size() < max_chunks_;
+    });
+    if (closing_ || eof_) {
+      return;
+    }
+
+    // The file is sequential, so chunks are read under the lock, in
+    // order; checking them is what runs in parallel.
+    chunks_.emplace_back(new Chunk);
+    Chunk* c = chunks_.back().get();
+    c->buf.resize(kChunkSize);
+    size_t n = 0;
+    Status s;
+    while (n < kChunkSize) {
+      Slice fragment;
+      s = file_->Read(kChunkSize - n, &fragment, &c->buf[n]);
+      if (!s.ok() || fragment.empty()) {
+        break;
+      }
+      if (fragment.data() != &c->buf[n]) {
+        std::memmove(&c->buf[n], fragment.data(), fragment.size());
+      }
+      n += fragment.size();
+    }
+    c->buf.resize(n);
+    c->last = (n < kChunkSize);
+    eof_ = c->last;
+    l.unlock();
+
+    Parse(c);
+    if (!s.ok()) {
+      Fragment f;
+      f.type = kBadFragment;
+      f.bytes = kBlockSize;
+      f.status = s;
+      c->fragments.push_back(f);
+    }
+
+    l.lock();
+    c->ready = true;
+    ready_cv_.notify_all();
+  }
+}
+
+void ParallelReader::Parse(Chunk* c) const {
+  Fragment f;
+  for (size_t block = 0; block < c->buf.size(); block += kBlockSize) {
+    const char* p = c->buf.data() + block;
+    size_t left = std::min<size_t>(kBlockSize, c->buf.size() - block);
+    // The last block of the file may end in the middle of a record.
+    const bool last_block = c->last && block + left == c->buf.size();
+
+    // A tail shorter than a header is the block trailer, or at the end
+    // of the file a header the writer did not finish.
+    while (left >= static_cast<size_t>(kHeaderSize)) {
+      const uint32_t a = static_cast<uint32_t>(p[4]) & 0xff;
+      const uint32_t b = static_cast<uint32_t>(p[5]) & 0xff;
+      const unsigned int type = static_cast<unsigned char>(p[6]);
+      const uint32_t length = a | (b << 8);
+      if (kHeaderSize + length > left) {
+        if (!last_block) {
+          f.type = kBadFragment;
+          f.bytes = left;
+          f.status = Status::Corruption("bad record length");
+          c->fragments.push_back(f);
+        }
+        // Otherwise the writer died in the middle of writing the record.
+        // Don't report a corruption.
+        break;
+      }
+
+      if (type == kZeroType && length == 0) {
+        // Skip zero length record without reporting any drops, like
+        // Reader does: such records come from preallocated file regions.
+        f.type = kBadFragment;
+        f.bytes = 0;
+        f.status = Status::OK();
+        c->fragments.push_back(f);
+        break;
+      }
+
+      // Check crc
+      const uint32_t expected_crc = crc32c::Unmask(DecodeFixed32(p));
+      const uint32_t actual_crc = crc32c::Value(p + 6, 1 + length);
+      if (actual_crc != expected_crc) {
+        // Drop the rest of the block.  "length" itself may have been
+        // corrupted and if we trust it we could find some fragment of
+        // a real log record that just happens to look like a valid
+        // log record.
+        f.type = kBadFragment;
+        f.bytes = left;
+        f.status = Status::Corruption("checksum mismatch");
+        c->fragments.push_back(f);
+        break;
+      }
+
+      f.type = type;
+      f.data = Slice(p + kHeaderSize, length);
+      f.bytes = 0;
+      f.status = Status::OK();
+      c->fragments.push_back(f);
+      p += kHeaderSize + length;
+      left -= kHeaderSize + length;
+    }
+  }
+}
+
+bool ParallelReader::NextFragment(Fragment* f) {
+  while (true) {
+    if (current_ != nullptr) {
+      if (next_fragment_ < current_->fragments.size()) {
+        *f = current_->fragments[next_fragment_++];
+        return true;
+      }
+      if (current_->last) {
+        return false;
+      }
+      // The records returned from this chunk have been consumed.
+      std::lock_guard<std::mutex> l(mu_);
+      chunks_.pop_front();
+      current_ = nullptr;
+      work_cv_.notify_one();
+    }
+
+    std::unique_lock<std::mutex> l(mu_);
+    ready_cv_.wait(l, [this] {
+      return !chunks_.empty() && chunks_.front()->ready;
+    });
+    current_ = chunks_.front().get();
+    next_fragment_ = 0;
+  }
+}
+
+bool ParallelReader::ReadRecord(Slice* record, std::string* scratch) {
+  scratch->clear();
+  record->clear();
+  bool in_fragmented_record = false;
+
+  Fragment fragment;
+  while (true) {
+    if (!NextFragment(&fragment)) {
+      // The writer died in the middle of a fragmented record, or there
+      // are no more records.  Neither is reported as a corruption.
+      scratch->clear();
+      return false;
+    }
+
+    switch (fragment.type) {
+      case kFullType:
+        if (in_fragmented_record && !scratch->empty()) {
+          ReportCorruption(scratch->size(), "partial record without end(1)");
+        }
+        scratch->clear();
+        *record = fragment.data;
+        return true;
+
+      case kFirstType:
+        if (in_fragmented_record && !scratch->empty()) {
+          ReportCorruption(scratch->size(), "partial record without end(2)");
+        }
+        scratch->assign(fragment.data.data(), fragment.data.size());
+        in_fragmented_record = true;
+        break;
+
+      case kMiddleType:
+        if (!in_fragmented_record) {
+          ReportCorruption(fragment.data.size(),
+                           "missing start of fragmented record(1)");
+        } else {
+          scratch->append(fragment.data.data(), fragment.data.size());
+        }
+        break;
+
+      case kLastType:
+        if (!in_fragmented_record) {
+          ReportCorruption(fragment.data.size(),
+                           "missing start of fragmented record(2)");
+        } else {
+          scratch->append(fragment.data.data(), fragment.data.size());
+          *record = Slice(*scratch);
+          return true;
+        }
+        break;
+
+      case kBadFragment:
+        if (!fragment.status.ok()) {
+          ReportDrop(fragment.bytes, fragment.status);
+        }
+        if (in_fragmented_record) {
+          ReportCorruption(scratch->size(), "error in middle of record");
+          in_fragmented_record = false;
+          scratch->clear();
+        }
+        break;
+
+      default: {
+        char buf[40];
+        std::snprintf(buf, sizeof(buf), "unknown record type %u",
+                      fragment.type);
+        ReportCorruption(
+            (fragment.data.size() + (in_fragmented_record ? scratch->size() : 0)),
+            buf);
+        in_fragmented_record = false;
+        scratch->clear();
+        break;
+      }
+    }
+  }
+}
+
+void ParallelReader::ReportCorruption(uint64_t bytes, const char* reason) {
+  ReportDrop(bytes, Status::Corruption(reason));
+}
+
+void ParallelReader::ReportDrop(uint64_t bytes, const Status& reason) {
+  if (reporter_ != nullptr) {
+    reporter_->Corruption(static_cast<size_t>(bytes), reason);
+  }
+}
+
+}  // namespace log
+}  // namespace leveldb
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "log_format.h"
+#include "log_reader.h"
+#include "slice.h"
+#include "status.h"
+
+namespace leveldb {
+
+class SequentialFile;
+
+namespace log {
+
+// Returns the same records as a Reader with checksums enabled that starts
+// at offset 0, but checks the records of different parts of the file on
+// several threads.
+//
+// The file is read in chunks of whole blocks. Physical records never cross
+// a block boundary, so a worker thread can split a chunk into fragments
+// and verify their checksums without looking at any other chunk. The
+// caller of ReadRecord() joins fragments into logical records in file
+// order and is the only thread that talks to the Reporter.
+class ParallelReader {
+ public:
+  // Create a reader that will return log records from "*file", which
+  // must be positioned at its start.  "*file" and "*reporter" (if
+  // non-null) must remain live while this ParallelReader is in use.
+  ParallelReader(SequentialFile* file, Reader::Reporter* reporter,
+                 int threads);
+
+  ParallelReader(const ParallelReader&) = delete;
+  ParallelReader& operator=(const ParallelReader&) = delete;
+
+  ~ParallelReader();
+
+  // Read the next record into *record.  Returns true if read
+  // successfully, false if we hit end of the input.  May use
+  // "*scratch" as temporary storage.  The contents filled in *record
+  // will only be valid until the next call to ReadRecord() or the next
+  // mutation to *scratch.
+  bool ReadRecord(Slice* record, std::string* scratch);
+
+ private:
+  struct Fragment;
+  struct Chunk;
+
+  // Worker thread: read the next chunk and check it.
+  void Work();
+
+  // Split chunk "c" into fragments.
+  void Parse(Chunk* c) const;
+
+  // Next fragment in file order; false at the end of the file.
+  bool NextFragment(Fragment* f);
+
+  void ReportCorruption(uint64_t bytes, const char* reason);
+  void ReportDrop(uint64_t bytes, const Status& reason);
+
+  SequentialFile* const file_;
+  Reader::Reporter* const reporter_;
+  const size_t max_chunks_;  // in flight
+
+  std::mutex mu_;
+  std::condition_variable work_cv_;   // a chunk slot was freed
+  std::condition_variable ready_cv_;  // a chunk was checked
+  std::deque<std::unique_ptr<Chunk>> chunks_;  // in file order
+  bool eof_;     // the last chunk has been read
+  bool closing_;
+
+  // Owned by the ReadRecord() caller.
+  Chunk* current_;
+  size_t next_fragment_;
+
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace log
+}  // namespace leveldb
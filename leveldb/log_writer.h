@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "log_format.h"
+#include "slice.h"
+#include "status.h"
+
+namespace leveldb {
+
+class WritableFile;
+
+namespace log {
+
+class Writer {
+ public:
+  // Create a writer that will append data to "*dest".
+  // "*dest" must be initially empty.
+  // "*dest" must remain live while this Writer is in use.
+  explicit Writer(WritableFile* dest);
+
+  // Create a writer that will append data to "*dest".
+  // "*dest" must have initial length "dest_length".
+  // "*dest" must remain live while this Writer is in use.
+  Writer(WritableFile* dest, uint64_t dest_length);
+
+  Writer(const Writer&) = delete;
+  Writer& operator=(const Writer&) = delete;
+
+  ~Writer();
+
+  // Append "slice" as one logical record.  Its fragments and their
+  // headers are passed to the file in a single WritableFile::AppendV().
+  Status AddRecord(const Slice& slice);
+
+ private:
+  // Format the header of a physical record that starts at block_offset_.
+  void FormatHeader(RecordType type, const char* ptr, size_t length,
+                    char* buf);
+
+  WritableFile* dest_;
+  int block_offset_;  // Current offset in block
+
+  // Scratch space of AddRecord().
+  std::string headers_;
+  std::vector<Slice> pieces_;
+
+  // crc32c values for all supported record types.  These are
+  // pre-computed to reduce the overhead of computing the crc of the
+  // record type stored in the header.
+  uint32_t type_crc_[kMaxRecordType + 1];
+};
+
+}  // namespace log
+}  // namespace leveldb
@@ -0,0 +1,157 @@
+// Manifest commit throughput with concurrent committers.
+//
+// Each thread plays a flush/compaction job: it repeatedly allocates a file
+// number, builds a VersionEdit that adds a file (and drops one of its
+// older files once it has --files_per_thread), and commits it with
+// VersionSet::LogAndApply. In "grouped" mode the threads call LogAndApply
+// directly, so edits that queue up behind a manifest write are committed
+// together. In "serial" mode every commit is additionally serialized by an
+// outer lock, which gives the one-record-one-fsync-per-edit baseline.
+//
+// Usage: manifest_bench [--dir=PATH] [--edits=N] [--max_threads=N]
+//                       [--files_per_thread=N]
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dbformat.h"
+#include "env.h"
+#include "filename.h"
+#include "options.h"
+#include "version_edit.h"
+#include "version_set.h"
+
+namespace leveldb {
+namespace {
+
+std::string FLAGS_dir = "/tmp/manifest_bench";
+uint64_t FLAGS_edits = 4000;
+int FLAGS_max_threads = 32;
+int FLAGS_files_per_thread = 200;
+
+double NowSeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void CleanDir(Env* env) {
+  std::vector<std::string> children;
+  env->CreateDir(FLAGS_dir);
+  env->GetChildren(FLAGS_dir, &children);
+  for (const std::string& child : children) {
+    uint64_t number;
+    FileType type;
+    if (ParseFileName(child, &number, &type)) {
+      env->RemoveFile(FLAGS_dir + "/" + child);
+    }
+  }
+}
+
+InternalKey FileKey(int thread, uint64_t number, char suffix) {
+  char buf[64];
+  std::snprintf(buf, sizeof(buf), "t%03d-%012llu-%c", thread,
+                static_cast<unsigned long long>(number), suffix);
+  return InternalKey(buf, 1, kTypeValue);
+}
+
+void Bench(const char* name, int num_threads, bool serial) {
+  Options options;
+  CleanDir(options.env);
+  InternalKeyComparator icmp(options.comparator);
+  VersionSet versions(FLAGS_dir, &options, nullptr, &icmp);
+  std::mutex mu;
+  std::mutex serial_mu;
+
+  {
+    // First commit creates the manifest and CURRENT.
+    VersionEdit edit;
+    edit.SetComparatorName(icmp.user_comparator()->Name());
+    mu.lock();
+    Status s = versions.LogAndApply(&edit, &mu);
+    mu.unlock();
+    if (!s.ok()) {
+      std::fprintf(stderr, "%s\n", s.ToString().c_str());
+      std::exit(1);
+    }
+  }
+  const uint64_t records_before = versions.ManifestRecords();
+
+  const uint64_t per_thread = FLAGS_edits / num_threads;
+  std::atomic<bool> failed(false);
+  double start = NowSeconds();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t]() {
+      std::deque<uint64_t> live;
+      const int level = 1 + t % (config::kNumLevels - 1);
+      for (uint64_t i = 0; i < per_thread; i++) {
+        std::unique_lock<std::mutex> outer(serial_mu, std::defer_lock);
+        if (serial) outer.lock();
+        mu.lock();
+        VersionEdit edit;
+        const uint64_t number = versions.NewFileNumber();
+        edit.AddFile(level, number, 2 << 20, FileKey(t, number, 'a'),
+                     FileKey(t, number, 'b'));
+        live.push_back(number);
+        if (live.size() > static_cast<size_t>(FLAGS_files_per_thread)) {
+          edit.RemoveFile(level, live.front());
+          live.pop_front();
+        }
+        Status s = versions.LogAndApply(&edit, &mu);
+        mu.unlock();
+        if (!s.ok()) {
+          std::fprintf(stderr, "%s\n", s.ToString().c_str());
+          failed = true;
+          return;
+        }
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  double secs = NowSeconds() - start;
+  if (failed) std::exit(1);
+
+  const uint64_t edits = per_thread * num_threads;
+  const uint64_t records = versions.ManifestRecords() - records_before;
+  std::printf("%s\t%d\t%.0f\t%.2f\t%.1f\n", name, num_threads, edits / secs,
+              static_cast<double>(edits) / records,
+              secs / edits * num_threads * 1e6);
+}
+
+}  // namespace
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  using namespace leveldb;
+  for (int i = 1; i < argc; i++) {
+    unsigned long long n;
+    char junk;
+    if (strncmp(argv[i], "--dir=", 6) == 0) {
+      FLAGS_dir = argv[i] + 6;
+    } else if (sscanf(argv[i], "--edits=%llu%c", &n, &junk) == 1) {
+      FLAGS_edits = n;
+    } else if (sscanf(argv[i], "--max_threads=%llu%c", &n, &junk) == 1) {
+      FLAGS_max_threads = static_cast<int>(n);
+    } else if (sscanf(argv[i], "--files_per_thread=%llu%c", &n, &junk) == 1) {
+      FLAGS_files_per_thread = static_cast<int>(n);
+    } else {
+      std::fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+
+  std::printf("mode\tthreads\tedits_per_sec\tedits_per_record\tcommit_us\n");
+  for (int threads = 1; threads <= FLAGS_max_threads; threads *= 2) {
+    Bench("serial", threads, true);
+    Bench("grouped", threads, false);
+  }
+  CleanDir(Env::Default());
+  return 0;
+}
@@ -0,0 +1,250 @@
+#include "merger.h"
+
+#include <cassert>
+#include <utility>
+
+#include "comparator.h"
+#include "iterator.h"
+#include "iterator_wrapper.h"
+
+namespace leveldb {
+
+namespace {
+
+// Merges the children with a tournament tree of losers.  Children are the
+// leaves n_..2n_-1 of an implicit binary tree whose internal nodes 1..n_-1
+// each hold the child that lost the match played there; tree_[0] holds the
+// overall winner, the current child.  When the winner moves, it replays
+// only the matches on its own path to the root, one comparison per level,
+// instead of the ~2 log n of a binary heap's sift-down.
+//
+// If the same child wins twice in a row, the best of the losers on its
+// path (the runner-up) is remembered.  As long as the winner's next key
+// still beats the runner-up, the tree cannot change and Next() costs a
+// single comparison: the common case of one input contributing a long
+// run of keys, such as a level that does not overlap the others much.
+class MergingIterator : public Iterator {
+ public:
+  MergingIterator(const Comparator* comparator, Iterator** children, int n)
+      : comparator_(comparator),
+        children_(new IteratorWrapper[n]),
+        n_(n),
+        tree_(new int[n]),
+        winners_(new int[2 * n]),
+        runner_up_(-1),
+        direction_(kForward) {
+    for (int i = 0; i < n; i++) {
+      children_[i].Set(children[i]);
+    }
+    tree_[0] = 0;
+  }
+
+  ~MergingIterator() override {
+    delete[] winners_;
+    delete[] tree_;
+    delete[] children_;
+  }
+
+  bool Valid() const override { return children_[tree_[0]].Valid(); }
+
+  void SeekToFirst() override {
+    for (int i = 0; i < n_; i++) {
+      children_[i].SeekToFirst();
+    }
+    direction_ = kForward;
+    Build();
+  }
+
+  void SeekToLast() override {
+    for (int i = 0; i < n_; i++) {
+      children_[i].SeekToLast();
+    }
+    direction_ = kReverse;
+    Build();
+  }
+
+  void Seek(const Slice& target) override {
+    for (int i = 0; i < n_; i++) {
+      children_[i].Seek(target);
+    }
+    direction_ = kForward;
+    Build();
+  }
+
+  void Next() override {
+    assert(Valid());
+
+    // Ensure that all children are positioned after key().
+    // If we are moving in the forward direction, it is already
+    // true for all of the non-current children since the current
+    // child is the smallest and key() == its key.  Otherwise,
+    // we explicitly position the non-current children.
+    if (direction_ != kForward) {
+      const int current = tree_[0];
+      for (int i = 0; i < n_; i++) {
+        IteratorWrapper* child = &children_[i];
+        if (i != current) {
+          child->Seek(key());
+          if (child->Valid() &&
+              comparator_->Compare(key(), child->key()) == 0) {
+            child->Next();
+          }
+        }
+      }
+      direction_ = kForward;
+      // Every other child is now past key(), so the current child still
+      // wins the rebuilt tree.
+      Build();
+    }
+
+    children_[tree_[0]].Next();
+    Advance();
+  }
+
+  void Prev() override {
+    assert(Valid());
+
+    // Ensure that all children are positioned before key().
+    // If we are moving in the reverse direction, it is already
+    // true for all of the non-current children since the current
+    // child is the largest and key() == its key.  Otherwise,
+    // we explicitly position the non-current children.
+    if (direction_ != kReverse) {
+      const int current = tree_[0];
+      for (int i = 0; i < n_; i++) {
+        IteratorWrapper* child = &children_[i];
+        if (i != current) {
+          child->Seek(key());
+          if (child->Valid()) {
+            // Child is at first entry >= key().  Step back one to be < key()
+            child->Prev();
+          } else {
+            // Child has no entries >= key().  Position at last entry.
+            child->SeekToLast();
+          }
+        }
+      }
+      direction_ = kReverse;
+      Build();
+    }
+
+    children_[tree_[0]].Prev();
+    Advance();
+  }
+
+  Slice key() const override {
+    assert(Valid());
+    return children_[tree_[0]].key();
+  }
+
+  Slice value() const override {
+    assert(Valid());
+    return children_[tree_[0]].value();
+  }
+
+  Status status() const override {
+    Status status;
+    for (int i = 0; i < n_; i++) {
+      status = children_[i].status();
+      if (!status.ok()) {
+        break;
+      }
+    }
+    return status;
+  }
+
+ private:
+  // Which direction is the iterator moving?
+  enum Direction { kForward, kReverse };
+
+  // Does child "a" come before child "b" in the current direction?  An
+  // exhausted child loses to every valid one; ties go to the child with
+  // the lower index going forward and the higher index going backward.
+  bool Beats(int a, int b) const {
+    const IteratorWrapper& x = children_[a];
+    const IteratorWrapper& y = children_[b];
+    if (!x.Valid()) return false;
+    if (!y.Valid()) return true;
+    const int r = comparator_->Compare(x.key(), y.key());
+    if (direction_ == kForward) {
+      return r < 0 || (r == 0 && a < b);
+    } else {
+      return r > 0 || (r == 0 && a > b);
+    }
+  }
+
+  // Play every match from scratch after the children were repositioned.
+  void Build();
+  // Replay the matches of the winner after it moved.
+  void Advance();
+
+  const Comparator* comparator_;
+  IteratorWrapper* children_;
+  const int n_;
+  int* tree_;      // tree_[0] is the winner; tree_[1..n_-1] are losers
+  int* winners_;   // scratch space for Build()
+  int runner_up_;  // best loser on the winner's path, or -1 if unknown
+  Direction direction_;
+};
+
+void MergingIterator::Build() {
+  for (int i = 0; i < n_; i++) {
+    winners_[n_ + i] = i;
+  }
+  for (int p = n_ - 1; p >= 1; p--) {
+    const int a = winners_[2 * p];
+    const int b = winners_[2 * p + 1];
+    if (Beats(b, a)) {
+      winners_[p] = b;
+      tree_[p] = a;
+    } else {
+      winners_[p] = a;
+      tree_[p] = b;
+    }
+  }
+  tree_[0] = (n_ > 1) ? winners_[1] : 0;
+  runner_up_ = -1;
+}
+
+void MergingIterator::Advance() {
+  int winner = tree_[0];
+  if (runner_up_ >= 0 && Beats(winner, runner_up_)) {
+    // Still ahead of every loser on its path: nothing to replay.
+    return;
+  }
+
+  const int previous = winner;
+  for (int p = (n_ + winner) / 2; p >= 1; p /= 2) {
+    if (Beats(tree_[p], winner)) {
+      std::swap(tree_[p], winner);
+    }
+  }
+  tree_[0] = winner;
+
+  runner_up_ = -1;
+  if (winner == previous) {
+    // The same child won again and may well keep winning: find the loser
+    // that would take over from it, to check the next key against.
+    for (int p = (n_ + winner) / 2; p >= 1; p /= 2) {
+      if (runner_up_ < 0 || Beats(tree_[p], runner_up_)) {
+        runner_up_ = tree_[p];
+      }
+    }
+  }
+}
+
+}  // namespace
+
+Iterator* NewMergingIterator(const Comparator* comparator, Iterator** children,
+                             int n) {
+  assert(n >= 0);
+  if (n == 0) {
+    return NewEmptyIterator();
+  } else if (n == 1) {
+    return children[0];
+  } else {
+    return new MergingIterator(comparator, children, n);
+  }
+}
+
+}  // namespace leveldb
@@ -0,0 +1,208 @@
+// Cost of merging sorted inputs: the loser-tree MergingIterator against a
+// std::priority_queue of child iterators.
+//
+// --keys distinct keys are dealt out to N in-memory children, N doubling
+// from --min_inputs to --max_inputs, and each merge is scanned from start
+// to end. Two layouts:
+//   random: every key goes to a random child, so the winner changes on
+//           almost every step;
+//   runs:   keys go out in runs of --run_length consecutive keys, as when
+//           a few inputs overlap only at their edges, so the current child
+//           keeps winning.
+// The heap pops the smallest child and pushes it back after Next(), about
+// 2 log N comparisons per key. The loser tree replays one match per level
+// and, while the same child keeps winning, one comparison per key.
+//
+// Usage: merger_bench [--keys=N] [--min_inputs=N] [--max_inputs=N]
+//                     [--run_length=N]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "comparator.h"
+#include "iterator.h"
+#include "iterator_wrapper.h"
+#include "merger.h"
+#include "utils/random.h"
+
+namespace leveldb {
+namespace {
+
+int FLAGS_keys = 1 << 20;
+int FLAGS_min_inputs = 4;
+int FLAGS_max_inputs = 64;
+int FLAGS_run_length = 64;
+
+double NowSeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+class CountingComparator : public Comparator {
+ public:
+  CountingComparator() : count_(0) {}
+
+  int Compare(const Slice& a, const Slice& b) const override {
+    count_++;
+    return BytewiseComparator()->Compare(a, b);
+  }
+  const char* Name() const override { return "CountingComparator"; }
+  void FindShortestSeparator(std::string*, const Slice&) const override {}
+  void FindShortSuccessor(std::string*) const override {}
+
+  uint64_t count() const { return count_; }
+  void Reset() { count_ = 0; }
+
+ private:
+  mutable uint64_t count_;
+};
+
+// Iterator over a sorted vector of keys with empty values.
+class VectorIterator : public Iterator {
+ public:
+  explicit VectorIterator(const std::vector<std::string>* keys)
+      : keys_(keys), index_(keys->size()) {}
+
+  bool Valid() const override { return index_ < keys_->size(); }
+  void SeekToFirst() override { index_ = 0; }
+  void SeekToLast() override {
+    index_ = keys_->empty() ? 0 : keys_->size() - 1;
+  }
+  void Seek(const Slice& target) override {
+    index_ = std::lower_bound(keys_->begin(), keys_->end(), target,
+                              [](const std::string& a, const Slice& b) {
+                                return Slice(a).compare(b) < 0;
+                              }) -
+             keys_->begin();
+  }
+  void Next() override { index_++; }
+  void Prev() override {
+    index_ = (index_ == 0) ? keys_->size() : index_ - 1;
+  }
+  Slice key() const override { return (*keys_)[index_]; }
+  Slice value() const override { return Slice(); }
+  Status status() const override { return Status::OK(); }
+
+ private:
+  const std::vector<std::string>* const keys_;
+  size_t index_;
+};
+
+// Deal the keys out to "n" children.
+std::vector<std::vector<std::string>> MakeInputs(int n, int run_length) {
+  std::vector<std::vector<std::string>> inputs(n);
+  Random rnd(301);
+  char buf[32];
+  int child = 0;
+  for (int i = 0; i < FLAGS_keys; i++) {
+    if (i % run_length == 0) {
+      child = rnd.Uniform(n);
+    }
+    std::snprintf(buf, sizeof(buf), "%016d", i);
+    inputs[child].push_back(buf);
+  }
+  return inputs;
+}
+
+uint64_t ScanLoserTree(const CountingComparator* cmp,
+                       const std::vector<std::vector<std::string>>& inputs) {
+  std::vector<Iterator*> children;
+  for (const std::vector<std::string>& keys : inputs) {
+    children.push_back(new VectorIterator(&keys));
+  }
+  Iterator* iter = NewMergingIterator(cmp, children.data(), children.size());
+  uint64_t sum = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    sum += iter->key().size();
+  }
+  delete iter;
+  return sum;
+}
+
+uint64_t ScanHeap(const CountingComparator* cmp,
+                  const std::vector<std::vector<std::string>>& inputs) {
+  std::vector<IteratorWrapper> children(inputs.size());
+  auto greater = [cmp](IteratorWrapper* a, IteratorWrapper* b) {
+    return cmp->Compare(a->key(), b->key()) > 0;
+  };
+  std::priority_queue<IteratorWrapper*, std::vector<IteratorWrapper*>,
+                      decltype(greater)>
+      heap(greater);
+  for (size_t i = 0; i < inputs.size(); i++) {
+    children[i].Set(new VectorIterator(&inputs[i]));
+    children[i].SeekToFirst();
+    if (children[i].Valid()) heap.push(&children[i]);
+  }
+  uint64_t sum = 0;
+  while (!heap.empty()) {
+    IteratorWrapper* top = heap.top();
+    sum += top->key().size();
+    heap.pop();
+    top->Next();
+    if (top->Valid()) heap.push(top);
+  }
+  return sum;
+}
+
+void Bench(const char* layout, int n, int run_length) {
+  const std::vector<std::vector<std::string>> inputs =
+      MakeInputs(n, run_length);
+  CountingComparator cmp;
+  for (int impl = 0; impl < 2; impl++) {
+    cmp.Reset();
+    const double start = NowSeconds();
+    const uint64_t sum =
+        impl == 0 ? ScanHeap(&cmp, inputs) : ScanLoserTree(&cmp, inputs);
+    const double secs = NowSeconds() - start;
+    if (sum != static_cast<uint64_t>(FLAGS_keys) * 16) {
+      std::fprintf(stderr, "merge lost keys\n");
+      std::exit(1);
+    }
+    std::printf("%s\t%d\t%s\t%.1f\t%.2f\n", layout, n,
+                impl == 0 ? "heap" : "loser_tree", secs * 1e9 / FLAGS_keys,
+                static_cast<double>(cmp.count()) / FLAGS_keys);
+  }
+}
+
+}  // namespace
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  using namespace leveldb;
+  for (int i = 1; i < argc; i++) {
+    unsigned long long n;
+    char junk;
+    if (sscanf(argv[i], "--keys=%llu%c", &n, &junk) == 1) {
+      FLAGS_keys = static_cast<int>(n);
+    } else if (sscanf(argv[i], "--min_inputs=%llu%c", &n, &junk) == 1) {
+      FLAGS_min_inputs = static_cast<int>(n);
+    } else if (sscanf(argv[i], "--max_inputs=%llu%c", &n, &junk) == 1) {
+      FLAGS_max_inputs = static_cast<int>(n);
+    } else if (sscanf(argv[i], "--run_length=%llu%c", &n, &junk) == 1) {
+      FLAGS_run_length = static_cast<int>(n);
+    } else {
+      std::fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+  if (FLAGS_min_inputs < 2 || FLAGS_min_inputs > FLAGS_max_inputs ||
+      FLAGS_run_length < 1) {
+    std::fprintf(stderr, "need 2 <= --min_inputs <= --max_inputs\n");
+    return 1;
+  }
+
+  std::printf("layout\tinputs\timpl\tns_per_key\tcmp_per_key\n");
+  for (int n = FLAGS_min_inputs; n <= FLAGS_max_inputs; n *= 2) {
+    Bench("random", n, 1);
+  }
+  for (int n = FLAGS_min_inputs; n <= FLAGS_max_inputs; n *= 2) {
+    Bench("runs", n, FLAGS_run_length);
+  }
+  return 0;
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cstddef>
+
+#include "comparator.h"
+#include "env.h"
+
+namespace leveldb {
+
+class AsyncReader;
+class BlockCache;
+class IOBackend;
+class RateLimiter;
+class ThreadPool;
+
+// DB contents are stored in a set of blocks, each of which holds a
+// sequence of key,value pairs.  The type is stored in each block's trailer.
+enum CompressionType { kNoCompression = 0x0 };
+
+// How a table locates the data block holding a key.
+enum IndexType {
+  // One index block with a handle per data block, loaded at table open.
+  kBinarySearchIndex = 0,
+  // The index is cut into partitions of about "metadata_block_size" bytes.
+  // Only the small top-level index over the partitions is loaded at open;
+  // partitions are read on demand through the block cache.
+  kTwoLevelIndexSearch = 1,
+};
+
+// Options to control the behavior of a table or database.
+struct Options {
+  // Comparator used to define the order of keys in the table.
+  const Comparator* comparator = BytewiseComparator();
+
+  // Use the specified object to interact with the environment,
+  // e.g. to read/write files.
+  Env* env = Env::Default();
+
+  // If true, the database will be created if it is missing.
+  bool create_if_missing = false;
+
+  // Amount of data to build up in memory (backed by an unsorted log
+  // on disk) before converting to a sorted on-disk file.
+  size_t write_buffer_size = 4 * 1024 * 1024;
+
+  // Level-0 compaction is started when we hit this many files.
+  int level0_file_num_compaction_trigger = 4;
+
+  // Soft limit on number of level-0 files.  Writes are paced by the
+  // WriteController from this point on.
+  int level0_slowdown_writes_trigger = 8;
+
+  // Maximum number of level-0 files.  We stop writes at this point.
+  int level0_stop_writes_trigger = 12;
+
+  // Target size of level 1; every deeper level may hold
+  // max_bytes_for_level_multiplier times as much as the one above it.
+  uint64_t max_bytes_for_level_base = 10 * 1048576;
+  double max_bytes_for_level_multiplier = 10;
+
+  // If true, the level targets are derived from the actual size of the
+  // last level instead: going up from it, each level's target is the one
+  // below divided by max_bytes_for_level_multiplier.  Levels whose target
+  // would drop below max_bytes_for_level_base are kept empty, and level 0
+  // (and flushes) go straight to the first level below them.  Most of the
+  // data then stays in the last level whatever the size of the DB, which
+  // bounds space amplification.
+  bool level_compaction_dynamic_level_bytes = false;
+
+  // Writes are paced once the estimated bytes that compaction has to
+  // rewrite to bring every level under its target reach the soft limit,
+  // and stopped at the hard limit.  Zero disables the check.
+  uint64_t soft_pending_compaction_bytes_limit = 64ull << 30;
+  uint64_t hard_pending_compaction_bytes_limit = 256ull << 30;
+
+  // Write rate, in bytes per second, granted when writes start to be
+  // paced.  While the backlog keeps growing the rate is lowered step by
+  // step, and raised again as compaction catches up.
+  uint64_t delayed_write_rate = 16 << 20;
+
+  // Factors the paced write rate is multiplied by each time the backlog
+  // is seen to grow, and to shrink, while writes are paced.  The rate
+  // stays between 16KB/s and delayed_write_rate.
+  double delayed_write_rate_decrease = 0.8;
+  double delayed_write_rate_increase = 1.25;
+
+  // Number of open files that can be used by the DB.  You may need to
+  // increase this if your database has a large working set (budget
+  // one open file per 2MB of working set).
+  int max_open_files = 1000;
+
+  // If non-null, use the specified cache for blocks.
+  BlockCache* block_cache = nullptr;
+
+  // Approximate size of user data packed per block.  Note that the
+  // block size specified here corresponds to uncompressed data.
+  size_t block_size = 4 * 1024;
+
+  // Number of keys between restart points for delta encoding of keys.
+  int block_restart_interval = 16;
+
+  IndexType index_type = kBinarySearchIndex;
+
+  // Target size of one index partition for kTwoLevelIndexSearch.
+  size_t metadata_block_size = 4 * 1024;
+
+  // Leveldb will write up to this amount of bytes to a file before
+  // switching to a new one.
+  size_t max_file_size = 2 * 1024 * 1024;
+
+  // A compaction is split into up to this many disjoint key ranges, each
+  // compacted by its own thread into its own output files.  One disables
+  // subcompactions.
+  int max_subcompactions = 1;
+
+  // If non-null, flushes and compactions run on this pool, which may be
+  // shared by several DBs and must outlive them.  Otherwise the DB starts
+  // a pool of its own with one flush and one compaction thread.
+  ThreadPool* background_pool = nullptr;
+
+  // If non-null, flushes and compactions write their output through this
+  // limiter, which may be shared by several DBs.  Flushes go first.
+  RateLimiter* rate_limiter = nullptr;
+
+  // Compactions read each input table in file order, keeping this many
+  // data blocks in flight ahead of the one being merged.  Zero reads one
+  // block at a time, as lookups do.
+  int compaction_readahead = 8;
+
+  // If non-null, compaction readahead goes through this backend, which may
+  // be shared by several DBs and must outlive them.  Otherwise the DB opens
+  // one of its own (NewDefaultIOBackend) with room for the readahead of
+  // max_subcompactions inputs.
+  IOBackend* io_backend = nullptr;
+
+  // Once the manifest grows past this size the next edit starts a new
+  // manifest, which begins with a snapshot of the current state, so that
+  // recovery only replays the edits since the snapshot.
+  uint64_t max_manifest_file_size = 64 << 20;
+
+  // Number of threads that checksum log and manifest blocks during
+  // recovery.  Records are still applied in log order by one thread.
+  int recovery_threads = 4;
+
+  // Values of at least this many bytes are written to blob files and the
+  // tables only keep a BlobIndex, so compaction does not rewrite them.
+  // Zero keeps every value inline.
+  size_t min_blob_size = 0;
+
+  // A blob file is garbage collected once this fraction of its value bytes
+  // is no longer referenced.
+  double blob_gc_garbage_ratio = 0.5;
+};
+
+// Options that control read operations
+struct ReadOptions {
+  // If true, all data read from underlying storage will be
+  // verified against corresponding checksums.
+  bool verify_checksums = false;
+
+  // Should the data read for this iteration be cached in memory?
+  // Callers may wish to set this field to false for bulk scans.
+  bool fill_cache = true;
+
+  // If non-null, a lookup running in one of this reader's coroutines
+  // parks the coroutine while a block that missed the block cache is read,
+  // and the reader runs its other coroutines on the thread meanwhile.
+  // Elsewhere the read blocks the thread as usual.
+  AsyncReader* async_reader = nullptr;
+
+  // If non-null and "readahead" is positive, table iterators read their
+  // data blocks in file order through this backend, "readahead" blocks
+  // ahead of the one being read, and bypass the block cache.  For scans
+  // that read most of every table, like compactions; moving backwards or
+  // seeking restarts the readahead.
+  IOBackend* readahead_backend = nullptr;
+  int readahead = 0;
+};
+
+// Options that control write operations
+struct WriteOptions {
+  // If true, the write will be flushed from the operating system
+  // buffer cache (by calling WritableFile::Sync()) before the write
+  // is considered complete.  If this flag is true, writes will be
+  // slower.
+  //
+  // Concurrent writes are committed in groups and a group is synced
+  // once, so sync writes from many threads share the cost of a sync.
+  bool sync = false;
+};
+
+}  // namespace leveldb
@@ -0,0 +1,135 @@
+#include "rate_limiter.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "env.h"
+
+namespace leveldb {
+
+struct RateLimiter::Req {
+  explicit Req(int64_t b) : bytes(b), granted(false) {}
+
+  int64_t bytes;
+  bool granted;
+};
+
+RateLimiter::RateLimiter(int64_t bytes_per_second,
+                         int64_t refill_period_micros)
+    : refill_bytes_(std::max<int64_t>(
+          1, bytes_per_second * refill_period_micros / 1000000)),
+      refill_period_(std::chrono::microseconds(refill_period_micros)),
+      available_(refill_bytes_),
+      next_refill_(Clock::now() + refill_period_),
+      total_bytes_(0) {}
+
+RateLimiter::~RateLimiter() {
+  assert(queue_[kHigh].empty());
+  assert(queue_[kLow].empty());
+}
+
+void RateLimiter::Request(int64_t bytes, Priority pri) {
+  while (bytes > 0) {
+    const int64_t chunk = std::min(bytes, refill_bytes_);
+    RequestChunk(chunk, pri);
+    bytes -= chunk;
+  }
+}
+
+int64_t RateLimiter::TotalBytesThrough() const {
+  std::lock_guard<std::mutex> l(mu_);
+  return total_bytes_;
+}
+
+void RateLimiter::RequestChunk(int64_t bytes, Priority pri) {
+  std::unique_lock<std::mutex> l(mu_);
+  if (queue_[kHigh].empty() && queue_[kLow].empty()) {
+    if (Clock::now() >= next_refill_) {
+      Refill();
+    }
+    if (available_ >= bytes) {
+      available_ -= bytes;
+      total_bytes_ += bytes;
+      return;
+    }
+  }
+
+  // Wait for a refill.  Whichever waiter wakes up first refills for all.
+  Req r(bytes);
+  queue_[pri].push_back(&r);
+  while (!r.granted) {
+    if (Clock::now() >= next_refill_) {
+      Refill();
+    } else {
+      cv_.wait_until(l, next_refill_);
+    }
+  }
+}
+
+void RateLimiter::Refill() {
+  // Tokens do not pile up while nobody writes: after an idle spell the
+  // next burst is still held to one refill.
+  available_ = std::min(available_ + refill_bytes_, refill_bytes_);
+  next_refill_ = Clock::now() + refill_period_;
+
+  bool granted = false;
+  for (std::deque<Req*>& queue : queue_) {
+    while (!queue.empty()) {
+      Req* r = queue.front();
+      if (r->bytes > available_) {
+        // Strict priority: a kLow request never passes a kHigh one.
+        if (granted) cv_.notify_all();
+        return;
+      }
+      available_ -= r->bytes;
+      total_bytes_ += r->bytes;
+      r->granted = true;
+      queue.pop_front();
+      granted = true;
+    }
+  }
+  if (granted) cv_.notify_all();
+}
+
+namespace {
+
+class RateLimitedFile : public WritableFile {
+ public:
+  RateLimitedFile(WritableFile* base, RateLimiter* limiter,
+                  RateLimiter::Priority pri)
+      : base_(base), limiter_(limiter), pri_(pri) {}
+
+  ~RateLimitedFile() override { delete base_; }
+
+  Status Append(const Slice& data) override {
+    limiter_->Request(data.size(), pri_);
+    return base_->Append(data);
+  }
+
+  Status AppendV(const Slice* data, size_t n) override {
+    int64_t bytes = 0;
+    for (size_t i = 0; i < n; i++) {
+      bytes += data[i].size();
+    }
+    limiter_->Request(bytes, pri_);
+    return base_->AppendV(data, n);
+  }
+
+  Status Close() override { return base_->Close(); }
+  Status Flush() override { return base_->Flush(); }
+  Status Sync() override { return base_->Sync(); }
+
+ private:
+  WritableFile* const base_;
+  RateLimiter* const limiter_;
+  const RateLimiter::Priority pri_;
+};
+
+}  // namespace
+
+WritableFile* NewRateLimitedFile(WritableFile* base, RateLimiter* limiter,
+                                 RateLimiter::Priority pri) {
+  return new RateLimitedFile(base, limiter, pri);
+}
+
+}  // namespace leveldb
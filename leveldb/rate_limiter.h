@@ -0,0 +1,72 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+namespace leveldb {
+
+class WritableFile;
+
+/**
+ * @brief RateLimiter
+ *
+ * @details Caps the bytes per second that background jobs write, so that a
+ * burst of compaction output does not take the disk bandwidth foreground
+ * reads and the log need. One limiter is meant to be shared by every job
+ * (options.rate_limiter), even across DBs.
+ *
+ * Every refill period the limiter grants bytes_per_second * period worth
+ * of tokens. A request that does not fit in the tokens left queues up and
+ * is granted at a later refill. kHigh requests (flushes) are always
+ * granted before queued kLow requests (compactions), so a flush that
+ * starts in the middle of a compaction does not wait behind it.
+ */
+class RateLimiter {
+ public:
+  enum Priority { kHigh = 0, kLow = 1 };
+
+  explicit RateLimiter(int64_t bytes_per_second,
+                       int64_t refill_period_micros = 100 * 1000);
+
+  RateLimiter(const RateLimiter&) = delete;
+  RateLimiter& operator=(const RateLimiter&) = delete;
+
+  ~RateLimiter();
+
+  // Block until "bytes" may be written.  Requests larger than one refill
+  // are granted piecewise.
+  void Request(int64_t bytes, Priority pri);
+
+  // Total bytes granted so far.
+  int64_t TotalBytesThrough() const;
+
+ private:
+  struct Req;
+  typedef std::chrono::steady_clock Clock;
+
+  // Grant at most one refill worth of bytes.
+  void RequestChunk(int64_t bytes, Priority pri);
+  // Add a refill worth of tokens and grant queued requests in order.
+  // REQUIRES: mu_ held.
+  void Refill();
+
+  const int64_t refill_bytes_;
+  const Clock::duration refill_period_;
+
+  mutable std::mutex mu_;
+  std::condition_variable cv_;
+  int64_t available_;
+  Clock::time_point next_refill_;
+  std::deque<Req*> queue_[2];
+  int64_t total_bytes_;
+};
+
+// Return a file that asks "limiter" for the bytes of every write before
+// passing it on to "base".  The result owns "base".
+WritableFile* NewRateLimitedFile(WritableFile* base, RateLimiter* limiter,
+                                 RateLimiter::Priority pri);
+
+}  // namespace leveldb
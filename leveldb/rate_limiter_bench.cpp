@@ -0,0 +1,166 @@
+// Foreground read latency while compaction is busy, with and without a
+// RateLimiter on background writes.
+//
+// A DB is loaded with --num keys of --value_size bytes. Then, for
+// --seconds, one thread overwrites random keys as fast as it can, which
+// keeps flushes and compactions running the whole time, while another
+// thread reads random keys and records the latency of every Get. The run
+// is repeated with options.rate_limiter set to --rate_mb MB/s.
+//
+// The limiter trades write throughput (writes are paced once compaction
+// falls behind) for read tail latency: compaction output no longer comes
+// in bursts that compete with reads for the disk and the CPU.
+//
+// Usage: rate_limiter_bench [--dir=PATH] [--num=N] [--value_size=N]
+//                           [--seconds=N] [--rate_mb=N]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "db.h"
+#include "env.h"
+#include "filename.h"
+#include "options.h"
+#include "rate_limiter.h"
+#include "utils/random.h"
+
+namespace leveldb {
+namespace {
+
+std::string FLAGS_dir = "/tmp/rate_limiter_bench";
+int FLAGS_num = 200000;
+int FLAGS_value_size = 500;
+int FLAGS_seconds = 10;
+int FLAGS_rate_mb = 8;
+
+double NowSeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void CleanDir(Env* env) {
+  std::vector<std::string> children;
+  env->CreateDir(FLAGS_dir);
+  env->GetChildren(FLAGS_dir, &children);
+  for (const std::string& child : children) {
+    uint64_t number;
+    FileType type;
+    if (ParseFileName(child, &number, &type)) {
+      env->RemoveFile(FLAGS_dir + "/" + child);
+    }
+  }
+}
+
+void Check(const Status& s) {
+  if (!s.ok()) {
+    std::fprintf(stderr, "%s\n", s.ToString().c_str());
+    std::exit(1);
+  }
+}
+
+std::string Key(int k) {
+  char buf[16];
+  std::snprintf(buf, sizeof(buf), "%012d", k);
+  return buf;
+}
+
+double Percentile(const std::vector<double>& sorted, double p) {
+  if (sorted.empty()) return 0;
+  return sorted[std::min(sorted.size() - 1,
+                         static_cast<size_t>(p * sorted.size()))];
+}
+
+void Bench(RateLimiter* limiter) {
+  Env* env = Env::Default();
+  CleanDir(env);
+  Options options;
+  options.create_if_missing = true;
+  options.rate_limiter = limiter;
+  DB* db;
+  Check(DB::Open(options, FLAGS_dir, &db));
+
+  const std::string value(FLAGS_value_size, 'v');
+  for (int i = 0; i < FLAGS_num; i++) {
+    Check(db->Put(WriteOptions(), Key(i), value));
+  }
+
+  std::atomic<bool> done(false);
+  uint64_t writes = 0;
+  std::thread writer([&] {
+    Random rnd(301);
+    while (!done.load(std::memory_order_relaxed)) {
+      Check(db->Put(WriteOptions(), Key(rnd.Uniform(FLAGS_num)), value));
+      writes++;
+    }
+  });
+
+  Random rnd(1000);
+  std::vector<double> micros;
+  std::string result;
+  const double start = NowSeconds();
+  const double deadline = start + FLAGS_seconds;
+  double now = start;
+  while (now < deadline) {
+    Check(db->Get(ReadOptions(), Key(rnd.Uniform(FLAGS_num)), &result));
+    const double after = NowSeconds();
+    micros.push_back((after - now) * 1e6);
+    now = after;
+  }
+  done = true;
+  writer.join();
+  const double secs = NowSeconds() - start;
+  delete db;
+
+  std::sort(micros.begin(), micros.end());
+  char rate[32] = "off";
+  if (limiter != nullptr) {
+    std::snprintf(rate, sizeof(rate), "%d", FLAGS_rate_mb);
+  }
+  std::printf("%s\t%.0f\t%.0f\t%.1f\t%.1f\t%.1f\t%.1f\n", rate,
+              micros.size() / secs, writes / secs, Percentile(micros, 0.5),
+              Percentile(micros, 0.99), Percentile(micros, 0.999),
+              micros.back());
+}
+
+}  // namespace
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  using namespace leveldb;
+  for (int i = 1; i < argc; i++) {
+    unsigned long long n;
+    char junk;
+    if (strncmp(argv[i], "--dir=", 6) == 0) {
+      FLAGS_dir = argv[i] + 6;
+    } else if (sscanf(argv[i], "--num=%llu%c", &n, &junk) == 1) {
+      FLAGS_num = static_cast<int>(n);
+    } else if (sscanf(argv[i], "--value_size=%llu%c", &n, &junk) == 1) {
+      FLAGS_value_size = static_cast<int>(n);
+    } else if (sscanf(argv[i], "--seconds=%llu%c", &n, &junk) == 1) {
+      FLAGS_seconds = static_cast<int>(n);
+    } else if (sscanf(argv[i], "--rate_mb=%llu%c", &n, &junk) == 1) {
+      FLAGS_rate_mb = static_cast<int>(n);
+    } else {
+      std::fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+  if (FLAGS_num <= 0 || FLAGS_rate_mb <= 0) {
+    std::fprintf(stderr, "need --num > 0 and --rate_mb > 0\n");
+    return 1;
+  }
+
+  std::printf(
+      "rate_mb\treads_per_sec\twrites_per_sec\tp50_us\tp99_us\tp999_us\t"
+      "max_us\n");
+  Bench(nullptr);
+  RateLimiter limiter(static_cast<int64_t>(FLAGS_rate_mb) << 20);
+  Bench(&limiter);
+  return 0;
+}
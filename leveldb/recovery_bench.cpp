@@ -0,0 +1,242 @@
+// Startup time against the size of the log and manifest to recover.
+//
+// Log: a write-ahead log of --log_mb_min..--log_mb_max MB (doubling) is
+// written directly, as a crashed DB would have left it, and then
+//   read_secs: the log is only read back, with log::Reader and with
+//              log::ParallelReader on --threads threads;
+//   open_secs: DB::Open replays it into a memtable (and flushes it), with
+//              options.recovery_threads 1 and --threads.
+//
+// Manifest: --edits edits are committed one by one (each adds a file and,
+// past 1000 files, removes the oldest), then VersionSet::Recover is timed,
+// once with an unbounded manifest and once with --max_manifest_kb, where
+// the manifest is restarted with a snapshot whenever it grows past it.
+//
+// Usage: recovery_bench [--dir=PATH] [--log_mb_min=N] [--log_mb_max=N]
+//                       [--threads=N] [--edits=N] [--max_manifest_kb=N]
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "db.h"
+#include "dbformat.h"
+#include "env.h"
+#include "filename.h"
+#include "log_parallel_reader.h"
+#include "log_reader.h"
+#include "log_writer.h"
+#include "options.h"
+#include "utils/random.h"
+#include "version_edit.h"
+#include "version_set.h"
+#include "write_batch.h"
+#include "write_batch_internal.h"
+
+namespace leveldb {
+namespace {
+
+std::string FLAGS_dir = "/tmp/recovery_bench";
+uint64_t FLAGS_log_mb_min = 16;
+uint64_t FLAGS_log_mb_max = 128;
+int FLAGS_threads = 4;
+uint64_t FLAGS_edits = 20000;
+uint64_t FLAGS_max_manifest_kb = 256;
+
+const int kValueSize = 100;
+const int kBatchSize = 16;
+const uint64_t kUnbounded = ~uint64_t{0};
+
+double NowSeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void CleanDir(Env* env) {
+  std::vector<std::string> children;
+  env->CreateDir(FLAGS_dir);
+  env->GetChildren(FLAGS_dir, &children);
+  for (const std::string& child : children) {
+    uint64_t number;
+    FileType type;
+    if (ParseFileName(child, &number, &type)) {
+      env->RemoveFile(FLAGS_dir + "/" + child);
+    }
+  }
+}
+
+void Check(const Status& s) {
+  if (!s.ok()) {
+    std::fprintf(stderr, "%s\n", s.ToString().c_str());
+    std::exit(1);
+  }
+}
+
+// Write log file 3 of about "mb" MB, without a manifest: DB::Open with
+// create_if_missing treats it as the log of a new DB and replays it.
+void WriteLog(uint64_t mb) {
+  Env* env = Env::Default();
+  CleanDir(env);
+  WritableFile* file;
+  Check(env->NewWritableFile(LogFileName(FLAGS_dir, 3), &file));
+  log::Writer writer(file);
+  Random rnd(301);
+  std::string value(kValueSize, 'v');
+  WriteBatch batch;
+  SequenceNumber seq = 1;
+  char key[32];
+  for (uint64_t bytes = 0; bytes < (mb << 20);) {
+    batch.Clear();
+    for (int i = 0; i < kBatchSize; i++) {
+      std::snprintf(key, sizeof(key), "%08x%08x", rnd.Next(), rnd.Next());
+      batch.Put(key, value);
+    }
+    WriteBatchInternal::SetSequence(&batch, seq);
+    seq += kBatchSize;
+    Check(writer.AddRecord(WriteBatchInternal::Contents(&batch)));
+    bytes += WriteBatchInternal::ByteSize(&batch);
+  }
+  Check(file->Close());
+  delete file;
+}
+
+template <typename Reader>
+double TimeRead(Reader* reader) {
+  const double start = NowSeconds();
+  Slice record;
+  std::string scratch;
+  while (reader->ReadRecord(&record, &scratch)) {
+  }
+  return NowSeconds() - start;
+}
+
+double ReadLog(int threads) {
+  SequentialFile* file;
+  Check(Env::Default()->NewSequentialFile(LogFileName(FLAGS_dir, 3), &file));
+  double secs;
+  if (threads == 0) {
+    log::Reader reader(file, nullptr, true, 0);
+    secs = TimeRead(&reader);
+  } else {
+    log::ParallelReader reader(file, nullptr, threads);
+    secs = TimeRead(&reader);
+  }
+  delete file;
+  return secs;
+}
+
+double OpenDB(int threads) {
+  Options options;
+  options.create_if_missing = true;
+  options.write_buffer_size = 1 << 30;  // Replay into a single memtable
+  options.recovery_threads = threads;
+  DB* db;
+  const double start = NowSeconds();
+  Check(DB::Open(options, FLAGS_dir, &db));
+  const double secs = NowSeconds() - start;
+  delete db;
+  return secs;
+}
+
+void BenchLog() {
+  std::printf("log_mb\treader\tthreads\tread_secs\topen_secs\n");
+  for (uint64_t mb = FLAGS_log_mb_min; mb <= FLAGS_log_mb_max; mb *= 2) {
+    for (int threads : {1, FLAGS_threads}) {
+      WriteLog(mb);
+      const double read_secs = ReadLog(threads == 1 ? 0 : threads);
+      const double open_secs = OpenDB(threads);
+      std::printf("%llu\t%s\t%d\t%.3f\t%.3f\n",
+                  static_cast<unsigned long long>(mb),
+                  threads == 1 ? "serial" : "parallel", threads, read_secs,
+                  open_secs);
+    }
+  }
+}
+
+void BenchManifest(uint64_t max_manifest_file_size) {
+  Env* env = Env::Default();
+  CleanDir(env);
+  Options options;
+  options.max_manifest_file_size = max_manifest_file_size;
+  InternalKeyComparator icmp(options.comparator);
+  std::mutex mu;
+  {
+    VersionSet versions(FLAGS_dir, &options, nullptr, &icmp);
+    std::vector<uint64_t> files;
+    std::lock_guard<std::mutex> l(mu);
+    for (uint64_t i = 0; i < FLAGS_edits; i++) {
+      VersionEdit edit;
+      if (i == 0) edit.SetComparatorName(options.comparator->Name());
+      const uint64_t number = versions.NewFileNumber();
+      char key[32];
+      std::snprintf(key, sizeof(key), "%016llu",
+                    static_cast<unsigned long long>(number));
+      edit.AddFile(1, number, 1 << 20, InternalKey(key, 1, kTypeValue),
+                   InternalKey(key, 1, kTypeValue));
+      files.push_back(number);
+      if (files.size() > 1000) {
+        edit.RemoveFile(1, files[files.size() - 1001]);
+      }
+      Check(versions.LogAndApply(&edit, &mu));
+    }
+  }
+
+  VersionSet versions(FLAGS_dir, &options, nullptr, &icmp);
+  const double start = NowSeconds();
+  Check(versions.Recover());
+  const double secs = NowSeconds() - start;
+  // Recover() read the manifest CURRENT points to.
+  std::string current;
+  uint64_t manifest_bytes = 0;
+  Check(ReadFileToString(env, CurrentFileName(FLAGS_dir), &current));
+  current.resize(current.size() - 1);
+  Check(env->GetFileSize(FLAGS_dir + "/" + current, &manifest_bytes));
+  char limit[32] = "none";
+  if (max_manifest_file_size != kUnbounded) {
+    std::snprintf(limit, sizeof(limit), "%llu",
+                  static_cast<unsigned long long>(max_manifest_file_size >> 10));
+  }
+  std::printf("%llu\t%s\t%.1f\t%.4f\n",
+              static_cast<unsigned long long>(FLAGS_edits), limit,
+              manifest_bytes / 1024.0, secs);
+}
+
+}  // namespace
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  using namespace leveldb;
+  for (int i = 1; i < argc; i++) {
+    unsigned long long n;
+    char junk;
+    if (strncmp(argv[i], "--dir=", 6) == 0) {
+      FLAGS_dir = argv[i] + 6;
+    } else if (sscanf(argv[i], "--log_mb_min=%llu%c", &n, &junk) == 1) {
+      FLAGS_log_mb_min = n;
+    } else if (sscanf(argv[i], "--log_mb_max=%llu%c", &n, &junk) == 1) {
+      FLAGS_log_mb_max = n;
+    } else if (sscanf(argv[i], "--threads=%llu%c", &n, &junk) == 1) {
+      FLAGS_threads = static_cast<int>(n);
+    } else if (sscanf(argv[i], "--edits=%llu%c", &n, &junk) == 1) {
+      FLAGS_edits = n;
+    } else if (sscanf(argv[i], "--max_manifest_kb=%llu%c", &n, &junk) == 1) {
+      FLAGS_max_manifest_kb = n;
+    } else {
+      std::fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+  if (FLAGS_log_mb_min == 0 || FLAGS_log_mb_min > FLAGS_log_mb_max) {
+    std::fprintf(stderr, "need 0 < --log_mb_min <= --log_mb_max\n");
+    return 1;
+  }
+
+  BenchLog();
+  std::printf("\nedits\tmax_manifest_kb\tmanifest_kb\trecover_secs\n");
+  BenchManifest(kUnbounded);
+  BenchManifest(FLAGS_max_manifest_kb << 10);
+  return 0;
+}
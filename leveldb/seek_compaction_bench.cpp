@@ -0,0 +1,329 @@
+// Point lookup latency under a skewed read workload, before and after
+// seek-triggered compactions.
+//
+// Every key lives in the last level. Levels 1-5 each hold one more file
+// over the first --hot_keys keys, with a fifth of those keys each, so a
+// lookup of a hot key probes up to six files before it finds the key.
+// Reads are Zipfian (item 0, the first key, being the most popular), so
+// almost all of them land in the overlapping range.
+//
+// Reads run in rounds of --reads. A background thread runs whatever
+// compaction the VersionSet picks, which here is always a seek compaction:
+// the upper file of the hot range is merged down once it has been charged
+// with its allowd_seeks, until the hot keys sit in a single level. With
+// --seek_compaction=0 the budget is never spent and the layout stays put.
+//
+// Usage: seek_compaction_bench [--dir=PATH] [--num=N] [--hot_keys=N]
+//                              [--reads=N] [--rounds=N]
+//                              [--seek_compaction=0|1]
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "compaction_job.h"
+#include "dbformat.h"
+#include "env.h"
+#include "filename.h"
+#include "options.h"
+#include "table_builder.h"
+#include "table_cache.h"
+#include "utils/zipfian.h"
+#include "version_edit.h"
+#include "version_set.h"
+
+namespace leveldb {
+namespace {
+
+std::string FLAGS_dir = "/tmp/seek_compaction_bench";
+uint64_t FLAGS_num = 200000;
+uint64_t FLAGS_hot_keys = 20000;
+uint64_t FLAGS_reads = 1000;
+int FLAGS_rounds = 20;
+bool FLAGS_seek_compaction = true;
+
+const int kValueSize = 100;
+const uint64_t kKeysPerFile = 20000;
+
+double NowSeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+std::string UserKey(uint64_t i) {
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "key%012llu",
+                static_cast<unsigned long long>(i));
+  return buf;
+}
+
+void CleanDir(Env* env) {
+  std::vector<std::string> children;
+  env->CreateDir(FLAGS_dir);
+  env->GetChildren(FLAGS_dir, &children);
+  for (const std::string& child : children) {
+    uint64_t number;
+    FileType type;
+    if (ParseFileName(child, &number, &type)) {
+      env->RemoveFile(FLAGS_dir + "/" + child);
+    }
+  }
+}
+
+class Bench {
+ public:
+  Bench()
+      : icmp_(options_.comparator),
+        table_options_(options_),
+        table_cache_(nullptr),
+        versions_(nullptr),
+        shutting_down_(false),
+        compactions_(0) {
+    table_options_.comparator = &icmp_;
+    table_cache_ = new TableCache(FLAGS_dir, table_options_, 1000);
+    versions_ = new VersionSet(FLAGS_dir, &options_, table_cache_, &icmp_);
+  }
+
+  ~Bench() {
+    {
+      std::lock_guard<std::mutex> l(mu_);
+      shutting_down_ = true;
+    }
+    cv_.notify_all();
+    if (compactor_.joinable()) compactor_.join();
+    delete versions_;
+    delete table_cache_;
+  }
+
+  // Write the initial layout with a single VersionEdit.
+  Status Load() {
+    VersionEdit edit;
+    edit.SetComparatorName(icmp_.user_comparator()->Name());
+    std::string value(kValueSize, 'v');
+    SequenceNumber seq = 1;
+    std::vector<uint64_t> keys;
+    Status s;
+    // The bottom level first: it holds the oldest data.
+    for (uint64_t start = 0; s.ok() && start < FLAGS_num;
+         start += kKeysPerFile) {
+      keys.clear();
+      for (uint64_t i = start; i < start + kKeysPerFile && i < FLAGS_num;
+           i++) {
+        keys.push_back(i);
+      }
+      s = WriteTable(config::kNumLevels - 1, keys, value, &seq, &edit);
+    }
+    // One file per upper level over the hot range. Its first and last
+    // key make the file span the whole range.
+    for (int level = config::kNumLevels - 2; s.ok() && level >= 1; level--) {
+      keys.clear();
+      keys.push_back(0);
+      for (uint64_t i = 1; i + 1 < FLAGS_hot_keys; i++) {
+        if (static_cast<int>(i % (config::kNumLevels - 2)) == level - 1) {
+          keys.push_back(i);
+        }
+      }
+      keys.push_back(FLAGS_hot_keys - 1);
+      s = WriteTable(level, keys, value, &seq, &edit);
+    }
+    if (s.ok()) {
+      mu_.lock();
+      versions_->SetLastSequence(seq);
+      s = versions_->LogAndApply(&edit, &mu_);
+      mu_.unlock();
+    }
+    if (s.ok()) {
+      compactor_ = std::thread(&Bench::CompactorLoop, this);
+    }
+    return s;
+  }
+
+  // One round of reads; returns the mean latency in microseconds and the
+  // fraction of lookups that had to probe more than one file.
+  Status ReadRound(ZipfianGenerator* zipf, double* micros,
+                   double* multi_probe) {
+    ReadOptions ro;
+    std::string value;
+    uint64_t multi = 0;
+    double start = NowSeconds();
+    for (uint64_t i = 0; i < FLAGS_reads; i++) {
+      const uint64_t k = zipf->Next();
+      LookupKey lkey(UserKey(k), kMaxSequenceNumber);
+      Version* v;
+      {
+        std::lock_guard<std::mutex> l(mu_);
+        v = versions_->current();
+        v->Ref();
+      }
+      Version::GetStats stats;
+      Status s = v->Get(ro, lkey, &value, &stats);
+      if (stats.seek_file != nullptr) {
+        multi++;
+        if (FLAGS_seek_compaction && v->UpdateStats(stats)) {
+          cv_.notify_one();
+        }
+      }
+      {
+        std::lock_guard<std::mutex> l(mu_);
+        v->Unref();
+      }
+      if (!s.ok()) {
+        return s;
+      }
+    }
+    *micros = (NowSeconds() - start) * 1e6 / FLAGS_reads;
+    *multi_probe = static_cast<double>(multi) / FLAGS_reads;
+    return Status::OK();
+  }
+
+  int compactions() const { return compactions_.load(); }
+
+  std::string LevelSummary() {
+    std::lock_guard<std::mutex> l(mu_);
+    std::string r;
+    for (int level = 0; level < config::kNumLevels; level++) {
+      char buf[16];
+      std::snprintf(buf, sizeof(buf), "%s%d", level == 0 ? "" : ",",
+                    versions_->NumLevelFiles(level));
+      r += buf;
+    }
+    return r;
+  }
+
+ private:
+  Status WriteTable(int level, const std::vector<uint64_t>& keys,
+                    const std::string& value, SequenceNumber* seq,
+                    VersionEdit* edit) {
+    const uint64_t number = versions_->NewFileNumber();
+    WritableFile* file;
+    Status s = options_.env->NewWritableFile(TableFileName(FLAGS_dir, number),
+                                             &file);
+    if (!s.ok()) return s;
+    TableBuilder builder(table_options_, file);
+    InternalKey smallest, largest;
+    for (uint64_t k : keys) {
+      InternalKey ikey(UserKey(k), (*seq)++, kTypeValue);
+      if (builder.NumEntries() == 0) smallest = ikey;
+      largest = ikey;
+      builder.Add(ikey.Encode(), value);
+    }
+    s = builder.Finish();
+    if (s.ok()) s = file->Sync();
+    if (s.ok()) s = file->Close();
+    delete file;
+    if (s.ok()) {
+      edit->AddFile(level, number, builder.FileSize(), smallest, largest);
+    }
+    return s;
+  }
+
+  void CompactorLoop() {
+    std::unique_lock<std::mutex> l(mu_);
+    while (true) {
+      cv_.wait(l, [this] {
+        return shutting_down_ || versions_->NeedsCompaction();
+      });
+      if (shutting_down_) return;
+      Compaction* c = versions_->PickCompaction();
+      if (c == nullptr) continue;
+      CompactionJob job(FLAGS_dir, table_options_, versions_, table_cache_, c,
+                        versions_->LastSequence());
+      Status s = job.Run(&mu_);
+      if (!s.ok()) {
+        std::fprintf(stderr, "compaction: %s\n", s.ToString().c_str());
+        std::exit(1);
+      }
+      compactions_++;
+      RemoveObsoleteFiles();
+    }
+  }
+
+  // REQUIRES: mu_ held.
+  void RemoveObsoleteFiles() {
+    std::set<uint64_t> live;
+    versions_->AddLiveFiles(&live);
+    std::vector<std::string> children;
+    options_.env->GetChildren(FLAGS_dir, &children);
+    for (const std::string& child : children) {
+      uint64_t number;
+      FileType type;
+      if (ParseFileName(child, &number, &type) && type == kTableFile &&
+          live.count(number) == 0) {
+        table_cache_->Evict(number);
+        options_.env->RemoveFile(FLAGS_dir + "/" + child);
+      }
+    }
+  }
+
+  Options options_;
+  InternalKeyComparator icmp_;
+  Options table_options_;
+  TableCache* table_cache_;
+  VersionSet* versions_;
+
+  std::mutex mu_;
+  std::condition_variable cv_;
+  bool shutting_down_;
+  std::thread compactor_;
+  std::atomic<int> compactions_;
+};
+
+}  // namespace
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  using namespace leveldb;
+  for (int i = 1; i < argc; i++) {
+    unsigned long long n;
+    char junk;
+    if (strncmp(argv[i], "--dir=", 6) == 0) {
+      FLAGS_dir = argv[i] + 6;
+    } else if (sscanf(argv[i], "--num=%llu%c", &n, &junk) == 1) {
+      FLAGS_num = n;
+    } else if (sscanf(argv[i], "--hot_keys=%llu%c", &n, &junk) == 1) {
+      FLAGS_hot_keys = n;
+    } else if (sscanf(argv[i], "--reads=%llu%c", &n, &junk) == 1) {
+      FLAGS_reads = n;
+    } else if (sscanf(argv[i], "--rounds=%llu%c", &n, &junk) == 1) {
+      FLAGS_rounds = static_cast<int>(n);
+    } else if (sscanf(argv[i], "--seek_compaction=%llu%c", &n, &junk) == 1) {
+      FLAGS_seek_compaction = (n != 0);
+    } else {
+      std::fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+  if (FLAGS_hot_keys < 2 || FLAGS_hot_keys > FLAGS_num) {
+    std::fprintf(stderr, "need 2 <= --hot_keys <= --num\n");
+    return 1;
+  }
+
+  CleanDir(Env::Default());
+  Bench bench;
+  Status s = bench.Load();
+  if (!s.ok()) {
+    std::fprintf(stderr, "%s\n", s.ToString().c_str());
+    return 1;
+  }
+
+  ZipfianGenerator zipf(FLAGS_num, 0.99, 301);
+  std::printf("round\tget_us\tmulti_probe\tcompactions\tfiles_per_level\n");
+  for (int round = 0; round < FLAGS_rounds; round++) {
+    double micros = 0, multi_probe = 0;
+    s = bench.ReadRound(&zipf, &micros, &multi_probe);
+    if (!s.ok()) {
+      std::fprintf(stderr, "%s\n", s.ToString().c_str());
+      return 1;
+    }
+    std::printf("%d\t%.2f\t%.3f\t%d\t%s\n", round, micros, multi_probe,
+                bench.compactions(), bench.LevelSummary().c_str());
+  }
+  return 0;
+}
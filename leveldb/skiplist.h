@@ -62,12 +62,12 @@ class SkipList {
 
   bool KeyIsAfterNode(const Key& key, Node* node) const;
 
-  Node* head_;
-
   Arena* const arena_;
 
   Comparator const cmp_;
 
+  Node* head_;
+
   Node* NewNode(const Key& key, int height);
 
   Node* FindGreaterOrEqual(const Key& key, Node** prev) const;
@@ -149,9 +149,9 @@ SkipList<Key, Comparator>::FindLessThan(const Key& key) const {
   Node* x = head_;
   int level = GetMaxHeight() - 1;
   while (true) {
-    assert(x == head_ || compare_(x->key, key) < 0);
+    assert(x == head_ || cmp_(x->key, key) < 0);
     Node* next = x->Next(level);
-    if (next == nullptr || cmp_(key, next->key) < 0) {
+    if (next == nullptr || cmp_(next->key, key) >= 0) {
       if (level == 0) {
         return x;
       } else {
@@ -192,12 +192,20 @@ bool SkipList<Key, Comparator>::KeyIsAfterNode(const Key& key,
 
 template <typename Key, class Comparator>
 SkipList<Key, Comparator>::SkipList(Comparator cmp, Arena* arena)
-    : arena_(arena), cmp_(cmp), head_(NewNode(0, kMaxHeight)) {
+    : arena_(arena),
+      cmp_(cmp),
+      head_(NewNode(0 /* any key will do */, kMaxHeight)),
+      max_height_(1),
+      rnd_(0xdeadbeef) {
   for (int i = 0; i < kMaxHeight; ++i) {
     head_->SetNext(i, nullptr);
   }
 }
 
+// Nodes live in the arena, which outlives the list.
+template <typename Key, class Comparator>
+SkipList<Key, Comparator>::~SkipList() = default;
+
 template <typename Key, class Comparator>
 struct SkipList<Key, Comparator>::Node {
   explicit Node(const Key& key) : key(key) {}
@@ -280,7 +288,7 @@ template <typename Key, class Comparator>
 typename SkipList<Key, Comparator>::Node* SkipList<Key, Comparator>::NewNode(
     const Key& key, int height) {
   char* const node_memory = arena_->AllocateAligned(
-      sizeof(Node) + sizeof(std::atomic<Node*>*) * (height - 1));
+      sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1));
   return new (node_memory) Node(key);
 }
 
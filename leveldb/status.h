@@ -1,3 +1,6 @@
+#pragma once
+
+#include <cstdio>
 #include <iostream>
 
 #include "slice.h"
@@ -7,12 +10,32 @@ namespace leveldb {
 class Status {
  public:
   Status() noexcept : state_(nullptr) {}
-  ~Status() = delete;
+  ~Status() { delete[] state_; }
   Status(const Status& rhs);
   Status& operator=(const Status& rhs);
   Status(Status&& rhs) noexcept : state_(rhs.state_) { rhs.state_ = nullptr; }
   Status& operator=(Status&& rhs) noexcept;
 
+  // Return a success status.
+  static Status OK() { return Status(); }
+
+  // Return error status of an appropriate type.
+  static Status NotFound(const Slice& msg, const Slice& msg2 = Slice()) {
+    return Status(kNotFound, msg, msg2);
+  }
+  static Status Corruption(const Slice& msg, const Slice& msg2 = Slice()) {
+    return Status(kCorruption, msg, msg2);
+  }
+  static Status NotSupported(const Slice& msg, const Slice& msg2 = Slice()) {
+    return Status(kNotSupported, msg, msg2);
+  }
+  static Status InvalidArgument(const Slice& msg, const Slice& msg2 = Slice()) {
+    return Status(kInvalidArgument, msg, msg2);
+  }
+  static Status IOError(const Slice& msg, const Slice& msg2 = Slice()) {
+    return Status(kIOError, msg, msg2);
+  }
+
   bool ok() const { return code() == kOk; }
   bool IsNotFound() const { return code() == kNotFound; }
   bool isCorruption() const { return code() == kCorruption; }
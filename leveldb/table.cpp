@@ -0,0 +1,403 @@
+#include "table.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "async_reader.h"
+#include "block.h"
+#include "block_cache.h"
+#include "comparator.h"
+#include "env.h"
+#include "format.h"
+#include "io_backend.h"
+#include "two_level_iterator.h"
+
+namespace leveldb {
+
+struct Table::Rep {
+  ~Rep() { delete index_block; }
+
+  Options options;
+  Status status;
+  RandomAccessFile* file;
+  uint64_t file_number;
+
+  BlockHandle metaindex_handle;  // Handle to metaindex_block: saved from footer
+  IndexType index_type;
+  // The index, or the top-level index over its partitions.
+  Block* index_block;
+};
+
+Status Table::Open(const Options& options, RandomAccessFile* file,
+                   uint64_t file_number, uint64_t size, Table** table) {
+  *table = nullptr;
+  if (size < Footer::kEncodedLength) {
+    return Status::Corruption("file is too short to be an sstable");
+  }
+
+  char footer_space[Footer::kEncodedLength];
+  Slice footer_input;
+  Status s = file->Read(size - Footer::kEncodedLength, Footer::kEncodedLength,
+                        &footer_input, footer_space);
+  if (!s.ok()) return s;
+
+  Footer footer;
+  s = footer.DecodeFrom(&footer_input);
+  if (!s.ok()) return s;
+
+  // Read the index block
+  BlockContents index_block_contents;
+  ReadOptions opt;
+  opt.verify_checksums = true;
+  s = ReadBlock(file, opt, footer.index_handle(), &index_block_contents);
+
+  if (s.ok()) {
+    // We've successfully read the footer and the index block: we're
+    // ready to serve requests.
+    Block* index_block = new Block(index_block_contents);
+    Rep* rep = new Table::Rep;
+    rep->options = options;
+    rep->file = file;
+    rep->file_number = file_number;
+    rep->metaindex_handle = footer.metaindex_handle();
+    rep->index_type = footer.index_type();
+    rep->index_block = index_block;
+    *table = new Table(rep);
+  }
+
+  return s;
+}
+
+Table::~Table() { delete rep_; }
+
+static void DeleteBlock(void* arg, void* ignored) {
+  delete reinterpret_cast<Block*>(arg);
+}
+
+static void DeleteCachedBlock(uint64_t file_number, uint64_t offset,
+                              void* value) {
+  delete reinterpret_cast<Block*>(value);
+}
+
+static void ReleaseBlock(void* arg, void* h) {
+  BlockCache* cache = reinterpret_cast<BlockCache*>(arg);
+  BlockCache::Handle* handle = reinterpret_cast<BlockCache::Handle*>(h);
+  cache->Release(handle);
+}
+
+// Read a block that is not in the block cache. From a coroutine of
+// options.async_reader the read parks the coroutine, not the thread.
+static Status ReadMissingBlock(RandomAccessFile* file,
+                               const ReadOptions& options,
+                               const BlockHandle& handle,
+                               BlockContents* contents) {
+  AsyncReader* reader = options.async_reader;
+  if (reader != nullptr && reader->InCoroutine()) {
+    return reader->ReadBlock(file, options, handle, contents);
+  }
+  return ReadBlock(file, options, handle, contents);
+}
+
+// Convert an index iterator value (i.e., an encoded BlockHandle)
+// into an iterator over the contents of the corresponding block. Used for
+// data blocks as well as for index partitions.
+Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
+                             const Slice& index_value) {
+  Table* table = reinterpret_cast<Table*>(arg);
+  BlockCache* block_cache = table->rep_->options.block_cache;
+  Block* block = nullptr;
+  BlockCache::Handle* cache_handle = nullptr;
+
+  BlockHandle handle;
+  Slice input = index_value;
+  Status s = handle.DecodeFrom(&input);
+  // We intentionally allow extra stuff in index_value so that we
+  // can add more features in the future.
+
+  if (s.ok()) {
+    BlockContents contents;
+    if (block_cache != nullptr) {
+      cache_handle = block_cache->Lookup(table->rep_->file_number,
+                                         handle.offset());
+      if (cache_handle != nullptr) {
+        block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
+      } else {
+        s = ReadMissingBlock(table->rep_->file, options, handle, &contents);
+        if (s.ok()) {
+          block = new Block(contents);
+          if (contents.cachable && options.fill_cache) {
+            // Stays nullptr if the cache is full of pinned blocks: we keep
+            // ours uncached then.
+            cache_handle = block_cache->Insert(
+                table->rep_->file_number, handle.offset(), block,
+                block->size(), &DeleteCachedBlock);
+          }
+        }
+      }
+    } else {
+      s = ReadMissingBlock(table->rep_->file, options, handle, &contents);
+      if (s.ok()) {
+        block = new Block(contents);
+      }
+    }
+  }
+
+  Iterator* iter;
+  if (block != nullptr) {
+    iter = block->NewIterator(table->rep_->options.comparator);
+    if (cache_handle == nullptr) {
+      iter->RegisterCleanup(&DeleteBlock, block, nullptr);
+    } else {
+      iter->RegisterCleanup(&ReleaseBlock, block_cache, cache_handle);
+    }
+  } else {
+    iter = NewErrorIterator(s);
+  }
+  return iter;
+}
+
+Iterator* Table::NewIndexIterator(const ReadOptions& options) const {
+  Iterator* top = rep_->index_block->NewIterator(rep_->options.comparator);
+  if (rep_->index_type == kBinarySearchIndex) {
+    return top;
+  }
+  // The top-level index maps the last separator of every partition to the
+  // partition's handle, so a two-level walk over it yields exactly the
+  // entries of the unpartitioned index.
+  return NewTwoLevelIterator(top, &Table::BlockReader,
+                             const_cast<Table*>(this), options);
+}
+
+namespace {
+
+// The data blocks of one readahead iterator.
+struct Readahead {
+  const Comparator* comparator;
+  IOBackend* backend;
+  int fd;
+  int depth;
+  std::vector<BlockHandle> handles;  // every data block, in file order
+  std::unique_ptr<BlockReadahead> reader;
+  size_t next = 0;  // the block "reader" returns next
+};
+
+void DeleteReadahead(void* arg, void* ignored) {
+  delete reinterpret_cast<Readahead*>(arg);
+}
+
+// Table::BlockReader for data blocks read through a Readahead. The
+// two-level iterator asks for the blocks in file order, except after a
+// Seek or a Prev, which starts a new BlockReadahead at the block asked for.
+Iterator* ReadaheadBlockReader(void* arg, const ReadOptions& options,
+                               const Slice& index_value) {
+  Readahead* ra = reinterpret_cast<Readahead*>(arg);
+  BlockHandle handle;
+  Slice input = index_value;
+  Status s = handle.DecodeFrom(&input);
+  if (!s.ok()) {
+    return NewErrorIterator(s);
+  }
+
+  const std::vector<BlockHandle>& handles = ra->handles;
+  if (ra->reader == nullptr || ra->next >= handles.size() ||
+      handles[ra->next].offset() != handle.offset()) {
+    auto it = std::lower_bound(
+        handles.begin(), handles.end(), handle.offset(),
+        [](const BlockHandle& h, uint64_t offset) {
+          return h.offset() < offset;
+        });
+    if (it == handles.end() || it->offset() != handle.offset()) {
+      return NewErrorIterator(Status::Corruption("block is not in the index"));
+    }
+    ra->reader.reset();  // waits for the reads it has in flight
+    ra->reader.reset(new BlockReadahead(ra->backend, ra->fd,
+                                        std::vector<BlockHandle>(it,
+                                                                 handles.end()),
+                                        ra->depth));
+    ra->next = it - handles.begin();
+  }
+
+  Slice raw;
+  s = ra->reader->Next(&raw);
+  ra->next++;
+  Slice data;
+  if (s.ok()) {
+    s = ParseBlockWithTrailer(Slice(raw.data(), raw.size() + kBlockTrailerSize),
+                              options, &data);
+  }
+  if (!s.ok()) {
+    return NewErrorIterator(s);
+  }
+  // The readahead reuses its buffer for a later block.
+  char* buf = new char[data.size()];
+  std::memcpy(buf, data.data(), data.size());
+  BlockContents contents;
+  contents.data = Slice(buf, data.size());
+  contents.cachable = false;
+  contents.heap_allocated = true;
+  Block* block = new Block(contents);
+  Iterator* iter = block->NewIterator(ra->comparator);
+  iter->RegisterCleanup(&DeleteBlock, block, nullptr);
+  return iter;
+}
+
+}  // namespace
+
+Iterator* Table::NewIterator(const ReadOptions& options) const {
+  const int fd = rep_->file->FileDescriptor();
+  if (options.readahead_backend == nullptr || options.readahead <= 0 ||
+      fd < 0) {
+    return NewTwoLevelIterator(NewIndexIterator(options), &Table::BlockReader,
+                               const_cast<Table*>(this), options);
+  }
+
+  Readahead* ra = new Readahead;
+  ra->comparator = rep_->options.comparator;
+  ra->backend = options.readahead_backend;
+  ra->fd = fd;
+  ra->depth = options.readahead;
+  Iterator* index_iter = NewIndexIterator(options);
+  for (index_iter->SeekToFirst(); index_iter->Valid(); index_iter->Next()) {
+    Slice input = index_iter->value();
+    BlockHandle handle;
+    if (handle.DecodeFrom(&input).ok()) {
+      ra->handles.push_back(handle);
+    }
+  }
+  Status s = index_iter->status();
+  delete index_iter;
+  if (!s.ok()) {
+    delete ra;
+    return NewErrorIterator(s);
+  }
+  Iterator* result = NewTwoLevelIterator(NewIndexIterator(options),
+                                         &ReadaheadBlockReader, ra, options);
+  result->RegisterCleanup(&DeleteReadahead, ra, nullptr);
+  return result;
+}
+
+Status Table::InternalGet(const ReadOptions& options, const Slice& k,
+                          void* arg,
+                          void (*handle_result)(void*, const Slice&,
+                                                const Slice&)) {
+  Status s;
+  Iterator* iiter = NewIndexIterator(options);
+  iiter->Seek(k);
+  if (iiter->Valid()) {
+    Iterator* block_iter = BlockReader(this, options, iiter->value());
+    block_iter->Seek(k);
+    if (block_iter->Valid()) {
+      (*handle_result)(arg, block_iter->key(), block_iter->value());
+    }
+    s = block_iter->status();
+    delete block_iter;
+  }
+  if (s.ok()) {
+    s = iiter->status();
+  }
+  delete iiter;
+  return s;
+}
+
+namespace {
+
+struct GetState {
+  const Comparator* comparator;
+  Slice key;
+  std::string* value;
+  bool found;
+};
+
+void SaveValue(void* arg, const Slice& k, const Slice& v) {
+  GetState* state = reinterpret_cast<GetState*>(arg);
+  if (state->comparator->Compare(k, state->key) == 0) {
+    state->value->assign(v.data(), v.size());
+    state->found = true;
+  }
+}
+
+struct MultiGetState {
+  const Table* table;
+  const ReadOptions* options;
+  size_t n;
+  const Slice* keys;
+  std::string* values;
+  Status* statuses;
+  size_t next;  // next key to look up
+};
+
+// One coroutine of a MultiGet: looks up keys until none is left.
+void MultiGetWorker(void* arg) {
+  MultiGetState* state = reinterpret_cast<MultiGetState*>(arg);
+  while (state->next < state->n) {
+    const size_t i = state->next++;
+    state->statuses[i] = state->table->Get(*state->options, state->keys[i],
+                                           &state->values[i]);
+  }
+}
+
+}  // namespace
+
+Status Table::Get(const ReadOptions& options, const Slice& key,
+                  std::string* value) const {
+  GetState state = {rep_->options.comparator, key, value, false};
+  Status s = const_cast<Table*>(this)->InternalGet(options, key, &state,
+                                                   &SaveValue);
+  if (s.ok() && !state.found) {
+    s = Status::NotFound(Slice());
+  }
+  return s;
+}
+
+void Table::MultiGet(const ReadOptions& options, size_t n, const Slice* keys,
+                     std::string* values, Status* statuses) const {
+  AsyncReader* reader = options.async_reader;
+  if (reader == nullptr || reader->InCoroutine()) {
+    for (size_t i = 0; i < n; i++) {
+      statuses[i] = Get(options, keys[i], &values[i]);
+    }
+    return;
+  }
+  MultiGetState state = {this, &options, n, keys, values, statuses, 0};
+  const size_t workers = n < static_cast<size_t>(reader->max_coroutines())
+                             ? n
+                             : reader->max_coroutines();
+  for (size_t i = 0; i < workers; i++) {
+    reader->Spawn(&MultiGetWorker, &state);
+  }
+  reader->Run();
+}
+
+uint64_t Table::ApproximateOffsetOf(const Slice& key) const {
+  Iterator* index_iter = NewIndexIterator(ReadOptions());
+  index_iter->Seek(key);
+  uint64_t result;
+  if (index_iter->Valid()) {
+    BlockHandle handle;
+    Slice input = index_iter->value();
+    Status s = handle.DecodeFrom(&input);
+    if (s.ok()) {
+      result = handle.offset();
+    } else {
+      // Strange: we can't decode the block handle in the index block.
+      // We'll just return the offset of the metaindex block, which is
+      // close to the whole file size for this case.
+      result = rep_->metaindex_handle.offset();
+    }
+  } else {
+    // key is past the last key in the file.  Approximate the offset
+    // by returning the offset of the metaindex block (which is
+    // right near the end of the file).
+    result = rep_->metaindex_handle.offset();
+  }
+  delete index_iter;
+  return result;
+}
+
+IndexType Table::index_type() const { return rep_->index_type; }
+
+size_t Table::ResidentIndexSize() const { return rep_->index_block->size(); }
+
+}  // namespace leveldb
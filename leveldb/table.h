@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "iterator.h"
+#include "options.h"
+
+namespace leveldb {
+
+class Block;
+class BlockHandle;
+class Footer;
+class RandomAccessFile;
+class TableCache;
+
+// A Table is a sorted map from strings to strings.  Tables are
+// immutable and persistent.  A Table may be safely accessed from
+// multiple threads without external synchronization.
+class Table {
+ public:
+  // Attempt to open the table that is stored in bytes [0..file_size)
+  // of "file", and read the metadata entries necessary to allow
+  // retrieving data from the table. Blocks are cached in
+  // options.block_cache under "file_number".
+  //
+  // Only the footer and the index block are read. For a partitioned index
+  // that is just the top-level index; partitions are loaded on demand.
+  //
+  // If successful, returns ok and sets "*table" to the newly opened
+  // table.  The client should delete "*table" when no longer needed.
+  // If there was an error while initializing the table, sets "*table"
+  // to nullptr and returns a non-ok status.  Does not take ownership of
+  // "*file", but the client must ensure that "file" remains live
+  // for the duration of the returned table's lifetime.
+  static Status Open(const Options& options, RandomAccessFile* file,
+                     uint64_t file_number, uint64_t file_size, Table** table);
+
+  Table(const Table&) = delete;
+  Table& operator=(const Table&) = delete;
+
+  ~Table();
+
+  // Returns a new iterator over the table contents.
+  // The result of NewIterator() is initially invalid (caller must
+  // call one of the Seek methods on the iterator before using it).
+  //
+  // With options.readahead_backend the data blocks are read ahead as
+  // described in ReadOptions, unless the file has no FileDescriptor().
+  Iterator* NewIterator(const ReadOptions&) const;
+
+  // Given a key, return an approximate byte offset in the file where
+  // the data for that key begins (or would begin if the key were
+  // present in the file).  The returned value is in terms of file
+  // bytes, and so includes effects like compression of the underlying data.
+  // E.g., the approximate offset of the last key in the table will
+  // be close to the file length.
+  uint64_t ApproximateOffsetOf(const Slice& key) const;
+
+  // If the table holds "key", store its value in *value and return OK.
+  // Otherwise return NotFound.
+  //
+  // With options.async_reader, a block read made from one of the reader's
+  // coroutines parks the coroutine instead of blocking the thread.
+  Status Get(const ReadOptions& options, const Slice& key,
+             std::string* value) const;
+
+  // Get() of keys[0..n-1] into values[i] and statuses[i]. With
+  // options.async_reader the lookups run as up to max_coroutines()
+  // coroutines of the reader, on the calling thread, with their block reads
+  // in flight together. Otherwise, or when called from one of the reader's
+  // coroutines, they run one after another.
+  void MultiGet(const ReadOptions& options, size_t n, const Slice* keys,
+                std::string* values, Status* statuses) const;
+
+  IndexType index_type() const;
+
+  // Bytes of index kept in memory for the lifetime of the table. Index
+  // partitions live in the block cache and are not counted.
+  size_t ResidentIndexSize() const;
+
+ private:
+  friend class TableCache;
+  struct Rep;
+
+  static Iterator* BlockReader(void*, const ReadOptions&, const Slice&);
+
+  explicit Table(Rep* rep) : rep_(rep) {}
+
+  // An iterator over the (separator -> data block handle) entries.
+  Iterator* NewIndexIterator(const ReadOptions&) const;
+
+  // Calls (*handle_result)(arg, ...) with the entry found after a call
+  // to Seek(key).  May not make such a call if filter policy says
+  // that key is not present.
+  Status InternalGet(const ReadOptions&, const Slice& key, void* arg,
+                     void (*handle_result)(void* arg, const Slice& k,
+                                           const Slice& v));
+
+  Rep* const rep_;
+};
+
+}  // namespace leveldb
@@ -0,0 +1,192 @@
+// Open latency and resident index memory of a large table with a flat
+// index and with a two-level partitioned index.
+//
+// For each mode a table of --table_mb is built once. The file is then
+// dropped from the page cache (posix_fadvise) and opened --opens times;
+// we report the mean open latency, the bytes of index the opened Table
+// keeps resident, the process RSS growth while holding all opened tables,
+// and the cost of cold point lookups through a block cache.
+//
+// Usage: table_bench [--dir=PATH] [--table_mb=N] [--value_size=N]
+//                    [--opens=N] [--lookups=N] [--partition_size=N]
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "block_cache.h"
+#include "env.h"
+#include "options.h"
+#include "table.h"
+#include "table_builder.h"
+#include "utils/random.h"
+
+namespace leveldb {
+namespace {
+
+std::string FLAGS_dir = "/tmp";
+uint64_t FLAGS_table_mb = 1024;
+uint64_t FLAGS_value_size = 100;
+int FLAGS_opens = 20;
+int FLAGS_lookups = 100000;
+uint64_t FLAGS_partition_size = 4096;
+
+double NowSeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+size_t ResidentBytes() {
+  FILE* f = std::fopen("/proc/self/statm", "r");
+  if (f == nullptr) return 0;
+  unsigned long size = 0, resident = 0;
+  if (std::fscanf(f, "%lu %lu", &size, &resident) != 2) resident = 0;
+  std::fclose(f);
+  return resident * ::sysconf(_SC_PAGESIZE);
+}
+
+void DropFromPageCache(const std::string& fname) {
+  int fd = ::open(fname.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+  }
+}
+
+std::string MakeKey(uint64_t i) {
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%016llu",
+                static_cast<unsigned long long>(i));
+  return buf;
+}
+
+uint64_t Build(const Options& options, const std::string& fname) {
+  Env* env = Env::Default();
+  WritableFile* file;
+  Status s = env->NewWritableFile(fname, &file);
+  if (!s.ok()) {
+    std::fprintf(stderr, "%s\n", s.ToString().c_str());
+    std::exit(1);
+  }
+  TableBuilder builder(options, file);
+  Random rnd(301);
+  std::string value(FLAGS_value_size, 'x');
+  const uint64_t target = FLAGS_table_mb << 20;
+  uint64_t n = 0;
+  while (builder.FileSize() < target) {
+    for (size_t i = 0; i < value.size(); i += 4) {
+      value[i] = 'a' + rnd.Uniform(26);
+    }
+    builder.Add(MakeKey(n++), value);
+  }
+  s = builder.Finish();
+  if (s.ok()) s = file->Sync();
+  if (s.ok()) s = file->Close();
+  delete file;
+  if (!s.ok()) {
+    std::fprintf(stderr, "%s\n", s.ToString().c_str());
+    std::exit(1);
+  }
+  return n;
+}
+
+void Bench(const char* name, IndexType index_type) {
+  Env* env = Env::Default();
+  const std::string fname = FLAGS_dir + "/table_bench_" + name + ".ldb";
+  Options options;
+  options.index_type = index_type;
+  options.metadata_block_size = FLAGS_partition_size;
+  const uint64_t num_keys = Build(options, fname);
+  uint64_t file_size;
+  env->GetFileSize(fname, &file_size);
+
+  BlockCache cache(64 << 20);
+  options.block_cache = &cache;
+
+  std::vector<RandomAccessFile*> files(FLAGS_opens);
+  std::vector<Table*> tables(FLAGS_opens);
+  const size_t rss_before = ResidentBytes();
+  double open_secs = 0;
+  for (int i = 0; i < FLAGS_opens; i++) {
+    DropFromPageCache(fname);
+    double start = NowSeconds();
+    Status s = env->NewRandomAccessFile(fname, &files[i]);
+    if (s.ok()) {
+      s = Table::Open(options, files[i], i, file_size, &tables[i]);
+    }
+    open_secs += NowSeconds() - start;
+    if (!s.ok()) {
+      std::fprintf(stderr, "%s\n", s.ToString().c_str());
+      std::exit(1);
+    }
+  }
+  const size_t rss_after = ResidentBytes();
+
+  // Cold point lookups on the first table.
+  DropFromPageCache(fname);
+  Random rnd(17);
+  ReadOptions ro;
+  double start = NowSeconds();
+  for (int i = 0; i < FLAGS_lookups; i++) {
+    std::string key = MakeKey(rnd.Next() % num_keys);
+    Iterator* iter = tables[0]->NewIterator(ro);
+    iter->Seek(key);
+    if (!iter->Valid() || iter->key() != Slice(key)) {
+      std::fprintf(stderr, "lookup of %s failed\n", key.c_str());
+      std::exit(1);
+    }
+    delete iter;
+  }
+  double lookup_secs = NowSeconds() - start;
+
+  std::printf("%s\t%llu\t%.1f\t%zu\t%.1f\t%.2f\n", name,
+              static_cast<unsigned long long>(file_size >> 20),
+              open_secs / FLAGS_opens * 1e6, tables[0]->ResidentIndexSize(),
+              (rss_after - rss_before) / 1024.0 / FLAGS_opens,
+              lookup_secs / FLAGS_lookups * 1e6);
+
+  for (int i = 0; i < FLAGS_opens; i++) {
+    delete tables[i];
+    delete files[i];
+  }
+  env->RemoveFile(fname);
+}
+
+}  // namespace
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  using namespace leveldb;
+  for (int i = 1; i < argc; i++) {
+    unsigned long long n;
+    char junk;
+    if (strncmp(argv[i], "--dir=", 6) == 0) {
+      FLAGS_dir = argv[i] + 6;
+    } else if (sscanf(argv[i], "--table_mb=%llu%c", &n, &junk) == 1) {
+      FLAGS_table_mb = n;
+    } else if (sscanf(argv[i], "--value_size=%llu%c", &n, &junk) == 1) {
+      FLAGS_value_size = n;
+    } else if (sscanf(argv[i], "--opens=%llu%c", &n, &junk) == 1) {
+      FLAGS_opens = static_cast<int>(n);
+    } else if (sscanf(argv[i], "--lookups=%llu%c", &n, &junk) == 1) {
+      FLAGS_lookups = static_cast<int>(n);
+    } else if (sscanf(argv[i], "--partition_size=%llu%c", &n, &junk) == 1) {
+      FLAGS_partition_size = n;
+    } else {
+      std::fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+
+  std::printf(
+      "index\tfile_mb\topen_us\tresident_index_bytes\trss_kb_per_open\t"
+      "cold_lookup_us\n");
+  Bench("flat", kBinarySearchIndex);
+  Bench("partitioned", kTwoLevelIndexSearch);
+  return 0;
+}
@@ -0,0 +1,233 @@
+#include "table_builder.h"
+
+#include <cassert>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "block_builder.h"
+#include "comparator.h"
+#include "env.h"
+#include "format.h"
+#include "utils/coding.h"
+#include "utils/crc32c.h"
+
+namespace leveldb {
+
+struct TableBuilder::Rep {
+  Rep(const Options& opt, WritableFile* f)
+      : options(opt),
+        index_block_options(opt),
+        file(f),
+        offset(0),
+        data_block(&options),
+        index_block(&index_block_options),
+        num_entries(0),
+        closed(false),
+        pending_index_entry(false) {
+    index_block_options.block_restart_interval = 1;
+  }
+
+  Options options;
+  Options index_block_options;
+  WritableFile* file;
+  uint64_t offset;
+  Status status;
+  BlockBuilder data_block;
+  // The whole index for kBinarySearchIndex, the partition being filled
+  // for kTwoLevelIndexSearch.
+  BlockBuilder index_block;
+  std::string last_key;
+  int64_t num_entries;
+  bool closed;  // Either Finish() or Abandon() has been called.
+
+  // Finished index partitions, keyed by the last separator they hold. They
+  // are written together at the end so that the index stays contiguous.
+  std::vector<std::pair<std::string, std::string>> index_partitions;
+  std::string last_index_key;
+
+  // We do not emit the index entry for a block until we have seen the
+  // first key for the next data block.  This allows us to use shorter
+  // keys in the index block.  For example, consider a block boundary
+  // between the keys "the quick brown fox" and "the who".  We can use
+  // "the r" as the key for the index block entry since it is >= all
+  // entries in the first block and < all entries in subsequent
+  // blocks.
+  //
+  // Invariant: r->pending_index_entry is true only if data_block is empty.
+  bool pending_index_entry;
+  BlockHandle pending_handle;  // Handle to add to index block
+
+  std::string compressed_output;
+};
+
+TableBuilder::TableBuilder(const Options& options, WritableFile* file)
+    : rep_(new Rep(options, file)) {}
+
+TableBuilder::~TableBuilder() {
+  assert(rep_->closed);  // Catch errors where caller forgot to call Finish()
+  delete rep_;
+}
+
+void TableBuilder::Add(const Slice& key, const Slice& value) {
+  Rep* r = rep_;
+  assert(!r->closed);
+  if (!ok()) return;
+  if (r->num_entries > 0) {
+    assert(r->options.comparator->Compare(key, Slice(r->last_key)) > 0);
+  }
+
+  if (r->pending_index_entry) {
+    assert(r->data_block.empty());
+    r->options.comparator->FindShortestSeparator(&r->last_key, key);
+    AddIndexEntry(r->last_key, r->pending_handle);
+    r->pending_index_entry = false;
+  }
+
+  r->last_key.assign(key.data(), key.size());
+  r->num_entries++;
+  r->data_block.Add(key, value);
+
+  const size_t estimated_block_size = r->data_block.CurrentSizeEstimate();
+  if (estimated_block_size >= r->options.block_size) {
+    Flush();
+  }
+}
+
+void TableBuilder::AddIndexEntry(const Slice& separator,
+                                 const BlockHandle& handle) {
+  Rep* r = rep_;
+  std::string handle_encoding;
+  handle.EncodeTo(&handle_encoding);
+  r->index_block.Add(separator, Slice(handle_encoding));
+  if (r->options.index_type == kTwoLevelIndexSearch) {
+    r->last_index_key.assign(separator.data(), separator.size());
+    if (r->index_block.CurrentSizeEstimate() >=
+        r->options.metadata_block_size) {
+      CutIndexPartition();
+    }
+  }
+}
+
+void TableBuilder::CutIndexPartition() {
+  Rep* r = rep_;
+  if (r->index_block.empty()) return;
+  r->index_partitions.emplace_back(r->last_index_key,
+                                   r->index_block.Finish().ToString());
+  r->index_block.Reset();
+}
+
+void TableBuilder::Flush() {
+  Rep* r = rep_;
+  assert(!r->closed);
+  if (!ok()) return;
+  if (r->data_block.empty()) return;
+  assert(!r->pending_index_entry);
+  WriteBlock(&r->data_block, &r->pending_handle);
+  if (ok()) {
+    r->pending_index_entry = true;
+    r->status = r->file->Flush();
+  }
+}
+
+void TableBuilder::WriteBlock(BlockBuilder* block, BlockHandle* handle) {
+  // File format contains a sequence of blocks where each block has:
+  //    block_data: uint8[n]
+  //    type: uint8
+  //    crc: uint32
+  assert(ok());
+  Slice raw = block->Finish();
+  WriteRawBlock(raw, kNoCompression, handle);
+  block->Reset();
+}
+
+void TableBuilder::WriteRawBlock(const Slice& block_contents,
+                                 CompressionType type, BlockHandle* handle) {
+  Rep* r = rep_;
+  handle->set_offset(r->offset);
+  handle->set_size(block_contents.size());
+  r->status = r->file->Append(block_contents);
+  if (r->status.ok()) {
+    char trailer[kBlockTrailerSize];
+    trailer[0] = type;
+    uint32_t crc = crc32c::Value(block_contents.data(), block_contents.size());
+    crc = crc32c::Extend(crc, trailer, 1);  // Extend crc to cover block type
+    EncodeFixed32(trailer + 1, crc32c::Mask(crc));
+    r->status = r->file->Append(Slice(trailer, kBlockTrailerSize));
+    if (r->status.ok()) {
+      r->offset += block_contents.size() + kBlockTrailerSize;
+    }
+  }
+}
+
+Status TableBuilder::status() const { return rep_->status; }
+
+Status TableBuilder::Finish() {
+  Rep* r = rep_;
+  Flush();
+  assert(!r->closed);
+  r->closed = true;
+
+  BlockHandle metaindex_block_handle, index_block_handle;
+
+  // Write metaindex block
+  if (ok()) {
+    BlockBuilder meta_index_block(&r->options);
+    WriteBlock(&meta_index_block, &metaindex_block_handle);
+  }
+
+  // Write index block
+  if (ok()) {
+    if (r->pending_index_entry) {
+      r->options.comparator->FindShortSuccessor(&r->last_key);
+      AddIndexEntry(r->last_key, r->pending_handle);
+      r->pending_index_entry = false;
+    }
+    if (r->options.index_type == kTwoLevelIndexSearch) {
+      // Write the partitions, then the top-level index that points at them.
+      CutIndexPartition();
+      BlockBuilder top_level(&r->index_block_options);
+      for (size_t i = 0; i < r->index_partitions.size() && ok(); i++) {
+        BlockHandle partition_handle;
+        WriteRawBlock(r->index_partitions[i].second, kNoCompression,
+                      &partition_handle);
+        std::string handle_encoding;
+        partition_handle.EncodeTo(&handle_encoding);
+        top_level.Add(r->index_partitions[i].first, handle_encoding);
+      }
+      r->index_partitions.clear();
+      if (ok()) {
+        WriteBlock(&top_level, &index_block_handle);
+      }
+    } else {
+      WriteBlock(&r->index_block, &index_block_handle);
+    }
+  }
+
+  // Write footer
+  if (ok()) {
+    Footer footer;
+    footer.set_metaindex_handle(metaindex_block_handle);
+    footer.set_index_handle(index_block_handle);
+    footer.set_index_type(r->options.index_type);
+    std::string footer_encoding;
+    footer.EncodeTo(&footer_encoding);
+    r->status = r->file->Append(footer_encoding);
+    if (r->status.ok()) {
+      r->offset += footer_encoding.size();
+    }
+  }
+  return r->status;
+}
+
+void TableBuilder::Abandon() {
+  Rep* r = rep_;
+  assert(!r->closed);
+  r->closed = true;
+}
+
+uint64_t TableBuilder::NumEntries() const { return rep_->num_entries; }
+
+uint64_t TableBuilder::FileSize() const { return rep_->offset; }
+
+}  // namespace leveldb
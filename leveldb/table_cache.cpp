@@ -0,0 +1,158 @@
+#include "table_cache.h"
+
+#include "blob_file.h"
+#include "env.h"
+#include "filename.h"
+
+namespace leveldb {
+
+struct TableAndFile {
+  RandomAccessFile* file;
+  Table* table;
+};
+
+static void DeleteEntry(uint64_t file_number, uint64_t offset, void* value) {
+  TableAndFile* tf = reinterpret_cast<TableAndFile*>(value);
+  delete tf->table;
+  delete tf->file;
+  delete tf;
+}
+
+struct BlobReaderAndFile {
+  RandomAccessFile* file;
+  BlobFileReader* reader;
+};
+
+static void DeleteBlobEntry(uint64_t file_number, uint64_t offset,
+                            void* value) {
+  BlobReaderAndFile* bf = reinterpret_cast<BlobReaderAndFile*>(value);
+  delete bf->reader;
+  delete bf->file;
+  delete bf;
+}
+
+static void UnrefEntry(void* arg1, void* arg2) {
+  BlockCache* cache = reinterpret_cast<BlockCache*>(arg1);
+  BlockCache::Handle* h = reinterpret_cast<BlockCache::Handle*>(arg2);
+  cache->Release(h);
+}
+
+TableCache::TableCache(const std::string& dbname, const Options& options,
+                       int entries)
+    : env_(options.env),
+      dbname_(dbname),
+      options_(options),
+      cache_(new BlockCache(entries, 1, entries >= 256 ? 4 : 0)) {}
+
+TableCache::~TableCache() { delete cache_; }
+
+Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
+                             BlockCache::Handle** handle) {
+  Status s;
+  *handle = cache_->Lookup(file_number, 0);
+  if (*handle == nullptr) {
+    std::string fname = TableFileName(dbname_, file_number);
+    RandomAccessFile* file = nullptr;
+    Table* table = nullptr;
+    s = env_->NewRandomAccessFile(fname, &file);
+    if (s.ok()) {
+      s = Table::Open(options_, file, file_number, file_size, &table);
+    }
+
+    if (!s.ok()) {
+      assert(table == nullptr);
+      delete file;
+      // We do not cache error results so that if the error is transient,
+      // or somebody repairs the file, we recover automatically.
+    } else {
+      TableAndFile* tf = new TableAndFile;
+      tf->file = file;
+      tf->table = table;
+      *handle = cache_->Insert(file_number, 0, tf, 1, &DeleteEntry);
+      if (*handle == nullptr) {
+        DeleteEntry(file_number, 0, tf);
+        s = Status::IOError("table cache: every slot is pinned");
+      }
+    }
+  }
+  return s;
+}
+
+Status TableCache::FindBlobFile(uint64_t file_number,
+                                BlockCache::Handle** handle) {
+  Status s;
+  *handle = cache_->Lookup(file_number, 0);
+  if (*handle == nullptr) {
+    std::string fname = BlobFileName(dbname_, file_number);
+    RandomAccessFile* file = nullptr;
+    uint64_t file_size = 0;
+    s = env_->GetFileSize(fname, &file_size);
+    if (s.ok()) {
+      s = env_->NewRandomAccessFile(fname, &file);
+    }
+    if (s.ok()) {
+      BlobReaderAndFile* bf = new BlobReaderAndFile;
+      bf->file = file;
+      bf->reader = new BlobFileReader(file, file_number, file_size);
+      *handle = cache_->Insert(file_number, 0, bf, 1, &DeleteBlobEntry);
+      if (*handle == nullptr) {
+        DeleteBlobEntry(file_number, 0, bf);
+        s = Status::IOError("table cache: every slot is pinned");
+      }
+    }
+  }
+  return s;
+}
+
+Iterator* TableCache::NewIterator(const ReadOptions& options,
+                                  uint64_t file_number, uint64_t file_size,
+                                  Table** tableptr) {
+  if (tableptr != nullptr) {
+    *tableptr = nullptr;
+  }
+
+  BlockCache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, &handle);
+  if (!s.ok()) {
+    return NewErrorIterator(s);
+  }
+
+  Table* table = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+  Iterator* result = table->NewIterator(options);
+  result->RegisterCleanup(&UnrefEntry, cache_, handle);
+  if (tableptr != nullptr) {
+    *tableptr = table;
+  }
+  return result;
+}
+
+Status TableCache::Get(const ReadOptions& options, uint64_t file_number,
+                       uint64_t file_size, const Slice& k, void* arg,
+                       void (*handle_result)(void*, const Slice&,
+                                             const Slice&)) {
+  BlockCache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, &handle);
+  if (s.ok()) {
+    Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+    s = t->InternalGet(options, k, arg, handle_result);
+    cache_->Release(handle);
+  }
+  return s;
+}
+
+Status TableCache::GetBlob(const ReadOptions& options, const BlobIndex& index,
+                           std::string* value) {
+  BlockCache::Handle* handle = nullptr;
+  Status s = FindBlobFile(index.file_number, &handle);
+  if (s.ok()) {
+    const BlobFileReader* reader =
+        reinterpret_cast<BlobReaderAndFile*>(cache_->Value(handle))->reader;
+    s = reader->Get(index, options.verify_checksums, value);
+    cache_->Release(handle);
+  }
+  return s;
+}
+
+void TableCache::Evict(uint64_t file_number) { cache_->Erase(file_number, 0); }
+
+}  // namespace leveldb
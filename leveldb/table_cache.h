@@ -1,7 +1,65 @@
-#include <iostream>
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "block_cache.h"
+#include "iterator.h"
+#include "options.h"
+#include "table.h"
 
 namespace leveldb {
+
 class Env;
+struct BlobIndex;
+
+// Thread-safe cache of open Tables and blob files, keyed by file number.
+// Entries live in a BlockCache with a charge of one per file, so "entries"
+// bounds the number of open files.
+//
+// "options.comparator" must be the internal key comparator the tables
+// were built with.
+class TableCache {
+ public:
+  TableCache(const std::string& dbname, const Options& options, int entries);
+
+  TableCache(const TableCache&) = delete;
+  TableCache& operator=(const TableCache&) = delete;
+
+  ~TableCache();
+
+  // Return an iterator for the specified file number (the corresponding
+  // file length must be exactly "file_size" bytes).  If "tableptr" is
+  // non-null, also sets "*tableptr" to point to the Table object
+  // underlying the returned iterator, or to nullptr if no Table object
+  // underlies the returned iterator.  The returned "*tableptr" object is owned
+  // by the cache and should not be deleted, and is valid for as long as the
+  // returned iterator is live.
+  Iterator* NewIterator(const ReadOptions& options, uint64_t file_number,
+                        uint64_t file_size, Table** tableptr = nullptr);
+
+  // If a seek to internal key "k" in specified file finds an entry,
+  // call (*handle_result)(arg, found_key, found_value).
+  Status Get(const ReadOptions& options, uint64_t file_number,
+             uint64_t file_size, const Slice& k, void* arg,
+             void (*handle_result)(void*, const Slice&, const Slice&));
+
+  // Read the value that "index" points at from its blob file.
+  Status GetBlob(const ReadOptions& options, const BlobIndex& index,
+                 std::string* value);
+
+  // Evict any entry for the specified file number
+  void Evict(uint64_t file_number);
+
+ private:
+  Status FindTable(uint64_t file_number, uint64_t file_size,
+                   BlockCache::Handle**);
+  Status FindBlobFile(uint64_t file_number, BlockCache::Handle**);
+
+  Env* const env_;
+  const std::string dbname_;
+  const Options& options_;
+  BlockCache* cache_;
+};
 
-class TableCache {};
-};  // namespace leveldb
\ No newline at end of file
+}  // namespace leveldb
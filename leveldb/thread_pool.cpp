@@ -0,0 +1,67 @@
+#include "thread_pool.h"
+
+#include <cassert>
+
+namespace leveldb {
+
+ThreadPool::ThreadPool(int high_threads, int low_threads)
+    : has_high_threads_(high_threads > 0), closing_(false) {
+  assert(high_threads + low_threads > 0);
+  for (int i = 0; i < high_threads; i++) {
+    threads_.emplace_back(&ThreadPool::Work, this, kHigh);
+  }
+  for (int i = 0; i < low_threads; i++) {
+    threads_.emplace_back(&ThreadPool::Work, this, kLow);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> l(mu_);
+    closing_ = true;
+  }
+  cv_.notify_all();
+  for (std::thread& t : threads_) {
+    t.join();
+  }
+}
+
+void ThreadPool::Schedule(Priority pri, std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> l(mu_);
+    queue_[pri].push_back(std::move(job));
+  }
+  // Threads of both priorities wait on cv_, so wake them all; only the
+  // ones that may run the job stay awake.
+  cv_.notify_all();
+}
+
+int ThreadPool::QueueLength(Priority pri) const {
+  std::lock_guard<std::mutex> l(mu_);
+  return static_cast<int>(queue_[pri].size());
+}
+
+void ThreadPool::Work(Priority pri) {
+  // kLow threads also serve kHigh jobs when there are no kHigh threads.
+  const bool takes_high = (pri == kHigh || !has_high_threads_);
+  const bool takes_low = (pri == kLow);
+  std::unique_lock<std::mutex> l(mu_);
+  while (true) {
+    cv_.wait(l, [&] {
+      return closing_ || (takes_high && !queue_[kHigh].empty()) ||
+             (takes_low && !queue_[kLow].empty());
+    });
+    if (closing_) {
+      return;
+    }
+    std::deque<std::function<void()>>& queue =
+        (takes_high && !queue_[kHigh].empty()) ? queue_[kHigh] : queue_[kLow];
+    std::function<void()> job = std::move(queue.front());
+    queue.pop_front();
+    l.unlock();
+    job();
+    l.lock();
+  }
+}
+
+}  // namespace leveldb
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace leveldb {
+
+/**
+ * @brief ThreadPool
+ *
+ * @details Runs background jobs from two queues: kHigh for flushes, which
+ * writers may be waiting on, and kLow for compactions. Each priority has
+ * its own threads, so a long compaction never holds up a flush. If the
+ * pool has no kHigh threads, kHigh jobs are run by the kLow threads, ahead
+ * of every queued kLow job.
+ *
+ * A pool can be shared by several DBs (options.background_pool), which is
+ * what the thread counts are for: a single DB runs at most one flush and
+ * one compaction at a time.
+ *
+ * The destructor waits for the running jobs and drops the queued ones.
+ */
+class ThreadPool {
+ public:
+  enum Priority { kHigh = 0, kLow = 1 };
+
+  ThreadPool(int high_threads, int low_threads);
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  ~ThreadPool();
+
+  // Queue "job" to run once on a thread of the pool.
+  void Schedule(Priority pri, std::function<void()> job);
+
+  // Number of jobs of priority "pri" that are queued but not running.
+  int QueueLength(Priority pri) const;
+
+ private:
+  void Work(Priority pri);
+
+  mutable std::mutex mu_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> queue_[2];
+  bool has_high_threads_;
+  bool closing_;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace leveldb
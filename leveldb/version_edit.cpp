@@ -1,6 +1,9 @@
 #include "version_edit.h"
 
+#include <algorithm>
+
 #include "utils/coding.h"
+#include "utils/logging.h"
 
 namespace leveldb {
 
@@ -15,7 +18,10 @@ enum Tag {
   kDeletedFile = 6,
   kNewFile = 7,
   // 8 was used for large value refs
-  kPrevLogNumber = 9
+  kPrevLogNumber = 9,
+  kNewBlobFile = 10,
+  kBlobGarbage = 11,
+  kDeletedBlobFile = 12
 };
 
 void VersionEdit::Clear() {
@@ -32,6 +38,57 @@ void VersionEdit::Clear() {
   compact_pointers_.clear();
   deleted_files_.clear();
   new_files_.clear();
+  new_blob_files_.clear();
+  blob_garbage_.clear();
+  deleted_blob_files_.clear();
+}
+
+void VersionEdit::Append(const VersionEdit& other) {
+  if (other.has_comparator_) SetComparatorName(other.comparator_);
+  if (other.has_log_number_) SetLogNumber(other.log_number_);
+  if (other.has_prev_log_number_) SetPrevLogNumber(other.prev_log_number_);
+  if (other.has_next_file_number_) SetNextFile(other.next_file_number_);
+  if (other.has_last_sequence_) SetLastSequence(other.last_sequence_);
+  compact_pointers_.insert(compact_pointers_.end(),
+                           other.compact_pointers_.begin(),
+                           other.compact_pointers_.end());
+
+  // Within one edit deletions are applied before additions, so a file that
+  // this edit adds and "other" deletes must vanish from both lists.
+  for (const auto& deleted : other.deleted_files_) {
+    auto it = std::find_if(new_files_.begin(), new_files_.end(),
+                           [&](const std::pair<int, FileMetaData>& f) {
+                             return f.first == deleted.first &&
+                                    f.second.number == deleted.second;
+                           });
+    if (it != new_files_.end()) {
+      new_files_.erase(it);
+    } else {
+      deleted_files_.insert(deleted);
+    }
+  }
+  new_files_.insert(new_files_.end(), other.new_files_.begin(),
+                    other.new_files_.end());
+
+  new_blob_files_.insert(new_blob_files_.end(), other.new_blob_files_.begin(),
+                         other.new_blob_files_.end());
+  blob_garbage_.insert(blob_garbage_.end(), other.blob_garbage_.begin(),
+                       other.blob_garbage_.end());
+  for (uint64_t number : other.deleted_blob_files_) {
+    auto same = [number](const BlobFileMetaData& f) {
+      return f.number == number;
+    };
+    auto it = std::find_if(new_blob_files_.begin(), new_blob_files_.end(),
+                           same);
+    if (it != new_blob_files_.end()) {
+      new_blob_files_.erase(it);
+      blob_garbage_.erase(
+          std::remove_if(blob_garbage_.begin(), blob_garbage_.end(), same),
+          blob_garbage_.end());
+    } else {
+      deleted_blob_files_.insert(number);
+    }
+  }
 }
 
 void VersionEdit::EncodeTo(std::string* dst) const {
@@ -78,57 +135,246 @@ void VersionEdit::EncodeTo(std::string* dst) const {
     PutLengthPrefixedSlice(dst, f.largest.Encode());
   }
 
-  std::string VersionEdit::DebugString() const {
-    std::string r;
-    r.append("VersionEdit {");
-    if (has_comparator_) {
-      r.append("\n  Comparator: ");
-      r.append(comparator_);
-    }
-    if (has_log_number_) {
-      r.append("\n  LogNumber: ");
-      AppendNumberTo(&r, log_number_);
-    }
-    if (has_prev_log_number_) {
-      r.append("\n  PrevLogNumber: ");
-      AppendNumberTo(&r, prev_log_number_);
-    }
-    if (has_next_file_number_) {
-      r.append("\n  NextFile: ");
-      AppendNumberTo(&r, next_file_number_);
-    }
-    if (has_last_sequence_) {
-      r.append("\n  LastSeq: ");
-      AppendNumberTo(&r, last_sequence_);
-    }
-    for (size_t i = 0; i < compact_pointers_.size(); i++) {
-      r.append("\n  CompactPointer: ");
-      AppendNumberTo(&r, compact_pointers_[i].first);
-      r.append(" ");
-      r.append(compact_pointers_[i].second.DebugString());
-    }
-    for (const auto& deleted_files_kvp : deleted_files_) {
-      r.append("\n  RemoveFile: ");
-      AppendNumberTo(&r, deleted_files_kvp.first);
-      r.append(" ");
-      AppendNumberTo(&r, deleted_files_kvp.second);
-    }
-    for (size_t i = 0; i < new_files_.size(); i++) {
-      const FileMetaData& f = new_files_[i].second;
-      r.append("\n  AddFile: ");
-      AppendNumberTo(&r, new_files_[i].first);
-      r.append(" ");
-      AppendNumberTo(&r, f.number);
-      r.append(" ");
-      AppendNumberTo(&r, f.file_size);
-      r.append(" ");
-      r.append(f.smallest.DebugString());
-      r.append(" .. ");
-      r.append(f.largest.DebugString());
+  for (const BlobFileMetaData& f : new_blob_files_) {
+    PutVarint32(dst, kNewBlobFile);
+    PutVarint64(dst, f.number);
+    PutVarint64(dst, f.total_count);
+    PutVarint64(dst, f.total_bytes);
+  }
+
+  for (const BlobFileMetaData& f : blob_garbage_) {
+    PutVarint32(dst, kBlobGarbage);
+    PutVarint64(dst, f.number);
+    PutVarint64(dst, f.garbage_count);
+    PutVarint64(dst, f.garbage_bytes);
+  }
+
+  for (uint64_t number : deleted_blob_files_) {
+    PutVarint32(dst, kDeletedBlobFile);
+    PutVarint64(dst, number);
+  }
+}
+
+static bool GetInternalKey(Slice* input, InternalKey* dst) {
+  Slice str;
+  if (GetLengthPrefixedSlice(input, &str)) {
+    return dst->DecodeFrom(str);
+  } else {
+    return false;
+  }
+}
+
+static bool GetLevel(Slice* input, int* level) {
+  uint32_t v;
+  if (GetVarint32(input, &v) && v < config::kNumLevels) {
+    *level = v;
+    return true;
+  } else {
+    return false;
+  }
+}
+
+Status VersionEdit::DecodeFrom(const Slice& src) {
+  Clear();
+  Slice input = src;
+  const char* msg = nullptr;
+  uint32_t tag;
+
+  // Temporary storage for parsing
+  int level;
+  uint64_t number;
+  FileMetaData f;
+  BlobFileMetaData b;
+  Slice str;
+  InternalKey key;
+
+  while (msg == nullptr && GetVarint32(&input, &tag)) {
+    switch (tag) {
+      case kComparator:
+        if (GetLengthPrefixedSlice(&input, &str)) {
+          comparator_ = str.ToString();
+          has_comparator_ = true;
+        } else {
+          msg = "comparator name";
+        }
+        break;
+
+      case kLogNumber:
+        if (GetVarint64(&input, &log_number_)) {
+          has_log_number_ = true;
+        } else {
+          msg = "log number";
+        }
+        break;
+
+      case kPrevLogNumber:
+        if (GetVarint64(&input, &prev_log_number_)) {
+          has_prev_log_number_ = true;
+        } else {
+          msg = "previous log number";
+        }
+        break;
+
+      case kNextFileNumber:
+        if (GetVarint64(&input, &next_file_number_)) {
+          has_next_file_number_ = true;
+        } else {
+          msg = "next file number";
+        }
+        break;
+
+      case kLastSequence:
+        if (GetVarint64(&input, &last_sequence_)) {
+          has_last_sequence_ = true;
+        } else {
+          msg = "last sequence number";
+        }
+        break;
+
+      case kCompactPointer:
+        if (GetLevel(&input, &level) && GetInternalKey(&input, &key)) {
+          compact_pointers_.push_back(std::make_pair(level, key));
+        } else {
+          msg = "compaction pointer";
+        }
+        break;
+
+      case kDeletedFile:
+        if (GetLevel(&input, &level) && GetVarint64(&input, &number)) {
+          deleted_files_.insert(std::make_pair(level, number));
+        } else {
+          msg = "deleted file";
+        }
+        break;
+
+      case kNewFile:
+        if (GetLevel(&input, &level) && GetVarint64(&input, &f.number) &&
+            GetVarint64(&input, &f.file_size) &&
+            GetInternalKey(&input, &f.smallest) &&
+            GetInternalKey(&input, &f.largest)) {
+          new_files_.push_back(std::make_pair(level, f));
+        } else {
+          msg = "new-file entry";
+        }
+        break;
+
+      case kNewBlobFile:
+        b = BlobFileMetaData();
+        if (GetVarint64(&input, &b.number) &&
+            GetVarint64(&input, &b.total_count) &&
+            GetVarint64(&input, &b.total_bytes)) {
+          new_blob_files_.push_back(b);
+        } else {
+          msg = "new-blob-file entry";
+        }
+        break;
+
+      case kBlobGarbage:
+        b = BlobFileMetaData();
+        if (GetVarint64(&input, &b.number) &&
+            GetVarint64(&input, &b.garbage_count) &&
+            GetVarint64(&input, &b.garbage_bytes)) {
+          blob_garbage_.push_back(b);
+        } else {
+          msg = "blob garbage entry";
+        }
+        break;
+
+      case kDeletedBlobFile:
+        if (GetVarint64(&input, &number)) {
+          deleted_blob_files_.insert(number);
+        } else {
+          msg = "deleted blob file";
+        }
+        break;
+
+      default:
+        msg = "unknown tag";
+        break;
     }
-    r.append("\n}\n");
-    return r;
   }
+
+  if (msg == nullptr && !input.empty()) {
+    msg = "invalid tag";
+  }
+
+  Status result;
+  if (msg != nullptr) {
+    result = Status::Corruption("VersionEdit", msg);
+  }
+  return result;
+}
+
+std::string VersionEdit::DebugString() const {
+  std::string r;
+  r.append("VersionEdit {");
+  if (has_comparator_) {
+    r.append("\n  Comparator: ");
+    r.append(comparator_);
+  }
+  if (has_log_number_) {
+    r.append("\n  LogNumber: ");
+    AppendNumberTo(&r, log_number_);
+  }
+  if (has_prev_log_number_) {
+    r.append("\n  PrevLogNumber: ");
+    AppendNumberTo(&r, prev_log_number_);
+  }
+  if (has_next_file_number_) {
+    r.append("\n  NextFile: ");
+    AppendNumberTo(&r, next_file_number_);
+  }
+  if (has_last_sequence_) {
+    r.append("\n  LastSeq: ");
+    AppendNumberTo(&r, last_sequence_);
+  }
+  for (size_t i = 0; i < compact_pointers_.size(); i++) {
+    r.append("\n  CompactPointer: ");
+    AppendNumberTo(&r, compact_pointers_[i].first);
+    r.append(" ");
+    r.append(compact_pointers_[i].second.DebugString());
+  }
+  for (const auto& deleted_files_kvp : deleted_files_) {
+    r.append("\n  RemoveFile: ");
+    AppendNumberTo(&r, deleted_files_kvp.first);
+    r.append(" ");
+    AppendNumberTo(&r, deleted_files_kvp.second);
+  }
+  for (size_t i = 0; i < new_files_.size(); i++) {
+    const FileMetaData& f = new_files_[i].second;
+    r.append("\n  AddFile: ");
+    AppendNumberTo(&r, new_files_[i].first);
+    r.append(" ");
+    AppendNumberTo(&r, f.number);
+    r.append(" ");
+    AppendNumberTo(&r, f.file_size);
+    r.append(" ");
+    r.append(f.smallest.DebugString());
+    r.append(" .. ");
+    r.append(f.largest.DebugString());
+  }
+  for (const BlobFileMetaData& f : new_blob_files_) {
+    r.append("\n  AddBlobFile: ");
+    AppendNumberTo(&r, f.number);
+    r.append(" ");
+    AppendNumberTo(&r, f.total_count);
+    r.append(" ");
+    AppendNumberTo(&r, f.total_bytes);
+  }
+  for (const BlobFileMetaData& f : blob_garbage_) {
+    r.append("\n  BlobGarbage: ");
+    AppendNumberTo(&r, f.number);
+    r.append(" ");
+    AppendNumberTo(&r, f.garbage_count);
+    r.append(" ");
+    AppendNumberTo(&r, f.garbage_bytes);
+  }
+  for (uint64_t number : deleted_blob_files_) {
+    r.append("\n  RemoveBlobFile: ");
+    AppendNumberTo(&r, number);
+  }
+  r.append("\n}\n");
+  return r;
 }
 
-}  // namespace leveldb
\ No newline at end of file
+}  // namespace leveldb
@@ -1,27 +1,64 @@
 #pragma once
 
+#include <atomic>
 #include <iostream>
 #include <set>
 #include <vector>
 
 #include "dbformat.h"
 #include "slice.h"
+#include "status.h"
 
 namespace leveldb {
 
 class VersionSet;
 
 struct FileMetaData {
-  FileMetaData() : refs(0), allowd_seeks(1 << 30), file_size(0) {}
+  FileMetaData() : refs(0), allowd_seeks(1 << 30), number(0), file_size(0) {}
+
+  // Copies take a snapshot of the seek budget.
+  FileMetaData(const FileMetaData& f)
+      : refs(f.refs),
+        allowd_seeks(f.allowd_seeks.load(std::memory_order_relaxed)),
+        number(f.number),
+        file_size(f.file_size),
+        smallest(f.smallest),
+        largest(f.largest) {}
+  FileMetaData& operator=(const FileMetaData& f) {
+    refs = f.refs;
+    allowd_seeks.store(f.allowd_seeks.load(std::memory_order_relaxed),
+                       std::memory_order_relaxed);
+    number = f.number;
+    file_size = f.file_size;
+    smallest = f.smallest;
+    largest = f.largest;
+    return *this;
+  }
 
   int refs;
-  int allowd_seeks;
+  // Seeks allowed until compaction, see Version::UpdateStats. Charged by
+  // readers without the DB mutex.
+  std::atomic<int> allowd_seeks;
   uint64_t number;
   uint64_t file_size;
   InternalKey smallest;
   InternalKey largest;
 };
 
+// A blob file and how much of it is no longer referenced from the LSM.
+struct BlobFileMetaData {
+  uint64_t number = 0;
+  uint64_t total_count = 0;
+  uint64_t total_bytes = 0;  // value bytes, excluding record headers
+  uint64_t garbage_count = 0;
+  uint64_t garbage_bytes = 0;
+
+  double GarbageRatio() const {
+    return total_bytes == 0 ? 0.0
+                            : static_cast<double>(garbage_bytes) / total_bytes;
+  }
+};
+
 class VersionEdit {
  public:
   VersionEdit() { Clear(); };
@@ -70,7 +107,34 @@ class VersionEdit {
     deleted_files_.insert({level, file});
   }
 
+  // Add a newly written blob file holding "count" values of "bytes" bytes.
+  void AddBlobFile(uint64_t file, uint64_t count, uint64_t bytes) {
+    BlobFileMetaData f;
+    f.number = file;
+    f.total_count = count;
+    f.total_bytes = bytes;
+    new_blob_files_.push_back(f);
+  }
+
+  // Record that "count" values of "bytes" bytes in blob "file" became
+  // unreachable, as reported by compaction.
+  void AddBlobGarbage(uint64_t file, uint64_t count, uint64_t bytes) {
+    BlobFileMetaData f;
+    f.number = file;
+    f.garbage_count = count;
+    f.garbage_bytes = bytes;
+    blob_garbage_.push_back(f);
+  }
+
+  void RemoveBlobFile(uint64_t file) { deleted_blob_files_.insert(file); }
+
+  // Fold "other" into this edit so that applying the result is the same as
+  // applying this edit and then "other". Used to commit several edits as a
+  // single manifest record.
+  void Append(const VersionEdit& other);
+
   void EncodeTo(std::string* dst) const;
+  Status DecodeFrom(const Slice& src);
 
   std::string DebugString() const;
 
@@ -95,6 +159,10 @@ class VersionEdit {
   std::vector<std::pair<int, InternalKey>> compact_pointers_;
   DeletedFileSet deleted_files_;
   std::vector<std::pair<int, FileMetaData>> new_files_;
+
+  std::vector<BlobFileMetaData> new_blob_files_;
+  std::vector<BlobFileMetaData> blob_garbage_;
+  std::set<uint64_t> deleted_blob_files_;
 };
 
 };  // namespace leveldb
\ No newline at end of file
@@ -0,0 +1,1686 @@
+#include "version_set.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+
+#include "env.h"
+#include "filename.h"
+#include "log_parallel_reader.h"
+#include "log_writer.h"
+#include "merger.h"
+#include "table.h"
+#include "table_cache.h"
+#include "two_level_iterator.h"
+#include "utils/coding.h"
+#include "utils/logging.h"
+
+namespace leveldb {
+
+static size_t TargetFileSize(const Options* options) {
+  return options->max_file_size;
+}
+
+// Maximum bytes of overlaps in grandparent (i.e., level+2) before we
+// stop building a single file in a level->level+1 compaction.
+static int64_t MaxGrandParentOverlapBytes(const Options* options) {
+  return 10 * TargetFileSize(options);
+}
+
+// Maximum number of bytes in all compacted files.  We avoid expanding
+// the lower level file set of a compaction if it would make the
+// total compaction cover more than this many bytes.
+static int64_t ExpandedCompactionByteSizeLimit(const Options* options) {
+  return 25 * TargetFileSize(options);
+}
+
+static int64_t TotalFileSize(const std::vector<FileMetaData*>& files) {
+  int64_t sum = 0;
+  for (size_t i = 0; i < files.size(); i++) {
+    sum += files[i]->file_size;
+  }
+  return sum;
+}
+
+LevelFiles::LevelFiles(std::vector<FileMetaData*> files)
+    : files_(std::move(files)) {
+  for (FileMetaData* f : files_) {
+    f->refs++;
+  }
+}
+
+LevelFiles::~LevelFiles() {
+  for (FileMetaData* f : files_) {
+    assert(f->refs > 0);
+    f->refs--;
+    if (f->refs <= 0) {
+      delete f;
+    }
+  }
+}
+
+Version::Version(VersionSet* vset)
+    : vset_(vset),
+      next_(this),
+      prev_(this),
+      refs_(0),
+      index_(&vset->icmp_),
+      file_to_compact_(nullptr),
+      file_to_compact_level_(-1),
+      pending_compaction_bytes_(0),
+      base_level_(1),
+      compaction_score_(-1),
+      compaction_level_(-1) {
+  static const std::shared_ptr<const LevelFiles> kEmptyLevel =
+      std::make_shared<LevelFiles>();
+  static const std::shared_ptr<const BlobFileMap> kNoBlobFiles =
+      std::make_shared<BlobFileMap>();
+  for (int level = 0; level < config::kNumLevels; level++) {
+    levels_[level] = kEmptyLevel;
+  }
+  blob_files_ = kNoBlobFiles;
+}
+
+Version::~Version() {
+  assert(refs_ == 0);
+
+  // Remove from linked list
+  prev_->next_ = next_;
+  next_->prev_ = prev_;
+
+  // The per-level file lists drop their file references once the last
+  // version sharing them goes away.
+}
+
+int FindFile(const InternalKeyComparator& icmp,
+             const std::vector<FileMetaData*>& files, const Slice& key) {
+  uint32_t left = 0;
+  uint32_t right = files.size();
+  while (left < right) {
+    uint32_t mid = (left + right) / 2;
+    const FileMetaData* f = files[mid];
+    if (icmp.InternalKeyComparator::Compare(f->largest.Encode(), key) < 0) {
+      // Key at "mid.largest" is < "target".  Therefore all
+      // files at or before "mid" are uninteresting.
+      left = mid + 1;
+    } else {
+      // Key at "mid.largest" is >= "target".  Therefore all files
+      // after "mid" are uninteresting.
+      right = mid;
+    }
+  }
+  return right;
+}
+
+static bool AfterFile(const Comparator* ucmp, const Slice* user_key,
+                      const FileMetaData* f) {
+  // null user_key occurs before all keys and is therefore never after *f
+  return (user_key != nullptr &&
+          ucmp->Compare(*user_key, f->largest.user_key()) > 0);
+}
+
+static bool BeforeFile(const Comparator* ucmp, const Slice* user_key,
+                       const FileMetaData* f) {
+  // null user_key occurs after all keys and is therefore never before *f
+  return (user_key != nullptr &&
+          ucmp->Compare(*user_key, f->smallest.user_key()) < 0);
+}
+
+bool SomeFileOverlapsRange(const InternalKeyComparator& icmp,
+                           bool disjoint_sorted_files,
+                           const std::vector<FileMetaData*>& files,
+                           const Slice* smallest_user_key,
+                           const Slice* largest_user_key) {
+  const Comparator* ucmp = icmp.user_comparator();
+  if (!disjoint_sorted_files) {
+    // Need to check against all files
+    for (size_t i = 0; i < files.size(); i++) {
+      const FileMetaData* f = files[i];
+      if (AfterFile(ucmp, smallest_user_key, f) ||
+          BeforeFile(ucmp, largest_user_key, f)) {
+        // No overlap
+      } else {
+        return true;  // Overlap
+      }
+    }
+    return false;
+  }
+
+  // Binary search over file list
+  uint32_t index = 0;
+  if (smallest_user_key != nullptr) {
+    // Find the earliest possible internal key for smallest_user_key
+    InternalKey small_key(*smallest_user_key, kMaxSequenceNumber,
+                          kValueTypeForSeek);
+    index = FindFile(icmp, files, small_key.Encode());
+  }
+
+  if (index >= files.size()) {
+    // beginning of range is after all files, so no overlap.
+    return false;
+  }
+
+  return !BeforeFile(ucmp, largest_user_key, files[index]);
+}
+
+// An internal iterator.  For a given version/level pair, yields
+// information about the files in the level.  For a given entry, key()
+// is the largest key that occurs in the file, and value() is an
+// 16-byte value containing the file number and file size, both
+// encoded using EncodeFixed64.
+class Version::LevelFileNumIterator : public Iterator {
+ public:
+  LevelFileNumIterator(const InternalKeyComparator& icmp,
+                       const std::vector<FileMetaData*>* flist)
+      : icmp_(icmp), flist_(flist), index_(flist->size()) {  // Marks as invalid
+  }
+  bool Valid() const override { return index_ < flist_->size(); }
+  void Seek(const Slice& target) override {
+    index_ = FindFile(icmp_, *flist_, target);
+  }
+  void SeekToFirst() override { index_ = 0; }
+  void SeekToLast() override {
+    index_ = flist_->empty() ? 0 : flist_->size() - 1;
+  }
+  void Next() override {
+    assert(Valid());
+    index_++;
+  }
+  void Prev() override {
+    assert(Valid());
+    if (index_ == 0) {
+      index_ = flist_->size();  // Marks as invalid
+    } else {
+      index_--;
+    }
+  }
+  Slice key() const override {
+    assert(Valid());
+    return (*flist_)[index_]->largest.Encode();
+  }
+  Slice value() const override {
+    assert(Valid());
+    EncodeFixed64(value_buf_, (*flist_)[index_]->number);
+    EncodeFixed64(value_buf_ + 8, (*flist_)[index_]->file_size);
+    return Slice(value_buf_, sizeof(value_buf_));
+  }
+  Status status() const override { return Status::OK(); }
+
+ private:
+  const InternalKeyComparator icmp_;
+  const std::vector<FileMetaData*>* const flist_;
+  uint32_t index_;
+
+  // Backing store for value().  Holds the file number and size.
+  mutable char value_buf_[16];
+};
+
+static Iterator* GetFileIterator(void* arg, const ReadOptions& options,
+                                 const Slice& file_value) {
+  TableCache* cache = reinterpret_cast<TableCache*>(arg);
+  if (file_value.size() != 16) {
+    return NewErrorIterator(
+        Status::Corruption("FileReader invoked with unexpected value"));
+  } else {
+    return cache->NewIterator(options, DecodeFixed64(file_value.data()),
+                              DecodeFixed64(file_value.data() + 8));
+  }
+}
+
+Iterator* Version::NewConcatenatingIterator(const ReadOptions& options,
+                                            int level) const {
+  return NewTwoLevelIterator(
+      new LevelFileNumIterator(vset_->icmp_, &files(level)), &GetFileIterator,
+      vset_->table_cache_, options);
+}
+
+namespace {
+enum SaverState {
+  kNotFound,
+  kFound,
+  kDeleted,
+  kCorrupt,
+};
+struct Saver {
+  SaverState state;
+  const Comparator* ucmp;
+  Slice user_key;
+  std::string* value;
+  bool is_blob_index;
+};
+}  // namespace
+static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
+  Saver* s = reinterpret_cast<Saver*>(arg);
+  ParsedInternalKey parsed_key;
+  if (!ParseInternalKey(ikey, &parsed_key)) {
+    s->state = kCorrupt;
+  } else {
+    if (s->ucmp->Compare(parsed_key.user_key, s->user_key) == 0) {
+      s->state = (parsed_key.type == kTypeDeletion) ? kDeleted : kFound;
+      if (s->state == kFound) {
+        s->value->assign(v.data(), v.size());
+        s->is_blob_index = (parsed_key.type == kTypeBlobIndex);
+      }
+    }
+  }
+}
+
+Status Version::Get(const ReadOptions& options, const LookupKey& k,
+                    std::string* value, GetStats* stats, bool* is_blob_index) {
+  stats->seek_file = nullptr;
+  stats->seek_file_level = -1;
+
+  FileMetaData* last_file_read = nullptr;
+  int last_file_read_level = -1;
+
+  // The index hands out level-0 files newest first and then at most one
+  // file per level, exactly the order in which they must be searched.
+  FileIndexer::Picker picker(&index_, k.user_key(), k.internal_key());
+  int level;
+  while (FileMetaData* f = picker.Next(&level)) {
+    if (stats->seek_file == nullptr && last_file_read != nullptr) {
+      // We have had more than one seek for this read.  Charge the 1st file.
+      stats->seek_file = last_file_read;
+      stats->seek_file_level = last_file_read_level;
+    }
+    last_file_read = f;
+    last_file_read_level = level;
+
+    Saver saver;
+    saver.state = kNotFound;
+    saver.ucmp = vset_->icmp_.user_comparator();
+    saver.user_key = k.user_key();
+    saver.value = value;
+    saver.is_blob_index = false;
+    Status s = vset_->table_cache_->Get(options, f->number, f->file_size,
+                                        k.internal_key(), &saver, SaveValue);
+    if (!s.ok()) {
+      return s;
+    }
+    switch (saver.state) {
+      case kNotFound:
+        break;  // Keep searching in other files
+      case kFound:
+        if (saver.is_blob_index && is_blob_index == nullptr) {
+          return Status::NotSupported("blob index entry without blob support");
+        }
+        if (is_blob_index != nullptr) *is_blob_index = saver.is_blob_index;
+        return s;
+      case kDeleted:
+        return Status::NotFound(Slice());
+      case kCorrupt:
+        return Status::Corruption("corrupted key for ", saver.user_key);
+    }
+  }
+
+  return Status::NotFound(Slice());
+}
+
+bool Version::UpdateStats(const GetStats& stats) {
+  FileMetaData* f = stats.seek_file;
+  if (f != nullptr &&
+      f->allowd_seeks.fetch_sub(1, std::memory_order_relaxed) <= 1 &&
+      file_to_compact_.load(std::memory_order_relaxed) == nullptr) {
+    int no_level = -1;
+    if (file_to_compact_level_.compare_exchange_strong(
+            no_level, stats.seek_file_level, std::memory_order_relaxed)) {
+      file_to_compact_.store(f, std::memory_order_release);
+      return true;
+    }
+  }
+  return false;
+}
+
+void Version::Ref() { ++refs_; }
+
+void Version::Unref() {
+  assert(this != &vset_->dummy_versions_);
+  assert(refs_ >= 1);
+  --refs_;
+  if (refs_ == 0) {
+    delete this;
+  }
+}
+
+bool Version::OverlapInLevel(int level, const Slice* smallest_user_key,
+                             const Slice* largest_user_key) {
+  return SomeFileOverlapsRange(vset_->icmp_, (level > 0), files(level),
+                               smallest_user_key, largest_user_key);
+}
+
+int Version::PickLevelForMemTableOutput(const Slice& smallest_user_key,
+                                        const Slice& largest_user_key) {
+  int level = 0;
+  if (vset_->options_->level_compaction_dynamic_level_bytes) {
+    // The levels above the base level stay empty, so the table either
+    // goes all the way to the base level or stays at level 0.
+    for (int l = 0; l <= base_level_; l++) {
+      if (OverlapInLevel(l, &smallest_user_key, &largest_user_key)) {
+        return 0;
+      }
+    }
+    if (base_level_ + 1 < config::kNumLevels) {
+      InternalKey start(smallest_user_key, kMaxSequenceNumber,
+                        kValueTypeForSeek);
+      InternalKey limit(largest_user_key, 0, static_cast<ValueType>(0));
+      std::vector<FileMetaData*> overlaps;
+      GetOverlappingInputs(base_level_ + 1, &start, &limit, &overlaps);
+      if (TotalFileSize(overlaps) >
+          MaxGrandParentOverlapBytes(vset_->options_)) {
+        return 0;
+      }
+    }
+    return base_level_;
+  }
+  if (!OverlapInLevel(0, &smallest_user_key, &largest_user_key)) {
+    // Push to next level if there is no overlap in next level,
+    // and the #bytes overlapping in the level after that are limited.
+    InternalKey start(smallest_user_key, kMaxSequenceNumber, kValueTypeForSeek);
+    InternalKey limit(largest_user_key, 0, static_cast<ValueType>(0));
+    std::vector<FileMetaData*> overlaps;
+    while (level < config::kMaxMemCompactLevel) {
+      if (OverlapInLevel(level + 1, &smallest_user_key, &largest_user_key)) {
+        break;
+      }
+      if (level + 2 < config::kNumLevels) {
+        // Check that file does not overlap too many grandparent bytes.
+        GetOverlappingInputs(level + 2, &start, &limit, &overlaps);
+        const int64_t sum = TotalFileSize(overlaps);
+        if (sum > MaxGrandParentOverlapBytes(vset_->options_)) {
+          break;
+        }
+      }
+      level++;
+    }
+  }
+  return level;
+}
+
+int Version::PickLevelForIngestedFile(const Slice& smallest_user_key,
+                                      const Slice& largest_user_key) {
+  // Anything in a level above the target is newer than the file would
+  // be, so the file has to stop at the first level it overlaps.
+  int level = 0;
+  while (level + 1 < config::kNumLevels &&
+         !OverlapInLevel(level, &smallest_user_key, &largest_user_key) &&
+         !OverlapInLevel(level + 1, &smallest_user_key, &largest_user_key)) {
+    level++;
+  }
+  return level;
+}
+
+// Store in "*inputs" all files in "level" that overlap [begin,end]
+void Version::GetOverlappingInputs(int level, const InternalKey* begin,
+                                   const InternalKey* end,
+                                   std::vector<FileMetaData*>* inputs) {
+  assert(level >= 0);
+  assert(level < config::kNumLevels);
+  inputs->clear();
+  Slice user_begin, user_end;
+  if (begin != nullptr) {
+    user_begin = begin->user_key();
+  }
+  if (end != nullptr) {
+    user_end = end->user_key();
+  }
+  const Comparator* user_cmp = vset_->icmp_.user_comparator();
+  const std::vector<FileMetaData*>& level_files = files(level);
+  for (size_t i = 0; i < level_files.size();) {
+    FileMetaData* f = level_files[i++];
+    const Slice file_start = f->smallest.user_key();
+    const Slice file_limit = f->largest.user_key();
+    if (begin != nullptr && user_cmp->Compare(file_limit, user_begin) < 0) {
+      // "f" is completely before specified range; skip it
+    } else if (end != nullptr && user_cmp->Compare(file_start, user_end) > 0) {
+      // "f" is completely after specified range; skip it
+    } else {
+      inputs->push_back(f);
+      if (level == 0) {
+        // Level-0 files may overlap each other.  So check if the newly
+        // added file has expanded the range.  If so, restart search.
+        if (begin != nullptr && user_cmp->Compare(file_start, user_begin) < 0) {
+          user_begin = file_start;
+          inputs->clear();
+          i = 0;
+        } else if (end != nullptr &&
+                   user_cmp->Compare(file_limit, user_end) > 0) {
+          user_end = file_limit;
+          inputs->clear();
+          i = 0;
+        }
+      }
+    }
+  }
+}
+
+std::string Version::DebugString() const {
+  std::string r;
+  for (int level = 0; level < config::kNumLevels; level++) {
+    // E.g.,
+    //   --- level 1 ---
+    //   17:123['a' .. 'd']
+    //   20:43['e' .. 'g']
+    r.append("--- level ");
+    AppendNumberTo(&r, level);
+    r.append(" ---\n");
+    for (const FileMetaData* f : files(level)) {
+      r.push_back(' ');
+      AppendNumberTo(&r, f->number);
+      r.push_back(':');
+      AppendNumberTo(&r, f->file_size);
+      r.append("[");
+      r.append(f->smallest.DebugString());
+      r.append(" .. ");
+      r.append(f->largest.DebugString());
+      r.append("]\n");
+    }
+  }
+  for (const auto& kvp : blob_files()) {
+    r.append(" blob ");
+    AppendNumberTo(&r, kvp.first);
+    r.append(": ");
+    AppendNumberTo(&r, kvp.second.garbage_bytes);
+    r.append("/");
+    AppendNumberTo(&r, kvp.second.total_bytes);
+    r.append(" garbage\n");
+  }
+  return r;
+}
+
+// A helper class so we can efficiently apply a whole sequence
+// of edits to a particular state without creating intermediate
+// Versions that contain full copies of the intermediate state.
+class VersionSet::Builder {
+ private:
+  // Helper to sort by v->files_[file_number].smallest
+  struct BySmallestKey {
+    const InternalKeyComparator* internal_comparator;
+
+    bool operator()(FileMetaData* f1, FileMetaData* f2) const {
+      int r = internal_comparator->Compare(f1->smallest, f2->smallest);
+      if (r != 0) {
+        return (r < 0);
+      } else {
+        // Break ties by file number
+        return (f1->number < f2->number);
+      }
+    }
+  };
+
+  typedef std::set<FileMetaData*, BySmallestKey> FileSet;
+  struct LevelState {
+    std::set<uint64_t> deleted_files;
+    FileSet* added_files;
+  };
+
+  VersionSet* vset_;
+  Version* base_;
+  LevelState levels_[config::kNumLevels];
+  // Copy-on-write view of base_->blob_files(), null while unchanged.
+  std::unique_ptr<BlobFileMap> blob_files_;
+
+ public:
+  // Initialize a builder with the files from *base and other info from *vset
+  Builder(VersionSet* vset, Version* base) : vset_(vset), base_(base) {
+    base_->Ref();
+    BySmallestKey cmp;
+    cmp.internal_comparator = &vset_->icmp_;
+    for (int level = 0; level < config::kNumLevels; level++) {
+      levels_[level].added_files = new FileSet(cmp);
+    }
+  }
+
+  ~Builder() {
+    for (int level = 0; level < config::kNumLevels; level++) {
+      const FileSet* added = levels_[level].added_files;
+      std::vector<FileMetaData*> to_unref;
+      to_unref.reserve(added->size());
+      for (FileSet::const_iterator it = added->begin(); it != added->end();
+           ++it) {
+        to_unref.push_back(*it);
+      }
+      delete added;
+      for (uint32_t i = 0; i < to_unref.size(); i++) {
+        FileMetaData* f = to_unref[i];
+        f->refs--;
+        if (f->refs <= 0) {
+          delete f;
+        }
+      }
+    }
+    base_->Unref();
+  }
+
+  // Apply all of the edits in *edit to the current state.
+  void Apply(const VersionEdit* edit) {
+    // Update compaction pointers
+    for (size_t i = 0; i < edit->compact_pointers_.size(); i++) {
+      const int level = edit->compact_pointers_[i].first;
+      vset_->compact_pointer_[level] =
+          edit->compact_pointers_[i].second.Encode().ToString();
+    }
+
+    // Delete files
+    for (const auto& deleted_file_set_kvp : edit->deleted_files_) {
+      const int level = deleted_file_set_kvp.first;
+      const uint64_t number = deleted_file_set_kvp.second;
+      levels_[level].deleted_files.insert(number);
+    }
+
+    // Add new files
+    for (size_t i = 0; i < edit->new_files_.size(); i++) {
+      const int level = edit->new_files_[i].first;
+      FileMetaData* f = new FileMetaData(edit->new_files_[i].second);
+      f->refs = 1;
+
+      // We arrange to automatically compact this file after
+      // a certain number of seeks.  Let's assume:
+      //   (1) One seek costs approximately the same as the compaction
+      //   of 40KB of data
+      //   (2) Writing or reading 1MB costs 10ms (100MB/s)
+      //   (3) A compaction of 1MB does 25MB of IO:
+      //         1MB read from this level
+      //         10-12MB read from next level (boundaries may be misaligned)
+      //         10-12MB written to next level
+      // This implies that 25 seeks cost the same as the compaction
+      // of 1MB of data.  I.e., one seek costs approximately the
+      // same as the compaction of 40KB of data.  We are a little
+      // conservative and allow approximately one seek for every 16KB
+      // of data before triggering a compaction.
+      int allowed_seeks = static_cast<int>(f->file_size / 16384U);
+      if (allowed_seeks < 100) allowed_seeks = 100;
+      // Not published yet: nobody charges seeks to it before the version
+      // holding it is installed under the mutex.
+      f->allowd_seeks.store(allowed_seeks, std::memory_order_relaxed);
+
+      levels_[level].deleted_files.erase(f->number);
+      levels_[level].added_files->insert(f);
+    }
+
+    // Blob files: new ones first, then garbage (which may refer to them),
+    // then the collected ones.
+    if (!edit->new_blob_files_.empty() || !edit->blob_garbage_.empty() ||
+        !edit->deleted_blob_files_.empty()) {
+      if (blob_files_ == nullptr) {
+        blob_files_.reset(new BlobFileMap(base_->blob_files()));
+      }
+      for (const BlobFileMetaData& f : edit->new_blob_files_) {
+        (*blob_files_)[f.number] = f;
+      }
+      for (const BlobFileMetaData& g : edit->blob_garbage_) {
+        auto it = blob_files_->find(g.number);
+        if (it != blob_files_->end()) {
+          it->second.garbage_count += g.garbage_count;
+          it->second.garbage_bytes += g.garbage_bytes;
+        }
+      }
+      for (uint64_t number : edit->deleted_blob_files_) {
+        blob_files_->erase(number);
+      }
+    }
+  }
+
+  // Save the current state in *v.
+  void SaveTo(Version* v) {
+    BySmallestKey cmp;
+    cmp.internal_comparator = &vset_->icmp_;
+    for (int level = 0; level < config::kNumLevels; level++) {
+      const LevelState& state = levels_[level];
+      if (state.added_files->empty() && state.deleted_files.empty()) {
+        // Untouched by every edit: share the file list.
+        v->levels_[level] = base_->levels_[level];
+        continue;
+      }
+
+      // Merge the set of added files with the set of pre-existing files.
+      // Drop any deleted files.  Store the result in a new LevelFiles.
+      const std::vector<FileMetaData*>& base_files = base_->files(level);
+      std::vector<FileMetaData*>::const_iterator base_iter =
+          base_files.begin();
+      std::vector<FileMetaData*>::const_iterator base_end = base_files.end();
+      const FileSet* added_files = state.added_files;
+      std::vector<FileMetaData*> files;
+      files.reserve(base_files.size() + added_files->size());
+      for (const auto& added_file : *added_files) {
+        // Add all smaller files listed in base_
+        for (std::vector<FileMetaData*>::const_iterator bpos =
+                 std::upper_bound(base_iter, base_end, added_file, cmp);
+             base_iter != bpos; ++base_iter) {
+          MaybeAddFile(level, *base_iter, &files);
+        }
+
+        MaybeAddFile(level, added_file, &files);
+      }
+
+      // Add remaining base files
+      for (; base_iter != base_end; ++base_iter) {
+        MaybeAddFile(level, *base_iter, &files);
+      }
+
+#ifndef NDEBUG
+      // Make sure there is no overlap in levels > 0
+      if (level > 0) {
+        for (uint32_t i = 1; i < files.size(); i++) {
+          const InternalKey& prev_end = files[i - 1]->largest;
+          const InternalKey& this_begin = files[i]->smallest;
+          if (vset_->icmp_.Compare(prev_end, this_begin) >= 0) {
+            std::fprintf(stderr, "overlapping ranges in same level %s vs. %s\n",
+                         prev_end.DebugString().c_str(),
+                         this_begin.DebugString().c_str());
+            std::abort();
+          }
+        }
+      }
+#endif
+      v->levels_[level] = std::make_shared<LevelFiles>(std::move(files));
+    }
+
+    if (blob_files_ != nullptr) {
+      v->blob_files_ = std::shared_ptr<const BlobFileMap>(blob_files_.release());
+    } else {
+      v->blob_files_ = base_->blob_files_;
+    }
+  }
+
+  void MaybeAddFile(int level, FileMetaData* f,
+                    std::vector<FileMetaData*>* files) {
+    if (levels_[level].deleted_files.count(f->number) > 0) {
+      // File is deleted: do nothing
+    } else {
+      if (level > 0 && !files->empty()) {
+        // Must not overlap
+        assert(vset_->icmp_.Compare((*files)[files->size() - 1]->largest,
+                                    f->smallest) < 0);
+      }
+      files->push_back(f);
+    }
+  }
+};
+
+struct VersionSet::ManifestWriter {
+  explicit ManifestWriter(VersionEdit* edit) : edit(edit), done(false) {}
+
+  VersionEdit* edit;
+  Status status;
+  bool done;
+  std::condition_variable cv;
+};
+
+VersionSet::VersionSet(const std::string& dbname, const Options* options,
+                       TableCache* table_cache,
+                       const InternalKeyComparator* cmp,
+                       IOBackend* io_backend)
+    : env_(options->env),
+      dbname_(dbname),
+      options_(options),
+      table_cache_(table_cache),
+      io_backend_(io_backend),
+      icmp_(*cmp),
+      next_file_number_(2),
+      manifest_file_number_(0),  // Filled by Recover()
+      last_sequence_(0),
+      log_number_(0),
+      prev_log_number_(0),
+      manifest_records_(0),
+      manifest_file_size_(0),
+      descriptor_file_(nullptr),
+      descriptor_log_(nullptr),
+      dummy_versions_(this),
+      current_(nullptr) {
+  // Finalized like any other version, so that even an empty VersionSet
+  // has level targets and a base level.
+  Version* v = new Version(this);
+  Finalize(v);
+  AppendVersion(v);
+}
+
+VersionSet::~VersionSet() {
+  current_->Unref();
+  assert(dummy_versions_.next_ == &dummy_versions_);  // List must be empty
+  delete descriptor_log_;
+  delete descriptor_file_;
+}
+
+void VersionSet::AppendVersion(Version* v) {
+  // Make "v" current
+  assert(v->refs_ == 0);
+  assert(v != current_);
+  if (current_ != nullptr) {
+    current_->Unref();
+  }
+  current_ = v;
+  v->Ref();
+
+  // Append to linked list
+  v->prev_ = dummy_versions_.prev_;
+  v->next_ = &dummy_versions_;
+  v->prev_->next_ = v;
+  v->next_->prev_ = v;
+}
+
+Status VersionSet::LogAndApply(VersionEdit* edit, std::mutex* mu) {
+  ManifestWriter w(edit);
+  std::unique_lock<std::mutex> lock(*mu, std::adopt_lock);
+  manifest_writers_.push_back(&w);
+  while (!w.done && &w != manifest_writers_.front()) {
+    w.cv.wait(lock);
+  }
+  if (w.done) {
+    lock.release();
+    return w.status;
+  }
+
+  // We are the front of the queue: commit every edit queued so far.
+  std::vector<ManifestWriter*> group(manifest_writers_.begin(),
+                                     manifest_writers_.end());
+  uint64_t log_number = log_number_;
+  uint64_t prev_log_number = prev_log_number_;
+  SequenceNumber last_sequence = last_sequence_;
+  VersionEdit record;
+  Version* v = new Version(this);
+  {
+    Builder builder(this, current_);
+    for (ManifestWriter* writer : group) {
+      VersionEdit* e = writer->edit;
+      if (e->has_log_number_) {
+        assert(e->log_number_ >= log_number);
+        assert(e->log_number_ < next_file_number_);
+      } else {
+        e->SetLogNumber(log_number);
+      }
+      if (!e->has_prev_log_number_) {
+        e->SetPrevLogNumber(prev_log_number);
+      }
+      e->SetNextFile(next_file_number_);
+      if (e->has_last_sequence_ && e->last_sequence_ > last_sequence) {
+        last_sequence = e->last_sequence_;
+      }
+      e->SetLastSequence(last_sequence);
+      log_number = e->log_number_;
+      prev_log_number = e->prev_log_number_;
+
+      builder.Apply(e);
+      record.Append(*e);
+    }
+    builder.SaveTo(v);
+  }
+  Finalize(v);
+
+  // Once the manifest is large, switch to a new one so that recovery does
+  // not have to replay the whole history.
+  if (descriptor_log_ != nullptr &&
+      manifest_file_size_ >= options_->max_manifest_file_size) {
+    delete descriptor_log_;
+    delete descriptor_file_;  // Closes the file
+    descriptor_log_ = nullptr;
+    descriptor_file_ = nullptr;
+    manifest_file_number_ = NewFileNumber();
+    record.SetNextFile(next_file_number_);
+  }
+
+  // Initialize new descriptor log file if necessary by creating
+  // a temporary file that contains a snapshot of the current version.
+  std::string new_manifest_file;
+  std::string snapshot;
+  Status s;
+  if (descriptor_log_ == nullptr) {
+    if (manifest_file_number_ == 0) {
+      // Never recovered: this is a new database.
+      manifest_file_number_ = NewFileNumber();
+      record.SetNextFile(next_file_number_);
+    }
+    new_manifest_file = DescriptorFileName(dbname_, manifest_file_number_);
+    s = env_->NewWritableFile(new_manifest_file, &descriptor_file_);
+    if (s.ok()) {
+      descriptor_log_ = new log::Writer(descriptor_file_);
+      manifest_file_size_ = 0;
+      // current_ and the compaction pointers may change once *mu is
+      // released, so the snapshot is encoded now and written below.
+      EncodeSnapshot(&snapshot);
+    }
+  }
+
+  // Unlock during expensive MANIFEST log write
+  {
+    lock.unlock();
+
+    if (s.ok() && !snapshot.empty()) {
+      s = descriptor_log_->AddRecord(snapshot);
+      manifest_file_size_ += snapshot.size();
+    }
+
+    // Write new record to MANIFEST log
+    if (s.ok()) {
+      std::string encoded;
+      record.EncodeTo(&encoded);
+      s = descriptor_log_->AddRecord(encoded);
+      manifest_file_size_ += encoded.size();
+      if (s.ok()) {
+        s = descriptor_file_->Sync();
+      }
+    }
+
+    // If we just created a new descriptor file, install it by writing a
+    // new CURRENT file that points to it.
+    if (s.ok() && !new_manifest_file.empty()) {
+      s = SetCurrentFile(env_, dbname_, manifest_file_number_);
+    }
+
+    lock.lock();
+  }
+
+  // Install the new version
+  if (s.ok()) {
+    AppendVersion(v);
+    log_number_ = log_number;
+    prev_log_number_ = prev_log_number;
+    // Writes may have moved it on while *mu was released.
+    if (last_sequence > last_sequence_) {
+      last_sequence_ = last_sequence;
+    }
+    manifest_records_++;
+  } else {
+    delete v;
+    if (!new_manifest_file.empty()) {
+      delete descriptor_log_;
+      delete descriptor_file_;
+      descriptor_log_ = nullptr;
+      descriptor_file_ = nullptr;
+      env_->RemoveFile(new_manifest_file);
+    }
+  }
+
+  // Hand the outcome to the rest of the group and wake the next leader.
+  for (ManifestWriter* writer : group) {
+    assert(writer == manifest_writers_.front());
+    manifest_writers_.pop_front();
+    if (writer != &w) {
+      writer->status = s;
+      writer->done = true;
+      writer->cv.notify_one();
+    }
+  }
+  if (!manifest_writers_.empty()) {
+    manifest_writers_.front()->cv.notify_one();
+  }
+
+  lock.release();
+  return s;
+}
+
+Status VersionSet::Recover() {
+  struct LogReporter : public log::Reader::Reporter {
+    Status* status;
+    void Corruption(size_t bytes, const Status& s) override {
+      if (this->status->ok()) *this->status = s;
+    }
+  };
+
+  // Read "CURRENT" file, which contains a pointer to the current manifest file
+  std::string current;
+  Status s = ReadFileToString(env_, CurrentFileName(dbname_), &current);
+  if (!s.ok()) {
+    return s;
+  }
+  if (current.empty() || current[current.size() - 1] != '\n') {
+    return Status::Corruption("CURRENT file does not end with newline");
+  }
+  current.resize(current.size() - 1);
+
+  std::string dscname = dbname_ + "/" + current;
+  SequentialFile* file;
+  s = env_->NewSequentialFile(dscname, &file);
+  if (!s.ok()) {
+    if (s.IsNotFound()) {
+      return Status::Corruption("CURRENT points to a non-existent file",
+                                s.ToString());
+    }
+    return s;
+  }
+
+  bool have_log_number = false;
+  bool have_prev_log_number = false;
+  bool have_next_file = false;
+  bool have_last_sequence = false;
+  uint64_t next_file = 0;
+  uint64_t last_sequence = 0;
+  uint64_t log_number = 0;
+  uint64_t prev_log_number = 0;
+  Builder builder(this, current_);
+  int read_records = 0;
+
+  {
+    LogReporter reporter;
+    reporter.status = &s;
+    log::ParallelReader reader(file, &reporter, options_->recovery_threads);
+    Slice record;
+    std::string scratch;
+    while (reader.ReadRecord(&record, &scratch) && s.ok()) {
+      ++read_records;
+      VersionEdit edit;
+      s = edit.DecodeFrom(record);
+      if (s.ok()) {
+        if (edit.has_comparator_ &&
+            edit.comparator_ != icmp_.user_comparator()->Name()) {
+          s = Status::InvalidArgument(
+              edit.comparator_ + " does not match existing comparator ",
+              icmp_.user_comparator()->Name());
+        }
+      }
+
+      if (s.ok()) {
+        builder.Apply(&edit);
+      }
+
+      if (edit.has_log_number_) {
+        log_number = edit.log_number_;
+        have_log_number = true;
+      }
+
+      if (edit.has_prev_log_number_) {
+        prev_log_number = edit.prev_log_number_;
+        have_prev_log_number = true;
+      }
+
+      if (edit.has_next_file_number_) {
+        next_file = edit.next_file_number_;
+        have_next_file = true;
+      }
+
+      if (edit.has_last_sequence_) {
+        last_sequence = edit.last_sequence_;
+        have_last_sequence = true;
+      }
+    }
+  }
+  delete file;
+  file = nullptr;
+
+  if (s.ok()) {
+    if (!have_next_file) {
+      s = Status::Corruption("no meta-nextfile entry in descriptor");
+    } else if (!have_log_number) {
+      s = Status::Corruption("no meta-lognumber entry in descriptor");
+    } else if (!have_last_sequence) {
+      s = Status::Corruption("no last-sequence-number entry in descriptor");
+    }
+
+    if (!have_prev_log_number) {
+      prev_log_number = 0;
+    }
+
+    MarkFileNumberUsed(prev_log_number);
+    MarkFileNumberUsed(log_number);
+  }
+
+  if (s.ok()) {
+    Version* v = new Version(this);
+    builder.SaveTo(v);
+    // Install recovered version
+    Finalize(v);
+    AppendVersion(v);
+    manifest_file_number_ = next_file;
+    next_file_number_ = next_file + 1;
+    last_sequence_ = last_sequence;
+    log_number_ = log_number;
+    prev_log_number_ = prev_log_number;
+  } else {
+    std::string error = s.ToString();
+    std::fprintf(stderr, "Error recovering version set with %d records: %s\n",
+                 read_records, error.c_str());
+  }
+
+  return s;
+}
+
+void VersionSet::MarkFileNumberUsed(uint64_t number) {
+  if (next_file_number_ <= number) {
+    next_file_number_ = number + 1;
+  }
+}
+
+void VersionSet::ComputeLevelTargets(Version* v) {
+  const double base_bytes = options_->max_bytes_for_level_base;
+  const double multiplier = options_->max_bytes_for_level_multiplier;
+  v->level_max_bytes_[0] = base_bytes;  // Not used: level 0 counts files
+
+  if (!options_->level_compaction_dynamic_level_bytes) {
+    v->base_level_ = 1;
+    double target = base_bytes;
+    for (int level = 1; level < config::kNumLevels; level++) {
+      v->level_max_bytes_[level] = target;
+      target *= multiplier;
+    }
+    return;
+  }
+
+  int first_non_empty_level = -1;
+  uint64_t max_level_bytes = 0;
+  for (int level = 1; level < config::kNumLevels; level++) {
+    const uint64_t level_bytes = TotalFileSize(v->files(level));
+    if (level_bytes > 0 && first_non_empty_level == -1) {
+      first_non_empty_level = level;
+    }
+    max_level_bytes = std::max(max_level_bytes, level_bytes);
+  }
+  for (int level = 1; level < config::kNumLevels; level++) {
+    v->level_max_bytes_[level] = std::numeric_limits<double>::max();
+  }
+  if (first_non_empty_level == -1) {
+    // Nothing below level 0 yet: it goes straight to the last level.
+    v->base_level_ = config::kNumLevels - 1;
+    return;
+  }
+
+  // Size the first non-empty level would have if the largest level were
+  // the last one and every level above it were "multiplier" times smaller.
+  double level_size = max_level_bytes;
+  for (int level = config::kNumLevels - 2; level >= first_non_empty_level;
+       level--) {
+    level_size /= multiplier;
+  }
+  // Open up levels above it while that is still more than the base size.
+  // The base level never goes below first_non_empty_level, so the levels
+  // above the base level are always empty.
+  int base_level = first_non_empty_level;
+  while (base_level > 1 && level_size > base_bytes) {
+    base_level--;
+    level_size /= multiplier;
+  }
+  v->base_level_ = base_level;
+  for (int level = base_level; level < config::kNumLevels; level++) {
+    // No target below the base size, or a small DB would get a level 1
+    // smaller than level 0.
+    v->level_max_bytes_[level] = std::max(level_size, base_bytes);
+    level_size *= multiplier;
+  }
+}
+
+void VersionSet::Finalize(Version* v) {
+  v->index_.Build(v);
+  ComputeLevelTargets(v);
+
+  // Precomputed best level for next compaction
+  int best_level = -1;
+  double best_score = -1;
+
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    double score;
+    if (level == 0) {
+      // We treat level-0 specially by bounding the number of files
+      // instead of number of bytes for two reasons:
+      //
+      // (1) With larger write-buffer sizes, it is nice not to do too
+      // many level-0 compactions.
+      //
+      // (2) The files in level-0 are merged on every read and
+      // therefore we wish to avoid too many files when the individual
+      // file size is small (perhaps because of a small write-buffer
+      // setting, or very high compression ratios, or lots of
+      // overwrites/deletions).
+      score = v->NumFiles(level) /
+              static_cast<double>(
+                  options_->level0_file_num_compaction_trigger);
+    } else {
+      // Compute the ratio of current size to size limit.
+      const uint64_t level_bytes = TotalFileSize(v->files(level));
+      score = static_cast<double>(level_bytes) / v->MaxBytesForLevel(level);
+    }
+
+    if (score > best_score) {
+      best_level = level;
+      best_score = score;
+    }
+  }
+
+  v->compaction_level_ = best_level;
+  v->compaction_score_ = best_score;
+
+  // Bytes that compaction has to rewrite to bring every level under its
+  // target: level 0 together with the base level once level 0 is due,
+  // then the excess of each level, which is merged with the overlapping
+  // part of the next level, about MaxBytesForLevel(L+1)/MaxBytesForLevel(L)
+  // times as much.  The excess moves down and adds to the next level's
+  // size.
+  const int base_level = v->base_level_;
+  uint64_t pending = 0;
+  uint64_t incoming = 0;
+  if (v->NumFiles(0) >= options_->level0_file_num_compaction_trigger) {
+    incoming = TotalFileSize(v->files(0));
+    pending += incoming + TotalFileSize(v->files(base_level));
+  }
+  for (int level = base_level; level < config::kNumLevels - 1; level++) {
+    const uint64_t level_bytes = TotalFileSize(v->files(level)) + incoming;
+    const double target = v->MaxBytesForLevel(level);
+    incoming = 0;
+    if (level_bytes > target) {
+      const uint64_t excess = level_bytes - static_cast<uint64_t>(target);
+      const double fanout = v->MaxBytesForLevel(level + 1) / target;
+      pending += static_cast<uint64_t>(excess * (fanout + 1));
+      incoming = excess;
+    }
+  }
+  v->pending_compaction_bytes_ = pending;
+}
+
+void VersionSet::EncodeSnapshot(std::string* record) {
+  // Save metadata
+  VersionEdit edit;
+  edit.SetComparatorName(icmp_.user_comparator()->Name());
+
+  // Save compaction pointers
+  for (int level = 0; level < config::kNumLevels; level++) {
+    if (!compact_pointer_[level].empty()) {
+      InternalKey key;
+      key.DecodeFrom(compact_pointer_[level]);
+      edit.SetCompactPointer(level, key);
+    }
+  }
+
+  // Save files
+  for (int level = 0; level < config::kNumLevels; level++) {
+    for (const FileMetaData* f : current_->files(level)) {
+      edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest);
+    }
+  }
+  for (const auto& kvp : current_->blob_files()) {
+    const BlobFileMetaData& f = kvp.second;
+    edit.AddBlobFile(f.number, f.total_count, f.total_bytes);
+    if (f.garbage_count > 0) {
+      edit.AddBlobGarbage(f.number, f.garbage_count, f.garbage_bytes);
+    }
+  }
+
+  edit.EncodeTo(record);
+}
+
+// Stores the minimal range that covers all entries in inputs in
+// *smallest, *largest.
+// REQUIRES: inputs is not empty
+void VersionSet::GetRange(const std::vector<FileMetaData*>& inputs,
+                          InternalKey* smallest, InternalKey* largest) {
+  assert(!inputs.empty());
+  smallest->Clear();
+  largest->Clear();
+  for (size_t i = 0; i < inputs.size(); i++) {
+    FileMetaData* f = inputs[i];
+    if (i == 0) {
+      *smallest = f->smallest;
+      *largest = f->largest;
+    } else {
+      if (icmp_.Compare(f->smallest, *smallest) < 0) {
+        *smallest = f->smallest;
+      }
+      if (icmp_.Compare(f->largest, *largest) > 0) {
+        *largest = f->largest;
+      }
+    }
+  }
+}
+
+// Stores the minimal range that covers all entries in inputs1 and inputs2
+// in *smallest, *largest.
+// REQUIRES: inputs is not empty
+void VersionSet::GetRange2(const std::vector<FileMetaData*>& inputs1,
+                           const std::vector<FileMetaData*>& inputs2,
+                           InternalKey* smallest, InternalKey* largest) {
+  std::vector<FileMetaData*> all = inputs1;
+  all.insert(all.end(), inputs2.begin(), inputs2.end());
+  GetRange(all, smallest, largest);
+}
+
+Iterator* VersionSet::MakeInputIterator(Compaction* c) {
+  ReadOptions options;
+  options.verify_checksums = true;
+  options.fill_cache = false;
+  options.readahead_backend = io_backend_;
+  options.readahead = options_->compaction_readahead;
+
+  // Level-0 files have to be merged together.  For other levels,
+  // we will make a concatenating iterator per level.
+  const int space = (c->level() == 0 ? c->inputs_[0].size() + 1 : 2);
+  Iterator** list = new Iterator*[space];
+  int num = 0;
+  for (int which = 0; which < 2; which++) {
+    if (!c->inputs_[which].empty()) {
+      if (c->level() + which == 0) {
+        const std::vector<FileMetaData*>& files = c->inputs_[which];
+        for (size_t i = 0; i < files.size(); i++) {
+          list[num++] = table_cache_->NewIterator(options, files[i]->number,
+                                                  files[i]->file_size);
+        }
+      } else {
+        // Create concatenating iterator for the files from this level
+        list[num++] = NewTwoLevelIterator(
+            new Version::LevelFileNumIterator(icmp_, &c->inputs_[which]),
+            &GetFileIterator, table_cache_, options);
+      }
+    }
+  }
+  assert(num <= space);
+  Iterator* result = NewMergingIterator(&icmp_, list, num);
+  delete[] list;
+  return result;
+}
+
+// Level 0 is compacted into the base level, any other level into the
+// next one.
+static int OutputLevel(const Version* v, int level) {
+  return (level == 0) ? v->base_level() : level + 1;
+}
+
+Compaction* VersionSet::PickCompaction() {
+  Compaction* c;
+  int level;
+
+  // We prefer compactions triggered by too much data in a level over
+  // the compactions triggered by seeks.
+  const bool size_compaction = (current_->compaction_score_ >= 1);
+  FileMetaData* seek_file =
+      current_->file_to_compact_.load(std::memory_order_acquire);
+  if (size_compaction) {
+    level = current_->compaction_level_;
+    assert(level >= 0);
+    assert(level + 1 < config::kNumLevels);
+    c = new Compaction(options_, level, OutputLevel(current_, level));
+
+    // Pick the first file that comes after compact_pointer_[level]
+    for (FileMetaData* f : current_->files(level)) {
+      if (compact_pointer_[level].empty() ||
+          icmp_.Compare(f->largest.Encode(), compact_pointer_[level]) > 0) {
+        c->inputs_[0].push_back(f);
+        break;
+      }
+    }
+    if (c->inputs_[0].empty()) {
+      // Wrap-around to the beginning of the key space
+      c->inputs_[0].push_back(current_->files(level)[0]);
+    }
+  } else if (seek_file != nullptr) {
+    level = current_->file_to_compact_level_.load(std::memory_order_relaxed);
+    c = new Compaction(options_, level, OutputLevel(current_, level));
+    c->seek_compaction_ = true;
+    c->inputs_[0].push_back(seek_file);
+  } else {
+    return nullptr;
+  }
+
+  c->input_version_ = current_;
+  c->input_version_->Ref();
+
+  // Files in level 0 may overlap each other, so pick up all overlapping ones
+  if (level == 0) {
+    InternalKey smallest, largest;
+    GetRange(c->inputs_[0], &smallest, &largest);
+    // Note that the next call will discard the file we placed in
+    // c->inputs_[0] earlier and replace it with an overlapping set
+    // which will include the picked file.
+    current_->GetOverlappingInputs(0, &smallest, &largest, &c->inputs_[0]);
+    assert(!c->inputs_[0].empty());
+  }
+
+  SetupOtherInputs(c);
+
+  return c;
+}
+
+// Finds the largest key in a vector of files. Returns true if files is not
+// empty.
+static bool FindLargestKey(const InternalKeyComparator& icmp,
+                           const std::vector<FileMetaData*>& files,
+                           InternalKey* largest_key) {
+  if (files.empty()) {
+    return false;
+  }
+  *largest_key = files[0]->largest;
+  for (size_t i = 1; i < files.size(); ++i) {
+    FileMetaData* f = files[i];
+    if (icmp.Compare(f->largest, *largest_key) > 0) {
+      *largest_key = f->largest;
+    }
+  }
+  return true;
+}
+
+// Finds minimum file b2=(l2, u2) in level file for which l2 > u1 and
+// user_key(l2) = user_key(u1)
+static FileMetaData* FindSmallestBoundaryFile(
+    const InternalKeyComparator& icmp,
+    const std::vector<FileMetaData*>& level_files,
+    const InternalKey& largest_key) {
+  const Comparator* user_cmp = icmp.user_comparator();
+  FileMetaData* smallest_boundary_file = nullptr;
+  for (size_t i = 0; i < level_files.size(); ++i) {
+    FileMetaData* f = level_files[i];
+    if (icmp.Compare(f->smallest, largest_key) > 0 &&
+        user_cmp->Compare(f->smallest.user_key(), largest_key.user_key()) ==
+            0) {
+      if (smallest_boundary_file == nullptr ||
+          icmp.Compare(f->smallest, smallest_boundary_file->smallest) < 0) {
+        smallest_boundary_file = f;
+      }
+    }
+  }
+  return smallest_boundary_file;
+}
+
+// Extracts the largest file b1 from |compaction_files| and then searches for
+// a b2 in |level_files| for which user_key(u1) = user_key(l2). If it finds
+// such a file b2 (known as a boundary file) it adds it to |compaction_files|
+// and then searches again using this new upper bound.
+//
+// If there are two blocks, b1=(l1, u1) and b2=(l2, u2) and
+// user_key(u1) = user_key(l2), and if we compact b1 but not b2 then a
+// subsequent get operation will yield an incorrect result because it will
+// return the record from b2 in level i rather than from b1 because it searches
+// level by level for records matching the supplied user key.
+static void AddBoundaryInputs(const InternalKeyComparator& icmp,
+                              const std::vector<FileMetaData*>& level_files,
+                              std::vector<FileMetaData*>* compaction_files) {
+  InternalKey largest_key;
+
+  // Quick return if compaction_files is empty.
+  if (!FindLargestKey(icmp, *compaction_files, &largest_key)) {
+    return;
+  }
+
+  bool continue_searching = true;
+  while (continue_searching) {
+    FileMetaData* smallest_boundary_file =
+        FindSmallestBoundaryFile(icmp, level_files, largest_key);
+
+    // If a boundary file was found advance largest_key, otherwise we're done.
+    if (smallest_boundary_file != nullptr) {
+      compaction_files->push_back(smallest_boundary_file);
+      largest_key = smallest_boundary_file->largest;
+    } else {
+      continue_searching = false;
+    }
+  }
+}
+
+void VersionSet::SetupOtherInputs(Compaction* c) {
+  const int level = c->level();
+  const int output_level = c->output_level();
+  InternalKey smallest, largest;
+
+  AddBoundaryInputs(icmp_, current_->files(level), &c->inputs_[0]);
+  GetRange(c->inputs_[0], &smallest, &largest);
+
+  current_->GetOverlappingInputs(output_level, &smallest, &largest,
+                                 &c->inputs_[1]);
+  AddBoundaryInputs(icmp_, current_->files(output_level), &c->inputs_[1]);
+
+  // Get entire range covered by compaction
+  InternalKey all_start, all_limit;
+  GetRange2(c->inputs_[0], c->inputs_[1], &all_start, &all_limit);
+
+  // See if we can grow the number of inputs in "level" without
+  // changing the number of "output_level" files we pick up.
+  if (!c->inputs_[1].empty()) {
+    std::vector<FileMetaData*> expanded0;
+    current_->GetOverlappingInputs(level, &all_start, &all_limit, &expanded0);
+    AddBoundaryInputs(icmp_, current_->files(level), &expanded0);
+    const int64_t inputs1_size = TotalFileSize(c->inputs_[1]);
+    const int64_t expanded0_size = TotalFileSize(expanded0);
+    if (expanded0.size() > c->inputs_[0].size() &&
+        inputs1_size + expanded0_size <
+            ExpandedCompactionByteSizeLimit(options_)) {
+      InternalKey new_start, new_limit;
+      GetRange(expanded0, &new_start, &new_limit);
+      std::vector<FileMetaData*> expanded1;
+      current_->GetOverlappingInputs(output_level, &new_start, &new_limit,
+                                     &expanded1);
+      AddBoundaryInputs(icmp_, current_->files(output_level), &expanded1);
+      if (expanded1.size() == c->inputs_[1].size()) {
+        smallest = new_start;
+        largest = new_limit;
+        c->inputs_[0] = expanded0;
+        c->inputs_[1] = expanded1;
+        GetRange2(c->inputs_[0], c->inputs_[1], &all_start, &all_limit);
+      }
+    }
+  }
+
+  // Compute the set of grandparent files that overlap this compaction
+  // (parent == output_level; grandparent == output_level+1)
+  if (output_level + 1 < config::kNumLevels) {
+    current_->GetOverlappingInputs(output_level + 1, &all_start, &all_limit,
+                                   &c->grandparents_);
+  }
+
+  // Update the place where we will do the next compaction for this level.
+  // We update this immediately instead of waiting for the VersionEdit
+  // to be applied so that if the compaction fails, we will try a different
+  // key range next time.
+  compact_pointer_[level] = largest.Encode().ToString();
+  c->edit_.SetCompactPointer(level, largest);
+}
+
+Compaction* VersionSet::CompactRange(int level, const InternalKey* begin,
+                                     const InternalKey* end) {
+  std::vector<FileMetaData*> inputs;
+  current_->GetOverlappingInputs(level, begin, end, &inputs);
+  if (inputs.empty()) {
+    return nullptr;
+  }
+
+  // Avoid compacting too much in one shot in case the range is large.
+  // But we cannot do this for level-0 since level-0 files can overlap
+  // and we must not pick one file and drop another older file if the
+  // two files overlap.
+  if (level > 0) {
+    const uint64_t limit = TargetFileSize(options_);
+    uint64_t total = 0;
+    for (size_t i = 0; i < inputs.size(); i++) {
+      uint64_t s = inputs[i]->file_size;
+      total += s;
+      if (total >= limit) {
+        inputs.resize(i + 1);
+        break;
+      }
+    }
+  }
+
+  Compaction* c = new Compaction(options_, level, OutputLevel(current_, level));
+  c->input_version_ = current_;
+  c->input_version_->Ref();
+  c->inputs_[0] = inputs;
+  SetupOtherInputs(c);
+  return c;
+}
+
+int VersionSet::NumLevelFiles(int level) const {
+  assert(level >= 0);
+  assert(level < config::kNumLevels);
+  return current_->NumFiles(level);
+}
+
+int64_t VersionSet::NumLevelBytes(int level) const {
+  assert(level >= 0);
+  assert(level < config::kNumLevels);
+  return TotalFileSize(current_->files(level));
+}
+
+void VersionSet::AddLiveFiles(std::set<uint64_t>* live) {
+  for (Version* v = dummy_versions_.next_; v != &dummy_versions_;
+       v = v->next_) {
+    for (int level = 0; level < config::kNumLevels; level++) {
+      for (const FileMetaData* f : v->files(level)) {
+        live->insert(f->number);
+      }
+    }
+    for (const auto& kvp : v->blob_files()) {
+      live->insert(kvp.first);
+    }
+  }
+}
+
+Compaction::Compaction(const Options* options, int level, int output_level)
+    : level_(level),
+      output_level_(output_level),
+      max_output_file_size_(TargetFileSize(options)),
+      input_version_(nullptr),
+      seek_compaction_(false) {}
+
+Compaction::Cursor::Cursor()
+    : grandparent_index(0), seen_key(false), overlapped_bytes(0) {
+  for (int i = 0; i < config::kNumLevels; i++) {
+    level_ptrs[i] = 0;
+  }
+}
+
+Compaction::~Compaction() {
+  if (input_version_ != nullptr) {
+    input_version_->Unref();
+  }
+}
+
+bool Compaction::IsTrivialMove() const {
+  const VersionSet* vset = input_version_->vset_;
+  // Avoid a move if there is lots of overlapping grandparent data.
+  // Otherwise, the move could create a parent file that will require
+  // a very expensive merge later on.
+  return (num_input_files(0) == 1 && num_input_files(1) == 0 &&
+          TotalFileSize(grandparents_) <=
+              MaxGrandParentOverlapBytes(vset->options_));
+}
+
+void Compaction::AddInputDeletions(VersionEdit* edit) {
+  for (int which = 0; which < 2; which++) {
+    for (size_t i = 0; i < inputs_[which].size(); i++) {
+      edit->RemoveFile(which == 0 ? level_ : output_level_,
+                       inputs_[which][i]->number);
+    }
+  }
+}
+
+bool Compaction::IsBaseLevelForKey(const Slice& user_key, Cursor* cursor) {
+  // Maybe use binary search to find right entry instead of linear search?
+  const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
+  for (int lvl = output_level_ + 1; lvl < config::kNumLevels; lvl++) {
+    const std::vector<FileMetaData*>& files = input_version_->files(lvl);
+    size_t& ptr = cursor->level_ptrs[lvl];
+    while (ptr < files.size()) {
+      FileMetaData* f = files[ptr];
+      if (user_cmp->Compare(user_key, f->largest.user_key()) <= 0) {
+        // We've advanced far enough
+        if (user_cmp->Compare(user_key, f->smallest.user_key()) >= 0) {
+          // Key falls in this file's range, so definitely not base level
+          return false;
+        }
+        break;
+      }
+      ptr++;
+    }
+  }
+  return true;
+}
+
+bool Compaction::ShouldStopBefore(const Slice& internal_key,
+                                  Cursor* cursor) {
+  const VersionSet* vset = input_version_->vset_;
+  // Scan to find earliest grandparent file that contains key.
+  const InternalKeyComparator* icmp = &vset->icmp_;
+  while (cursor->grandparent_index < grandparents_.size() &&
+         icmp->Compare(
+             internal_key,
+             grandparents_[cursor->grandparent_index]->largest.Encode()) > 0) {
+    if (cursor->seen_key) {
+      cursor->overlapped_bytes +=
+          grandparents_[cursor->grandparent_index]->file_size;
+    }
+    cursor->grandparent_index++;
+  }
+  cursor->seen_key = true;
+
+  if (cursor->overlapped_bytes > MaxGrandParentOverlapBytes(vset->options_)) {
+    // Too much overlap for current output; start new output
+    cursor->overlapped_bytes = 0;
+    return true;
+  } else {
+    return false;
+  }
+}
+
+int64_t Compaction::TotalInputBytes() const {
+  return TotalFileSize(inputs_[0]) + TotalFileSize(inputs_[1]);
+}
+
+void Compaction::GetSplitPoints(int max_ranges,
+                                std::vector<std::string>* boundaries) {
+  boundaries->clear();
+  if (max_ranges <= 1) {
+    return;
+  }
+  const VersionSet* vset = input_version_->vset_;
+  const InternalKeyComparator& icmp = vset->icmp_;
+  const Comparator* user_cmp = icmp.user_comparator();
+
+  // Every input file boundary is a candidate. All versions of a user key
+  // have to land in the same range, so the candidates are user keys.
+  std::vector<FileMetaData*> files = inputs_[0];
+  files.insert(files.end(), inputs_[1].begin(), inputs_[1].end());
+  std::vector<Slice> candidates;
+  for (FileMetaData* f : files) {
+    candidates.push_back(f->smallest.user_key());
+    candidates.push_back(f->largest.user_key());
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            [user_cmp](const Slice& a, const Slice& b) {
+              return user_cmp->Compare(a, b) < 0;
+            });
+  candidates.erase(std::unique(candidates.begin(), candidates.end(),
+                               [user_cmp](const Slice& a, const Slice& b) {
+                                 return user_cmp->Compare(a, b) == 0;
+                               }),
+                   candidates.end());
+
+  // Estimate the input bytes up to each candidate from the table indexes
+  // and cut where the estimate crosses the next multiple of
+  // total / max_ranges. The last candidate is the end of the input.
+  // A file straddles several candidates: its table is looked up once and
+  // pinned by the iterator until we are done.
+  const int64_t total = TotalInputBytes();
+  std::vector<Iterator*> pins(files.size(), nullptr);
+  std::vector<Table*> tables(files.size(), nullptr);
+  for (size_t i = 0; i + 1 < candidates.size(); i++) {
+    const InternalKey ikey(candidates[i], kMaxSequenceNumber,
+                           kValueTypeForSeek);
+    int64_t below = 0;
+    for (size_t j = 0; j < files.size(); j++) {
+      const FileMetaData* f = files[j];
+      if (icmp.Compare(f->largest, ikey) <= 0) {
+        below += f->file_size;
+      } else if (icmp.Compare(f->smallest, ikey) < 0) {
+        if (pins[j] == nullptr) {
+          pins[j] = vset->table_cache_->NewIterator(
+              ReadOptions(), f->number, f->file_size, &tables[j]);
+        }
+        if (tables[j] != nullptr) {
+          below += tables[j]->ApproximateOffsetOf(ikey.Encode());
+        }
+      }
+    }
+    const int64_t target =
+        total * static_cast<int64_t>(boundaries->size() + 1) / max_ranges;
+    if (below >= target) {
+      boundaries->push_back(candidates[i].ToString());
+      if (static_cast<int>(boundaries->size()) + 1 == max_ranges) {
+        break;
+      }
+    }
+  }
+  for (Iterator* pin : pins) {
+    delete pin;
+  }
+}
+
+void Compaction::ReleaseInputs() {
+  if (input_version_ != nullptr) {
+    input_version_->Unref();
+    input_version_ = nullptr;
+  }
+}
+
+}  // namespace leveldb
@@ -1,8 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
 #include "dbformat.h"
+#include "file_indexer.h"
+#include "options.h"
 #include "version_edit.h"
 
 namespace leveldb {
 
+namespace log {
+class Writer;
+}
+
+class Compaction;
+class Iterator;
+class TableCache;
+class VersionSet;
+class WritableFile;
+
+// Return the smallest index i such that files[i]->largest >= key.
+// Return files.size() if there is no such file.
+// REQUIRES: "files" contains a sorted list of non-overlapping files.
+int FindFile(const InternalKeyComparator& icmp,
+             const std::vector<FileMetaData*>& files, const Slice& key);
+
+// Returns true iff some file in "files" overlaps the user key range
+// [*smallest,*largest].
+// smallest==nullptr represents a key smaller than all keys in the DB.
+// largest==nullptr represents a key largest than all keys in the DB.
+// REQUIRES: If disjoint_sorted_files, files[] contains disjoint ranges
+//           in sorted order.
+bool SomeFileOverlapsRange(const InternalKeyComparator& icmp,
+                           bool disjoint_sorted_files,
+                           const std::vector<FileMetaData*>& files,
+                           const Slice* smallest_user_key,
+                           const Slice* largest_user_key);
+
+// The files of one level, sorted by smallest key. Immutable once built and
+// shared by every Version in which the level did not change, so installing
+// a Version only rebuilds the levels an edit touched. Holds a reference on
+// each of its files.
+class LevelFiles {
+ public:
+  LevelFiles() = default;
+  explicit LevelFiles(std::vector<FileMetaData*> files);
+
+  LevelFiles(const LevelFiles&) = delete;
+  LevelFiles& operator=(const LevelFiles&) = delete;
+
+  ~LevelFiles();
+
+  const std::vector<FileMetaData*>& files() const { return files_; }
+
+ private:
+  std::vector<FileMetaData*> files_;
+};
+
+typedef std::map<uint64_t, BlobFileMetaData> BlobFileMap;
+
 class Version {
  public:
   struct GetStats {
@@ -10,19 +74,87 @@ class Version {
     int seek_file_level;
   };
 
+  // Lookup the value for key.  If found, store it in *val and
+  // return OK.  Else return a non-OK status.  Fills *stats.
+  // If the entry found is a BlobIndex, *is_blob_index is set to true (when
+  // is_blob_index is null such an entry is reported as NotSupported).
+  // REQUIRES: lock is not held
+  Status Get(const ReadOptions&, const LookupKey& key, std::string* val,
+             GetStats* stats, bool* is_blob_index = nullptr);
+
+  // Adds "stats" into the current state.  Returns true if a new
+  // compaction may need to be triggered, false otherwise.
+  // Does not need the lock: seek budgets are relaxed atomic counters and
+  // the first file to exhaust its budget claims file_to_compact_ with a
+  // compare-and-swap.
+  bool UpdateStats(const GetStats& stats);
+
+  // Reference count management (so Versions do not disappear out from
+  // under live iterators)
+  void Ref();
+  void Unref();
+
+  // Store in "*inputs" all files in "level" that overlap [begin,end]
+  // begin==nullptr means before all keys; end==nullptr means after all keys.
+  void GetOverlappingInputs(int level, const InternalKey* begin,
+                            const InternalKey* end,
+                            std::vector<FileMetaData*>* inputs);
+
+  // Returns true iff some file in the specified level overlaps
+  // some part of [*smallest_user_key,*largest_user_key].
+  // smallest_user_key==nullptr represents a key smaller than all the DB's keys.
+  // largest_user_key==nullptr represents a key largest than all the DB's keys.
+  bool OverlapInLevel(int level, const Slice* smallest_user_key,
+                      const Slice* largest_user_key);
+
+  // Return the level at which we should place a new memtable compaction
+  // result that covers the range [smallest_user_key,largest_user_key].
+  int PickLevelForMemTableOutput(const Slice& smallest_user_key,
+                                 const Slice& largest_user_key);
+
+  // Return the deepest level at which a file covering the user key range
+  // [smallest_user_key,largest_user_key] can be placed without overlapping
+  // any file of that level or of a level above it. Unlike
+  // PickLevelForMemTableOutput the result is not capped, so data that does
+  // not overlap anything goes straight to the bottom level.
+  int PickLevelForIngestedFile(const Slice& smallest_user_key,
+                               const Slice& largest_user_key);
+
+  int NumFiles(int level) const { return files(level).size(); }
+
+  // Level that level 0 is compacted into: 1, or with
+  // level_compaction_dynamic_level_bytes the first level that is allowed
+  // to hold data.  Levels between 0 and it are empty.
+  int base_level() const { return base_level_; }
+
+  // Target size of "level" >= 1; infinite for levels above base_level().
+  double MaxBytesForLevel(int level) const { return level_max_bytes_[level]; }
+
+  const std::vector<FileMetaData*>& files(int level) const {
+    return levels_[level]->files();
+  }
+
+  // Blob files by number, with their garbage counts.
+  const BlobFileMap& blob_files() const { return *blob_files_; }
+
+  // Return a human readable string that describes this version's contents.
+  std::string DebugString() const;
+
  private:
   friend class Compaction;
-  friend class VerisonSet;
+  friend class VersionSet;
 
   class LevelFileNumIterator;
 
-  explicit Version(VersionSet* vset) {}
+  explicit Version(VersionSet* vset);
 
-  Version(const VersionSet&) = delete;
+  // Iterator over the concatenated files of sorted level "level" > 0.
+  Iterator* NewConcatenatingIterator(const ReadOptions&, int level) const;
 
-  Version& operator=(const VersionSet&) = delete;
+  Version(const Version&) = delete;
+  Version& operator=(const Version&) = delete;
 
-  ~Version() = default;
+  ~Version();
 
   VersionSet* vset_;
   Version* next_;
@@ -30,13 +162,317 @@ class Version {
 
   int refs_;
 
-  // FileMetaData 的二维数组，第一个维度表示level，第二个维度表示level下的文件
-  std::vector<FileMetaData*> files_[config::kNumLevels];
+  // 每个 level 的文件列表，未被修改的 level 在相邻的 Version 之间共享
+  std::shared_ptr<const LevelFiles> levels_[config::kNumLevels];
+
+  std::shared_ptr<const BlobFileMap> blob_files_;
+
+  // Point lookup structure over files_, built by VersionSet::Finalize().
+  FileIndexer index_;
+
+  // Next file to compact based on seek stats.  The level is claimed first
+  // (-1 -> level) and the file is published after it, so whoever sees the
+  // file also sees its level.
+  std::atomic<FileMetaData*> file_to_compact_;
+  std::atomic<int> file_to_compact_level_;
+
+  // Estimated bytes compaction has to rewrite before every level is under
+  // its target.  Initialized by Finalize().
+  uint64_t pending_compaction_bytes_;
+
+  // Level targets, computed by Finalize() from the options and, with
+  // level_compaction_dynamic_level_bytes, from the size of the last level.
+  int base_level_;
+  double level_max_bytes_[config::kNumLevels];
+
+  // Level that should be compacted next and its compaction score.
+  // Score < 1 means compaction is not strictly needed.  These fields
+  // are initialized by Finalize().
+  double compaction_score_;
+  int compaction_level_;
 };
 
 class VersionSet {
  public:
-  VersionSet() {}
+  // With an "io_backend", compaction inputs are read ahead through it,
+  // options->compaction_readahead blocks per input table.
+  VersionSet(const std::string& dbname, const Options* options,
+             TableCache* table_cache, const InternalKeyComparator* cmp,
+             IOBackend* io_backend = nullptr);
+
+  VersionSet(const VersionSet&) = delete;
+  VersionSet& operator=(const VersionSet&) = delete;
+
+  ~VersionSet();
+
+  // Apply *edit to the current version to form a new descriptor that
+  // is both saved to persistent state and installed as the new
+  // current version.  Will release *mu while actually writing to the file.
+  //
+  // Edits that arrive while another LogAndApply is writing wait in a
+  // queue; the next writer commits all of them with one manifest record
+  // and one fsync, and installs one Version for the whole group.
+  //
+  // An edit may carry a last sequence beyond LastSequence() (an ingestion
+  // does): LastSequence() then advances to it once the edit is applied.
+  //
+  // REQUIRES: *mu is held on entry.
+  // REQUIRES: no other thread concurrently calls LogAndApply()
+  //           without holding *mu
+  Status LogAndApply(VersionEdit* edit, std::mutex* mu);
+
+  // Recover the last saved descriptor from persistent storage.
+  Status Recover();
+
+  // Return the current version.
+  Version* current() const { return current_; }
+
+  // Return the current manifest file number
+  uint64_t ManifestFileNumber() const { return manifest_file_number_; }
+
+  // Allocate and return a new file number
+  uint64_t NewFileNumber() { return next_file_number_++; }
+
+  // Return the number the next NewFileNumber() call will return.
+  uint64_t NextFileNumber() const { return next_file_number_; }
+
+  // Arrange to reuse "file_number" unless a newer file number has
+  // already been allocated.
+  // REQUIRES: "file_number" was returned by a call to NewFileNumber().
+  void ReuseFileNumber(uint64_t file_number) {
+    if (next_file_number_ == file_number + 1) {
+      next_file_number_ = file_number;
+    }
+  }
+
+  // Return the number of Table files at the specified level.
+  int NumLevelFiles(int level) const;
+
+  // Return the combined file size of all files at the specified level.
+  int64_t NumLevelBytes(int level) const;
+
+  // Return the last sequence number.
+  uint64_t LastSequence() const { return last_sequence_; }
+
+  // Set the last sequence number to s.
+  void SetLastSequence(uint64_t s) {
+    assert(s >= last_sequence_);
+    last_sequence_ = s;
+  }
+
+  // Mark the specified file number as used.
+  void MarkFileNumberUsed(uint64_t number);
+
+  // Return the current log file number.
+  uint64_t LogNumber() const { return log_number_; }
+
+  // Return the log file number for the log file that is currently
+  // being compacted, or zero if there is no such log file.
+  uint64_t PrevLogNumber() const { return prev_log_number_; }
+
+  // Pick level and inputs for a new compaction.
+  // Returns nullptr if there is no compaction to be done.
+  // Otherwise returns a pointer to a heap-allocated object that
+  // describes the compaction.  Caller should delete the result.
+  Compaction* PickCompaction();
+
+  // Return a compaction object for compacting the range [begin,end] in
+  // the specified level.  Returns nullptr if there is nothing in that
+  // level that overlaps the specified range.  Caller should delete
+  // the result.
+  Compaction* CompactRange(int level, const InternalKey* begin,
+                           const InternalKey* end);
+
+  // Create an iterator that reads over the compaction inputs for "*c".
+  // The caller should delete the iterator when no longer needed.
+  Iterator* MakeInputIterator(Compaction* c);
+
+  // Returns true iff some level needs a compaction.
+  bool NeedsCompaction() const {
+    Version* v = current_;
+    return (v->compaction_score_ >= 1) ||
+           (v->file_to_compact_.load(std::memory_order_acquire) != nullptr);
+  }
+
+  // Estimated bytes compaction has to rewrite before every level of the
+  // current version is under its target size.
+  uint64_t EstimatedPendingCompactionBytes() const {
+    return current_->pending_compaction_bytes_;
+  }
+
+  // Add all files listed in any live version to *live.
+  // May also mutate some internal state.
+  void AddLiveFiles(std::set<uint64_t>* live);
+
+  // Number of manifest records written, i.e. of committed edit groups.
+  uint64_t ManifestRecords() const { return manifest_records_; }
+
+  const InternalKeyComparator& icmp() const { return icmp_; }
+
+ private:
+  class Builder;
+
+  friend class Compaction;
+  friend class Version;
+
+  // A LogAndApply() call waiting for its edit to be committed.
+  struct ManifestWriter;
+
+  void Finalize(Version* v);
+
+  // Fill in v->base_level_ and v->level_max_bytes_.
+  void ComputeLevelTargets(Version* v);
+
+  void GetRange(const std::vector<FileMetaData*>& inputs, InternalKey* smallest,
+                InternalKey* largest);
+
+  void GetRange2(const std::vector<FileMetaData*>& inputs1,
+                 const std::vector<FileMetaData*>& inputs2,
+                 InternalKey* smallest, InternalKey* largest);
+
+  void SetupOtherInputs(Compaction* c);
+
+  // Encode the current state as one edit, the first record of a manifest.
+  void EncodeSnapshot(std::string* record);
+
+  void AppendVersion(Version* v);
+
+  Env* const env_;
+  const std::string dbname_;
+  const Options* const options_;
+  TableCache* const table_cache_;
+  IOBackend* const io_backend_;
+  const InternalKeyComparator icmp_;
+  uint64_t next_file_number_;
+  uint64_t manifest_file_number_;
+  uint64_t last_sequence_;
+  uint64_t log_number_;
+  uint64_t prev_log_number_;  // 0 or backing store for memtable being compacted
+  uint64_t manifest_records_;
+  uint64_t manifest_file_size_;  // Bytes written to the current manifest
+
+  // Opened lazily
+  WritableFile* descriptor_file_;
+  log::Writer* descriptor_log_;
+  Version dummy_versions_;  // Head of circular doubly-linked list of versions.
+  Version* current_;        // == dummy_versions_.prev_
+
+  // Queue of pending LogAndApply() calls; the front one is committing.
+  std::deque<ManifestWriter*> manifest_writers_;
+
+  // Per-level key at which the next compaction at that level should start.
+  // Either an empty string, or a valid InternalKey.
+  std::string compact_pointer_[config::kNumLevels];
+};
+
+// A Compaction encapsulates information about a compaction.
+class Compaction {
+ public:
+  ~Compaction();
+
+  // Return the level that is being compacted.  Inputs from "level"
+  // and "output_level" will be merged to produce a set of "output_level"
+  // files.
+  int level() const { return level_; }
+
+  // level() + 1, except that level 0 is compacted into the base level.
+  int output_level() const { return output_level_; }
+
+  // Return the object that holds the edits to the descriptor done
+  // by this compaction.
+  VersionEdit* edit() { return &edit_; }
+
+  // "which" must be either 0 or 1
+  int num_input_files(int which) const { return inputs_[which].size(); }
+
+  // Return the ith input file at "level()" (which == 0) or
+  // "output_level()" (which == 1).
+  FileMetaData* input(int which, int i) const { return inputs_[which][i]; }
+
+  // Maximum size of files to build during this compaction.
+  uint64_t MaxOutputFileSize() const { return max_output_file_size_; }
+
+  // Is this a trivial compaction that can be implemented by just
+  // moving a single input file to the next level (no merging or splitting)
+  bool IsTrivialMove() const;
+
+  // True if the compaction was triggered by a file running out of seeks.
+  bool is_seek_compaction() const { return seek_compaction_; }
+
+  // Add all inputs to this compaction as delete operations to *edit.
+  void AddInputDeletions(VersionEdit* edit);
+
+  // Position of one output stream in the grandparent files and in the
+  // levels below the compaction. Keys must be presented in increasing
+  // order, so a compaction split into subcompactions keeps one cursor per
+  // subcompaction.
+  struct Cursor {
+    Cursor();
+
+    size_t grandparent_index;  // Index in grandparents_
+    bool seen_key;             // Some output key has been seen
+    int64_t overlapped_bytes;  // Bytes of overlap between current output
+                               // and grandparent files
+
+    // level_ptrs[L] indexes input_version_->files(L): we are positioned at
+    // one of the file ranges for each level L > output_level_.
+    size_t level_ptrs[config::kNumLevels];
+  };
+
+  // Returns true if the information we have available guarantees that
+  // the compaction is producing data in "output_level" for which no data
+  // exists in levels greater than "output_level".
+  bool IsBaseLevelForKey(const Slice& user_key) {
+    return IsBaseLevelForKey(user_key, &cursor_);
+  }
+  bool IsBaseLevelForKey(const Slice& user_key, Cursor* cursor);
+
+  // Returns true iff we should stop building the current output
+  // before processing "internal_key".
+  bool ShouldStopBefore(const Slice& internal_key) {
+    return ShouldStopBefore(internal_key, &cursor_);
+  }
+  bool ShouldStopBefore(const Slice& internal_key, Cursor* cursor);
+
+  // Total size of the input files.
+  int64_t TotalInputBytes() const;
+
+  // Store in "*boundaries" up to "max_ranges - 1" user keys that cut the
+  // input into ranges of roughly equal size, in increasing order. The keys
+  // are taken from the boundaries of the input files; range sizes are
+  // estimated from the table indexes, which may have to be read: call it
+  // without the DB mutex. The inputs are pinned by input_version().
+  void GetSplitPoints(int max_ranges, std::vector<std::string>* boundaries);
+
+  // The version the inputs were picked from.
+  Version* input_version() const { return input_version_; }
+
+  // Release the input version for the compaction, once the compaction
+  // is successful.
+  void ReleaseInputs();
+
+ private:
+  friend class Version;
+  friend class VersionSet;
+
+  Compaction(const Options* options, int level, int output_level);
+
+  int level_;
+  int output_level_;
+  uint64_t max_output_file_size_;
+  Version* input_version_;
+  VersionEdit edit_;
+  bool seek_compaction_;
+
+  // Each compaction reads inputs from "level_" and "output_level_"
+  std::vector<FileMetaData*> inputs_[2];  // The two sets of inputs
+
+  // State used to check for number of overlapping grandparent files
+  // (parent == output_level_, grandparent == output_level_ + 1)
+  std::vector<FileMetaData*> grandparents_;
+
+  // Cursor of the compaction when it is not split.
+  Cursor cursor_;
 };
 
-};  // namespace leveldb
\ No newline at end of file
+}  // namespace leveldb
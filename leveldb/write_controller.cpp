@@ -0,0 +1,91 @@
+#include "write_controller.h"
+
+#include <algorithm>
+
+namespace leveldb {
+
+namespace {
+
+// The delayed rate never drops below this many bytes per second, so a
+// paced writer always makes progress.
+const uint64_t kMinWriteRate = 16 << 10;
+
+// A writer that was idle may burst this much time worth of the rate.
+const uint64_t kMaxBurstMicros = 1000;
+
+}  // namespace
+
+WriteController::WriteController(const Options& options)
+    : slowdown_trigger_(options.level0_slowdown_writes_trigger),
+      stop_trigger_(options.level0_stop_writes_trigger),
+      soft_pending_limit_(options.soft_pending_compaction_bytes_limit),
+      hard_pending_limit_(options.hard_pending_compaction_bytes_limit),
+      max_rate_(std::max(options.delayed_write_rate, kMinWriteRate)),
+      dec_ratio_(options.delayed_write_rate_decrease),
+      inc_ratio_(options.delayed_write_rate_increase),
+      state_(kNormal),
+      rate_(max_rate_),
+      prev_level0_files_(0),
+      prev_pending_bytes_(0),
+      credit_(0),
+      last_refill_micros_(0) {}
+
+void WriteController::Update(int level0_files,
+                             uint64_t pending_compaction_bytes) {
+  const bool stop = level0_files >= stop_trigger_ ||
+                    (hard_pending_limit_ > 0 &&
+                     pending_compaction_bytes >= hard_pending_limit_);
+  const bool delay = level0_files >= slowdown_trigger_ ||
+                     (soft_pending_limit_ > 0 &&
+                      pending_compaction_bytes >= soft_pending_limit_);
+  const bool worse = level0_files > prev_level0_files_ ||
+                     pending_compaction_bytes > prev_pending_bytes_;
+  const bool better = level0_files < prev_level0_files_ ||
+                      pending_compaction_bytes < prev_pending_bytes_;
+
+  if (!stop && !delay) {
+    state_ = kNormal;
+    rate_ = max_rate_;
+  } else if (state_ == kNormal) {
+    // Start pacing at the configured rate with an empty bucket.
+    state_ = stop ? kStopped : kDelayed;
+    rate_ = max_rate_;
+    credit_ = 0;
+    last_refill_micros_ = 0;
+  } else {
+    // Already paced: the previous rate was too fast if the backlog still
+    // grew, and can be relaxed once it shrinks.
+    if (worse) {
+      rate_ = std::max(kMinWriteRate,
+                       static_cast<uint64_t>(rate_ * dec_ratio_));
+    } else if (better) {
+      rate_ = std::min(max_rate_, static_cast<uint64_t>(rate_ * inc_ratio_));
+    }
+    state_ = stop ? kStopped : kDelayed;
+  }
+  prev_level0_files_ = level0_files;
+  prev_pending_bytes_ = pending_compaction_bytes;
+}
+
+uint64_t WriteController::GetDelay(uint64_t now_micros, uint64_t bytes) {
+  if (state_ != kDelayed) {
+    return 0;
+  }
+  if (last_refill_micros_ == 0) {
+    last_refill_micros_ = now_micros;
+  }
+  if (now_micros > last_refill_micros_) {
+    credit_ += static_cast<double>(now_micros - last_refill_micros_) * rate_ /
+               1e6;
+    last_refill_micros_ = now_micros;
+    credit_ = std::min(credit_, static_cast<double>(rate_) *
+                                    kMaxBurstMicros / 1e6);
+  }
+  credit_ -= bytes;
+  if (credit_ >= 0) {
+    return 0;
+  }
+  return static_cast<uint64_t>(-credit_ * 1e6 / rate_);
+}
+
+}  // namespace leveldb
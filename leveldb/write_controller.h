@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+
+#include "options.h"
+
+namespace leveldb {
+
+/**
+ * @brief WriteController
+ *
+ * @details Turns the compaction backlog into a write rate instead of the
+ * full-speed-then-stop cliff of fixed level-0 triggers.
+ *
+ * Below options.level0_slowdown_writes_trigger level-0 files and below the
+ * soft pending compaction bytes limit writes are not paced. Past either,
+ * every write pays for its bytes from a token bucket refilled at the
+ * delayed write rate. The rate starts at options.delayed_write_rate, is
+ * lowered (options.delayed_write_rate_decrease) each time an Update() sees
+ * the backlog grow and raised again (options.delayed_write_rate_increase)
+ * each time it shrinks, so it settles near what compaction sustains. At
+ * options.level0_stop_writes_trigger files or the hard limit writes stop
+ * until compaction brings the backlog down.
+ *
+ * Not thread-safe: the write path calls it with the DB mutex held.
+ */
+class WriteController {
+ public:
+  enum State { kNormal, kDelayed, kStopped };
+
+  explicit WriteController(const Options& options);
+
+  WriteController(const WriteController&) = delete;
+  WriteController& operator=(const WriteController&) = delete;
+
+  // Recompute the state after a flush or a compaction changed the shape of
+  // the tree.
+  void Update(int level0_files, uint64_t pending_compaction_bytes);
+
+  State state() const { return state_; }
+
+  // Current delayed write rate in bytes per second.
+  uint64_t delayed_write_rate() const { return rate_; }
+
+  // Charge a write of "bytes" issued at "now_micros" and return how many
+  // microseconds the writer has to wait before it may proceed. Always zero
+  // unless the state is kDelayed; kStopped has to be waited out by the
+  // caller.
+  uint64_t GetDelay(uint64_t now_micros, uint64_t bytes);
+
+ private:
+  const int slowdown_trigger_;
+  const int stop_trigger_;
+  const uint64_t soft_pending_limit_;
+  const uint64_t hard_pending_limit_;
+  const uint64_t max_rate_;
+  const double dec_ratio_;
+  const double inc_ratio_;
+
+  State state_;
+  uint64_t rate_;
+
+  // Backlog seen by the previous Update().
+  int prev_level0_files_;
+  uint64_t prev_pending_bytes_;
+
+  // Bytes that may still be written without waiting; negative while
+  // writers are queued behind the rate.
+  double credit_;
+  uint64_t last_refill_micros_;
+};
+
+}  // namespace leveldb
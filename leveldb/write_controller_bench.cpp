@@ -0,0 +1,200 @@
+// Write latency under sustained overload with hard level-0 triggers versus
+// the WriteController.
+//
+// A model of the write path, without the I/O: one writer issues
+// --value_size writes as fast as it is allowed to, every --write_buffer_kb
+// of writes becomes a level-0 file, and a compaction thread retires
+// level-0 files at --compaction_mb_per_sec. The writer outruns compaction,
+// so level 0 grows until the write policy holds it back.
+//
+//   triggers:   leveldb's policy. One 1ms sleep per write once level 0 has
+//               level0_slowdown_writes_trigger files; writes block at
+//               level0_stop_writes_trigger files until compaction catches
+//               up.
+//   controller: WriteController pacing at options.delayed_write_rate,
+//               adapted as level 0 grows and shrinks.
+//
+// Usage: write_controller_bench [--seconds=N] [--value_size=N]
+//                               [--write_buffer_kb=N]
+//                               [--compaction_mb_per_sec=N]
+//                               [--delayed_write_mb_per_sec=N]
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "env.h"
+#include "options.h"
+#include "write_controller.h"
+
+namespace leveldb {
+namespace {
+
+int FLAGS_seconds = 10;
+uint64_t FLAGS_value_size = 1024;
+uint64_t FLAGS_write_buffer_kb = 1024;
+uint64_t FLAGS_compaction_mb_per_sec = 8;
+uint64_t FLAGS_delayed_write_mb_per_sec = 16;
+
+class Model {
+ public:
+  Model(const Options& options, bool use_controller)
+      : options_(options),
+        use_controller_(use_controller),
+        controller_(options),
+        level0_files_(0),
+        buffered_bytes_(0),
+        done_(false) {}
+
+  void Run() {
+    std::thread compactor(&Model::CompactorLoop, this);
+    const uint64_t start = NowMicros();
+    const uint64_t end = start + FLAGS_seconds * 1000000ull;
+    uint64_t now = start;
+    while (now < end) {
+      Write();
+      const uint64_t finish = NowMicros();
+      latencies_.push_back(finish - now);
+      now = finish;
+    }
+    {
+      std::lock_guard<std::mutex> l(mu_);
+      done_ = true;
+    }
+    cv_.notify_all();
+    compactor.join();
+    elapsed_micros_ = now - start;
+  }
+
+  void Report(const char* name) {
+    std::sort(latencies_.begin(), latencies_.end());
+    const size_t n = latencies_.size();
+    auto pct = [&](double p) {
+      return latencies_[std::min(n - 1, static_cast<size_t>(n * p))];
+    };
+    std::printf("%s\t%zu\t%.1f\t%llu\t%llu\t%llu\t%llu\n", name, n,
+                n * FLAGS_value_size / 1048576.0 / (elapsed_micros_ / 1e6),
+                static_cast<unsigned long long>(pct(0.5)),
+                static_cast<unsigned long long>(pct(0.99)),
+                static_cast<unsigned long long>(pct(0.999)),
+                static_cast<unsigned long long>(latencies_[n - 1]));
+  }
+
+ private:
+  static uint64_t NowMicros() { return Env::Default()->NowMicros(); }
+
+  static void SleepMicros(uint64_t micros) {
+    std::this_thread::sleep_for(std::chrono::microseconds(micros));
+  }
+
+  void Write() {
+    std::unique_lock<std::mutex> l(mu_);
+    if (use_controller_) {
+      cv_.wait(l, [this] {
+        return controller_.state() != WriteController::kStopped;
+      });
+      const uint64_t delay = controller_.GetDelay(NowMicros(),
+                                                  FLAGS_value_size);
+      if (delay > 0) {
+        l.unlock();
+        SleepMicros(delay);
+        l.lock();
+      }
+    } else {
+      if (level0_files_ >= options_.level0_slowdown_writes_trigger &&
+          level0_files_ < options_.level0_stop_writes_trigger) {
+        // Yield some CPU to compaction, once per write.
+        l.unlock();
+        SleepMicros(1000);
+        l.lock();
+      }
+      cv_.wait(l, [this] {
+        return level0_files_ < options_.level0_stop_writes_trigger;
+      });
+    }
+
+    buffered_bytes_ += FLAGS_value_size;
+    if (buffered_bytes_ >= FLAGS_write_buffer_kb << 10) {
+      // The memtable becomes a level-0 file.
+      buffered_bytes_ = 0;
+      level0_files_++;
+      controller_.Update(level0_files_, 0);
+      cv_.notify_all();
+    }
+  }
+
+  void CompactorLoop() {
+    const uint64_t file_micros = (FLAGS_write_buffer_kb << 10) * 1000000ull /
+                                 (FLAGS_compaction_mb_per_sec << 20);
+    std::unique_lock<std::mutex> l(mu_);
+    while (true) {
+      cv_.wait(l, [this] { return done_ || level0_files_ > 0; });
+      if (done_) return;
+      l.unlock();
+      SleepMicros(file_micros);
+      l.lock();
+      level0_files_--;
+      controller_.Update(level0_files_, 0);
+      cv_.notify_all();
+    }
+  }
+
+  const Options options_;
+  const bool use_controller_;
+
+  std::mutex mu_;
+  std::condition_variable cv_;
+  WriteController controller_;
+  int level0_files_;
+  uint64_t buffered_bytes_;
+  bool done_;
+
+  std::vector<uint64_t> latencies_;
+  uint64_t elapsed_micros_;
+};
+
+}  // namespace
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  using namespace leveldb;
+  for (int i = 1; i < argc; i++) {
+    unsigned long long n;
+    char junk;
+    if (sscanf(argv[i], "--seconds=%llu%c", &n, &junk) == 1) {
+      FLAGS_seconds = static_cast<int>(n);
+    } else if (sscanf(argv[i], "--value_size=%llu%c", &n, &junk) == 1) {
+      FLAGS_value_size = n;
+    } else if (sscanf(argv[i], "--write_buffer_kb=%llu%c", &n, &junk) == 1) {
+      FLAGS_write_buffer_kb = n;
+    } else if (sscanf(argv[i], "--compaction_mb_per_sec=%llu%c", &n, &junk) ==
+               1) {
+      FLAGS_compaction_mb_per_sec = n;
+    } else if (sscanf(argv[i], "--delayed_write_mb_per_sec=%llu%c", &n,
+                      &junk) == 1) {
+      FLAGS_delayed_write_mb_per_sec = n;
+    } else {
+      std::fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+
+  Options options;
+  options.delayed_write_rate = FLAGS_delayed_write_mb_per_sec << 20;
+  std::printf("policy\twrites\tmb_per_sec\tp50_us\tp99_us\tp999_us\tmax_us\n");
+  {
+    Model model(options, false);
+    model.Run();
+    model.Report("triggers");
+  }
+  {
+    Model model(options, true);
+    model.Run();
+    model.Report("controller");
+  }
+  return 0;
+}
@@ -0,0 +1,146 @@
+#include "leveldb/async_reader.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "leveldb/block_cache.h"
+#include "leveldb/env.h"
+#include "leveldb/io_backend.h"
+#include "leveldb/options.h"
+#include "leveldb/table.h"
+#include "leveldb/table_builder.h"
+#include "utils/random.h"
+
+namespace leveldb {
+
+// Reads through another file, but has no descriptor to hand to a backend.
+class NoDescriptorFile : public RandomAccessFile {
+ public:
+  explicit NoDescriptorFile(const RandomAccessFile* file) : file_(file) {}
+
+  Status Read(uint64_t offset, size_t n, Slice* result,
+              char* scratch) const override {
+    return file_->Read(offset, n, result, scratch);
+  }
+
+ private:
+  const RandomAccessFile* const file_;
+};
+
+// A table of the even keys, looked up with Table::MultiGet through an
+// AsyncReader and checked against Table::Get, key by key.
+class AsyncReaderTest : public testing::Test {
+ protected:
+  static const int kKeys = 20000;
+
+  AsyncReaderTest() : fname_(testing::TempDir() + "async_reader_test.ldb") {
+    Options options;
+    WritableFile* file;
+    EXPECT_TRUE(options.env->NewWritableFile(fname_, &file).ok());
+    TableBuilder builder(options, file);
+    for (int i = 0; i < kKeys; i += 2) {
+      builder.Add(Key(i), Value(i));
+    }
+    EXPECT_TRUE(builder.Finish().ok());
+    EXPECT_TRUE(file->Close().ok());
+    file_size_ = builder.FileSize();
+    delete file;
+
+    RandomAccessFile* raf;
+    EXPECT_TRUE(options.env->NewRandomAccessFile(fname_, &raf).ok());
+    file_.reset(raf);
+  }
+
+  ~AsyncReaderTest() override {
+    file_.reset();
+    Env::Default()->RemoveFile(fname_);
+  }
+
+  static std::string Key(int i) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%016d", i);
+    return buf;
+  }
+
+  static std::string Value(int i) {
+    return "value" + std::to_string(i) + std::string(100, 'a' + i % 26);
+  }
+
+  // MultiGet of random keys, present and missing, on a table opened over
+  // "file" with a cold cache. Returns the reads that parked a coroutine.
+  uint64_t CheckMultiGet(IOBackend* backend, RandomAccessFile* file) {
+    BlockCache cache(64 << 20);
+    Options options;
+    options.block_cache = &cache;
+    Table* table = nullptr;
+    EXPECT_TRUE(Table::Open(options, file, 0, file_size_, &table).ok());
+    if (table == nullptr) {
+      return 0;
+    }
+    std::unique_ptr<Table> guard(table);
+
+    // More keys than coroutines, so that every coroutine does several
+    // lookups.
+    const size_t n = 2000;
+    Random rnd(301);
+    std::vector<std::string> key_strings(n);
+    std::vector<Slice> keys(n);
+    for (size_t i = 0; i < n; i++) {
+      key_strings[i] = Key(rnd.Uniform(kKeys + 100));
+      keys[i] = key_strings[i];
+    }
+    AsyncReader reader(backend, 32);
+    ReadOptions ro;
+    ro.async_reader = &reader;
+    std::vector<std::string> values(n);
+    std::vector<Status> statuses(n);
+    table->MultiGet(ro, n, keys.data(), values.data(), statuses.data());
+
+    size_t found = 0;
+    for (size_t i = 0; i < n; i++) {
+      std::string value;
+      Status s = table->Get(ReadOptions(), keys[i], &value);
+      found += s.ok();
+      EXPECT_EQ(s.ToString(), statuses[i].ToString()) << key_strings[i];
+      EXPECT_TRUE(s.ok() || s.IsNotFound()) << s.ToString();
+      if (s.ok() && statuses[i].ok()) {
+        EXPECT_EQ(value, values[i]) << key_strings[i];
+        EXPECT_EQ(Value(std::stoi(key_strings[i])), value);
+      }
+    }
+    EXPECT_GT(found, 0u);
+    EXPECT_LT(found, n);
+    return reader.reads();
+  }
+
+  const std::string fname_;
+  uint64_t file_size_ = 0;
+  std::unique_ptr<RandomAccessFile> file_;
+};
+
+TEST_F(AsyncReaderTest, IoUring) {
+  Status s;
+  std::unique_ptr<IOBackend> backend(NewIoUringBackend(64, &s));
+  if (backend == nullptr) {
+    GTEST_SKIP() << "io_uring: " << s.ToString();
+  }
+  EXPECT_GT(CheckMultiGet(backend.get(), file_.get()), 0u);
+}
+
+TEST_F(AsyncReaderTest, ThreadPool) {
+  std::unique_ptr<IOBackend> backend(NewThreadPoolBackend(4));
+  EXPECT_GT(CheckMultiGet(backend.get(), file_.get()), 0u);
+}
+
+TEST_F(AsyncReaderTest, FileWithoutDescriptor) {
+  // Read blocking, on the coroutine, without parking it.
+  std::unique_ptr<IOBackend> backend(NewThreadPoolBackend(4));
+  NoDescriptorFile file(file_.get());
+  EXPECT_EQ(0u, CheckMultiGet(backend.get(), &file));
+}
+
+}  // namespace leveldb
@@ -0,0 +1,77 @@
+#include "leveldb/block_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace leveldb {
+
+static std::vector<uint64_t> deleted;
+
+static void RecordDelete(uint64_t file_number, uint64_t offset, void* value) {
+  deleted.push_back(offset);
+}
+
+TEST(BlockCacheTest, HitAndMiss) {
+  deleted.clear();
+  BlockCache cache(1 << 20, 4096, 0);
+  EXPECT_EQ(nullptr, cache.Lookup(1, 0));
+
+  int v = 7;
+  cache.Release(cache.Insert(1, 0, &v, 4096, &RecordDelete));
+  BlockCache::Handle* h = cache.Lookup(1, 0);
+  ASSERT_NE(nullptr, h);
+  EXPECT_EQ(&v, cache.Value(h));
+  cache.Release(h);
+
+  EXPECT_EQ(nullptr, cache.Lookup(2, 0));
+  EXPECT_EQ(1u, cache.hits());
+  EXPECT_EQ(2u, cache.misses());
+  EXPECT_EQ(4096u, cache.TotalCharge());
+}
+
+TEST(BlockCacheTest, EvictsUnreferencedFirst) {
+  deleted.clear();
+  BlockCache cache(4 * 4096, 4096, 0);
+  for (uint64_t i = 0; i < 4; i++) {
+    cache.Release(cache.Insert(1, i * 4096, nullptr, 4096, &RecordDelete));
+  }
+  // Give block 0 its reference bit; block 1 should be the victim.
+  cache.Release(cache.Lookup(1, 0));
+  cache.Release(cache.Insert(1, 4 * 4096, nullptr, 4096, &RecordDelete));
+
+  ASSERT_EQ(1u, deleted.size());
+  EXPECT_EQ(4096u, deleted[0]);
+  EXPECT_EQ(4u * 4096, cache.ShardUsage(0));
+}
+
+TEST(BlockCacheTest, PinnedEntriesSurviveErase) {
+  deleted.clear();
+  BlockCache cache(1 << 20, 4096, 0);
+  BlockCache::Handle* h = cache.Insert(3, 0, nullptr, 100, &RecordDelete);
+  cache.Erase(3, 0);
+  EXPECT_EQ(nullptr, cache.Lookup(3, 0));
+  EXPECT_TRUE(deleted.empty());
+  cache.Release(h);
+  EXPECT_EQ(1u, deleted.size());
+  EXPECT_EQ(0u, cache.TotalCharge());
+}
+
+TEST(BlockCacheTest, InsertIntoPinnedShardLeavesValueToCaller) {
+  deleted.clear();
+  BlockCache cache(1 << 20, 1 << 20, 0);  // a single shard of 16 slots
+  std::vector<BlockCache::Handle*> pinned;
+  for (uint64_t i = 0;; i++) {
+    BlockCache::Handle* h = cache.Insert(4, i, nullptr, 1, &RecordDelete);
+    if (h == nullptr) break;
+    pinned.push_back(h);
+    ASSERT_LT(i, 16u);
+  }
+  EXPECT_TRUE(deleted.empty());
+  EXPECT_EQ(pinned.size(), cache.TotalCharge());
+  for (BlockCache::Handle* h : pinned) {
+    cache.Release(h);
+  }
+}
+
+}  // namespace leveldb
@@ -0,0 +1,211 @@
+#include "leveldb/compaction_job.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "leveldb/comparator.h"
+#include "leveldb/env.h"
+#include "leveldb/filename.h"
+#include "leveldb/iterator.h"
+#include "leveldb/table_builder.h"
+#include "leveldb/table_cache.h"
+#include "leveldb/version_edit.h"
+#include "leveldb/version_set.h"
+
+namespace leveldb {
+
+// The same level-0 files are compacted with one and with several
+// subcompactions. File i holds the user keys of [Key(i * kSpan),
+// Key((i + 1) * kSpan)], so every boundary key, and thus every split
+// point, has a version in two files; some of the newer ones are
+// deletions. Only the newest version of a key may survive, and a
+// deletion with it.
+class CompactionJobTest : public testing::Test {
+ protected:
+  static constexpr int kFiles = 8;
+  static constexpr int kSpan = 100;
+
+  // (internal key, value) of every output entry, in key order.
+  typedef std::vector<std::pair<std::string, std::string>> Entries;
+
+  CompactionJobTest() : env_(Env::Default()), icmp_(BytewiseComparator()) {
+    // Small blocks, so that the split points can be estimated from the
+    // indexes, and small outputs, so that every range writes several.
+    options_.block_size = 256;
+    options_.max_file_size = 8 << 10;
+    table_options_ = options_;
+    table_options_.comparator = &icmp_;
+  }
+
+  static std::string Key(int i) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "k%06d", i);
+    return buf;
+  }
+
+  // The newest entry of every user key that the inputs leave visible.
+  static Entries Expected() {
+    std::map<std::string, std::pair<std::string, std::string>> newest;
+    SequenceNumber sequence = 0;
+    for (int f = 0; f < kFiles; f++) {
+      for (int i = f * kSpan; i <= (f + 1) * kSpan; i++) {
+        sequence++;
+        if (IsDeletion(f, i)) {
+          newest.erase(Key(i));
+        } else {
+          InternalKey ikey(Key(i), sequence, kTypeValue);
+          newest[Key(i)] = {ikey.Encode().ToString(), Value(sequence)};
+        }
+      }
+    }
+    Entries result;
+    for (const auto& kvp : newest) {
+      result.push_back(kvp.second);
+    }
+    return result;
+  }
+
+  // Every other boundary key is deleted by the newer of its two files.
+  static bool IsDeletion(int file, int i) {
+    return i == file * kSpan && file % 2 == 0 && file > 0;
+  }
+
+  static std::string Value(SequenceNumber sequence) {
+    return "value" + std::to_string(sequence) + std::string(100, 'x');
+  }
+
+  // Build the inputs in a DB of their own, compact them with
+  // "max_subcompactions" ranges and return the output entries.
+  Entries Compact(int max_subcompactions, CompactionJob::Stats* stats) {
+    const std::string dbname = testing::TempDir() + "compaction_job_test_" +
+                               std::to_string(max_subcompactions);
+    env_->CreateDir(dbname);
+    RemoveFiles(dbname);
+    TableCache table_cache(dbname, table_options_, 100);
+    VersionSet versions(dbname, &options_, &table_cache, &icmp_);
+    std::mutex mu;
+    VersionEdit edit;
+    edit.SetComparatorName(icmp_.user_comparator()->Name());
+    SequenceNumber sequence = 0;
+    for (int f = 0; f < kFiles; f++) {
+      mu.lock();
+      FileMetaData meta;
+      meta.number = versions.NewFileNumber();
+      mu.unlock();
+      WritableFile* file;
+      EXPECT_TRUE(
+          env_->NewWritableFile(TableFileName(dbname, meta.number), &file)
+              .ok());
+      TableBuilder builder(table_options_, file);
+      for (int i = f * kSpan; i <= (f + 1) * kSpan; i++) {
+        sequence++;
+        InternalKey ikey(Key(i), sequence,
+                         IsDeletion(f, i) ? kTypeDeletion : kTypeValue);
+        builder.Add(ikey.Encode(),
+                    IsDeletion(f, i) ? Slice() : Slice(Value(sequence)));
+        if (i == f * kSpan) meta.smallest = ikey;
+        meta.largest = ikey;
+      }
+      EXPECT_TRUE(builder.Finish().ok());
+      EXPECT_TRUE(file->Close().ok());
+      delete file;
+      edit.AddFile(0, meta.number, builder.FileSize(), meta.smallest,
+                   meta.largest);
+    }
+    mu.lock();
+    versions.SetLastSequence(sequence);
+    EXPECT_TRUE(versions.LogAndApply(&edit, &mu).ok());
+
+    Compaction* c = versions.PickCompaction();
+    EXPECT_NE(nullptr, c);
+    if (c == nullptr) {
+      mu.unlock();
+      return Entries();
+    }
+    EXPECT_EQ(kFiles, c->num_input_files(0));
+    Options job_options = table_options_;
+    job_options.max_subcompactions = max_subcompactions;
+    {
+      CompactionJob job(dbname, job_options, &versions, &table_cache, c,
+                        versions.LastSequence());
+      EXPECT_TRUE(job.Run(&mu).ok());
+      *stats = job.stats();
+    }
+
+    // Every output is in one level, in key order and without overlap.
+    Version* v = versions.current();
+    EXPECT_EQ(0, v->NumFiles(0));
+    Entries result;
+    for (int level = 1; level < config::kNumLevels; level++) {
+      const std::vector<FileMetaData*>& files = v->files(level);
+      if (files.empty()) continue;
+      EXPECT_TRUE(result.empty()) << "outputs in several levels";
+      for (size_t i = 0; i < files.size(); i++) {
+        const FileMetaData* f = files[i];
+        if (i > 0) {
+          EXPECT_LT(icmp_.user_comparator()->Compare(
+                        files[i - 1]->largest.user_key(),
+                        f->smallest.user_key()),
+                    0)
+              << "files " << files[i - 1]->number << " and " << f->number;
+        }
+        Iterator* iter =
+            table_cache.NewIterator(ReadOptions(), f->number, f->file_size);
+        for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+          EXPECT_GE(icmp_.Compare(iter->key(), f->smallest.Encode()), 0);
+          EXPECT_LE(icmp_.Compare(iter->key(), f->largest.Encode()), 0);
+          result.emplace_back(iter->key().ToString(),
+                              iter->value().ToString());
+        }
+        EXPECT_TRUE(iter->status().ok());
+        delete iter;
+      }
+    }
+    mu.unlock();
+    return result;
+  }
+
+  void RemoveFiles(const std::string& dbname) {
+    std::vector<std::string> children;
+    env_->GetChildren(dbname, &children);
+    for (const std::string& child : children) {
+      env_->RemoveFile(dbname + "/" + child);
+    }
+  }
+
+  Env* const env_;
+  const InternalKeyComparator icmp_;
+  Options options_;
+  Options table_options_;  // comparator == &icmp_
+};
+
+TEST_F(CompactionJobTest, SubcompactionsMatchSingleRange) {
+  const Entries expected = Expected();
+  CompactionJob::Stats single, parallel;
+  const Entries one = Compact(1, &single);
+  const Entries four = Compact(4, &parallel);
+  EXPECT_EQ(1, single.num_subcompactions);
+  EXPECT_GT(parallel.num_subcompactions, 1);
+  EXPECT_LE(parallel.num_subcompactions, 4);
+  EXPECT_GT(single.num_output_files, 1);
+
+  ASSERT_EQ(expected.size(), one.size());
+  ASSERT_EQ(expected.size(), four.size());
+  for (size_t i = 0; i < expected.size(); i++) {
+    ParsedInternalKey ikey;
+    ASSERT_TRUE(ParseInternalKey(expected[i].first, &ikey));
+    EXPECT_EQ(expected[i], one[i]) << "1 range, " << ikey.DebugString();
+    EXPECT_EQ(expected[i], four[i]) << "4 ranges, " << ikey.DebugString();
+  }
+  RemoveFiles(testing::TempDir() + "compaction_job_test_1");
+  RemoveFiles(testing::TempDir() + "compaction_job_test_4");
+}
+
+}  // namespace leveldb
@@ -0,0 +1,217 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "leveldb/filename.h"
+#include "leveldb/options.h"
+#include "utils/random.h"
+
+namespace leveldb {
+
+// Values of at least min_blob_size bytes go through flushes, compactions
+// and blob garbage collection, and are read back, before and after a
+// reopen, against a model of the last write to every key.
+class DBBlobTest : public testing::Test {
+ protected:
+  static const size_t kMinBlobSize = 1000;
+
+  DBBlobTest() : dbname_(testing::TempDir() + "db_blob_test") {
+    Destroy();
+    options_.create_if_missing = true;
+    options_.write_buffer_size = 64 << 10;
+    options_.min_blob_size = kMinBlobSize;
+  }
+
+  ~DBBlobTest() override { Destroy(); }
+
+  void Destroy() {
+    Env* env = Env::Default();
+    std::vector<std::string> children;
+    env->GetChildren(dbname_, &children);
+    for (const std::string& child : children) {
+      env->RemoveFile(dbname_ + "/" + child);
+    }
+  }
+
+  std::unique_ptr<DB> Open() {
+    DB* db = nullptr;
+    Status s = DB::Open(options_, dbname_, &db);
+    EXPECT_TRUE(s.ok()) << s.ToString();
+    return std::unique_ptr<DB>(db);
+  }
+
+  static std::string Key(int i) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "k%06d", i);
+    return buf;
+  }
+
+  // Bytes of the blob files in the DB directory, and their number.
+  uint64_t BlobBytes(int* count = nullptr) {
+    Env* env = Env::Default();
+    std::vector<std::string> children;
+    env->GetChildren(dbname_, &children);
+    uint64_t bytes = 0;
+    int n = 0;
+    for (const std::string& child : children) {
+      uint64_t number, size;
+      FileType type;
+      if (ParseFileName(child, &number, &type) && type == kBlobFile &&
+          env->GetFileSize(dbname_ + "/" + child, &size).ok()) {
+        bytes += size;
+        n++;
+      }
+    }
+    if (count != nullptr) *count = n;
+    return bytes;
+  }
+
+  void Check(DB* db) {
+    for (const auto& kvp : model_) {
+      std::string value;
+      Status s = db->Get(ReadOptions(), kvp.first, &value);
+      if (kvp.second.empty()) {
+        EXPECT_TRUE(s.IsNotFound()) << kvp.first << ": " << s.ToString();
+      } else {
+        ASSERT_TRUE(s.ok()) << kvp.first << ": " << s.ToString();
+        EXPECT_EQ(kvp.second, value) << kvp.first;
+      }
+    }
+  }
+
+  const std::string dbname_;
+  Options options_;
+  // Last value written to every key; empty once deleted.
+  std::map<std::string, std::string> model_;
+};
+
+// Writer threads overwrite their own keys while garbage collection moves
+// the values that are still live, so some keys change under it.
+TEST_F(DBBlobTest, OverwritesAreReadBackAndCollected) {
+  const int kThreads = 4;
+  const int kKeys = 50;
+  const int kRounds = 12;
+  std::vector<std::map<std::string, std::string>> models(kThreads);
+  std::vector<uint64_t> value_bytes(kThreads);
+  {
+    std::unique_ptr<DB> db = Open();
+    ASSERT_NE(nullptr, db);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+      threads.emplace_back([&, t] {
+        Random rnd(301 + t);
+        std::map<std::string, std::string>& model = models[t];
+        for (int round = 0; round < kRounds; round++) {
+          for (int i = 0; i < kKeys; i++) {
+            const std::string key = Key(t * kKeys + rnd.Uniform(kKeys));
+            if (rnd.OneIn(10)) {
+              ASSERT_TRUE(db->Delete(WriteOptions(), key).ok());
+              model[key].clear();
+              continue;
+            }
+            // Mostly blob values, some of them right at the threshold.
+            const size_t size = rnd.OneIn(5)   ? 1 + rnd.Uniform(kMinBlobSize)
+                                : rnd.OneIn(5) ? kMinBlobSize
+                                               : 2000 + rnd.Uniform(4000);
+            std::string value(size, static_cast<char>('a' + round));
+            value.replace(0, key.size(), key);
+            ASSERT_TRUE(db->Put(WriteOptions(), key, value).ok());
+            model[key] = value;
+            value_bytes[t] += size;
+          }
+          for (const auto& kvp : model) {
+            std::string value;
+            Status s = db->Get(ReadOptions(), kvp.first, &value);
+            if (kvp.second.empty()) {
+              ASSERT_TRUE(s.IsNotFound()) << kvp.first << ": " << s.ToString();
+            } else {
+              ASSERT_TRUE(s.ok()) << kvp.first << ": " << s.ToString();
+              ASSERT_EQ(kvp.second, value) << kvp.first;
+            }
+          }
+        }
+      });
+    }
+    for (std::thread& t : threads) {
+      t.join();
+    }
+  }
+  uint64_t total_value_bytes = 0;
+  for (int t = 0; t < kThreads; t++) {
+    model_.insert(models[t].begin(), models[t].end());
+    total_value_bytes += value_bytes[t];
+  }
+  int blob_files;
+  const uint64_t blob_bytes = BlobBytes(&blob_files);
+  EXPECT_GT(blob_files, 0);
+  // Every key was overwritten several times; without garbage collection
+  // the blob files would hold about every value ever written.
+  EXPECT_LT(blob_bytes, total_value_bytes / 2)
+      << blob_files << " blob files, " << total_value_bytes
+      << " value bytes";
+
+  std::unique_ptr<DB> db = Open();
+  ASSERT_NE(nullptr, db);
+  Check(db.get());
+}
+
+TEST_F(DBBlobTest, CompactionSeparatesInlineValues) {
+  const int kKeys = 200;
+  options_.min_blob_size = 0;
+  {
+    std::unique_ptr<DB> db = Open();
+    ASSERT_NE(nullptr, db);
+    // Out of order, so that the tables overlap and most of them end up
+    // compacted into level 1 rather than placed below it.
+    for (int j = 0; j < kKeys; j++) {
+      const int i = (j * 7) % kKeys;
+      const std::string value(3000, static_cast<char>('a' + i % 26));
+      ASSERT_TRUE(db->Put(WriteOptions(), Key(i), value).ok());
+      model_[Key(i)] = value;
+    }
+    // Small values until the large ones are flushed and out of the log.
+    for (int i = 0; i < 2000; i++) {
+      ASSERT_TRUE(db->Put(WriteOptions(), Key(i) + "s", "small").ok());
+      model_[Key(i) + "s"] = "small";
+    }
+  }
+  EXPECT_EQ(0u, BlobBytes());
+
+  // The large values only reach a blob file when a compaction rewrites
+  // the tables that hold them inline; small keys in between make the
+  // level-0 files overlap all of them.
+  options_.min_blob_size = kMinBlobSize;
+  std::unique_ptr<DB> db = Open();
+  ASSERT_NE(nullptr, db);
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(20);
+  int round = 0;
+  while (BlobBytes() < kKeys * 3000 / 2 &&
+         std::chrono::steady_clock::now() < deadline) {
+    for (int i = 0; i < kKeys; i++) {
+      const std::string key = Key(i) + "t";
+      const std::string value(500, static_cast<char>('a' + round % 26));
+      ASSERT_TRUE(db->Put(WriteOptions(), key, value).ok());
+      model_[key] = value;
+    }
+    round++;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_GE(BlobBytes(), kKeys * 3000u / 2);
+  Check(db.get());
+  db.reset();
+
+  db = Open();
+  ASSERT_NE(nullptr, db);
+  Check(db.get());
+}
+
+}  // namespace leveldb
@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "leveldb/options.h"
+#include "utils/random.h"
+
+namespace leveldb {
+
+// Writers put and delete keys from several threads at once, so their
+// batches share WAL writes (group commit), then the DB is reopened and
+// every key is read back: some from flushed tables, the rest replayed
+// from the log.
+class DBWriteTest : public testing::TestWithParam<bool> {
+ protected:
+  DBWriteTest() : dbname_(testing::TempDir() + "db_write_test") {
+    Destroy();
+    options_.create_if_missing = true;
+    // Small enough for a few flushes, so that reopening finds tables as
+    // well as a log to replay.
+    options_.write_buffer_size = 256 << 10;
+  }
+
+  ~DBWriteTest() override { Destroy(); }
+
+  void Destroy() {
+    Env* env = Env::Default();
+    std::vector<std::string> children;
+    env->GetChildren(dbname_, &children);
+    for (const std::string& child : children) {
+      env->RemoveFile(dbname_ + "/" + child);
+    }
+  }
+
+  std::unique_ptr<DB> Open() {
+    DB* db = nullptr;
+    Status s = DB::Open(options_, dbname_, &db);
+    EXPECT_TRUE(s.ok()) << s.ToString();
+    return std::unique_ptr<DB>(db);
+  }
+
+  static std::string Key(int thread, int i) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "t%02d-%06d", thread, i);
+    return buf;
+  }
+
+  const std::string dbname_;
+  Options options_;
+};
+
+TEST_P(DBWriteTest, ConcurrentWritesSurviveReopen) {
+  const int kThreads = 8;
+  const int kOps = 3000;
+  const int kKeys = 500;
+  WriteOptions write_options;
+  write_options.sync = GetParam();
+
+  // Every thread writes its own keys, so its last write to a key wins.
+  std::vector<std::map<std::string, std::string>> expected(kThreads);
+  {
+    std::unique_ptr<DB> db = Open();
+    ASSERT_NE(nullptr, db);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+      threads.emplace_back([&, t] {
+        Random rnd(1000 + t);
+        std::map<std::string, std::string>& model = expected[t];
+        for (int i = 0; i < kOps; i++) {
+          const std::string key = Key(t, rnd.Uniform(kKeys));
+          if (rnd.OneIn(4)) {
+            ASSERT_TRUE(db->Delete(write_options, key).ok());
+            model.erase(key);
+          } else {
+            // Now and then a value larger than a log block.
+            const size_t size = rnd.OneIn(100) ? 40000 + rnd.Uniform(40000)
+                                               : 10 + rnd.Uniform(200);
+            std::string value(size, static_cast<char>('a' + i % 26));
+            value.append(std::to_string(i));
+            ASSERT_TRUE(db->Put(write_options, key, value).ok());
+            model[key] = value;
+          }
+        }
+      });
+    }
+    for (std::thread& t : threads) {
+      t.join();
+    }
+  }
+
+  std::unique_ptr<DB> db = Open();
+  ASSERT_NE(nullptr, db);
+  for (int t = 0; t < kThreads; t++) {
+    for (int i = 0; i < kKeys; i++) {
+      const std::string key = Key(t, i);
+      std::string value;
+      Status s = db->Get(ReadOptions(), key, &value);
+      auto it = expected[t].find(key);
+      if (it == expected[t].end()) {
+        EXPECT_TRUE(s.IsNotFound()) << key << ": " << s.ToString();
+      } else {
+        ASSERT_TRUE(s.ok()) << key << ": " << s.ToString();
+        EXPECT_EQ(it->second, value) << key;
+      }
+    }
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(Sync, DBWriteTest, testing::Bool());
+
+}  // namespace leveldb
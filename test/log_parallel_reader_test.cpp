@@ -0,0 +1,188 @@
+#include "leveldb/log_parallel_reader.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "leveldb/env.h"
+#include "leveldb/log_reader.h"
+#include "leveldb/log_writer.h"
+#include "utils/random.h"
+
+namespace leveldb {
+namespace log {
+
+class StringSink : public WritableFile {
+ public:
+  Status Append(const Slice& data) override {
+    contents.append(data.data(), data.size());
+    return Status::OK();
+  }
+  Status Close() override { return Status::OK(); }
+  Status Flush() override { return Status::OK(); }
+  Status Sync() override { return Status::OK(); }
+
+  std::string contents;
+};
+
+class StringSource : public SequentialFile {
+ public:
+  explicit StringSource(const std::string& contents) : contents_(contents) {}
+
+  Status Read(size_t n, Slice* result, char* scratch) override {
+    n = std::min(n, contents_.size() - pos_);
+    std::memcpy(scratch, contents_.data() + pos_, n);
+    pos_ += n;
+    *result = Slice(scratch, n);
+    return Status::OK();
+  }
+
+  Status Skip(uint64_t n) override {
+    pos_ += std::min<uint64_t>(n, contents_.size() - pos_);
+    return Status::OK();
+  }
+
+ private:
+  const std::string contents_;
+  size_t pos_ = 0;
+};
+
+// Everything a reader returned and reported, in order.
+struct Result : public Reader::Reporter {
+  void Corruption(size_t bytes, const Status& status) override {
+    events.push_back("drop " + std::to_string(bytes) + " " +
+                     status.ToString());
+  }
+
+  std::vector<std::string> events;
+};
+
+static Result ReadSerial(const std::string& contents) {
+  StringSource file(contents);
+  Result result;
+  Reader reader(&file, &result, true, 0);
+  Slice record;
+  std::string scratch;
+  while (reader.ReadRecord(&record, &scratch)) {
+    result.events.push_back("record " + record.ToString());
+  }
+  return result;
+}
+
+static Result ReadParallel(const std::string& contents, int threads) {
+  StringSource file(contents);
+  Result result;
+  ParallelReader reader(&file, &result, threads);
+  Slice record;
+  std::string scratch;
+  while (reader.ReadRecord(&record, &scratch)) {
+    result.events.push_back("record " + record.ToString());
+  }
+  return result;
+}
+
+// A log of "n" records, mostly small, some spanning blocks.
+static std::string MakeLog(Random* rnd, int n) {
+  StringSink sink;
+  Writer writer(&sink);
+  for (int i = 0; i < n; i++) {
+    const size_t size = rnd->OneIn(8) ? rnd->Uniform(3 * kBlockSize)
+                                      : rnd->Uniform(300);
+    std::string record(size, static_cast<char>('a' + i % 26));
+    record.append(std::to_string(i));
+    EXPECT_TRUE(writer.AddRecord(record).ok());
+  }
+  return sink.contents;
+}
+
+// Sets *dropped if the readers reported a corruption.
+static void CheckSame(const std::string& contents, const char* what,
+                      bool* dropped = nullptr) {
+  const Result serial = ReadSerial(contents);
+  if (dropped != nullptr) {
+    *dropped = false;
+    for (const std::string& event : serial.events) {
+      *dropped = *dropped || event.compare(0, 5, "drop ") == 0;
+    }
+  }
+  for (int threads : {1, 2, 4}) {
+    const Result parallel = ReadParallel(contents, threads);
+    ASSERT_EQ(serial.events.size(), parallel.events.size())
+        << what << ", " << threads << " threads";
+    for (size_t i = 0; i < serial.events.size(); i++) {
+      // Records are long: compare them without printing them first.
+      ASSERT_TRUE(serial.events[i] == parallel.events[i])
+          << what << ", " << threads << " threads, event " << i << ": "
+          << serial.events[i].substr(0, 80) << " vs "
+          << parallel.events[i].substr(0, 80);
+    }
+  }
+}
+
+TEST(LogParallelReaderTest, Intact) {
+  Random rnd(301);
+  for (int n : {0, 1, 10, 500}) {
+    CheckSame(MakeLog(&rnd, n), "intact");
+  }
+}
+
+TEST(LogParallelReaderTest, Truncated) {
+  Random rnd(302);
+  const std::string log = MakeLog(&rnd, 100);
+  for (int i = 0; i < 50; i++) {
+    CheckSame(log.substr(0, rnd.Uniform(log.size())), "truncated");
+  }
+  // At and around block boundaries.
+  for (size_t block = 1; block * kBlockSize < log.size() && block <= 16;
+       block++) {
+    for (int delta : {-kHeaderSize, -1, 0, 1, kHeaderSize}) {
+      CheckSame(log.substr(0, block * kBlockSize + delta), "truncated");
+    }
+  }
+}
+
+TEST(LogParallelReaderTest, Corrupted) {
+  Random rnd(303);
+  const std::string log = MakeLog(&rnd, 100);
+  int cases_with_drops = 0;
+  for (int i = 0; i < 100; i++) {
+    std::string corrupted = log;
+    // Flip a few bytes: checksums, lengths, types and payloads.
+    for (int flips = 1 + rnd.Uniform(4); flips > 0; flips--) {
+      corrupted[rnd.Uniform(corrupted.size())] ^= 1 + rnd.Uniform(255);
+    }
+    bool dropped;
+    CheckSame(corrupted, "corrupted", &dropped);
+    cases_with_drops += dropped;
+  }
+  EXPECT_GT(cases_with_drops, 50);
+}
+
+TEST(LogParallelReaderTest, Garbage) {
+  Random rnd(304);
+  const std::string log = MakeLog(&rnd, 100);
+  int cases_with_drops = 0;
+  for (int i = 0; i < 50; i++) {
+    // Overwrite a run of bytes, possibly a whole block, with noise or
+    // zeroes (a preallocated tail).
+    std::string corrupted = log;
+    const size_t begin = rnd.Uniform(corrupted.size());
+    const size_t len = std::min<size_t>(rnd.Uniform(2 * kBlockSize),
+                                        corrupted.size() - begin);
+    const bool zero = rnd.OneIn(2);
+    for (size_t j = begin; j < begin + len; j++) {
+      corrupted[j] = zero ? 0 : static_cast<char>(rnd.Uniform(256));
+    }
+    bool dropped;
+    CheckSame(corrupted, zero ? "zeroed" : "garbage", &dropped);
+    cases_with_drops += dropped;
+  }
+  EXPECT_GT(cases_with_drops, 10);
+}
+
+}  // namespace log
+}  // namespace leveldb
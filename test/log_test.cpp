@@ -0,0 +1,195 @@
+#include <gtest/gtest.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "leveldb/env.h"
+#include "leveldb/log_reader.h"
+#include "leveldb/log_writer.h"
+#include "utils/random.h"
+
+// Stands in for the pwritev() of libc, which PosixWritableFile calls. When
+// short_write_limit is set every call writes at most that many bytes, as a
+// full disk or a signal may make it, so the caller has to resume in the
+// middle of a buffer.
+static size_t short_write_limit = 0;
+
+extern "C" ssize_t pwritev(int fd, const struct iovec* iov, int iovcnt,
+                           off_t offset) {
+  size_t limit = short_write_limit > 0 ? short_write_limit : SIZE_MAX;
+  ssize_t total = 0;
+  for (int i = 0; i < iovcnt && limit > 0; i++) {
+    const size_t n = std::min(iov[i].iov_len, limit);
+    const ssize_t r = ::pwrite(fd, iov[i].iov_base, n, offset + total);
+    if (r < 0) {
+      return total > 0 ? total : -1;
+    }
+    total += r;
+    limit -= r;
+    if (static_cast<size_t>(r) < n) {
+      break;
+    }
+  }
+  return total;
+}
+
+namespace leveldb {
+namespace log {
+
+// A record of "n" bytes that tells where it came from.
+static std::string MakeRecord(size_t i, size_t n) {
+  std::string r(n, '\0');
+  for (size_t j = 0; j < n; j++) {
+    r[j] = static_cast<char>('a' + (i * 7 + j) % 26);
+  }
+  return r;
+}
+
+class ReportCollector : public Reader::Reporter {
+ public:
+  void Corruption(size_t bytes, const Status& status) override {
+    dropped_bytes += bytes;
+    message.append(status.ToString());
+  }
+
+  size_t dropped_bytes = 0;
+  std::string message;
+};
+
+class LogTest : public testing::Test {
+ protected:
+  LogTest() : fname_(testing::TempDir() + "log_test.log") {}
+
+  ~LogTest() override {
+    short_write_limit = 0;
+    Env::Default()->RemoveFile(fname_);
+  }
+
+  // Write "records", starting a new Writer on the same file every
+  // "per_writer" records as a reopened log would.
+  void Write(const std::vector<std::string>& records, size_t per_writer) {
+    WritableFile* file;
+    ASSERT_TRUE(Env::Default()->NewWritableFile(fname_, &file).ok());
+    std::unique_ptr<WritableFile> guard(file);
+    uint64_t length = 0;
+    std::unique_ptr<Writer> writer;
+    for (size_t i = 0; i < records.size(); i++) {
+      if (i % per_writer == 0) {
+        writer.reset(new Writer(file, length));
+      }
+      ASSERT_TRUE(writer->AddRecord(records[i]).ok());
+      length += RecordBytes(length, records[i].size());
+    }
+    ASSERT_TRUE(file->Close().ok());
+    uint64_t size;
+    ASSERT_TRUE(Env::Default()->GetFileSize(fname_, &size).ok());
+    ASSERT_EQ(length, size);
+  }
+
+  std::vector<std::string> Read(ReportCollector* report) {
+    SequentialFile* file;
+    EXPECT_TRUE(Env::Default()->NewSequentialFile(fname_, &file).ok());
+    std::unique_ptr<SequentialFile> guard(file);
+    Reader reader(file, report, true, 0);
+    std::vector<std::string> records;
+    Slice record;
+    std::string scratch;
+    while (reader.ReadRecord(&record, &scratch)) {
+      records.push_back(record.ToString());
+    }
+    return records;
+  }
+
+  // Bytes a record of "n" bytes takes when the log is "offset" bytes long:
+  // a header per fragment, and the padding of a block tail too short for
+  // a header.
+  static uint64_t RecordBytes(uint64_t offset, size_t n) {
+    uint64_t bytes = 0;
+    bool first = true;
+    while (first || n > 0) {
+      first = false;
+      size_t left = kBlockSize - (offset + bytes) % kBlockSize;
+      if (left < kHeaderSize) {
+        bytes += left;
+        left = kBlockSize;
+      }
+      const size_t fragment = std::min<size_t>(n, left - kHeaderSize);
+      bytes += kHeaderSize + fragment;
+      n -= fragment;
+    }
+    return bytes;
+  }
+
+  void CheckRoundTrip(const std::vector<std::string>& records,
+                      size_t per_writer) {
+    Write(records, per_writer);
+    ReportCollector report;
+    std::vector<std::string> read = Read(&report);
+    EXPECT_EQ(0u, report.dropped_bytes) << report.message;
+    ASSERT_EQ(records.size(), read.size());
+    for (size_t i = 0; i < records.size(); i++) {
+      ASSERT_EQ(records[i], read[i]) << "record " << i;
+    }
+  }
+
+  // Sizes that put record ends at and around every block boundary case,
+  // followed by random ones of up to three blocks.
+  static std::vector<std::string> Records() {
+    const size_t payload = kBlockSize - kHeaderSize;
+    std::vector<size_t> sizes = {
+        0,
+        1,
+        100,
+        payload,                    // fills a block exactly
+        payload - kHeaderSize,      // leaves room for an empty header only
+        payload - kHeaderSize + 1,  // leaves a tail to pad
+        payload - 1,
+        payload + 1,
+        2 * payload,
+        3 * kBlockSize + 17,
+        0,
+    };
+    Random rnd(301);
+    for (int i = 0; i < 200; i++) {
+      sizes.push_back(rnd.OneIn(10) ? rnd.Uniform(3 * kBlockSize)
+                                    : rnd.Uniform(200));
+    }
+    std::vector<std::string> records;
+    for (size_t i = 0; i < sizes.size(); i++) {
+      records.push_back(MakeRecord(i, sizes[i]));
+    }
+    return records;
+  }
+
+  const std::string fname_;
+};
+
+TEST_F(LogTest, RoundTrip) { CheckRoundTrip(Records(), SIZE_MAX); }
+
+TEST_F(LogTest, RoundTripAcrossWriters) {
+  // Every new Writer picks up the block offset from the file length.
+  CheckRoundTrip(Records(), 7);
+}
+
+TEST_F(LogTest, RecordOfManyBlocks) {
+  // Two pieces per fragment: more than IOV_MAX of them for one AppendV.
+  std::vector<std::string> records = {
+      MakeRecord(0, 10), MakeRecord(1, 600 * kBlockSize), MakeRecord(2, 10)};
+  CheckRoundTrip(records, SIZE_MAX);
+}
+
+TEST_F(LogTest, ShortWrites) {
+  // The limits cut headers as well as fragments in two.
+  for (size_t limit : {1000, 4099, 40000}) {
+    short_write_limit = limit;
+    CheckRoundTrip(Records(), 5);
+  }
+}
+
+}  // namespace log
+}  // namespace leveldb
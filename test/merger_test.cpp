@@ -0,0 +1,236 @@
+#include "leveldb/merger.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "leveldb/comparator.h"
+#include "leveldb/iterator.h"
+#include "utils/random.h"
+
+namespace leveldb {
+
+// A sorted run of distinct keys; every value names the child it came from.
+typedef std::vector<std::string> Keys;
+
+class KeysIterator : public Iterator {
+ public:
+  KeysIterator(const Keys* keys, int child)
+      : keys_(keys), value_(std::to_string(child)), index_(keys->size()) {}
+
+  bool Valid() const override { return index_ < keys_->size(); }
+  void SeekToFirst() override { index_ = 0; }
+  void SeekToLast() override {
+    index_ = keys_->empty() ? 0 : keys_->size() - 1;
+  }
+  void Seek(const Slice& target) override {
+    index_ = std::lower_bound(keys_->begin(), keys_->end(),
+                              target.ToString()) -
+             keys_->begin();
+  }
+  void Next() override { index_++; }
+  void Prev() override {
+    index_ = (index_ == 0) ? keys_->size() : index_ - 1;
+  }
+  Slice key() const override { return (*keys_)[index_]; }
+  Slice value() const override { return value_; }
+  Status status() const override { return Status::OK(); }
+
+ private:
+  const Keys* const keys_;
+  const std::string value_;
+  size_t index_;
+};
+
+// What the merging iterator must yield, on a list of (key, child) sorted by
+// key and then by child.  Going forward, entries with equal keys come out
+// lowest child first, going backward highest child first, so both
+// directions walk the same list.  Turning around repositions every child
+// strictly past the current key, which skips the rest of its duplicates.
+class ReferenceMerge {
+ public:
+  explicit ReferenceMerge(const std::vector<Keys>& runs) {
+    for (size_t child = 0; child < runs.size(); child++) {
+      for (const std::string& key : runs[child]) {
+        entries_.emplace_back(key, static_cast<int>(child));
+      }
+    }
+    std::sort(entries_.begin(), entries_.end());
+    pos_ = entries_.size();
+  }
+
+  bool Valid() const { return pos_ < entries_.size(); }
+  const std::string& key() const { return entries_[pos_].first; }
+  std::string value() const { return std::to_string(entries_[pos_].second); }
+
+  void SeekToFirst() {
+    pos_ = 0;
+    forward_ = true;
+  }
+  void SeekToLast() {
+    pos_ = entries_.empty() ? 0 : entries_.size() - 1;
+    forward_ = false;
+  }
+  void Seek(const std::string& target) {
+    pos_ = Begin(target);
+    forward_ = true;
+  }
+  void Next() {
+    pos_ = forward_ ? pos_ + 1 : End(key());
+    forward_ = true;
+  }
+  void Prev() {
+    const size_t begin = forward_ ? Begin(key()) : pos_;
+    pos_ = (begin == 0) ? entries_.size() : begin - 1;
+    forward_ = false;
+  }
+
+ private:
+  // First entry with a key >= "key", and first one with a key > "key".
+  size_t Begin(const std::string& key) const {
+    return std::lower_bound(entries_.begin(), entries_.end(),
+                            std::make_pair(key, -1)) -
+           entries_.begin();
+  }
+  size_t End(const std::string& key) const {
+    return std::upper_bound(entries_.begin(), entries_.end(), key,
+                            [](const std::string& k,
+                               const std::pair<std::string, int>& e) {
+                              return k < e.first;
+                            }) -
+           entries_.begin();
+  }
+
+  std::vector<std::pair<std::string, int>> entries_;
+  size_t pos_;
+  bool forward_ = true;
+};
+
+static std::string Key(int i) {
+  char buf[16];
+  std::snprintf(buf, sizeof(buf), "%04d", i);
+  return buf;
+}
+
+static Iterator* NewMerge(const std::vector<Keys>& runs) {
+  std::vector<Iterator*> children;
+  for (size_t i = 0; i < runs.size(); i++) {
+    children.push_back(new KeysIterator(&runs[i], static_cast<int>(i)));
+  }
+  return NewMergingIterator(BytewiseComparator(), children.data(),
+                            static_cast<int>(children.size()));
+}
+
+// Every child holds the same keys: ties decide the whole order.
+TEST(MergerTest, TiesFollowDirection) {
+  for (int n : {2, 3, 5, 7}) {
+    std::vector<Keys> runs(n, Keys{Key(1), Key(2)});
+    Iterator* iter = NewMerge(runs);
+    std::vector<std::string> forward, backward;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      forward.push_back(iter->key().ToString() + "/" +
+                        iter->value().ToString());
+    }
+    for (iter->SeekToLast(); iter->Valid(); iter->Prev()) {
+      backward.push_back(iter->key().ToString() + "/" +
+                         iter->value().ToString());
+    }
+    std::vector<std::string> expected;
+    for (int k : {1, 2}) {
+      for (int child = 0; child < n; child++) {
+        expected.push_back(Key(k) + "/" + std::to_string(child));
+      }
+    }
+    EXPECT_EQ(expected, forward) << n << " children";
+    std::reverse(expected.begin(), expected.end());
+    EXPECT_EQ(expected, backward) << n << " children";
+    delete iter;
+  }
+}
+
+TEST(MergerTest, EmptyChildren) {
+  for (int n : {0, 1, 3, 5, 7}) {
+    std::vector<Keys> runs(n);
+    Iterator* iter = NewMerge(runs);
+    iter->SeekToFirst();
+    EXPECT_FALSE(iter->Valid());
+    iter->SeekToLast();
+    EXPECT_FALSE(iter->Valid());
+    iter->Seek(Key(0));
+    EXPECT_FALSE(iter->Valid());
+    delete iter;
+  }
+}
+
+// Random runs over a small key space, so that most keys are in several
+// children, and some children empty; random seeks and steps that keep
+// turning around are checked against the reference after every move.
+TEST(MergerTest, RandomAgainstReference) {
+  Random rnd(301);
+  const int kKeySpace = 40;
+  for (int n : {3, 5, 7}) {
+    for (int round = 0; round < 20; round++) {
+      std::vector<Keys> runs(n);
+      for (Keys& keys : runs) {
+        if (rnd.OneIn(4)) {
+          continue;  // empty
+        }
+        const int density = 1 + rnd.Uniform(4);
+        for (int k = 0; k < kKeySpace; k++) {
+          if (rnd.OneIn(density)) {
+            keys.push_back(Key(k));
+          }
+        }
+      }
+
+      Iterator* iter = NewMerge(runs);
+      ReferenceMerge model(runs);
+      std::string ops;
+      for (int step = 0; step < 500; step++) {
+        const int op = rnd.Uniform(model.Valid() ? 10 : 3);
+        if (op == 0) {
+          iter->SeekToFirst();
+          model.SeekToFirst();
+          ops.append(" first");
+        } else if (op == 1) {
+          iter->SeekToLast();
+          model.SeekToLast();
+          ops.append(" last");
+        } else if (op == 2) {
+          const std::string target = Key(rnd.Uniform(kKeySpace + 2) - 1);
+          iter->Seek(target);
+          model.Seek(target);
+          ops.append(" seek" + target);
+        } else if (op < 6) {
+          iter->Next();
+          model.Next();
+          ops.append(" next");
+        } else {
+          iter->Prev();
+          model.Prev();
+          ops.append(" prev");
+        }
+        ASSERT_EQ(model.Valid(), iter->Valid())
+            << n << " children, round " << round << ":" << ops;
+        if (model.Valid()) {
+          ASSERT_EQ(model.key(), iter->key().ToString())
+              << n << " children, round " << round << ":" << ops;
+          ASSERT_EQ(model.value(), iter->value().ToString())
+              << n << " children, round " << round << ":" << ops;
+        }
+        // Keep the trail of operations short enough to read on failure.
+        if (ops.size() > 200) {
+          ops.erase(0, ops.size() - 200);
+        }
+      }
+      EXPECT_TRUE(iter->status().ok());
+      delete iter;
+    }
+  }
+}
+
+}  // namespace leveldb
@@ -0,0 +1,422 @@
+#include "leveldb/version_set.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "leveldb/comparator.h"
+#include "leveldb/env.h"
+#include "leveldb/filename.h"
+#include "leveldb/ingest.h"
+#include "leveldb/iterator.h"
+#include "leveldb/table_cache.h"
+#include "leveldb/version_edit.h"
+
+namespace leveldb {
+
+// File "number" covers the user keys [number * 10, number * 10 + 5], so
+// files never overlap.
+static InternalKey FileKey(uint64_t number, int offset) {
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "k%08llu",
+                static_cast<unsigned long long>(number * 10 + offset));
+  return InternalKey(buf, 1, kTypeValue);
+}
+
+static void AddFile(VersionEdit* edit, int level, uint64_t number) {
+  edit->AddFile(level, number, 1000 + number, FileKey(number, 0),
+                FileKey(number, 5));
+}
+
+// File numbers by level, in the order the version keeps them.
+static std::vector<std::vector<uint64_t>> Files(Version* v) {
+  std::vector<std::vector<uint64_t>> result(config::kNumLevels);
+  for (int level = 0; level < config::kNumLevels; level++) {
+    for (const FileMetaData* f : v->files(level)) {
+      result[level].push_back(f->number);
+    }
+  }
+  return result;
+}
+
+// Iterator over sorted user keys, each with its key as the value.
+class KeysIterator : public Iterator {
+ public:
+  explicit KeysIterator(std::vector<std::string> keys)
+      : keys_(std::move(keys)), index_(keys_.size()) {}
+
+  bool Valid() const override { return index_ < keys_.size(); }
+  void SeekToFirst() override { index_ = 0; }
+  void SeekToLast() override { index_ = keys_.size() - 1; }
+  void Seek(const Slice& target) override {
+    index_ = std::lower_bound(keys_.begin(), keys_.end(), target.ToString()) -
+             keys_.begin();
+  }
+  void Next() override { index_++; }
+  void Prev() override { index_--; }
+  Slice key() const override { return keys_[index_]; }
+  Slice value() const override { return keys_[index_]; }
+  Status status() const override { return Status::OK(); }
+
+ private:
+  const std::vector<std::string> keys_;
+  size_t index_;
+};
+
+// User keys from the middle of the range of file "number".
+static std::vector<std::string> KeysOf(uint64_t number) {
+  return {FileKey(number, 1).user_key().ToString(),
+          FileKey(number, 2).user_key().ToString()};
+}
+
+class VersionSetTest : public testing::Test {
+ protected:
+  VersionSetTest()
+      : env_(Env::Default()),
+        icmp_(BytewiseComparator()),
+        dbname_(testing::TempDir() + "version_set_test") {
+    env_->CreateDir(dbname_);
+    RemoveFiles();
+    table_options_.comparator = &icmp_;
+    table_cache_.reset(new TableCache(dbname_, table_options_, 100));
+    versions_.reset(new VersionSet(dbname_, &options_, table_cache_.get(),
+                                   &icmp_));
+    // The first edit writes the initial manifest.
+    VersionEdit edit;
+    edit.SetComparatorName(icmp_.user_comparator()->Name());
+    EXPECT_TRUE(Apply(&edit).ok());
+  }
+
+  ~VersionSetTest() override {
+    versions_.reset();
+    RemoveFiles();
+  }
+
+  void RemoveFiles() {
+    std::vector<std::string> children;
+    env_->GetChildren(dbname_, &children);
+    for (const std::string& child : children) {
+      env_->RemoveFile(dbname_ + "/" + child);
+    }
+  }
+
+  // LogAndApply() releases mu_ while writing and holds it again on return.
+  Status Apply(VersionEdit* edit) {
+    mu_.lock();
+    Status s = versions_->LogAndApply(edit, &mu_);
+    mu_.unlock();
+    return s;
+  }
+
+  uint64_t NewFileNumber() {
+    std::lock_guard<std::mutex> l(mu_);
+    return versions_->NewFileNumber();
+  }
+
+  // Ingest "keys", apply the edit and return the level of every new file.
+  std::vector<int> Ingest(const std::vector<std::string>& keys) {
+    TableIngestor ingestor(dbname_, options_, versions_.get());
+    KeysIterator input(keys);
+    EXPECT_TRUE(ingestor.Add(&input).ok());
+    VersionEdit edit;
+    EXPECT_TRUE(ingestor.Finish(&edit).ok());
+    EXPECT_TRUE(Apply(&edit).ok());
+    ingestor.Commit();
+    EXPECT_EQ(ingestor.sequence(), versions_->LastSequence());
+
+    std::vector<int> levels;
+    std::vector<std::vector<uint64_t>> files = Files(versions_->current());
+    for (const FileMetaData& f : ingestor.files()) {
+      EXPECT_TRUE(env_->FileExists(TableFileName(dbname_, f.number)));
+      int level = -1;
+      for (int l = 0; l < config::kNumLevels; l++) {
+        if (std::find(files[l].begin(), files[l].end(), f.number) !=
+            files[l].end()) {
+          level = l;
+        }
+      }
+      levels.push_back(level);
+    }
+    return levels;
+  }
+
+  // A VersionSet recovered from the manifest written so far.
+  std::unique_ptr<VersionSet> Recover() {
+    std::unique_ptr<VersionSet> recovered(
+        new VersionSet(dbname_, &options_, table_cache_.get(), &icmp_));
+    EXPECT_TRUE(recovered->Recover().ok());
+    return recovered;
+  }
+
+  Env* const env_;
+  const InternalKeyComparator icmp_;
+  const std::string dbname_;
+  Options options_;
+  Options table_options_;
+  std::unique_ptr<TableCache> table_cache_;
+  std::mutex mu_;
+  std::unique_ptr<VersionSet> versions_;
+};
+
+TEST_F(VersionSetTest, ConcurrentEditsRecover) {
+  const int kThreads = 8;
+  const int kEditsPerThread = 25;
+  std::vector<std::vector<uint64_t>> added(kThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([this, t, &added] {
+      // Every thread owns one level (and level 0 is shared by two), adds
+      // its files one edit at a time, and drops every third file again.
+      const int level = t % config::kNumLevels;
+      for (int i = 0; i < kEditsPerThread; i++) {
+        VersionEdit edit;
+        const uint64_t number = NewFileNumber();
+        AddFile(&edit, level, number);
+        added[t].push_back(number);
+        if (i % 3 == 2) {
+          edit.RemoveFile(level, added[t][i - 2]);
+        }
+        ASSERT_TRUE(Apply(&edit).ok());
+      }
+    });
+  }
+  for (std::thread& t : threads) {
+    t.join();
+  }
+
+  // Queued edits are committed in groups, at most one record each.
+  EXPECT_LE(versions_->ManifestRecords(),
+            static_cast<uint64_t>(1 + kThreads * kEditsPerThread));
+
+  std::vector<std::set<uint64_t>> expected(config::kNumLevels);
+  for (int t = 0; t < kThreads; t++) {
+    for (int i = 0; i < kEditsPerThread; i++) {
+      if (i % 3 != 0 || i + 2 >= kEditsPerThread) {
+        expected[t % config::kNumLevels].insert(added[t][i]);
+      }
+    }
+  }
+  std::vector<std::vector<uint64_t>> files = Files(versions_->current());
+  for (int level = 0; level < config::kNumLevels; level++) {
+    EXPECT_EQ(expected[level], std::set<uint64_t>(files[level].begin(),
+                                                  files[level].end()))
+        << "level " << level;
+  }
+
+  std::unique_ptr<VersionSet> recovered = Recover();
+  EXPECT_EQ(files, Files(recovered->current()));
+  EXPECT_EQ(versions_->current()->DebugString(),
+            recovered->current()->DebugString());
+  EXPECT_EQ(versions_->LastSequence(), recovered->LastSequence());
+  EXPECT_EQ(versions_->LogNumber(), recovered->LogNumber());
+  // Recovery takes the next number for the manifest it will write; no
+  // number handed out before is handed out again.
+  EXPECT_EQ(versions_->NextFileNumber(), recovered->ManifestFileNumber());
+  EXPECT_EQ(versions_->NextFileNumber() + 1, recovered->NextFileNumber());
+}
+
+TEST_F(VersionSetTest, RecoverLastSequence) {
+  VersionEdit edit;
+  AddFile(&edit, 2, NewFileNumber());
+  {
+    std::lock_guard<std::mutex> l(mu_);
+    versions_->SetLastSequence(100);
+  }
+  ASSERT_TRUE(Apply(&edit).ok());
+  EXPECT_EQ(100u, versions_->LastSequence());
+
+  // An edit carrying a later sequence (an ingestion) moves it on.
+  VersionEdit ingest;
+  AddFile(&ingest, 6, NewFileNumber());
+  ingest.SetLastSequence(250);
+  ASSERT_TRUE(Apply(&ingest).ok());
+  EXPECT_EQ(250u, versions_->LastSequence());
+
+  // An edit carrying an older one does not move it back.
+  VersionEdit stale;
+  stale.SetLastSequence(7);
+  ASSERT_TRUE(Apply(&stale).ok());
+  EXPECT_EQ(250u, versions_->LastSequence());
+
+  std::unique_ptr<VersionSet> recovered = Recover();
+  EXPECT_EQ(250u, recovered->LastSequence());
+  EXPECT_EQ(Files(versions_->current()), Files(recovered->current()));
+}
+
+TEST_F(VersionSetTest, UnchangedLevelsAreShared) {
+  VersionEdit setup;
+  for (int level = 0; level < config::kNumLevels; level++) {
+    AddFile(&setup, level, NewFileNumber());
+  }
+  ASSERT_TRUE(Apply(&setup).ok());
+
+  Version* before = versions_->current();
+  before->Ref();
+  VersionEdit edit;
+  AddFile(&edit, 3, NewFileNumber());
+  ASSERT_TRUE(Apply(&edit).ok());
+  Version* after = versions_->current();
+  ASSERT_NE(before, after);
+
+  for (int level = 0; level < config::kNumLevels; level++) {
+    if (level == 3) {
+      EXPECT_NE(&before->files(level), &after->files(level));
+      EXPECT_EQ(1, before->NumFiles(level));
+      EXPECT_EQ(2, after->NumFiles(level));
+    } else {
+      EXPECT_EQ(&before->files(level), &after->files(level))
+          << "level " << level;
+    }
+  }
+  {
+    std::lock_guard<std::mutex> l(mu_);
+    before->Unref();
+  }
+}
+
+TEST_F(VersionSetTest, ManifestRolloverRecovers) {
+  // Every edit from here on finds the manifest full, so it starts a new one
+  // that opens with a snapshot of the current version.
+  options_.max_manifest_file_size = 1;
+  std::vector<uint64_t> added;
+  for (int i = 0; i < 12; i++) {
+    const uint64_t old_manifest = versions_->ManifestFileNumber();
+    VersionEdit edit;
+    const uint64_t number = NewFileNumber();
+    AddFile(&edit, i % config::kNumLevels, number);
+    added.push_back(number);
+    if (i % 4 == 3) {
+      edit.RemoveFile((i - 2) % config::kNumLevels, added[i - 2]);
+    }
+    if (i % 3 == 0) {
+      const uint64_t blob = NewFileNumber();
+      edit.AddBlobFile(blob, 100 + i, 10000 + i);
+      edit.AddBlobGarbage(blob, i, 100 * i);
+    }
+    edit.SetCompactPointer(i % config::kNumLevels, FileKey(number, 5));
+    edit.SetLogNumber(NewFileNumber());
+    edit.SetLastSequence(1000 + i);
+    ASSERT_TRUE(Apply(&edit).ok());
+    ASSERT_NE(old_manifest, versions_->ManifestFileNumber()) << "edit " << i;
+
+    // CURRENT names the new manifest, so recovery only sees the snapshot
+    // and the edit after it.
+    std::unique_ptr<VersionSet> recovered = Recover();
+    EXPECT_EQ(versions_->current()->DebugString(),
+              recovered->current()->DebugString())
+        << "edit " << i;
+    EXPECT_EQ(Files(versions_->current()), Files(recovered->current()));
+    EXPECT_EQ(versions_->LastSequence(), recovered->LastSequence());
+    EXPECT_EQ(versions_->LogNumber(), recovered->LogNumber());
+    EXPECT_EQ(versions_->NextFileNumber(), recovered->ManifestFileNumber());
+  }
+}
+
+TEST_F(VersionSetTest, DynamicLevelTargets) {
+  options_.level_compaction_dynamic_level_bytes = true;
+  options_.max_bytes_for_level_base = 1000;
+  options_.max_bytes_for_level_multiplier = 10;
+
+  // Sized from the last level down: level 1 would be 1e9 / 10^5 bytes,
+  // more than the base size, yet there is no level above it to open.
+  VersionEdit edit;
+  const uint64_t last = NewFileNumber();
+  edit.AddFile(config::kNumLevels - 1, last, 1000000000, FileKey(last, 0),
+               FileKey(last, 5));
+  AddFile(&edit, 1, NewFileNumber());
+  ASSERT_TRUE(Apply(&edit).ok());
+  Version* v = versions_->current();
+  EXPECT_EQ(1, v->base_level());
+  double target = 10000;
+  for (int level = 1; level < config::kNumLevels; level++) {
+    EXPECT_DOUBLE_EQ(target, v->MaxBytesForLevel(level)) << "level " << level;
+    target *= 10;
+  }
+
+  // With only a small last level every target is the base size at least.
+  VersionEdit shrink;
+  shrink.RemoveFile(config::kNumLevels - 1, last);
+  ASSERT_TRUE(Apply(&shrink).ok());
+  v = versions_->current();
+  EXPECT_EQ(1, v->base_level());
+  for (int level = 1; level < config::kNumLevels; level++) {
+    EXPECT_LE(1000, v->MaxBytesForLevel(level)) << "level " << level;
+  }
+}
+
+TEST_F(VersionSetTest, IngestPlacesFilesAndAdvancesSequence) {
+  const uint64_t in_level1 = NewFileNumber();
+  const uint64_t in_level3 = NewFileNumber();
+  VersionEdit setup;
+  AddFile(&setup, 1, in_level1);
+  AddFile(&setup, 3, in_level3);
+  {
+    std::lock_guard<std::mutex> l(mu_);
+    versions_->SetLastSequence(100);
+  }
+  ASSERT_TRUE(Apply(&setup).ok());
+
+  // Each file stops right above the first level it overlaps.
+  EXPECT_EQ(std::vector<int>{0}, Ingest(KeysOf(in_level1)));
+  EXPECT_EQ(101u, versions_->LastSequence());
+  EXPECT_EQ(std::vector<int>{2}, Ingest(KeysOf(in_level3)));
+  EXPECT_EQ(std::vector<int>{config::kNumLevels - 1},
+            Ingest(KeysOf(NewFileNumber())));
+  EXPECT_EQ(103u, versions_->LastSequence());
+
+  // One file per key, each at the deepest level its own range allows:
+  // the first two overlap the file just ingested at level 2.
+  options_.block_size = 1;
+  options_.max_file_size = 1;
+  std::vector<std::string> keys = KeysOf(in_level3);
+  const std::vector<std::string> more = KeysOf(NewFileNumber());
+  keys.insert(keys.end(), more.begin(), more.end());
+  EXPECT_EQ((std::vector<int>{1, 1, config::kNumLevels - 1,
+                              config::kNumLevels - 1}),
+            Ingest(keys));
+  EXPECT_EQ(104u, versions_->LastSequence());
+
+  std::unique_ptr<VersionSet> recovered = Recover();
+  EXPECT_EQ(104u, recovered->LastSequence());
+  EXPECT_EQ(Files(versions_->current()), Files(recovered->current()));
+}
+
+TEST_F(VersionSetTest, UncommittedIngestionRemovesFiles) {
+  const std::string before = versions_->current()->DebugString();
+  std::vector<uint64_t> numbers;
+  {
+    // Abandoned while a file is still being written.
+    TableIngestor ingestor(dbname_, options_, versions_.get());
+    KeysIterator input(KeysOf(1));
+    ASSERT_TRUE(ingestor.Add(&input).ok());
+    ASSERT_EQ(1u, ingestor.files().size());
+    numbers.push_back(ingestor.files()[0].number);
+    ingestor.Abandon();
+    EXPECT_TRUE(ingestor.files().empty());
+  }
+  {
+    // Finished, but the edit is never applied: the destructor cleans up.
+    TableIngestor ingestor(dbname_, options_, versions_.get());
+    KeysIterator input(KeysOf(2));
+    ASSERT_TRUE(ingestor.Add(&input).ok());
+    VersionEdit edit;
+    ASSERT_TRUE(ingestor.Finish(&edit).ok());
+    numbers.push_back(ingestor.files()[0].number);
+    EXPECT_TRUE(env_->FileExists(TableFileName(dbname_, numbers.back())));
+  }
+  for (uint64_t number : numbers) {
+    EXPECT_FALSE(env_->FileExists(TableFileName(dbname_, number))) << number;
+  }
+  EXPECT_EQ(0u, versions_->LastSequence());
+  EXPECT_EQ(before, versions_->current()->DebugString());
+}
+
+}  // namespace leveldb
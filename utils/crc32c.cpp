@@ -0,0 +1,59 @@
+#include "crc32c.h"
+
+namespace leveldb {
+namespace crc32c {
+
+namespace {
+
+// Castagnoli polynomial, reflected.
+const uint32_t kPoly = 0x82f63b78u;
+
+// Slicing-by-4 tables, built once on first use.
+struct Tables {
+  uint32_t t[4][256];
+
+  Tables() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t crc = i;
+      for (int k = 0; k < 8; k++) {
+        crc = (crc >> 1) ^ ((crc & 1) ? kPoly : 0);
+      }
+      t[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+      for (int s = 1; s < 4; s++) {
+        t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xff];
+      }
+    }
+  }
+};
+
+const Tables& GetTables() {
+  static const Tables tables;
+  return tables;
+}
+
+}  // namespace
+
+uint32_t Extend(uint32_t init_crc, const char* data, size_t n) {
+  const uint32_t(*t)[256] = GetTables().t;
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+  const uint8_t* e = p + n;
+  uint32_t l = init_crc ^ 0xffffffffu;
+
+  while (e - p >= 4) {
+    l ^= static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+         (static_cast<uint32_t>(p[2]) << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+    l = t[3][l & 0xff] ^ t[2][(l >> 8) & 0xff] ^ t[1][(l >> 16) & 0xff] ^
+        t[0][l >> 24];
+    p += 4;
+  }
+  while (p != e) {
+    l = t[0][(l ^ *p++) & 0xff] ^ (l >> 8);
+  }
+  return l ^ 0xffffffffu;
+}
+
+}  // namespace crc32c
+}  // namespace leveldb
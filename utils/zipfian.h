@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "utils/random.h"
+
+namespace leveldb {
+
+// Zipfian distributed integers in [0, n), following the generator used by
+// YCSB (Gray et al., "Quickly Generating Billion-Record Synthetic
+// Databases"). Item 0 is the most popular one; use Scrambled() to spread
+// the hot items over the key space.
+class ZipfianGenerator {
+ public:
+  ZipfianGenerator(uint64_t n, double theta, uint32_t seed)
+      : n_(n), theta_(theta), rnd_(seed) {
+    zeta2_ = Zeta(2, theta_);
+    zetan_ = Zeta(n_, theta_);
+    alpha_ = 1.0 / (1.0 - theta_);
+    eta_ = (1 - std::pow(2.0 / n_, 1 - theta_)) / (1 - zeta2_ / zetan_);
+  }
+
+  uint64_t Next() {
+    double u = static_cast<double>(rnd_.Next()) / 2147483647.0;
+    double uz = u * zetan_;
+    if (uz < 1.0) return 0;
+    if (uz < 1.0 + std::pow(0.5, theta_)) return 1;
+    uint64_t v =
+        static_cast<uint64_t>(n_ * std::pow(eta_ * u - eta_ + 1, alpha_));
+    return v < n_ ? v : n_ - 1;
+  }
+
+  // Same popularity ranking, but hot items are not adjacent.
+  uint64_t Scrambled() { return FNVHash64(Next()) % n_; }
+
+ private:
+  static double Zeta(uint64_t n, double theta) {
+    double sum = 0;
+    for (uint64_t i = 0; i < n; i++) {
+      sum += 1 / std::pow(i + 1, theta);
+    }
+    return sum;
+  }
+
+  static uint64_t FNVHash64(uint64_t v) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (int i = 0; i < 8; i++) {
+      h ^= v & 0xff;
+      h *= 1099511628211ull;
+      v >>= 8;
+    }
+    return h;
+  }
+
+  const uint64_t n_;
+  const double theta_;
+  double zeta2_;
+  double zetan_;
+  double alpha_;
+  double eta_;
+  Random rnd_;
+};
+
+}  // namespace leveldb